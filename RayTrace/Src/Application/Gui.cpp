@@ -6,7 +6,8 @@ void Gui::init(Gui::CreateInfo info)
 {
 	APP_LOG_INFO("Initializing ImGui");
 
-	m_device = &info.pSystemContext->getDevice();
+	m_device      = &info.pSystemContext->getDevice();
+	m_gpuProfiler = info.pGpuProfiler;
 
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -126,6 +127,14 @@ void Gui::beginUI()
 			{
 				ImGui::SetTooltip("Change the exposure to control the scene's overall brightness.");
 			}
+
+			ImGui::SliderFloat("LOD Threshold", &m_state.lodThreshold, 0.0f, 10.0f);
+
+			// Tooltip for LOD threshold slider
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip("Largest on screen error in pixels allowed when choosing a simplified mesh. Set to 0 to always use full detail. Only affects rasterization.");
+			}
 		}
 
 		// Lighting settings
@@ -253,6 +262,9 @@ void Gui::beginUI()
 			ImGui::Text("FPS: %.1f", framerate);
 		}
 
+		renderProfilerUI();
+		renderMemoryUI();
+
 		if (ImGui::BeginMainMenuBar()) 
 		{
 
@@ -362,3 +374,80 @@ void Gui::renderRtxCamera()
 	m_state.changed |= ImGui::SliderFloat("Lens Radius", &m_state.lensRadius, 0.0f, 0.5f);
 	ImGui::SetItemTooltip("Adjust the aperture size of the lens");
 }
+
+void Gui::renderMemoryUI()
+{
+	if (!ImGui::CollapsingHeader("Memory"))
+		return;
+
+	const float      megabyte  = 1024.0f * 1024.0f;
+	MemoryAllocator& allocator = m_device->getAllocator();
+
+	ImGui::SeparatorText("Heaps");
+
+	std::vector<MemoryAllocator::HeapBudget> budgets = allocator.getHeapBudgets();
+	for (size_t i = 0; i < budgets.size(); i++)
+	{
+		const auto& heap = budgets[i];
+
+		float usage    = heap.usage / megabyte;
+		float budget   = heap.budget / megabyte;
+		float fraction = (heap.budget > 0) ? static_cast<float>(heap.usage) / heap.budget : 0.0f;
+
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB", usage, budget);
+
+		ImGui::Text("Heap %zu%s", i, heap.deviceLocal ? " (device local)" : "");
+		ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), overlay);
+	}
+
+	if (!m_device->isMemoryBudgetSupported())
+		ImGui::TextDisabled("Budgets are heap sizes, VK_EXT_memory_budget is not supported");
+
+	ImGui::SeparatorText("Categories");
+
+	MemoryAllocator::Stats stats = allocator.getStats();
+	for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::ENUM_MAX); i++)
+		ImGui::Text("%s: %.1f MB", MemoryAllocator::GetCategoryName(static_cast<MemoryCategory>(i)), stats.categoryBytes[i] / megabyte);
+
+	ImGui::SeparatorText("Allocator");
+
+	ImGui::Text("Blocks: %u (%u dedicated)", stats.blockCount, stats.dedicatedCount);
+	ImGui::Text("Allocations: %u", stats.allocationCount);
+	ImGui::Text("Used: %.1f / %.1f MB", stats.usedBytes / megabyte, stats.reservedBytes / megabyte);
+
+	if (ImGui::Button("Dump Memory Report"))
+		allocator.writeReport("memory_report.json");
+	ImGui::SetItemTooltip("Write every live resource to memory_report.json");
+}
+
+void Gui::renderProfilerUI()
+{
+	if (!m_gpuProfiler || !ImGui::CollapsingHeader("GPU Timings"))
+		return;
+
+	const auto& timings = m_gpuProfiler->getTimings();
+	if (timings.empty())
+		ImGui::TextDisabled("No timings were read yet");
+
+	for (const auto& timing : timings)
+	{
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "%.3f ms (avg %.3f ms)", timing.latest, timing.average);
+
+		// Graphs are scaled to twice the average so that spikes stand out without flattening the rest
+		ImGui::Text("%s", timing.name.c_str());
+		ImGui::PlotLines(
+			("##" + timing.name).c_str(),
+			timing.history.data(),
+			static_cast<int>(timing.history.size()),
+			static_cast<int>(m_gpuProfiler->getHistoryOffset()),
+			overlay,
+			0.0f, std::max(timing.average * 2.0f, 0.01f),
+			ImVec2(-1.0f, 50.0f));
+	}
+
+	if (ImGui::Button("Export GPU Timings"))
+		m_gpuProfiler->writeCsv("gpu_timings.csv");
+	ImGui::SetItemTooltip("Write the timing history to gpu_timings.csv");
+}
@@ -13,6 +13,7 @@
 #include "Core/system_context.h"
 #include "Core/render_pass.h"
 #include "Core/descriptor.h"
+#include "Core/gpu_profiler.h"
 
 /*
 * General flow to follow 
@@ -97,6 +98,7 @@ public:
 		uint32_t              minImageCount;
 		uint32_t              imageCount;                   
 		VkSampleCountFlagBits msaaSamples;
+		GpuProfiler*          pGpuProfiler = nullptr; // Optional, shows the GPU timings
 	};
 
 	struct UiState
@@ -109,6 +111,7 @@ public:
 		// Scene
 		float backgroundColor[3] = { 1.0f, 1.0f, 1.0f };
 		float exposure           = 1.0;
+		float lodThreshold       = 1.0f;
 
 		// Lighting
 		float lightColor[3]    = { 1.0f, 1.0f, 1.0f };
@@ -184,7 +187,8 @@ private:
 			: name(_name), button(_button) {}
 	};
 
-	const Device* m_device = nullptr;
+	const Device* m_device      = nullptr;
+	GpuProfiler*  m_gpuProfiler = nullptr;
 
 	DescriptorPool m_descriptorPool;
 
@@ -193,4 +197,6 @@ private:
 
 	void renderRtxUI();
 	void renderRtxCamera();
+	void renderMemoryUI();
+	void renderProfilerUI();
 };
@@ -2,6 +2,73 @@
 
 #include "application.h"
 
+#include <algorithm>
+
+// Shaders of every pipeline. The names are sources in the shader directory
+struct PipelineShader
+{
+	ShaderStage stage;
+	const char* name;
+	uint32_t    hitGroup = 0;
+};
+
+static const std::vector<PipelineShader>& getPipelineShaders(Pipeline::PipelineType type)
+{
+	static const std::vector<std::vector<PipelineShader>> shaders = {
+		// LIGHTING
+		{
+			{ ShaderStage::VERT, "lighting.vert" },
+			{ ShaderStage::FRAG, "lighting.frag" }
+		},
+		// FLAT
+		{
+			{ ShaderStage::VERT, "flat.vert" },
+			{ ShaderStage::FRAG, "flat.frag" }
+		},
+		// POST
+		{
+			{ ShaderStage::VERT, "post.vert" },
+			{ ShaderStage::FRAG, "post.frag" }
+		},
+		// RTX_RT
+		{
+			{ ShaderStage::RGEN, "rtx_main.rgen" },
+			{ ShaderStage::MISS, "rtx_main.rmiss" },
+			{ ShaderStage::MISS, "rtx_shadow.rmiss" },
+			{ ShaderStage::CHIT, "rtx_main.rchit",   0 },
+			{ ShaderStage::AHIT, "rtx_main_0.rahit", 0 },
+			{ ShaderStage::AHIT, "rtx_main_1.rahit", 1 }
+		},
+		// RTX_PATH
+		{
+			{ ShaderStage::RGEN, "rtx_path.rgen" },
+			{ ShaderStage::MISS, "rtx_path.rmiss" },
+			{ ShaderStage::CHIT, "rtx_path.rchit", 0 },
+			{ ShaderStage::AHIT, "rtx_path.rahit", 0 }
+		}
+	};
+
+	return shaders[type];
+}
+
+static bool isRtxPipeline(Pipeline::PipelineType type)
+{
+	return type == Pipeline::RTX_RT || type == Pipeline::RTX_PATH;
+}
+
+static const char* getPipelineName(Pipeline::PipelineType type)
+{
+	switch (type)
+	{
+		case Pipeline::LIGHTING: return "Lighting Pipeline";
+		case Pipeline::FLAT:     return "Flat Pipeline";
+		case Pipeline::POST:     return "Post Pipeline";
+		case Pipeline::RTX_RT:   return "RTX Real Time Pipeline";
+		case Pipeline::RTX_PATH: return "RTX Path Pipeline";
+		default:                 return "Pipeline";
+	}
+}
+
 void Application::init(Application::Settings& settings)
 {
 	// Store settings
@@ -9,6 +76,7 @@ void Application::init(Application::Settings& settings)
 
 	// Initialize logger to info level
 	Logger::init(LogLevel::INFO);
+	APP_PROFILE_THREAD("Main");
 
 	// CPU Raytracing
 	if (m_settings.cpuRaytracing)
@@ -35,12 +103,39 @@ void Application::init(Application::Settings& settings)
 	swapchainCreateInfo.msaa           = false;
 	m_swapchain.init(swapchainCreateInfo);
 
-	// Command system
-	m_commandSystem.init(*m_device, m_settings.framesInFlight);
+	// Workers that compile the pipelines and record the scene in parallel
+	JobSystem::CreateInfo jobInfo{};
+	jobInfo.threadCount = m_settings.recordingThreads;
+	m_jobSystem.init(jobInfo);
+
+	// Shaders are compiled from source and cached
+	ShaderCompiler::CreateInfo compilerInfo{};
+	compilerInfo.watch = m_settings.hotReloadShaders;
+	if (!m_device->areFragmentStoresSupported())
+		compilerInfo.defines.push_back("NO_FRAGMENT_STORES");
+	m_shaderCompiler.init(compilerInfo);
+
+	// Command system. Each frame is recorded into two command buffers, before and after the post processing
+	m_commandSystem.init(*m_device, m_settings.framesInFlight, 2, m_jobSystem.getThreadCount());
+
+	// GPU timings of the passes
+	GpuProfiler::CreateInfo profilerInfo{};
+	profilerInfo.device         = m_device;
+	profilerInfo.framesInFlight = m_settings.framesInFlight;
+	m_gpuProfiler.init(profilerInfo);
 
 	// Offscreen render
 	setupOffscreenRender();
 
+	// Post processing on the compute queue
+	PostProcessor::CreateInfo postInfo{};
+	postInfo.device         = m_device;
+	postInfo.extent         = m_swapchain.getExtent();
+	postInfo.sourceFormat   = m_offscreenColorTexture.getImage().format;
+	postInfo.framesInFlight = m_settings.framesInFlight;
+	postInfo.profiler       = &m_gpuProfiler;
+	m_postProcessor.init(postInfo);
+
 	// Render passes
 	createRenderPasses();
 
@@ -73,11 +168,25 @@ void Application::init(Application::Settings& settings)
 	guiInfo.minImageCount  = m_swapchain.getMinImageCount();
 	guiInfo.imageCount     = m_swapchain.getImageCount();
 	guiInfo.msaaSamples    = m_swapchain.getMSAASampleCount();
+	guiInfo.pGpuProfiler   = &m_gpuProfiler;
 	m_gui.init(guiInfo);
 
 	// Load scene
 	m_sceneBuilder.init(*m_device, m_commandSystem, m_gui);
-	m_scene.onLoad(m_sceneBuilder);
+	m_sceneBuilder.setTextureStreaming(m_settings.streamTextures);
+	m_sceneBuilder.setJobSystem(&m_jobSystem);
+	{
+		APP_PROFILE_ZONE("Scene Load");
+		m_scene.onLoad(m_sceneBuilder);
+	}
+
+	// Stream the finer levels of the scene textures
+	TextureStreamer::CreateInfo streamerInfo{};
+	streamerInfo.device         = m_device;
+	streamerInfo.commandSystem  = &m_commandSystem;
+	streamerInfo.framesInFlight = m_settings.framesInFlight;
+	streamerInfo.budget         = static_cast<VkDeviceSize>(m_settings.textureBudget) * 1024 * 1024;
+	m_textureStreamer.init(streamerInfo, m_sceneBuilder.getTextureInfo(), m_sceneBuilder.getTextureStreamInfo());
 
 	// Create object description buffer
 	std::vector<ObjectDescription> objectDescriptions = m_sceneBuilder.getObjectDescriptions();
@@ -90,6 +199,14 @@ void Application::init(Application::Settings& settings)
 	createInfo.name             = "Object Description Storage Buffer";
 	m_objectDescBuffer = Buffer::CreateStorageBuffer(createInfo);
 
+	// Create the scene material table
+	std::vector<Material> materials = m_sceneBuilder.getMaterials();
+	createInfo.data      = materials.data();
+	createInfo.dataSize  = sizeof(Material) * materials.size();
+	createInfo.dataCount = static_cast<uint32_t>(materials.size());
+	createInfo.name      = "Material Storage Buffer";
+	m_materialBuffer = Buffer::CreateStorageBuffer(createInfo);
+
 	// Create acceleration structure
 	if (m_device->isRtxSupported())
 		m_accelerationStructure.init(m_sceneBuilder.getModelInformation(), m_sceneBuilder.getInstances(), *m_device, m_commandSystem);
@@ -111,10 +228,12 @@ void Application::init(Application::Settings& settings)
 	cameraInfo.window = m_window;
 	m_camera.init(cameraInfo);
 
-	// Pipeline
+	// Pipeline. Reflections are compiled out of the ray tracing shaders when no material of the scene has them
+	const std::vector<Material>& sceneMaterials = m_sceneBuilder.getMaterials();
+	m_sceneReflections = std::any_of(sceneMaterials.begin(), sceneMaterials.end(), [](const Material& material) {
+		return material.illum == 3;
+	});
 	createPipelines();
-	if (m_device->isRtxSupported())
-		createRtxPipeline();
 
 	// Renderer
 	Renderer::CreateInfo rendererInfo{};
@@ -130,6 +249,11 @@ void Application::init(Application::Settings& settings)
 	rendererInfo.pGui                     = &m_gui;
 	rendererInfo.pOffscreenFramebuffer    = &m_offscreenFramebuffer;
 	rendererInfo.pPostFramebuffers        = m_postFramebuffers.data();
+	rendererInfo.pTextureStreamer         = &m_textureStreamer;
+	rendererInfo.pJobSystem               = &m_jobSystem;
+	rendererInfo.pGpuProfiler             = &m_gpuProfiler;
+	rendererInfo.pPostProcessor           = &m_postProcessor;
+	rendererInfo.pOffscreenTexture        = &m_offscreenColorTexture;
 
 	if (m_device->isRtxSupported())
 	{
@@ -158,6 +282,7 @@ void Application::run()
 	while (!m_window.isWindowClosed())
 	{
 		pollEvents();
+		updatePipelines();
 
 		if (m_window.isWindowMinimized())
 			continue;
@@ -222,68 +347,66 @@ void Application::createRenderPasses()
 
 void Application::createPipelines()
 {
+	APP_PROFILE_FUNCTION();
 	APP_LOG_INFO("Creating pipelines");
 
-	// Create a pipeline builder
-	auto builder = Pipeline::Builder(*m_device);
-
-	// Offscreen
-	{
-		builder.addGraphicsBase();
-
-		builder.disableFaceCulling();
-
-		builder.linkRenderPass(m_renderPasses[RenderPass::MAIN]);
-		builder.linkDescriptorSetLayouts(&m_offscreenDescriptorLayout.layout, 1);
-		builder.linkPushConstants(sizeof(MeshPushConstants));
+	// Every pipeline has its own builder and shaders, so they are compiled on the job system at the same time. The
+	// pipeline cache is internally synchronized and shared by all of them. These are the generic pipelines, the
+	// variants for the settings of the UI are built later by updatePipelines()
+	uint32_t pipelineCount = (m_device->isRtxSupported()) ? Pipeline::RTX_PATH + 1 : Pipeline::POST + 1;
+	m_pipelines.resize(pipelineCount);
 
-		// Lighting shaders
-		ShaderSet lightingShaders(*m_device);
-		lightingShaders.addShader(ShaderStage::VERT, "../../Shaders/lighting_vert.spv");
-		lightingShaders.addShader(ShaderStage::FRAG, "../../Shaders/lighting_frag.spv");
-		builder.linkShaders(lightingShaders);
+	std::vector<PipelineVariant> variants(pipelineCount);
+	m_jobSystem.run(pipelineCount, [this, &variants](uint32_t job, uint32_t) {
+		variants[job] = buildPipeline(static_cast<Pipeline::PipelineType>(job), ShaderVariant{});
+	});
 
-		// Build graphics pipeline - LIGHTING
-		m_pipelines.push_back(builder.buildGraphicsPipeline(Pipeline::LIGHTING, "Lighting Pipeline"));
+	for (uint32_t i = 0; i < pipelineCount; i++)
+	{
+		auto type = static_cast<Pipeline::PipelineType>(i);
 
-		// Flat shaders
-		ShaderSet flatShaders(*m_device);
-		flatShaders.addShader(ShaderStage::VERT, "../../Shaders/flat_vert.spv");
-		flatShaders.addShader(ShaderStage::FRAG, "../../Shaders/flat_frag.spv");
-		builder.linkShaders(flatShaders);
+		PipelineVariant& variant = m_pipelineVariants[{ type, ShaderVariant{} }];
+		variant = variants[i];
+		usePipelineVariant(type, variant);
+	}
+}
 
-		// Build graphics pipeline - FLAT
-		m_pipelines.push_back(builder.buildGraphicsPipeline(Pipeline::FLAT, "Flat Pipeline"));
+Pipeline Application::createGraphicsPipeline(Pipeline::PipelineType type, const ShaderVariant& variant)
+{
+	APP_PROFILE_FUNCTION();
 
-		// Cleanup shader sets
-		lightingShaders.cleanup();
-		flatShaders.cleanup();
-	}
+	auto builder = Pipeline::Builder(*m_device);
+	builder.addGraphicsBase();
+	builder.disableFaceCulling();
 
 	// Post
+	if (type == Pipeline::POST)
 	{
-		builder.reset();
-		builder.addGraphicsBase();
-
-		builder.disableFaceCulling();
 		builder.disableDepthTesting();
 
 		builder.linkRenderPass(m_renderPasses[RenderPass::POST]);
 		builder.linkDescriptorSetLayouts(&m_postDescriptorLayout.layout, 1);
 		builder.linkPushConstants(sizeof(PostPushConstants));
+	}
+
+	// Offscreen
+	else
+	{
+		builder.linkRenderPass(m_renderPasses[RenderPass::MAIN]);
+		builder.linkDescriptorSetLayouts(&m_offscreenDescriptorLayout.layout, 1);
+		builder.linkPushConstants(sizeof(MeshPushConstants));
+	}
 
-		// Post shaders
-		ShaderSet postShaders(*m_device);
-		postShaders.addShader(ShaderStage::VERT, "../../Shaders/post_vert.spv");
-		postShaders.addShader(ShaderStage::FRAG, "../../Shaders/post_frag.spv");
-		builder.linkShaders(postShaders);
+	ShaderSet shaders(*m_device);
+	for (const auto& shader : getPipelineShaders(type))
+		shaders.addShader(shader.stage, m_shaderCompiler.load(shader.name), shader.hitGroup);
+	specializeShaders(shaders, variant);
+	builder.linkShaders(shaders);
 
-		// Build graphics pipeline - POST
-		m_pipelines.push_back(builder.buildGraphicsPipeline(Pipeline::POST, "Post Pipeline"));
+	Pipeline pipeline = builder.buildGraphicsPipeline(type, getPipelineName(type));
 
-		// Cleanup shader set
-		postShaders.cleanup();
-	}
+	shaders.cleanup();
+	return pipeline;
 }
 
 void Application::createDescriptorSets()
@@ -299,7 +422,7 @@ void Application::createDescriptorSets()
 	poolInfo.poolSize = 3;
 
 	poolInfo.uniformBufferCount        = imageCount;
-	poolInfo.storageBufferCount        = imageCount;
+	poolInfo.storageBufferCount        = 3 * imageCount;
 	poolInfo.combinedImageSamplerCount = imageCount + imageCount * static_cast<uint32_t>(m_sceneBuilder.getTextureInfo().size());
 
 	m_descriptorPool.init(poolInfo);
@@ -327,6 +450,18 @@ void Application::createDescriptorSets()
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount,
 			VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR);
 
+		// Add a storage buffer for the scene material table
+		layoutBuilder.addBinding(
+			(uint32_t)SceneBinding::MATERIAL,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+			VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR);
+
+		// Add a storage buffer for the texture streaming feedback
+		layoutBuilder.addBinding(
+			(uint32_t)SceneBinding::FEEDBACK,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+			VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+
 		m_offscreenDescriptorLayout = layoutBuilder.buildLayout("Offscreen Descriptor Set Layout");
 	}
 
@@ -348,16 +483,18 @@ void Application::createDescriptorSets()
 	{
 		// Offscreen set
 		m_offscreenDescriptorSets.push_back(m_descriptorPool.allocateDescriptorSet(m_offscreenDescriptorLayout));
-		m_offscreenDescriptorSets[i].setTotalWriteCounts(2, textureCount, 0);
+		m_offscreenDescriptorSets[i].setTotalWriteCounts(4, textureCount, 0);
 		m_offscreenDescriptorSets[i].addBufferWrite(m_uniformBuffers[i], BufferType::UNIFORM, 0, (uint32_t)SceneBinding::GLOBAL);
 		m_offscreenDescriptorSets[i].addBufferWrite(m_objectDescBuffer, BufferType::STORAGE, 0, (uint32_t)SceneBinding::OBJ_DESC);
 		m_offscreenDescriptorSets[i].addImageWriteArray(m_sceneBuilder.getTextureInfo(), (uint32_t)SceneBinding::TEXTURE);
+		m_offscreenDescriptorSets[i].addBufferWrite(m_materialBuffer, BufferType::STORAGE, 0, (uint32_t)SceneBinding::MATERIAL);
+		m_offscreenDescriptorSets[i].addBufferWrite(m_textureStreamer.getFeedbackBuffer(i % m_settings.framesInFlight), BufferType::STORAGE, 0, (uint32_t)SceneBinding::FEEDBACK);
 		m_offscreenDescriptorSets[i].update(*m_device);
 
 		// Post set
 		m_postDescriptorSets.push_back(m_descriptorPool.allocateDescriptorSet(m_postDescriptorLayout));
 		m_postDescriptorSets[i].setTotalWriteCounts(0, 1, 0);
-		m_postDescriptorSets[i].addImageWrite(m_offscreenColorTexture.getDescriptor(), 0);
+		m_postDescriptorSets[i].addImageWrite(m_postProcessor.getOutput(i % m_settings.framesInFlight), 0);
 		m_postDescriptorSets[i].update(*m_device);
 	}
 }
@@ -448,9 +585,9 @@ void Application::createRtxDescriptorSets()
 	m_rtxDescriptorSet.update(*m_device);
 }
 
-void Application::createRtxPipeline()
+Pipeline Application::createRtxPipeline(Pipeline::PipelineType type, ShaderBindingTable& sbt, const ShaderVariant& variant)
 {
-	APP_LOG_INFO("Creating Rtx pipelines");
+	APP_PROFILE_FUNCTION();
 
 	auto builder = Pipeline::Builder(*m_device);
 
@@ -461,41 +598,225 @@ void Application::createRtxPipeline()
 
 	builder.linkRtxPushConstants(sizeof(RtxPushConstants));
 
-	// Real time
+	// The real time pipeline has a hit group per any hit shader, the path tracer only one
+	ShaderSet rtxShaders(*m_device, (type == Pipeline::RTX_RT) ? 2 : 1);
+	for (const auto& shader : getPipelineShaders(type))
+		rtxShaders.addShader(shader.stage, m_shaderCompiler.load(shader.name), shader.hitGroup);
+	specializeShaders(rtxShaders, variant);
+	rtxShaders.setupRtxShaderGroup();
+	builder.linkRtxShaders(rtxShaders);
+
+	Pipeline pipeline = builder.buildRtxPipeline(getPipelineName(type));
+
+	sbt.build(*m_device, pipeline.pipeline, rtxShaders, (type == Pipeline::RTX_RT) ? "SBT Real Time" : "SBT Path");
+
+	rtxShaders.cleanup();
+	return pipeline;
+}
+
+Application::PipelineVariant Application::buildPipeline(Pipeline::PipelineType type, const ShaderVariant& variant)
+{
+	PipelineVariant result;
+	if (isRtxPipeline(type))
+		result.pipeline = createRtxPipeline(type, result.sbt, variant);
+	else
+		result.pipeline = createGraphicsPipeline(type, variant);
+
+	return result;
+}
+
+void Application::specializeShaders(ShaderSet& shaders, const ShaderVariant& variant) const
+{
+	shaders.setConstant(SpecConstant::DEBUG_MODE,   variant.debugMode);
+	shaders.setConstant(SpecConstant::SAMPLE_COUNT, variant.sampleCount);
+	shaders.setConstant(SpecConstant::MAX_DEPTH,    variant.maxDepth);
+	shaders.setConstant(SpecConstant::REFLECTIONS,  static_cast<int32_t>(m_sceneReflections));
+}
+
+// The value if it is one of the presets, zero to leave it to the push constants otherwise
+template <size_t N>
+static int presetValue(const int (&presets)[N], int value)
+{
+	return (std::find(std::begin(presets), std::end(presets), value) != std::end(presets)) ? value : 0;
+}
+
+Application::ShaderVariant Application::getShaderVariant(Pipeline::PipelineType type) const
+{
+	// The renderer reads the same state of the UI into the uniforms and push constants when the frame begins
+	const Gui::UiState& ui = m_gui.getUIState();
+
+	// Only the pipeline of the current render method is specialized, the others stay generic until they are used
+	ShaderVariant variant{};
+	switch (type)
 	{
-		ShaderSet rtxRtShaders(*m_device, 2);
-		rtxRtShaders.addShader(ShaderStage::RGEN, "../../Shaders/rtx_main_rgen.spv");
-		rtxRtShaders.addShader(ShaderStage::MISS, "../../Shaders/rtx_main_rmiss.spv");
-		rtxRtShaders.addShader(ShaderStage::MISS, "../../Shaders/rtx_shadow_rmiss.spv");
-		rtxRtShaders.addShader(ShaderStage::CHIT, "../../Shaders/rtx_main_rchit.spv", 0);
-		rtxRtShaders.addShader(ShaderStage::AHIT, "../../Shaders/rtx_main_0_rahit.spv", 0);
-		rtxRtShaders.addShader(ShaderStage::AHIT, "../../Shaders/rtx_main_1_rahit.spv", 1);
-		rtxRtShaders.setupRtxShaderGroup();
-		builder.linkRtxShaders(rtxRtShaders);
+		case Pipeline::LIGHTING:
+			if (ui.renderMethod == Gui::RenderMethod::RASTER)
+				variant.debugMode = static_cast<int>(ui.debugMode);
+			break;
 
-		m_pipelines.push_back(builder.buildRtxPipeline("RTX Real Time Pipeline"));
+		case Pipeline::RTX_RT:
+			if (ui.renderMethod == Gui::RenderMethod::RTX_RT)
+			{
+				variant.debugMode   = static_cast<int>(ui.debugMode);
+				variant.sampleCount = presetValue(VARIANT_SAMPLE_COUNTS, ui.sampleCount);
+				variant.maxDepth    = presetValue(VARIANT_MAX_DEPTHS, ui.maxDepth);
+			}
+			break;
 
-		m_realTimeSBT.build(*m_device, m_pipelines[Pipeline::RTX_RT].pipeline, rtxRtShaders, "SBT Real Time");
+		case Pipeline::RTX_PATH:
+			if (ui.renderMethod == Gui::RenderMethod::RTX_PATH)
+			{
+				variant.sampleCount = presetValue(VARIANT_SAMPLE_COUNTS, ui.sampleCount);
+				variant.maxDepth    = presetValue(VARIANT_MAX_DEPTHS, ui.maxDepth);
+			}
+			break;
 
-		rtxRtShaders.cleanup();
+		default:
+			break;
 	}
-	
-	// Path	
+
+	return variant;
+}
+
+void Application::usePipelineVariant(Pipeline::PipelineType type, PipelineVariant& variant)
+{
+	variant.lastUsed = m_pipelineFrame;
+
+	m_pipelines[type] = variant.pipeline;
+	if (type == Pipeline::RTX_RT)
+		m_realTimeSBT = variant.sbt;
+	else if (type == Pipeline::RTX_PATH)
+		m_pathSBT = variant.sbt;
+}
+
+void Application::releasePipelineVariant(Pipeline::PipelineType type, const PipelineVariant& variant)
+{
+	// Frames that were already submitted may still use it, so it is destroyed once the graphics queue is done
+	const Device*   device = m_device;
+	PipelineVariant old    = variant;
+	bool            rtx    = isRtxPipeline(type);
+
+	m_device->getGraphicsTimeline().defer([old, device, rtx]() mutable {
+		old.pipeline.cleanup(*device);
+		if (rtx)
+			old.sbt.cleanup();
+	});
+}
+
+void Application::updatePipelines()
+{
+	m_pipelineFrame++;
+
+	// Take the pipelines that finished building
+	if (m_pipelineBuild.valid() && m_pipelineBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
 	{
-		ShaderSet rtxPathShaders(*m_device, 1);
-		rtxPathShaders.addShader(ShaderStage::RGEN, "../../Shaders/rtx_path_rgen.spv");
-		rtxPathShaders.addShader(ShaderStage::MISS, "../../Shaders/rtx_path_rmiss.spv");
-		rtxPathShaders.addShader(ShaderStage::CHIT, "../../Shaders/rtx_path_rchit.spv", 0);
-		rtxPathShaders.addShader(ShaderStage::AHIT, "../../Shaders/rtx_path_rahit.spv", 0);
-		rtxPathShaders.setupRtxShaderGroup();
-		builder.linkRtxShaders(rtxPathShaders);
+		PipelineBatch batch = m_pipelineBuild.get();
+		for (auto& build : batch.builds)
+		{
+			// Variants of the old shaders are dropped. The one of the current settings is built again below
+			if (batch.reload)
+			{
+				APP_LOG_INFO("Reloaded pipeline ({})", getPipelineName(build.type));
+
+				for (auto it = m_pipelineVariants.begin(); it != m_pipelineVariants.end();)
+				{
+					if (it->first.first != build.type)
+					{
+						it++;
+						continue;
+					}
+
+					releasePipelineVariant(build.type, it->second);
+					it = m_pipelineVariants.erase(it);
+				}
+			}
+			else
+				APP_LOG_INFO("Specialized pipeline ({})", getPipelineName(build.type));
 
-		m_pipelines.push_back(builder.buildRtxPipeline("RTX Path Pipeline"));
+			build.result.lastUsed = m_pipelineFrame;
+			m_pipelineVariants[{ build.type, build.variant }] = build.result;
 
-		m_pathSBT.build(*m_device, m_pipelines[Pipeline::RTX_PATH].pipeline, rtxPathShaders, "SBT Path");
+			// Keep only the variants that were used most recently
+			uint32_t variantCount = 0;
+			auto     oldest       = m_pipelineVariants.end();
+			for (auto it = m_pipelineVariants.begin(); it != m_pipelineVariants.end(); it++)
+			{
+				if (it->first.first != build.type || it->first.second == ShaderVariant{})
+					continue;
 
-		rtxPathShaders.cleanup();
+				variantCount++;
+				if (oldest == m_pipelineVariants.end() || it->second.lastUsed < oldest->second.lastUsed)
+					oldest = it;
+			}
+
+			if (variantCount > MAX_PIPELINE_VARIANTS)
+			{
+				releasePipelineVariant(build.type, oldest->second);
+				m_pipelineVariants.erase(oldest);
+			}
+		}
+
+		if (batch.reload)
+			m_renderer.onShadersReloaded();
 	}
+
+	// Use the variant of the current settings for every pipeline. The generic pipeline gives the same image with
+	// the uniforms and push constants, so it is used until the variant is built
+	std::vector<PipelineBuild> missing;
+	for (uint32_t i = 0; i < m_pipelines.size(); i++)
+	{
+		auto          type    = static_cast<Pipeline::PipelineType>(i);
+		ShaderVariant variant = getShaderVariant(type);
+
+		auto it = m_pipelineVariants.find({ type, variant });
+		if (it == m_pipelineVariants.end())
+		{
+			missing.push_back({ type, variant });
+			it = m_pipelineVariants.find({ type, ShaderVariant{} });
+		}
+
+		usePipelineVariant(type, it->second);
+	}
+
+	if (m_pipelineBuild.valid())
+		return;
+
+	// Pipelines whose shaders were compiled again are rebuilt before any new variant
+	PipelineBatch batch;
+	std::vector<std::string> changed = m_shaderCompiler.takeChangedShaders();
+	if (!changed.empty())
+	{
+		for (uint32_t i = 0; i < m_pipelines.size(); i++)
+		{
+			auto type = static_cast<Pipeline::PipelineType>(i);
+			for (const auto& shader : getPipelineShaders(type))
+			{
+				if (std::find(changed.begin(), changed.end(), shader.name) != changed.end())
+				{
+					batch.builds.push_back({ type, ShaderVariant{} });
+					break;
+				}
+			}
+		}
+		batch.reload = !batch.builds.empty();
+	}
+
+	if (batch.builds.empty())
+		batch.builds = missing;
+
+	if (batch.builds.empty())
+		return;
+
+	// The SPIR-V is already in the cache, so this only creates the pipelines. Frames keep rendering with the
+	// current ones meanwhile
+	m_pipelineBuild = std::async(std::launch::async, [this, batch]() mutable {
+		APP_PROFILE_THREAD("Pipeline Builder");
+
+		for (auto& build : batch.builds)
+			build.result = buildPipeline(build.type, build.variant);
+
+		return batch;
+	});
 }
 
 void Application::setupOffscreenRender()
@@ -529,14 +850,15 @@ void Application::resetOffscreenRender()
 
 	// Reset texture and depth buffer
 	setupOffscreenRender();
+	m_postProcessor.resize(m_swapchain.getExtent());
 
 	// Update descriptor sets
-	for (auto& set : m_postDescriptorSets)
+	for (uint32_t i = 0; i < m_postDescriptorSets.size(); i++)
 	{
 		// Update post set
-		set.setTotalWriteCounts(0, 1, 0);
-		set.addImageWrite(m_offscreenColorTexture.getDescriptor(), 0);
-		set.update(*m_device);
+		m_postDescriptorSets[i].setTotalWriteCounts(0, 1, 0);
+		m_postDescriptorSets[i].addImageWrite(m_postProcessor.getOutput(i % m_settings.framesInFlight), 0);
+		m_postDescriptorSets[i].update(*m_device);
 	}
 
 	if (m_device->isRtxSupported())
@@ -553,6 +875,8 @@ void Application::resetOffscreenRender()
 
 void Application::pollEvents()
 {
+	APP_PROFILE_FUNCTION();
+
 	glfwPollEvents();
 
 	// This is used to avoid processing more than one window resize per frame
@@ -621,6 +945,12 @@ void Application::pollEvents()
 
 				m_camera.onKeyPress(*keyPressEvent);
 				m_renderer.onKeyPress(*keyPressEvent);
+
+#ifndef RT_DIST
+				// Dump the CPU zones of every thread
+				if (keyPressEvent->key == GLFW_KEY_P)
+					CpuProfiler::WriteTrace("cpu_trace.json");
+#endif
 				break;
 			}
 
@@ -641,17 +971,35 @@ void Application::pollEvents()
 
 void Application::cleanup()
 {
+	// Pipelines that are still building
+	m_shaderCompiler.cleanup();
+	if (m_pipelineBuild.valid())
+	{
+		PipelineBatch batch = m_pipelineBuild.get();
+		for (auto& build : batch.builds)
+		{
+			build.result.pipeline.cleanup(*m_device);
+			if (isRtxPipeline(build.type))
+				build.result.sbt.cleanup();
+		}
+	}
+
+	// Texture streaming
+	m_textureStreamer.cleanup();
+
 	// Scene
 	m_scene.onUnload();
+	m_sceneBuilder.cleanup();
 
 	// ImGui
 	m_gui.cleanup();
 
+	// Post processing
+	m_postProcessor.cleanup();
+
 	// Rtx Structure
 	if (m_device->isRtxSupported())
 	{
-		m_realTimeSBT.cleanup();
-		m_pathSBT.cleanup();
 		m_accelerationStructure.cleanup();
 		m_rtxDescriptorLayout.cleanup(*m_device);
 		m_rtxDescriptorPool.cleanup();
@@ -662,12 +1010,18 @@ void Application::cleanup()
 		framebuffer.cleanup();
 	m_offscreenFramebuffer.cleanup();
 
-	// Pipelines
-	for (auto& pipeline : m_pipelines)
-		pipeline.cleanup(*m_device);
+	// Pipelines and their variants
+	for (auto& [key, variant] : m_pipelineVariants)
+	{
+		variant.pipeline.cleanup(*m_device);
+		if (isRtxPipeline(key.first))
+			variant.sbt.cleanup();
+	}
 
 	// Command System
 	m_commandSystem.cleanup();
+	m_jobSystem.cleanup();
+	m_gpuProfiler.cleanup();
 	
 	// Descriptor stuff
 	m_offscreenDescriptorLayout.cleanup(*m_device);
@@ -678,6 +1032,7 @@ void Application::cleanup()
 	for (auto& buffer : m_uniformBuffers)
 		buffer.cleanup();
 	m_objectDescBuffer.cleanup();
+	m_materialBuffer.cleanup();
 
 	// Render passes
 	for (auto& renderPass : m_renderPasses)
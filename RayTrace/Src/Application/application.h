@@ -5,6 +5,7 @@
 #include "event.h"
 #include "model.h"
 #include "Gui.h"
+#include "cpu_profiler.h"
 
 #include "Cpu-Raytracing/cpu_raytracer.h"
 
@@ -29,6 +30,14 @@
 #include "Core/framebuffer.h"
 #include "Core/texture.h"
 #include "Core/acceleration_structure.h"
+#include "Core/texture_streamer.h"
+#include "Core/post_processor.h"
+#include "Core/job_system.h"
+#include "Core/gpu_profiler.h"
+#include "Core/shader_compiler.h"
+
+#include <future>
+#include <map>
 
 class Application
 {
@@ -44,6 +53,13 @@ public:
 		bool vSync         = true;
 		bool cpuRaytracing = false;
 		bool useRtx        = false;
+
+		bool     streamTextures = true;
+		uint32_t textureBudget  = 512; // MB of streamed texture levels
+
+		uint32_t recordingThreads = 0; // Threads that record draws, zero uses every hardware thread
+
+		bool hotReloadShaders = true; // Rebuild pipelines when their shader sources change
 	};
 
 	void init(Application::Settings& settings);
@@ -62,8 +78,11 @@ private:
 	// Rendering components
 	Swapchain               m_swapchain;
 	CommandSystem           m_commandSystem;
+	JobSystem               m_jobSystem;
+	GpuProfiler             m_gpuProfiler;
 	DescriptorPool          m_descriptorPool;
 	std::vector<Pipeline>   m_pipelines;
+	ShaderCompiler          m_shaderCompiler;
 	std::vector<RenderPass> m_renderPasses;
 	Camera                  m_camera;
 	Renderer                m_renderer;
@@ -72,6 +91,7 @@ private:
 	std::vector<Framebuffer>   m_postFramebuffers;
 	DescriptorSetLayout        m_postDescriptorLayout;
 	std::vector<DescriptorSet> m_postDescriptorSets;
+	PostProcessor              m_postProcessor;
 
 	// Main offscreen pass
 	Framebuffer                m_offscreenFramebuffer;
@@ -81,6 +101,8 @@ private:
 	std::vector<DescriptorSet> m_offscreenDescriptorSets;
 	std::vector<Buffer>        m_uniformBuffers;
 	Buffer                     m_objectDescBuffer;
+	Buffer                     m_materialBuffer;
+	TextureStreamer            m_textureStreamer;
 
     // Scenes
 	// CornellBoxScene m_scene;
@@ -98,14 +120,67 @@ private:
 	DescriptorPool        m_rtxDescriptorPool;
 	DescriptorSetLayout   m_rtxDescriptorLayout;
 	DescriptorSet         m_rtxDescriptorSet;
+
+	// Settings that the shaders of a pipeline are specialized on. Negative and zero values are left to the
+	// uniforms and push constants, which is what the generic pipelines do. Only discrete settings are part of it,
+	// so dragging a slider does not build a pipeline for every value it passes
+	struct ShaderVariant
+	{
+		int debugMode   = -1;
+		int sampleCount = 0;
+		int maxDepth    = 0;
+
+		auto operator<=>(const ShaderVariant&) const = default;
+	};
+
+	// Values of the sliders that get a variant. Any other value uses the generic pipeline
+	static constexpr int VARIANT_SAMPLE_COUNTS[] = { 1, 2, 4, 8, 16 };
+	static constexpr int VARIANT_MAX_DEPTHS[]    = { 1, 2, 4, 8, 10 };
+
+	struct PipelineVariant
+	{
+		Pipeline           pipeline;
+		ShaderBindingTable sbt;          // Ray tracing pipelines only
+		uint64_t           lastUsed = 0;
+	};
+
+	// Every pipeline that was built, the generic ones and the variants of recent settings. m_pipelines,
+	// m_realTimeSBT and m_pathSBT only hold the ones that are currently used
+	static constexpr uint32_t MAX_PIPELINE_VARIANTS = 4; // Per pipeline, besides the generic one
+
+	std::map<std::pair<Pipeline::PipelineType, ShaderVariant>, PipelineVariant> m_pipelineVariants;
+	uint64_t                                                                    m_pipelineFrame    = 0;
+	bool                                                                        m_sceneReflections = true;
+
+	// Pipelines that are built in the background, after their shaders changed or for new settings
+	struct PipelineBuild
+	{
+		Pipeline::PipelineType type;
+		ShaderVariant          variant;
+		PipelineVariant        result;
+	};
+	struct PipelineBatch
+	{
+		std::vector<PipelineBuild> builds;
+		bool                       reload = false; // Replaces every variant of the pipelines
+	};
+	std::future<PipelineBatch> m_pipelineBuild;
 	
 	void createRenderPasses();
 	void createPipelines();
+	Pipeline createGraphicsPipeline(Pipeline::PipelineType type, const ShaderVariant& variant);
 	void createDescriptorSets();
 	void createFramebuffers();
 
 	void createRtxDescriptorSets();
-	void createRtxPipeline();
+	Pipeline createRtxPipeline(Pipeline::PipelineType type, ShaderBindingTable& sbt, const ShaderVariant& variant);
+
+	PipelineVariant buildPipeline(Pipeline::PipelineType type, const ShaderVariant& variant);
+	void specializeShaders(ShaderSet& shaders, const ShaderVariant& variant) const;
+	ShaderVariant getShaderVariant(Pipeline::PipelineType type) const;
+	void usePipelineVariant(Pipeline::PipelineType type, PipelineVariant& variant);
+	void releasePipelineVariant(Pipeline::PipelineType type, const PipelineVariant& variant);
+	void updatePipelines();
 
 	void setupOffscreenRender();
 	void resetOffscreenRender();
@@ -0,0 +1,162 @@
+#include "pch.h"
+
+#include "cpu_profiler.h"
+#include "logging.h"
+#include "utilities.h"
+
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+
+namespace
+{
+	// Zones that a thread keeps, about 384 KB per thread
+	constexpr uint64_t RING_SIZE = 16384;
+
+	// Fields are atomic so that a trace can be written while the thread keeps recording. Relaxed atomics compile
+	// to plain loads and stores
+	struct ZoneEvent
+	{
+		std::atomic<const char*> name  = nullptr;
+		std::atomic<uint64_t>    start = 0;
+		std::atomic<uint64_t>    end   = 0;
+	};
+
+	struct ThreadBuffer
+	{
+		ZoneEvent             events[RING_SIZE];
+		std::atomic<uint64_t> head = 0; // Number of zones that were ever recorded
+		uint32_t              id   = 0;
+		std::string           name;     // Guarded by the registry mutex
+	};
+
+	// Buffers are never freed, so the zones of threads that already exited are still in the trace
+	struct Registry
+	{
+		std::mutex                                 mutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	};
+
+	Registry& GetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	ThreadBuffer& GetThreadBuffer()
+	{
+		// Only the first zone of a thread takes the lock
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (!buffer)
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+
+			registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+			buffer       = registry.buffers.back().get();
+			buffer->id   = static_cast<uint32_t>(registry.buffers.size());
+			buffer->name = "Thread " + std::to_string(buffer->id);
+		}
+
+		return *buffer;
+	}
+}
+
+void CpuProfiler::SetThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+	buffer.name = name;
+}
+
+void CpuProfiler::Record(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	uint64_t   head  = buffer.head.load(std::memory_order_relaxed);
+	ZoneEvent& event = buffer.events[head % RING_SIZE];
+
+	event.name.store(name, std::memory_order_relaxed);
+	event.start.store(start, std::memory_order_relaxed);
+	event.end.store(end, std::memory_order_relaxed);
+
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+bool CpuProfiler::WriteTrace(const std::string& filename)
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		APP_LOG_ERROR("Failed to open CPU trace {}", filename);
+		return false;
+	}
+
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	size_t zoneCount = 0;
+
+	file << "{\n";
+	file << "  \"displayTimeUnit\": \"ns\",\n";
+	file << "  \"traceEvents\": [\n";
+
+	bool first = true;
+	auto separate = [&]() {
+		file << (first ? "    " : ",\n    ");
+		first = false;
+	};
+
+	for (const auto& buffer : registry.buffers)
+	{
+		separate();
+		file << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id
+			<< ", \"args\": { \"name\": " << quoteJson(buffer->name) << " } }";
+
+		// Copy the ring while its thread may still be recording into it
+		uint64_t headBefore = buffer->head.load(std::memory_order_acquire);
+		uint64_t oldest     = (headBefore > RING_SIZE) ? headBefore - RING_SIZE : 0;
+
+		struct Zone
+		{
+			uint64_t    index;
+			const char* name;
+			uint64_t    start;
+			uint64_t    end;
+		};
+
+		std::vector<Zone> zones;
+		zones.reserve(static_cast<size_t>(headBefore - oldest));
+		for (uint64_t i = oldest; i < headBefore; i++)
+		{
+			const ZoneEvent& event = buffer->events[i % RING_SIZE];
+			zones.push_back({ i, event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed), event.end.load(std::memory_order_relaxed) });
+		}
+
+		// Zones whose slots were reused during the copy, or are being reused right now, may be torn
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t headAfter = buffer->head.load(std::memory_order_relaxed);
+
+		for (const auto& zone : zones)
+		{
+			if (zone.index + RING_SIZE <= headAfter || !zone.name)
+				continue;
+
+			// Chrome traces are in microseconds
+			separate();
+			file << "{ \"name\": " << quoteJson(zone.name) << ", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id
+				<< ", \"ts\": " << zone.start / 1000 << "." << std::setfill('0') << std::setw(3) << zone.start % 1000
+				<< ", \"dur\": " << (zone.end - zone.start) / 1000 << "." << std::setw(3) << (zone.end - zone.start) % 1000
+				<< std::setfill(' ') << " }";
+
+			zoneCount++;
+		}
+	}
+
+	file << "\n  ]\n";
+	file << "}\n";
+
+	APP_LOG_INFO("Wrote {} CPU zones of {} threads to {}", zoneCount, registry.buffers.size(), filename);
+	return true;
+}
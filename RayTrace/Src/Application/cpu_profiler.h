@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+/*****************************************************************************************************************
+ *
+ * @class CpuProfiler
+ *
+ * Records the CPU time of scoped zones on every thread. Each thread writes its zones into its own ring buffer
+ * without locking, so zones are cheap enough for per frame work. Only the newest zones of a thread are kept once
+ * its ring is full. WriteTrace() writes the zones of all threads as a Chrome trace, which can be opened with
+ * chrome://tracing or Perfetto.
+ *
+ * Zones are recorded through the macros below, which compile out in distribution builds. Zone names must be
+ * string literals or otherwise outlive the profiler.
+ *
+ * Example Usage:
+ *     void loadScene()
+ *     {
+ *         APP_PROFILE_FUNCTION();
+ *         ...
+ *         {
+ *             APP_PROFILE_ZONE("Build BLAS");
+ *             ...
+ *         }
+ *     }
+ *
+ *     APP_PROFILE_THREAD("Loader");           // Name the current thread in the trace
+ *     CpuProfiler::WriteTrace("cpu_trace.json");
+ *
+ */
+class CpuProfiler
+{
+public:
+	// Records the time from its construction to its destruction
+	class Zone
+	{
+	public:
+		Zone(const char* name)
+			: m_name(name), m_start(Now()) {}
+
+		~Zone() { Record(m_name, m_start, Now()); }
+
+	private:
+		const char* m_name;
+		uint64_t    m_start;
+	};
+
+	/**
+	 * Name the calling thread in the trace.
+	 *
+	 * @param name: The name.
+	 */
+	static void SetThreadName(const std::string& name);
+
+	/**
+	 * Write the zones of every thread as Chrome trace JSON.
+	 *
+	 * @param filename: The file to write.
+	 *
+	 * @return False if the file could not be opened.
+	 */
+	static bool WriteTrace(const std::string& filename);
+
+	// Nanoseconds since the profiler was first used
+	static uint64_t Now()
+	{
+		static const auto start = std::chrono::steady_clock::now();
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	static void Record(const char* name, uint64_t start, uint64_t end);
+};
+
+#define APP_PROFILE_CONCAT_INNER(a, b) a##b
+#define APP_PROFILE_CONCAT(a, b)       APP_PROFILE_CONCAT_INNER(a, b)
+
+#ifndef RT_DIST
+	#define APP_PROFILE_ZONE(name)   CpuProfiler::Zone APP_PROFILE_CONCAT(profileZone, __LINE__)(name)
+	#define APP_PROFILE_FUNCTION()   APP_PROFILE_ZONE(__FUNCTION__)
+	#define APP_PROFILE_THREAD(name) CpuProfiler::SetThreadName(name)
+#else
+	#define APP_PROFILE_ZONE(name)   (void)0
+	#define APP_PROFILE_FUNCTION()   (void)0
+	#define APP_PROFILE_THREAD(name) (void)0
+#endif
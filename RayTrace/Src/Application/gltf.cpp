@@ -0,0 +1,748 @@
+#include "pch.h"
+#include "gltf.h"
+
+#include <algorithm>
+#include <charconv>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+// --------------------------------------------------------------------------
+// Json Parser
+//
+
+class JsonParser
+{
+public:
+	JsonParser(const char* text, size_t length)
+		: m_current(text), m_end(text + length) {}
+
+	JsonValue parseDocument()
+	{
+		JsonValue value = parseValue();
+
+		skipWhitespace();
+		if (m_current != m_end)
+			error("Unexpected data after the root value");
+
+		return value;
+	}
+
+private:
+	const char* m_current = nullptr;
+	const char* m_end     = nullptr;
+	uint32_t    m_depth   = 0;
+
+	// Deeper documents are rejected instead of overflowing the stack
+	static constexpr uint32_t MAX_DEPTH = 256;
+
+	// Unwinds the recursive descent, JsonValue::Parse catches the exception
+	[[noreturn]] void error(const char* message)
+	{
+		APP_LOG_ERROR("Failed to parse JSON: {}", message);
+		throw std::exception();
+	}
+
+	void skipWhitespace()
+	{
+		while (m_current != m_end && (*m_current == ' ' || *m_current == '\t' || *m_current == '\n' || *m_current == '\r'))
+			m_current++;
+	}
+
+	void expect(const char* literal)
+	{
+		for (const char* c = literal; *c; c++)
+		{
+			if (m_current == m_end || *m_current != *c)
+				error("Invalid literal");
+			m_current++;
+		}
+	}
+
+	JsonValue parseValue()
+	{
+		skipWhitespace();
+		if (m_current == m_end)
+			error("Unexpected end of document");
+
+		JsonValue value;
+		switch (*m_current)
+		{
+			case '{':
+				value.m_type = JsonValue::Type::OBJECT;
+				enter();
+				parseObject(value);
+				m_depth--;
+				break;
+
+			case '[':
+				value.m_type = JsonValue::Type::ARRAY;
+				enter();
+				parseArray(value);
+				m_depth--;
+				break;
+
+			case '"':
+				value.m_type   = JsonValue::Type::STRING;
+				value.m_string = parseString();
+				break;
+
+			case 't':
+				expect("true");
+				value.m_type    = JsonValue::Type::BOOLEAN;
+				value.m_boolean = true;
+				break;
+
+			case 'f':
+				expect("false");
+				value.m_type    = JsonValue::Type::BOOLEAN;
+				value.m_boolean = false;
+				break;
+
+			case 'n':
+				expect("null");
+				break;
+
+			default:
+				value.m_type   = JsonValue::Type::NUMBER;
+				value.m_number = parseNumber();
+		}
+
+		return value;
+	}
+
+	void enter()
+	{
+		if (++m_depth > MAX_DEPTH)
+			error("Document is nested too deeply");
+	}
+
+	void parseObject(JsonValue& value)
+	{
+		m_current++; // {
+
+		skipWhitespace();
+		if (m_current != m_end && *m_current == '}')
+		{
+			m_current++;
+			return;
+		}
+
+		while (true)
+		{
+			skipWhitespace();
+			if (m_current == m_end || *m_current != '"')
+				error("Expected an object key");
+
+			value.m_keys.emplace_back(parseString());
+
+			skipWhitespace();
+			if (m_current == m_end || *m_current != ':')
+				error("Expected ':' after an object key");
+			m_current++;
+
+			value.m_values.emplace_back(parseValue());
+
+			skipWhitespace();
+			if (m_current == m_end)
+				error("Unexpected end of object");
+
+			if (*m_current == ',')
+			{
+				m_current++;
+				continue;
+			}
+			if (*m_current == '}')
+			{
+				m_current++;
+				return;
+			}
+
+			error("Expected ',' or '}' in object");
+		}
+	}
+
+	void parseArray(JsonValue& value)
+	{
+		m_current++; // [
+
+		skipWhitespace();
+		if (m_current != m_end && *m_current == ']')
+		{
+			m_current++;
+			return;
+		}
+
+		while (true)
+		{
+			value.m_values.emplace_back(parseValue());
+
+			skipWhitespace();
+			if (m_current == m_end)
+				error("Unexpected end of array");
+
+			if (*m_current == ',')
+			{
+				m_current++;
+				continue;
+			}
+			if (*m_current == ']')
+			{
+				m_current++;
+				return;
+			}
+
+			error("Expected ',' or ']' in array");
+		}
+	}
+
+	double parseNumber()
+	{
+		// from_chars does not accept a leading plus, which JSON does not allow either
+		double result = 0.0;
+		auto [end, ec] = std::from_chars(m_current, m_end, result);
+		if (ec != std::errc() || end == m_current)
+			error("Invalid number");
+
+		m_current = end;
+		return result;
+	}
+
+	uint32_t parseHex4()
+	{
+		if (m_end - m_current < 4)
+			error("Invalid unicode escape");
+
+		uint32_t code = 0;
+		auto [end, ec] = std::from_chars(m_current, m_current + 4, code, 16);
+		if (ec != std::errc() || end != m_current + 4)
+			error("Invalid unicode escape");
+
+		m_current += 4;
+		return code;
+	}
+
+	static void appendUtf8(std::string& out, uint32_t code)
+	{
+		if (code < 0x80)
+		{
+			out += static_cast<char>(code);
+		}
+		else if (code < 0x800)
+		{
+			out += static_cast<char>(0xC0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			out += static_cast<char>(0xE0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+
+	std::string parseString()
+	{
+		m_current++; // "
+
+		std::string out;
+		while (true)
+		{
+			if (m_current == m_end)
+				error("Unterminated string");
+
+			char c = *m_current++;
+			if (c == '"')
+				return out;
+
+			if (c != '\\')
+			{
+				out += c;
+				continue;
+			}
+
+			if (m_current == m_end)
+				error("Unterminated string");
+
+			switch (*m_current++)
+			{
+				case '"':  out += '"';  break;
+				case '\\': out += '\\'; break;
+				case '/':  out += '/';  break;
+				case 'b':  out += '\b'; break;
+				case 'f':  out += '\f'; break;
+				case 'n':  out += '\n'; break;
+				case 'r':  out += '\r'; break;
+				case 't':  out += '\t'; break;
+
+				case 'u':
+				{
+					uint32_t code = parseHex4();
+
+					// Combine surrogate pairs. A high surrogate must be followed by an escaped low surrogate, and a
+					// low surrogate can not appear on its own
+					if (code >= 0xD800 && code < 0xDC00)
+					{
+						if (m_end - m_current < 6 || m_current[0] != '\\' || m_current[1] != 'u')
+							error("High surrogate without a low surrogate");
+
+						m_current += 2;
+						uint32_t low = parseHex4();
+						if (low < 0xDC00 || low > 0xDFFF)
+							error("High surrogate without a low surrogate");
+
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					else if (code >= 0xDC00 && code <= 0xDFFF)
+						error("Low surrogate without a high surrogate");
+
+					appendUtf8(out, code);
+					break;
+				}
+
+				default:
+					error("Invalid escape sequence");
+			}
+		}
+	}
+};
+
+// --------------------------------------------------------------------------
+// Json Value
+//
+
+JsonValue JsonValue::Parse(const char* text, size_t length)
+{
+	JsonParser parser(text, length);
+	try
+	{
+		return parser.parseDocument();
+	}
+	catch (const std::exception&)
+	{
+		return JsonValue();
+	}
+}
+
+bool JsonValue::has(const std::string& key) const
+{
+	return std::find(m_keys.begin(), m_keys.end(), key) != m_keys.end();
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+	static const JsonValue null;
+
+	auto it = std::find(m_keys.begin(), m_keys.end(), key);
+	if (it == m_keys.end())
+		return null;
+
+	return m_values[it - m_keys.begin()];
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	static const JsonValue null;
+
+	if (m_type != Type::ARRAY || index >= m_values.size())
+		return null;
+
+	return m_values[index];
+}
+
+// --------------------------------------------------------------------------
+// Gltf File
+//
+
+GltfFile::~GltfFile()
+{
+	for (auto& mapping : m_mappings)
+		unmapFile(mapping);
+}
+
+bool GltfFile::load(const std::string& filename)
+{
+	m_rootPath = filename.substr(0, filename.find_last_of("/\\"));
+
+	Mapping file;
+	if (!mapFile(filename, file))
+		return false;
+
+	m_mappings.push_back(file);
+
+	if (!parse(file.data, file.size, filename))
+		return false;
+
+	APP_LOG_TRACE("Mapped glTF file {} ({} bytes, {} buffers)", filename, file.size, m_buffers.size());
+	return true;
+}
+
+bool GltfFile::loadFromMemory(const uint8_t* data, size_t size)
+{
+	m_rootPath = ".";
+	return parse(data, size, "<memory>");
+}
+
+bool GltfFile::parse(const uint8_t* data, size_t size, const std::string& name)
+{
+	// A .glb starts with a 12 byte header followed by a JSON chunk and an optional binary chunk. Anything else
+	// is treated as a plain .gltf JSON file
+	const uint8_t* binaryChunk = nullptr;
+	size_t         binarySize  = 0;
+
+	auto readU32 = [](const uint8_t* p) {
+		uint32_t value;
+		memcpy(&value, p, sizeof(uint32_t));
+		return value;
+	};
+
+	if (size >= 12 && readU32(data) == 0x46546C67) // "glTF"
+	{
+		if (readU32(data + 4) != 2)
+		{
+			APP_LOG_ERROR("Unsupported glTF version {} in {}", readU32(data + 4), name);
+			return false;
+		}
+
+		size_t length = readU32(data + 8);
+		if (length > size)
+		{
+			APP_LOG_ERROR("GLB file is truncated, {} of {} bytes: {}", size, length, name);
+			return false;
+		}
+
+		// Chunks are padded to 4 bytes and must fill the file exactly
+		size_t offset = 12;
+		bool   parsed = false;
+		while (offset < length)
+		{
+			if (offset + 8 > length)
+			{
+				APP_LOG_ERROR("GLB chunk header at byte {} is truncated: {}", offset, name);
+				return false;
+			}
+
+			uint32_t chunkLength = readU32(data + offset);
+			uint32_t chunkType   = readU32(data + offset + 4);
+			offset += 8;
+
+			if (chunkLength % 4 != 0)
+			{
+				APP_LOG_ERROR("GLB chunk at byte {} is not aligned to 4 bytes: {}", offset - 8, name);
+				return false;
+			}
+			if (chunkLength > length - offset)
+			{
+				APP_LOG_ERROR("GLB chunk at byte {} is truncated: {}", offset - 8, name);
+				return false;
+			}
+
+			if (chunkType == 0x4E4F534A) // "JSON"
+			{
+				m_json = JsonValue::Parse(reinterpret_cast<const char*>(data + offset), chunkLength);
+				parsed = true;
+			}
+			else if (chunkType == 0x004E4942) // "BIN"
+			{
+				binaryChunk = data + offset;
+				binarySize  = chunkLength;
+			}
+
+			offset += chunkLength;
+		}
+
+		if (!parsed)
+		{
+			APP_LOG_ERROR("GLB file has no JSON chunk: {}", name);
+			return false;
+		}
+	}
+	else
+	{
+		m_json = JsonValue::Parse(reinterpret_cast<const char*>(data), size);
+	}
+
+	// Parse errors are already logged and leave a null document
+	if (m_json.getType() != JsonValue::Type::OBJECT)
+	{
+		APP_LOG_ERROR("glTF file does not contain a JSON object: {}", name);
+		m_json = JsonValue();
+		return false;
+	}
+
+	// Resolve buffers. A buffer without a uri is the binary chunk of the .glb
+	const JsonValue& buffers = m_json["buffers"];
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		const JsonValue& uri = buffers[i]["uri"];
+		if (uri.isNull())
+		{
+			m_buffers.push_back(binaryChunk);
+			m_bufferSizes.push_back(binarySize);
+		}
+		else if (uri.getString().rfind("data:", 0) == 0)
+		{
+			APP_LOG_ERROR("Embedded base64 buffers are not supported, buffer {} will be empty", i);
+			m_buffers.push_back(nullptr);
+			m_bufferSizes.push_back(0);
+		}
+		else
+		{
+			Mapping external;
+			if (!mapFile(m_rootPath + "/" + uri.getString(), external))
+				return false;
+
+			m_mappings.push_back(external);
+			m_buffers.push_back(external.data);
+			m_bufferSizes.push_back(external.size);
+		}
+	}
+
+	return true;
+}
+
+const uint8_t* GltfFile::getBufferView(int32_t index, size_t* size) const
+{
+	const JsonValue& view = m_json["bufferViews"][index < 0 ? SIZE_MAX : static_cast<size_t>(index)];
+	if (view.isNull())
+		return nullptr;
+
+	int32_t buffer = view["buffer"].getInt();
+	if (buffer < 0 || buffer >= static_cast<int32_t>(m_buffers.size()) || !m_buffers[buffer])
+		return nullptr;
+
+	size_t offset = static_cast<size_t>(view["byteOffset"].getNumber(0.0));
+	size_t length = static_cast<size_t>(view["byteLength"].getNumber(0.0));
+	if (offset + length > m_bufferSizes[buffer])
+		return nullptr;
+
+	*size = length;
+	return m_buffers[buffer] + offset;
+}
+
+GltfFile::Accessor GltfFile::getAccessor(int32_t index) const
+{
+	Accessor accessor{};
+
+	const JsonValue& json = m_json["accessors"][index < 0 ? SIZE_MAX : static_cast<size_t>(index)];
+	if (json.isNull())
+		return accessor;
+
+	static const std::pair<const char*, uint32_t> types[] = {
+		{ "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 }, { "MAT2", 4 }, { "MAT3", 9 }, { "MAT4", 16 }
+	};
+	for (const auto& [name, components] : types)
+	{
+		if (json["type"].getString() == name)
+			accessor.components = components;
+	}
+
+	accessor.count         = static_cast<uint32_t>(json["count"].getNumber(0.0));
+	accessor.componentType = static_cast<uint32_t>(json["componentType"].getNumber(FLOAT));
+	accessor.normalized    = json["normalized"].getBool(false);
+
+	uint32_t componentSize = 4;
+	if (accessor.componentType == BYTE || accessor.componentType == UNSIGNED_BYTE)
+		componentSize = 1;
+	else if (accessor.componentType == SHORT || accessor.componentType == UNSIGNED_SHORT)
+		componentSize = 2;
+
+	if (json.has("sparse"))
+		APP_LOG_WARN("Sparse accessors are not supported, accessor {} uses its base values", index);
+
+	size_t viewSize = 0;
+	const uint8_t* view = getBufferView(json["bufferView"].getInt(), &viewSize);
+	if (!view)
+		return accessor;
+
+	const JsonValue& viewJson = m_json["bufferViews"][static_cast<size_t>(json["bufferView"].getInt())];
+
+	uint32_t elementSize = componentSize * accessor.components;
+	accessor.stride      = static_cast<uint32_t>(viewJson["byteStride"].getNumber(elementSize));
+	if (accessor.stride < elementSize)
+	{
+		APP_LOG_ERROR("Accessor {} has a stride of {} bytes for {} byte elements", index, accessor.stride, elementSize);
+		accessor.count = 0;
+		return accessor;
+	}
+
+	size_t offset = static_cast<size_t>(json["byteOffset"].getNumber(0.0));
+	if (accessor.count > 0 && offset + static_cast<size_t>(accessor.count - 1) * accessor.stride + elementSize > viewSize)
+	{
+		APP_LOG_ERROR("Accessor {} is out of the range of its buffer view", index);
+		accessor.count = 0;
+		return accessor;
+	}
+
+	accessor.data = view + offset;
+	return accessor;
+}
+
+float GltfFile::Accessor::readFloat(uint32_t element, uint32_t component) const
+{
+	if (!data || component >= components)
+		return 0.0f;
+
+	const uint8_t* p = data + static_cast<size_t>(element) * stride;
+	switch (componentType)
+	{
+		case FLOAT:
+		{
+			float value;
+			memcpy(&value, p + component * sizeof(float), sizeof(float));
+			return value;
+		}
+
+		case UNSIGNED_BYTE:
+		{
+			float value = p[component];
+			return normalized ? value / 255.0f : value;
+		}
+
+		case BYTE:
+		{
+			float value = static_cast<int8_t>(p[component]);
+			return normalized ? std::max(value / 127.0f, -1.0f) : value;
+		}
+
+		case UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, p + component * sizeof(uint16_t), sizeof(uint16_t));
+			return normalized ? value / 65535.0f : static_cast<float>(value);
+		}
+
+		case SHORT:
+		{
+			int16_t value;
+			memcpy(&value, p + component * sizeof(int16_t), sizeof(int16_t));
+			return normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+		}
+
+		case UNSIGNED_INT:
+		{
+			uint32_t value;
+			memcpy(&value, p + component * sizeof(uint32_t), sizeof(uint32_t));
+			return static_cast<float>(value);
+		}
+	}
+
+	return 0.0f;
+}
+
+uint32_t GltfFile::Accessor::readIndex(uint32_t element) const
+{
+	if (!data)
+		return element;
+
+	const uint8_t* p = data + static_cast<size_t>(element) * stride;
+	switch (componentType)
+	{
+		case UNSIGNED_BYTE:
+			return p[0];
+
+		case UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, p, sizeof(uint16_t));
+			return value;
+		}
+
+		case UNSIGNED_INT:
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(uint32_t));
+			return value;
+		}
+	}
+
+	return 0;
+}
+
+bool GltfFile::mapFile(const std::string& filename, Mapping& mapping)
+{
+	mapping = Mapping{};
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		APP_LOG_ERROR("Failed to open file: {}", filename);
+		return false;
+	}
+
+	LARGE_INTEGER size{};
+	GetFileSizeEx(file, &size);
+
+	HANDLE handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void*  view   = handle ? MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view)
+	{
+		if (handle)
+			CloseHandle(handle);
+		CloseHandle(file);
+
+		APP_LOG_ERROR("Failed to map file: {}", filename);
+		return false;
+	}
+
+	mapping.data   = static_cast<const uint8_t*>(view);
+	mapping.size   = static_cast<size_t>(size.QuadPart);
+	mapping.file   = file;
+	mapping.handle = handle;
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		APP_LOG_ERROR("Failed to open file: {}", filename);
+		return false;
+	}
+
+	struct stat info{};
+	fstat(file, &info);
+
+	void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+	{
+		APP_LOG_ERROR("Failed to map file: {}", filename);
+		return false;
+	}
+
+	mapping.data = static_cast<const uint8_t*>(view);
+	mapping.size = static_cast<size_t>(info.st_size);
+#endif
+
+	return true;
+}
+
+void GltfFile::unmapFile(Mapping& mapping)
+{
+	if (!mapping.data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(mapping.data);
+	CloseHandle(mapping.handle);
+	CloseHandle(mapping.file);
+#else
+	munmap(const_cast<uint8_t*>(mapping.data), mapping.size);
+#endif
+
+	mapping = Mapping{};
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "logging.h"
+
+/*****************************************************************************************************************
+ *
+ * @class JsonValue
+ *
+ * Minimal read only JSON document used by the glTF loader. Objects keep their keys in file order. Looking up a
+ * key or index that does not exist returns a null value, so optional glTF properties can be read without
+ * checking every level first.
+ *
+ * Example Usage:
+ *     JsonValue json = JsonValue::Parse(text, length);
+ *     float roughness = json["materials"][0]["pbrMetallicRoughness"]["roughnessFactor"].getFloat(1.0f);
+ *
+ */
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		NUL = 0,
+		BOOLEAN,
+		NUMBER,
+		STRING,
+		ARRAY,
+		OBJECT
+	};
+
+	/**
+	 * Parse a JSON document. The text does not need to be null terminated. Errors are logged and never thrown.
+	 *
+	 * @param text: JSON text.
+	 * @param length: Length of the text in bytes.
+	 *
+	 * @return The root value of the document, a null value if the text is not valid JSON.
+	 */
+	static JsonValue Parse(const char* text, size_t length);
+
+	Type getType() const { return m_type; }
+	bool isNull() const { return m_type == Type::NUL; }
+
+	bool has(const std::string& key) const;
+	size_t size() const { return m_values.size(); }
+
+	const JsonValue& operator[](const std::string& key) const;
+	const JsonValue& operator[](size_t index) const;
+
+	double getNumber(double fallback = 0.0) const { return m_type == Type::NUMBER ? m_number : fallback; }
+	float getFloat(float fallback = 0.0f) const { return static_cast<float>(getNumber(fallback)); }
+	int32_t getInt(int32_t fallback = -1) const { return static_cast<int32_t>(getNumber(fallback)); }
+	bool getBool(bool fallback = false) const { return m_type == Type::BOOLEAN ? m_boolean : fallback; }
+	const std::string& getString() const { return m_string; }
+
+private:
+	friend class JsonParser;
+
+	Type        m_type    = Type::NUL;
+	bool        m_boolean = false;
+	double      m_number  = 0.0;
+	std::string m_string;
+
+	// Array elements, or object values with their keys stored at the same index in m_keys
+	std::vector<JsonValue>   m_values;
+	std::vector<std::string> m_keys;
+};
+
+/*****************************************************************************************************************
+ *
+ * @class GltfFile
+ *
+ * Opens a glTF 2.0 file (.glb or .gltf). The file and any external buffers are memory mapped, so accessors point
+ * straight into the mapped file and vertex data can be read without an intermediate copy. Only the binary chunk
+ * of a .glb and external buffer files are supported. Base64 data URIs are not.
+ *
+ * Pointers returned by a GltfFile are valid until it is destroyed.
+ *
+ * Example Usage:
+ *     GltfFile gltf;
+ *     gltf.load("scene.glb");
+ *     GltfFile::Accessor positions = gltf.getAccessor(primitive["attributes"]["POSITION"].getInt());
+ *
+ */
+class GltfFile
+{
+public:
+	// Component types defined by the glTF specification
+	enum ComponentType
+	{
+		BYTE           = 5120,
+		UNSIGNED_BYTE  = 5121,
+		SHORT          = 5122,
+		UNSIGNED_SHORT = 5123,
+		UNSIGNED_INT   = 5125,
+		FLOAT          = 5126
+	};
+
+	struct Accessor
+	{
+		const uint8_t* data          = nullptr; // nullptr if the accessor has no buffer view (all zeros)
+		uint32_t       count         = 0;
+		uint32_t       componentType = FLOAT;
+		uint32_t       components    = 1;
+		uint32_t       stride        = 0;
+		bool           normalized    = false;
+
+		// Read one component of an element as a float, applying normalization for integer types
+		float readFloat(uint32_t element, uint32_t component) const;
+		uint32_t readIndex(uint32_t element) const;
+	};
+
+	GltfFile() = default;
+	~GltfFile();
+
+	GltfFile(const GltfFile&) = delete;
+	GltfFile& operator=(const GltfFile&) = delete;
+
+	/**
+	 * Map and parse a glTF file. Errors are logged and never thrown.
+	 *
+	 * @param filename: Path to the .glb or .gltf file.
+	 *
+	 * @return False if the file or one of its buffers can not be read, or the file is not valid JSON or a valid
+	 *         GLB container.
+	 */
+	bool load(const std::string& filename);
+
+	/**
+	 * Parse a glTF file that is already in memory. External buffers are relative to the working directory.
+	 *
+	 * @param data: Contents of a .glb or .gltf file. Must stay valid until the GltfFile is destroyed.
+	 * @param size: Size of the data in bytes.
+	 *
+	 * @return False if one of its buffers can not be read, or the data is not valid JSON or a valid GLB container.
+	 *         The error is logged.
+	 */
+	bool loadFromMemory(const uint8_t* data, size_t size);
+
+	const JsonValue& getJson() const { return m_json; }
+
+	/**
+	 * Get the bytes of a buffer view.
+	 *
+	 * @param index: Index of the buffer view.
+	 * @param size: Receives the size of the view in bytes.
+	 *
+	 * @return Pointer to the start of the view, nullptr if the view is invalid.
+	 */
+	const uint8_t* getBufferView(int32_t index, size_t* size) const;
+
+	Accessor getAccessor(int32_t index) const;
+
+private:
+	struct Mapping
+	{
+		const uint8_t* data   = nullptr;
+		size_t         size   = 0;
+		void*          file   = nullptr;
+		void*          handle = nullptr;
+	};
+
+	std::string m_rootPath;
+	JsonValue   m_json;
+
+	std::vector<Mapping>        m_mappings;
+	std::vector<const uint8_t*> m_buffers;
+	std::vector<size_t>         m_bufferSizes;
+
+	bool parse(const uint8_t* data, size_t size, const std::string& name);
+
+	bool mapFile(const std::string& filename, Mapping& mapping);
+	void unmapFile(Mapping& mapping);
+};
@@ -0,0 +1,386 @@
+#include "pch.h"
+#include "mesh_simplifier.h"
+
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+
+// --------------------------------------------------------------------------
+// Quadric
+//
+
+// Symmetric 4x4 matrix stored as its upper triangle
+struct Quadric
+{
+	double a[10] = {};
+
+	static Quadric FromPlane(const glm::dvec3& n, double d)
+	{
+		Quadric q;
+		q.a[0] = n.x * n.x; q.a[1] = n.x * n.y; q.a[2] = n.x * n.z; q.a[3] = n.x * d;
+		q.a[4] = n.y * n.y; q.a[5] = n.y * n.z; q.a[6] = n.y * d;
+		q.a[7] = n.z * n.z; q.a[8] = n.z * d;
+		q.a[9] = d * d;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& other)
+	{
+		for (uint32_t i = 0; i < 10; i++)
+			a[i] += other.a[i];
+		return *this;
+	}
+
+	// Sum of squared distances from p to every plane in the quadric
+	double evaluate(const glm::dvec3& p) const
+	{
+		double error =
+			a[0] * p.x * p.x + 2.0 * a[1] * p.x * p.y + 2.0 * a[2] * p.x * p.z + 2.0 * a[3] * p.x +
+			a[4] * p.y * p.y + 2.0 * a[5] * p.y * p.z + 2.0 * a[6] * p.y +
+			a[7] * p.z * p.z + 2.0 * a[8] * p.z +
+			a[9];
+
+		return std::max(error, 0.0);
+	}
+};
+
+// --------------------------------------------------------------------------
+// Mesh Simplifier
+//
+
+std::vector<MeshSimplifier::Lod> MeshSimplifier::BuildLodChain(const std::vector<Vertex>& vertices, const uint32_t* indices, uint32_t indexCount, uint32_t maxLevels, float reduction, uint32_t minTriangles)
+{
+	std::vector<Lod> lods;
+
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount <= minTriangles)
+		return lods;
+
+	// Weld vertices by position. Each welded vertex remembers the first original vertex that used it
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			size_t h = std::hash<float>()(p.x);
+			h ^= std::hash<float>()(p.y) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<float>()(p.z) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> weldMap;
+	std::vector<uint32_t>   representative;
+	std::vector<glm::dvec3> positions;
+	std::vector<uint32_t>   corners(triangleCount * 3);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+	{
+		const glm::vec3& p = vertices[indices[i]].pos;
+
+		auto [it, inserted] = weldMap.try_emplace(p, static_cast<uint32_t>(positions.size()));
+		if (inserted)
+		{
+			representative.push_back(indices[i]);
+			positions.emplace_back(p);
+		}
+
+		corners[i] = it->second;
+	}
+
+	uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+
+	// Original vertex of every corner. Simplified triangles point to these, so each triangle keeps the normal,
+	// texture coordinate and color of its own side of a seam
+	std::vector<uint32_t> wedges(indices, indices + triangleCount * 3);
+
+	// Tangents are computed per triangle, so only the other attributes can tell a seam apart
+	auto sameAttributes = [&](uint32_t a, uint32_t b) {
+		const Vertex& va = vertices[a];
+		const Vertex& vb = vertices[b];
+		return va.normal == vb.normal && va.texCoord == vb.texCoord && va.color == vb.color;
+	};
+
+	// Drop triangles that are degenerate after welding
+	std::vector<bool> alive(triangleCount, true);
+	uint32_t          liveCount = triangleCount;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t* c = &corners[3 * t];
+		if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0])
+		{
+			alive[t] = false;
+			liveCount--;
+		}
+	}
+
+	// Vertex quadrics from the planes of their triangles
+	auto triangleNormal = [&](uint32_t v0, uint32_t v1, uint32_t v2) {
+		return glm::cross(positions[v1] - positions[v0], positions[v2] - positions[v0]);
+	};
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		if (!alive[t])
+			continue;
+
+		uint32_t*  c = &corners[3 * t];
+		glm::dvec3 n = triangleNormal(c[0], c[1], c[2]);
+		double     length = glm::length(n);
+		if (length <= 0.0)
+			continue;
+
+		n /= length;
+		Quadric q = Quadric::FromPlane(n, -glm::dot(n, positions[c[0]]));
+		for (uint32_t k = 0; k < 3; k++)
+			quadrics[c[k]] += q;
+	}
+
+	// Lock vertices on open boundaries. An edge used by a single triangle is a boundary edge
+	std::vector<bool> locked(vertexCount, false);
+	{
+		// Welded vertices whose original vertices differ lie on a seam, and moving them would tear it open
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+		{
+			if (!sameAttributes(wedges[i], representative[corners[i]]))
+				locked[corners[i]] = true;
+		}
+
+		std::unordered_map<uint64_t, uint32_t> edgeCounts;
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			if (!alive[t])
+				continue;
+
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint64_t a = corners[3 * t + k];
+				uint64_t b = corners[3 * t + (k + 1) % 3];
+				edgeCounts[(std::min(a, b) << 32) | std::max(a, b)]++;
+			}
+		}
+
+		for (const auto& [edge, count] : edgeCounts)
+		{
+			if (count == 1)
+			{
+				locked[edge >> 32]        = true;
+				locked[edge & 0xFFFFFFFF] = true;
+			}
+		}
+	}
+
+	std::vector<bool>                  removed(vertexCount, false);
+	std::vector<uint32_t>              version(vertexCount, 0);
+	std::vector<std::vector<uint32_t>> adjacency(vertexCount);
+
+	// Candidate collapse of vertex u onto vertex v
+	struct Collapse
+	{
+		double   cost;
+		uint32_t u, v;
+		uint32_t versionU, versionV;
+
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	double maxError = 0.0;
+
+	for (uint32_t level = 0; level < maxLevels; level++)
+	{
+		uint32_t startCount  = liveCount;
+		uint32_t targetCount = std::max(minTriangles, static_cast<uint32_t>(startCount * reduction));
+		if (startCount <= minTriangles)
+			break;
+
+		// Rebuild the vertex to triangle adjacency
+		for (auto& list : adjacency)
+			list.clear();
+
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			if (!alive[t])
+				continue;
+
+			for (uint32_t k = 0; k < 3; k++)
+				adjacency[corners[3 * t + k]].push_back(t);
+		}
+
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+		auto pushEdges = [&](uint32_t vertex) {
+			for (uint32_t t : adjacency[vertex])
+			{
+				if (!alive[t])
+					continue;
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t other = corners[3 * t + k];
+					if (other == vertex)
+						continue;
+
+					Quadric q = quadrics[vertex];
+					q += quadrics[other];
+
+					if (!locked[vertex])
+						heap.push({ q.evaluate(positions[other]), vertex, other, version[vertex], version[other] });
+					if (!locked[other])
+						heap.push({ q.evaluate(positions[vertex]), other, vertex, version[other], version[vertex] });
+				}
+			}
+		};
+
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			if (!removed[v])
+				pushEdges(v);
+		}
+
+		std::vector<uint32_t> neighborsU, neighborsV;
+		auto gatherNeighbors = [&](uint32_t vertex, std::vector<uint32_t>& out) {
+			out.clear();
+			for (uint32_t t : adjacency[vertex])
+			{
+				if (!alive[t])
+					continue;
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					if (corners[3 * t + k] != vertex)
+						out.push_back(corners[3 * t + k]);
+				}
+			}
+
+			std::sort(out.begin(), out.end());
+			out.erase(std::unique(out.begin(), out.end()), out.end());
+		};
+
+		while (liveCount > targetCount && !heap.empty())
+		{
+			Collapse collapse = heap.top();
+			heap.pop();
+
+			uint32_t u = collapse.u;
+			uint32_t v = collapse.v;
+			if (removed[u] || removed[v] || version[u] != collapse.versionU || version[v] != collapse.versionV)
+				continue;
+
+			// Link condition. An interior edge can share at most two neighbors, otherwise the collapse would
+			// create a non-manifold mesh
+			gatherNeighbors(u, neighborsU);
+			gatherNeighbors(v, neighborsV);
+
+			std::vector<uint32_t> shared;
+			std::set_intersection(neighborsU.begin(), neighborsU.end(), neighborsV.begin(), neighborsV.end(), std::back_inserter(shared));
+			if (shared.size() > 2)
+				continue;
+
+			// Reject collapses that flip or squash any of the remaining triangles around u
+			bool valid = true;
+			for (uint32_t t : adjacency[u])
+			{
+				if (!alive[t])
+					continue;
+
+				uint32_t* c = &corners[3 * t];
+				if (c[0] == v || c[1] == v || c[2] == v)
+					continue;
+
+				glm::dvec3 before = triangleNormal(c[0], c[1], c[2]);
+				glm::dvec3 after  = triangleNormal(c[0] == u ? v : c[0], c[1] == u ? v : c[1], c[2] == u ? v : c[2]);
+
+				double lengthBefore = glm::length(before);
+				double lengthAfter  = glm::length(after);
+				if (lengthAfter <= 1e-12 * lengthBefore || glm::dot(before, after) < 0.2 * lengthBefore * lengthAfter)
+				{
+					valid = false;
+					break;
+				}
+			}
+
+			if (!valid)
+				continue;
+
+			// The triangles around u take the original vertex of v from the triangles on the collapsed edge. u
+			// is not on a seam, so they all have to agree
+			uint32_t wedge = UINT32_MAX;
+			for (uint32_t t : adjacency[u])
+			{
+				if (!alive[t])
+					continue;
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					if (corners[3 * t + k] != v)
+						continue;
+
+					if (wedge == UINT32_MAX)
+						wedge = wedges[3 * t + k];
+					else if (!sameAttributes(wedge, wedges[3 * t + k]))
+						valid = false;
+				}
+			}
+
+			if (!valid || wedge == UINT32_MAX)
+				continue;
+
+			// Collapse u onto v
+			for (uint32_t t : adjacency[u])
+			{
+				if (!alive[t])
+					continue;
+
+				uint32_t* c = &corners[3 * t];
+				if (c[0] == v || c[1] == v || c[2] == v)
+				{
+					alive[t] = false;
+					liveCount--;
+					continue;
+				}
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					if (c[k] == u)
+					{
+						c[k]              = v;
+						wedges[3 * t + k] = wedge;
+					}
+				}
+
+				adjacency[v].push_back(t);
+			}
+
+			// Bumping the version of v invalidates every queued collapse that involves v, and the edges around v
+			// are queued again with the new quadric
+			quadrics[v] += quadrics[u];
+			removed[u] = true;
+			version[v]++;
+
+			maxError = std::max(maxError, collapse.cost);
+
+			pushEdges(v);
+		}
+
+		// Stop when the mesh can no longer be reduced in a meaningful way
+		if (liveCount > startCount * 0.9f)
+			break;
+
+		Lod lod;
+		lod.error = static_cast<float>(std::sqrt(maxError));
+		lod.indices.reserve(liveCount * 3);
+		lod.sourceTriangles.reserve(liveCount);
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			if (!alive[t])
+				continue;
+
+			for (uint32_t k = 0; k < 3; k++)
+				lod.indices.push_back(wedges[3 * t + k]);
+			lod.sourceTriangles.push_back(t);
+		}
+
+		lods.emplace_back(std::move(lod));
+	}
+
+	return lods;
+}
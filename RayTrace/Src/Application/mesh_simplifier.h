@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Core/rendering_structures.h"
+
+/*****************************************************************************************************************
+ *
+ * @class MeshSimplifier
+ *
+ * Builds a chain of levels of detail for an indexed triangle list using quadric error metrics (Garland and
+ * Heckbert). Only half edge collapses are performed, so vertices are never created or moved and every level
+ * indexes into the original vertex buffer. Vertices are welded by position before simplifying. Boundary vertices
+ * are locked to avoid opening holes, and so are seam vertices, where the normals, texture coordinates or colors
+ * of the welded vertices differ. Every simplified triangle keeps the attributes of its own side of a seam.
+ *
+ * The simplifier is stateless and can be called from multiple threads at once.
+ *
+ * Example Usage:
+ *     std::vector<MeshSimplifier::Lod> lods = MeshSimplifier::BuildLodChain(vertices, indices.data(), indexCount, 4);
+ *
+ */
+class MeshSimplifier
+{
+public:
+	struct Lod
+	{
+		std::vector<uint32_t> indices;         // Indices into the original vertex buffer
+		std::vector<uint32_t> sourceTriangles; // The input triangle each simplified triangle descends from
+		float                 error = 0.0f;    // Approximate geometric error in object space
+	};
+
+	/**
+	 * Build the level of detail chain. Each level is coarser than the previous one.
+	 *
+	 * @param vertices: Vertex buffer that the indices point into.
+	 * @param indices: Triangle list to simplify.
+	 * @param indexCount: Number of indices in the triangle list.
+	 * @param maxLevels: Maximum number of levels to build.
+	 * @param reduction: Target triangle ratio between two consecutive levels.
+	 * @param minTriangles: Stop simplifying once a level reaches this many triangles.
+	 *
+	 * @return The levels of detail, not including the original triangle list.
+	 */
+	static std::vector<Lod> BuildLodChain(
+		const std::vector<Vertex>& vertices,
+		const uint32_t*            indices,
+		uint32_t                   indexCount,
+		uint32_t                   maxLevels,
+		float                      reduction    = 0.5f,
+		uint32_t                   minTriangles = 64);
+};
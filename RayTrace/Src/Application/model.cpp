@@ -1,5 +1,16 @@
 #include "pch.h"
 #include "model.h"
+#include "cpu_profiler.h"
+#include "utilities.h"
+
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include <filesystem>
+#include <charconv>
+#include <string_view>
+
+#include <glm/gtc/quaternion.hpp>
 
 #define TINYOBJLOADER_IMPLEMENTATION // This must exist in only one cpp file
 #include <tiny_obj_loader.h>
@@ -14,11 +25,29 @@ void Model::cleanup()
 
 	m_vertexBuffer.cleanup();
 	m_indexBuffer.cleanup();
-	m_materialBuffer.cleanup();
 	m_materialIndexBuffer.cleanup();
+	m_geometryBuffer.cleanup();
 
 	for (auto& texture : m_textures)
 		texture.cleanup();
+
+	for (auto& part : m_parts)
+		part.cleanup();
+}
+
+Model& Model::getPart(uint32_t objectID)
+{
+	if (objectID == m_index)
+		return *this;
+
+	for (auto& part : m_parts)
+	{
+		if (part.getIndex() == objectID)
+			return part;
+	}
+
+	APP_LOG_CRITICAL("Model ({}) does not have a part with object ID {}", m_index, objectID);
+	throw std::exception();
 }
 
 // --------------------------------------------------------------------------
@@ -46,6 +75,12 @@ void SceneBuilder::ObjLoader::loadObj(const std::string& filename)
 	auto& shapes = reader.GetShapes();
 	auto& materialsTOL = reader.GetMaterials();
 
+	// Textures are relative to the obj file
+	std::string rootPath = filename.substr(0, filename.find_last_of("/\\"));
+
+	// Materials that never need the any-hit shader
+	std::vector<bool> opaqueMaterials;
+
 	// Loop over all material
 	for (const auto& material : materialsTOL)
 	{
@@ -65,48 +100,68 @@ void SceneBuilder::ObjLoader::loadObj(const std::string& filename)
 		// Diffuse texture
 		if (!material.diffuse_texname.empty())
 		{
-			// Set the texture ID. This is assuming every material with a texture will always have an albedo map
-			mat.textureID = static_cast<int>(textures.size());
-
-			textures.push_back(material.diffuse_texname);
-			textureTypes.push_back(Texture::FileType::ALBEDO);
+			mat.albedoTexture = addTexture(material.diffuse_texname, Texture::FileType::ALBEDO);
 			mat.textureMask |= 0x00000001; // Bit 1
 		}
 
 		if (!material.normal_texname.empty())
 		{
-			textures.push_back(material.normal_texname);
-			textureTypes.push_back(Texture::FileType::NORMAL);
+			mat.normalTexture = addTexture(material.normal_texname, Texture::FileType::NORMAL);
 			mat.textureMask |= 0x00000002; // Bit 2
 		}
 
+		// The scalar maps are packed into one texture
+		TextureSource alpha{}, rough{}, metal{};
 		if (!material.alpha_texname.empty())
 		{
-			textures.push_back(material.alpha_texname);
-			textureTypes.push_back(Texture::FileType::ALPHA);
+			alpha.path = material.alpha_texname;
+			alpha.type = Texture::FileType::ALPHA;
 			mat.textureMask |= 0x00000004; // Bit 3
 		}
 
 		if (!material.metallic_texname.empty())
 		{
-			textures.push_back(material.metallic_texname);
-			textureTypes.push_back(Texture::FileType::METAL);
+			metal.path = material.metallic_texname;
+			metal.type = Texture::FileType::METAL;
 			mat.textureMask |= 0x00000008; // Bit 4
 		}
 
 		if (!material.roughness_texname.empty())
 		{
-			textures.push_back(material.roughness_texname);
-			textureTypes.push_back(Texture::FileType::ROUGH);
+			rough.path = material.roughness_texname;
+			rough.type = Texture::FileType::ROUGH;
 			mat.textureMask |= 0x00000010; // Bit 5
 		}
 
+		if (mat.textureMask & 0x0000001C)
+			mat.packedTexture = addPackedTexture(alpha, rough, metal);
+
+		// A material needs alpha testing if it has an alpha map, is not fully solid, or is transparent (illum 7).
+		// Albedo maps with an alpha channel are also alpha tested, so only the file header is read to check that
+		bool opaque = !(mat.textureMask & 0x00000004) && mat.dissolve >= 1.0f && mat.illum != 7;
+		if (opaque && (mat.textureMask & 0x00000001))
+		{
+			int width, height, channels;
+			std::string albedoPath = rootPath + "/" + material.diffuse_texname;
+			if (!stbi_info(albedoPath.c_str(), &width, &height, &channels) || channels == 4 || channels == 2)
+				opaque = false;
+		}
+
 		materials.emplace_back(mat);
+		opaqueMaterials.push_back(opaque);
 	}
 
 	// Add default material is there were none
 	if (materials.empty())
+	{
 		materials.emplace_back(Material());
+		opaqueMaterials.push_back(true);
+	}
+
+	// Out of bounds material indices fall back to the first material
+	auto isOpaque = [&](int32_t material) {
+		return (material < 0 || material >= static_cast<int32_t>(opaqueMaterials.size())) ? opaqueMaterials[0] : opaqueMaterials[material];
+	};
 
 	// Loop over all shapes
 	for (const auto& shape : shapes)
@@ -117,6 +172,8 @@ void SceneBuilder::ObjLoader::loadObj(const std::string& filename)
 		// Material indices
 		matIndex.insert(matIndex.end(), shape.mesh.material_ids.begin(), shape.mesh.material_ids.end());
 
+		uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+
 		for (const auto& index : shape.mesh.indices)
 		{
 			Vertex vertex{};
@@ -152,12 +209,50 @@ void SceneBuilder::ObjLoader::loadObj(const std::string& filename)
 			vertices.push_back(vertex);
 			indices.push_back(static_cast<int>(indices.size()));
 		}
+
+		// Order the triangles of the shape so the opaque ones come first. Each shape then becomes up to
+		// two geometries, one that can be flagged opaque and one that still needs the any-hit shader
+		uint32_t firstTriangle = firstIndex / 3;
+		uint32_t triangleCount = static_cast<uint32_t>(indices.size() - firstIndex) / 3;
+
+		std::vector<uint32_t> order(triangleCount);
+		std::iota(order.begin(), order.end(), 0);
+		auto opaqueEnd = std::stable_partition(order.begin(), order.end(), [&](uint32_t t) {
+			return isOpaque(matIndex[firstTriangle + t]);
+		});
+		uint32_t opaqueCount = static_cast<uint32_t>(opaqueEnd - order.begin());
+
+		if (opaqueCount != 0 && opaqueCount != triangleCount)
+		{
+			std::vector<uint32_t> shapeIndices(indices.begin() + firstIndex, indices.end());
+			std::vector<int32_t>  shapeMaterials(matIndex.begin() + firstTriangle, matIndex.begin() + firstTriangle + triangleCount);
+			for (uint32_t t = 0; t < triangleCount; t++)
+			{
+				for (uint32_t v = 0; v < 3; v++)
+					indices[firstIndex + 3 * t + v] = shapeIndices[3 * order[t] + v];
+				matIndex[firstTriangle + t] = shapeMaterials[order[t]];
+			}
+		}
+
+		ShapeRange range{};
+		range.firstIndex    = firstIndex;
+		range.indexCount    = triangleCount * 3;
+		range.firstVertex   = firstIndex;
+		range.vertexCount   = triangleCount * 3;
+		range.firstGeometry = static_cast<uint32_t>(geometries.size());
+
+		addGeometry(firstIndex, opaqueCount * 3, true);
+		addGeometry(firstIndex + opaqueCount * 3, (triangleCount - opaqueCount) * 3, false);
+
+		range.geometryCount = static_cast<uint32_t>(geometries.size()) - range.firstGeometry;
+		if (range.indexCount > 0)
+			shapeRanges.push_back(range);
 	}
 
 	// Fix out of bounds material indices
 	for (auto& index : matIndex)
 	{
-		if (index < 0 || index > materials.size())
+		if (index < 0 || index >= static_cast<int32_t>(materials.size()))
 			index = 0;
 	}
 
@@ -177,7 +272,67 @@ void SceneBuilder::ObjLoader::loadObj(const std::string& filename)
 		}
 	}
 
-	// Compute tangents
+	computeTangents();
+
+	// Convert from SRGB to linear
+	for (auto& m : materials)
+	{
+		m.ambient  = glm::pow(m.ambient, glm::vec3(2.2f));
+		m.diffuse  = glm::pow(m.diffuse, glm::vec3(2.2f));
+		m.specular = glm::pow(m.specular, glm::vec3(2.2f));
+	}
+
+	APP_LOG_TRACE("Number of materials: {}", materialsTOL.size());
+	APP_LOG_TRACE("Number of shapes: {}", shapes.size());
+	APP_LOG_TRACE("Number of geometries: {}", geometries.size());
+	APP_LOG_TRACE("Number of vertices: {}", attrib.vertices.size());
+	APP_LOG_TRACE("Number of indices: {}", indices.size());
+	APP_LOG_TRACE("Number of textures: {}", textures.size());
+}
+
+int32_t SceneBuilder::ObjLoader::addTexture(const std::string& path, Texture::FileType type)
+{
+	TextureSource texture{};
+	texture.path = path;
+	texture.type = type;
+	textures.push_back(texture);
+
+	return static_cast<int32_t>(textures.size()) - 1;
+}
+
+int32_t SceneBuilder::ObjLoader::addPackedTexture(const TextureSource& alpha, const TextureSource& rough, const TextureSource& metal)
+{
+	TextureSource texture{};
+	texture.type = Texture::FileType::PACKED;
+	texture.maps = { alpha, rough, metal };
+	textures.push_back(texture);
+
+	return static_cast<int32_t>(textures.size()) - 1;
+}
+
+void SceneBuilder::ObjLoader::addGeometry(uint32_t firstIndex, uint32_t indexCount, bool opaque)
+{
+	// Adds a range of the index buffer as a geometry along with its bounds
+	if (indexCount == 0)
+		return;
+
+	GeometryInfo geometry{};
+	geometry.firstIndex = firstIndex;
+	geometry.indexCount = indexCount;
+	geometry.opaque     = opaque;
+	geometry.minBounds  = glm::vec3(std::numeric_limits<float>::max());
+	geometry.maxBounds  = glm::vec3(std::numeric_limits<float>::lowest());
+	for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+	{
+		geometry.minBounds = glm::min(geometry.minBounds, vertices[indices[i]].pos);
+		geometry.maxBounds = glm::max(geometry.maxBounds, vertices[indices[i]].pos);
+	}
+
+	geometries.push_back(geometry);
+}
+
+void SceneBuilder::ObjLoader::computeTangents()
+{
 	for (uint32_t i = 0; i < indices.size(); i += 3)
 	{
 		Vertex& v0 = vertices[indices[i + 0]];
@@ -201,177 +356,1518 @@ void SceneBuilder::ObjLoader::loadObj(const std::string& filename)
 		v1.tangent = t;
 		v2.tangent = t;
 	}
-
-	APP_LOG_TRACE("Number of materials: {}", materialsTOL.size());
-	APP_LOG_TRACE("Number of shapes: {}", shapes.size());
-	APP_LOG_TRACE("Number of vertices: {}", attrib.vertices.size());
-	APP_LOG_TRACE("Number of indices: {}", indices.size());
-	APP_LOG_TRACE("Number of textures: {}", textures.size());
 }
 
-// --------------------------------------------------------------------------
-// Scene Builder
-//
-void SceneBuilder::init(const Device& device, const CommandSystem& commandSystem, Gui& gui)
+void SceneBuilder::ObjLoader::loadGltf(const std::string& filename)
 {
-	m_device        = &device;
-	m_commandSystem = &commandSystem;
-	m_gui           = &gui;
+	gltf = std::make_shared<GltfFile>();
+	if (!gltf->load(filename))
+	{
+		APP_LOG_CRITICAL("Failed to load model: {}", filename);
+		throw std::exception();
+	}
+
+	readGltf();
 }
 
-Model SceneBuilder::loadModel(const std::string& filename)
+void SceneBuilder::ObjLoader::readGltf()
 {
-	APP_LOG_INFO("Loading model {}", filename);
+	const JsonValue& json = gltf->getJson();
 
-	// Load model
-	ObjLoader loader;
-	loader.loadObj(filename);
+	auto element = [](int32_t index) {
+		return index < 0 ? SIZE_MAX : static_cast<size_t>(index);
+	};
 
-	// Convert from SRGB to linear
-	for (auto& m : loader.materials)
+	// Describes the image of a glTF texture. The type is NONE if the image can not be loaded. Embedded images
+	// are decoded straight from the mapped file
+	auto getImage = [&](const JsonValue& textureInfo, Texture::FileType type, VkComponentSwizzle channel) {
+		int32_t          imageIndex = json["textures"][element(textureInfo["index"].getInt())]["source"].getInt();
+		const JsonValue& image      = json["images"][element(imageIndex)];
+
+		TextureSource texture{};
+		texture.type    = type;
+		texture.channel = channel;
+
+		if (image.has("bufferView"))
+		{
+			texture.fileData = gltf->getBufferView(image["bufferView"].getInt(), &texture.fileSize);
+			texture.image    = imageIndex;
+		}
+		else if (image["uri"].getString().rfind("data:", 0) != 0)
+			texture.path = image["uri"].getString();
+
+		if (!texture.fileData && texture.path.empty())
+		{
+			APP_LOG_WARN("Skipping unsupported glTF image");
+			texture.type = Texture::FileType::NONE;
+		}
+
+		return texture;
+	};
+
+	// Adds the image of a glTF texture and returns its index, -1 if the image can not be loaded
+	auto addImage = [&](const JsonValue& textureInfo, Texture::FileType type) {
+		TextureSource texture = getImage(textureInfo, type, VK_COMPONENT_SWIZZLE_IDENTITY);
+		if (texture.type == Texture::FileType::NONE)
+			return -1;
+
+		textures.push_back(texture);
+		return static_cast<int32_t>(textures.size()) - 1;
+	};
+
+	// Materials. glTF colors are already linear
+	std::vector<bool> opaqueMaterials;
+
+	const JsonValue& materialsJson = json["materials"];
+	for (size_t i = 0; i < materialsJson.size(); i++)
 	{
-		m.ambient  = glm::pow(m.ambient, glm::vec3(2.2f));
-		m.diffuse  = glm::pow(m.diffuse, glm::vec3(2.2f));
-		m.specular = glm::pow(m.specular, glm::vec3(2.2f));
+		const JsonValue& material = materialsJson[i];
+		const JsonValue& pbr      = material["pbrMetallicRoughness"];
+		const JsonValue& color    = pbr["baseColorFactor"];
+		const JsonValue& emissive = material["emissiveFactor"];
+
+		std::string alphaMode = material.has("alphaMode") ? material["alphaMode"].getString() : "OPAQUE";
+
+		Material mat;
+		mat.diffuse   = glm::vec3(color[0].getFloat(1.0f), color[1].getFloat(1.0f), color[2].getFloat(1.0f));
+		mat.emission  = glm::vec3(emissive[0].getFloat(0.0f), emissive[1].getFloat(0.0f), emissive[2].getFloat(0.0f));
+		mat.dissolve  = (alphaMode == "BLEND") ? color[3].getFloat(1.0f) : 1.0f;
+		mat.metallic  = pbr["metallicFactor"].getFloat(1.0f);
+		mat.roughness = pbr["roughnessFactor"].getFloat(1.0f);
+		mat.illum     = 2;
+
+		// Opaque materials ignore the alpha channel and masked materials bring their own cutoff
+		if (alphaMode == "OPAQUE")
+			mat.alphaCutoff = 0.0f;
+		else if (alphaMode == "MASK")
+			mat.alphaCutoff = material["alphaCutoff"].getFloat(0.5f);
+
+		if (pbr.has("baseColorTexture"))
+		{
+			mat.albedoTexture = addImage(pbr["baseColorTexture"], Texture::FileType::ALBEDO);
+			if (mat.albedoTexture >= 0)
+				mat.textureMask |= 0x00000001; // Bit 1
+		}
+
+		if (material.has("normalTexture"))
+		{
+			mat.normalTexture = addImage(material["normalTexture"], Texture::FileType::NORMAL);
+			if (mat.normalTexture >= 0)
+				mat.textureMask |= 0x00000002; // Bit 2
+		}
+
+		// Metalness is stored in blue and roughness in green of the same image, which already matches the
+		// packed layout
+		if (pbr.has("metallicRoughnessTexture"))
+		{
+			TextureSource metal = getImage(pbr["metallicRoughnessTexture"], Texture::FileType::METAL, VK_COMPONENT_SWIZZLE_B);
+			TextureSource rough = getImage(pbr["metallicRoughnessTexture"], Texture::FileType::ROUGH, VK_COMPONENT_SWIZZLE_G);
+			if (metal.type != Texture::FileType::NONE)
+			{
+				mat.packedTexture = addPackedTexture(TextureSource{}, rough, metal);
+				mat.textureMask |= 0x00000008; // Bit 4
+				mat.textureMask |= 0x00000010; // Bit 5
+			}
+		}
+
+		materials.emplace_back(mat);
+		opaqueMaterials.push_back(alphaMode == "OPAQUE");
 	}
 
-	Model::CreateInfo modelInfo{};
-	modelInfo.device     = m_device;
-	modelInfo.modelIndex = m_modelCount;
+	// Default material from the glTF specification, used by primitives without a material
+	int32_t defaultMaterial = static_cast<int32_t>(materials.size());
+	{
+		Material mat;
+		mat.diffuse     = glm::vec3(1.0f);
+		mat.metallic    = 1.0f;
+		mat.roughness   = 1.0f;
+		mat.illum       = 2;
+		mat.alphaCutoff = 0.0f;
 
-	uint32_t numIndices  = static_cast<uint32_t>(loader.indices.size());
-	uint32_t numVertices = static_cast<uint32_t>(loader.vertices.size());
+		materials.emplace_back(mat);
+		opaqueMaterials.push_back(true);
+	}
 
-	Buffer::CreateInfo createInfo{};
-	createInfo.device        = m_device;
-	createInfo.commandSystem = m_commandSystem;
+	// Find the world transforms of every node that places a mesh
+	const JsonValue& meshes = json["meshes"];
+	const JsonValue& nodes  = json["nodes"];
 
-	if (m_device->isRtxSupported())
-		createInfo.flags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+	std::vector<std::vector<glm::mat4>> meshTransforms(meshes.size());
 
-	// Create vertex buffer
-	char vertexName[128];
-	sprintf(vertexName, "Vertex Buffer Model %d", m_modelCount);
-	createInfo.name        = vertexName;
-	createInfo.data        = loader.vertices.data();
-	createInfo.dataSize    = sizeof(Vertex) * numVertices;
-	createInfo.dataCount   = numVertices;
-	modelInfo.vertexBuffer = Buffer::CreateVertexBuffer(createInfo);
+	const JsonValue& scene = json["scenes"][element(json["scene"].getInt(0))];
+	if (scene.isNull())
+	{
+		// Without a scene every mesh is placed once at the origin
+		for (auto& transforms : meshTransforms)
+			transforms.push_back(glm::mat4(1.0f));
+	}
+	else
+	{
+		std::vector<std::pair<int32_t, glm::mat4>> stack;
+		for (size_t i = 0; i < scene["nodes"].size(); i++)
+			stack.emplace_back(scene["nodes"][i].getInt(), glm::mat4(1.0f));
 
-	// Create index buffer
-	char indexName[128];
-	sprintf(indexName, "Index Buffer Model %d", m_modelCount);
-	createInfo.name       = indexName;
-	createInfo.data       = loader.indices.data();
-	createInfo.dataSize   = sizeof(uint32_t) * numIndices;
-	createInfo.dataCount  = numIndices;;
-	modelInfo.indexBuffer = Buffer::CreateIndexBuffer(createInfo);
+		// Nodes can only have one parent, so visiting a node twice means the file is invalid
+		std::vector<bool> visited(nodes.size(), false);
+		while (!stack.empty())
+		{
+			auto [nodeIndex, parent] = stack.back();
+			stack.pop_back();
 
-	// Create material buffer
-	char materialName[128];
-	sprintf(materialName, "Material Storage Buffer Model %d", m_modelCount);
-	createInfo.name          = materialName;
-	createInfo.data          = loader.materials.data();
-	createInfo.dataSize      = sizeof(Material) * loader.materials.size();
-	createInfo.dataCount     = static_cast<uint32_t>(loader.materials.size());
-	modelInfo.materialBuffer = Buffer::CreateStorageBuffer(createInfo);
-
-	// Create material index buffer
-	char materialIndexName[128];
-	sprintf(materialIndexName, "Material Index Storage Buffer Model %d", m_modelCount);
-	createInfo.name               = materialIndexName;
-	createInfo.data               = loader.matIndex.data();
-	createInfo.dataSize           = sizeof(int32_t) * loader.matIndex.size();
-	createInfo.dataCount          = static_cast<uint32_t>(loader.matIndex.size());
-	modelInfo.materialIndexBuffer = Buffer::CreateStorageBuffer(createInfo);
+			if (nodeIndex < 0 || nodeIndex >= static_cast<int32_t>(nodes.size()) || visited[nodeIndex])
+				continue;
+			visited[nodeIndex] = true;
 
-	// Store buffer addresses
-	ObjectDescription desc;
-	desc.vertexAddress        = modelInfo.vertexBuffer.getDeviceAddress();
-	desc.indexAddress         = modelInfo.indexBuffer.getDeviceAddress();
-	desc.materialAddress      = modelInfo.materialBuffer.getDeviceAddress();
-	desc.materialIndexAddress = modelInfo.materialIndexBuffer.getDeviceAddress();
-	desc.textureOffset        = static_cast<uint32_t>(m_textureInfo.size());
-	m_objectDescriptions.emplace_back(desc);
+			const JsonValue& node = nodes[nodeIndex];
 
-	// Create textures
-	createTextures(loader.textures, loader.textureTypes, filename, modelInfo.textures);
-	for (const auto& texture : modelInfo.textures)
-		m_textureInfo.emplace_back(texture.getDescriptor());
+			glm::mat4 local(1.0f);
+			if (node.has("matrix"))
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					for (uint32_t r = 0; r < 4; r++)
+						local[c][r] = node["matrix"][c * 4 + r].getFloat(c == r ? 1.0f : 0.0f);
+				}
+			}
+			else
+			{
+				const JsonValue& t = node["translation"];
+				const JsonValue& r = node["rotation"];
+				const JsonValue& s = node["scale"];
 
-	// Store model info
-	m_modelInfos.emplace_back(m_modelCount, numVertices, numIndices, desc.vertexAddress, desc.indexAddress);
-	m_modelCount++;
+				glm::quat rotation(r[3].getFloat(1.0f), r[0].getFloat(0.0f), r[1].getFloat(0.0f), r[2].getFloat(0.0f));
 
-	return Model(modelInfo);
-}
+				local = glm::translate(glm::mat4(1.0f), glm::vec3(t[0].getFloat(0.0f), t[1].getFloat(0.0f), t[2].getFloat(0.0f)));
+				local = local * glm::mat4_cast(rotation);
+				local = glm::scale(local, glm::vec3(s[0].getFloat(1.0f), s[1].getFloat(1.0f), s[2].getFloat(1.0f)));
+			}
 
-Model::Instance SceneBuilder::createInstance(const Model& model, glm::mat4 transform)
-{
-	Model::Instance instance;
-	instance.transform = transform;
-	instance.objectID  = model.getIndex();
+			glm::mat4 world = parent * local;
 
-	m_instances.emplace_back(instance);
+			int32_t mesh = node["mesh"].getInt();
+			if (mesh >= 0 && mesh < static_cast<int32_t>(meshes.size()))
+				meshTransforms[mesh].push_back(world);
 
-	return instance;
-}
+			for (size_t i = 0; i < node["children"].size(); i++)
+				stack.emplace_back(node["children"][i].getInt(), world);
+		}
+	}
 
-void SceneBuilder::createTextures(const std::vector<std::string>& texturePaths, const std::vector<Texture::FileType>& textureTypes, const std::string& objPath, std::vector<Texture>& textures)
-{
-	// We need to have at least one texture so that the pipeline does not complain. So we create a
-	// dummy texture if there are currently no textures to load and no previous textures loaded
-	if (texturePaths.empty() && m_textureInfo.empty())
+	// Reads a vec3 or vec2 attribute. Float data is copied directly out of the mapped file
+	auto readVec3 = [](const GltfFile::Accessor& accessor, uint32_t i) {
+		glm::vec3 value(0.0f);
+		if (accessor.componentType == GltfFile::FLOAT && accessor.data && accessor.components >= 3)
+			memcpy(&value, accessor.data + static_cast<size_t>(i) * accessor.stride, sizeof(glm::vec3));
+		else
+			value = { accessor.readFloat(i, 0), accessor.readFloat(i, 1), accessor.readFloat(i, 2) };
+		return value;
+	};
+
+	auto readVec2 = [](const GltfFile::Accessor& accessor, uint32_t i) {
+		glm::vec2 value(0.0f);
+		if (accessor.componentType == GltfFile::FLOAT && accessor.data && accessor.components >= 2)
+			memcpy(&value, accessor.data + static_cast<size_t>(i) * accessor.stride, sizeof(glm::vec2));
+		else
+			value = { accessor.readFloat(i, 0), accessor.readFloat(i, 1) };
+		return value;
+	};
+
+	// Each mesh becomes a shape with one geometry per primitive. The mesh is stored in the space of the first
+	// node that places it, and every other node becomes an instance relative to that node
+	uint32_t primitiveCount = 0;
+	for (size_t meshIndex = 0; meshIndex < meshes.size(); meshIndex++)
 	{
-		Texture::CreateInfo textureInfo{};
-		textureInfo.pDevice        = m_device;
-		textureInfo.pCommandSystem = m_commandSystem;
-		textureInfo.extent         = {1, 1};
-		textureInfo.name           = "Dummy Texture";
+		const std::vector<glm::mat4>& transforms = meshTransforms[meshIndex];
+		if (transforms.empty())
+			continue;
 
-		std::vector<Texture> texture; 
-		texture.emplace_back(Texture::Create(textureInfo));
-		textures = std::move(texture);
-		return;
+		glm::mat4 base         = transforms[0];
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(base)));
+		bool      flipWinding  = glm::determinant(glm::mat3(base)) < 0.0f;
+
+		ShapeRange range{};
+		range.firstIndex    = static_cast<uint32_t>(indices.size());
+		range.firstVertex   = static_cast<uint32_t>(vertices.size());
+		range.firstGeometry = static_cast<uint32_t>(geometries.size());
+
+		const JsonValue& primitives = meshes[meshIndex]["primitives"];
+		for (size_t p = 0; p < primitives.size(); p++)
+		{
+			const JsonValue& primitive  = primitives[p];
+			const JsonValue& attributes = primitive["attributes"];
+
+			if (primitive["mode"].getInt(4) != 4)
+			{
+				APP_LOG_WARN("Skipping glTF primitive that is not a triangle list (mesh {})", meshIndex);
+				continue;
+			}
+
+			GltfFile::Accessor positions = gltf->getAccessor(attributes["POSITION"].getInt());
+			if (positions.count == 0)
+				continue;
+
+			GltfFile::Accessor normals   = gltf->getAccessor(attributes["NORMAL"].getInt());
+			GltfFile::Accessor texCoords = gltf->getAccessor(attributes["TEXCOORD_0"].getInt());
+			GltfFile::Accessor colors    = gltf->getAccessor(attributes["COLOR_0"].getInt());
+
+			uint32_t baseVertex = static_cast<uint32_t>(vertices.size());
+			vertices.resize(baseVertex + positions.count, Vertex{});
+
+			for (uint32_t i = 0; i < positions.count; i++)
+			{
+				Vertex& vertex = vertices[baseVertex + i];
+				vertex.pos = readVec3(positions, i);
+
+				if (i < normals.count)
+					vertex.normal = readVec3(normals, i);
+
+				// glTF puts the origin of texture coordinates at the top left, textures are loaded flipped
+				if (i < texCoords.count)
+				{
+					vertex.texCoord   = readVec2(texCoords, i);
+					vertex.texCoord.y = 1.0f - vertex.texCoord.y;
+				}
+
+				if (i < colors.count)
+					vertex.color = readVec3(colors, i);
+			}
+
+			// Indices
+			uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+			if (primitive.has("indices"))
+			{
+				GltfFile::Accessor indexAccessor = gltf->getAccessor(primitive["indices"].getInt());
+				uint32_t           count         = indexAccessor.count - indexAccessor.count % 3;
+
+				indices.reserve(indices.size() + count);
+				for (uint32_t i = 0; i < count; i++)
+					indices.push_back(baseVertex + std::min(indexAccessor.readIndex(i), positions.count - 1));
+			}
+			else
+			{
+				for (uint32_t i = 0; i < positions.count - positions.count % 3; i++)
+					indices.push_back(baseVertex + i);
+			}
+
+			uint32_t indexCount = static_cast<uint32_t>(indices.size()) - firstIndex;
+
+			if (flipWinding)
+			{
+				for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3)
+					std::swap(indices[i + 1], indices[i + 2]);
+			}
+
+			// Smooth normals from the faces when the primitive has none
+			if (normals.count == 0)
+			{
+				for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3)
+				{
+					Vertex& v0 = vertices[indices[i + 0]];
+					Vertex& v1 = vertices[indices[i + 1]];
+					Vertex& v2 = vertices[indices[i + 2]];
+
+					glm::vec3 n = glm::cross((v1.pos - v0.pos), (v2.pos - v0.pos));
+					v0.normal += n;
+					v1.normal += n;
+					v2.normal += n;
+				}
+			}
+
+			// Move the primitive into the space of its first node
+			for (uint32_t i = baseVertex; i < vertices.size(); i++)
+			{
+				vertices[i].pos = glm::vec3(base * glm::vec4(vertices[i].pos, 1.0f));
+
+				float length = glm::length(vertices[i].normal);
+				if (length > 0.0f)
+					vertices[i].normal = glm::normalize(normalMatrix * (vertices[i].normal / length));
+			}
+
+			// Material
+			int32_t material = primitive["material"].getInt();
+			if (material < 0 || material >= defaultMaterial)
+				material = defaultMaterial;
+
+			matIndex.insert(matIndex.end(), indexCount / 3, material);
+			addGeometry(firstIndex, indexCount, opaqueMaterials[material]);
+
+			primitiveCount++;
+		}
+
+		range.indexCount    = static_cast<uint32_t>(indices.size()) - range.firstIndex;
+		range.vertexCount   = static_cast<uint32_t>(vertices.size()) - range.firstVertex;
+		range.geometryCount = static_cast<uint32_t>(geometries.size()) - range.firstGeometry;
+		if (range.indexCount == 0)
+			continue;
+
+		uint32_t shape = static_cast<uint32_t>(shapeRanges.size());
+		shapeRanges.push_back(range);
+
+		// Other nodes that place this mesh
+		if (transforms.size() > 1)
+		{
+			glm::mat4 inverseBase = glm::inverse(base);
+
+			InstanceGroup group;
+			group.shapes.assign(transforms.size(), shape);
+			group.transforms.push_back(glm::mat4(1.0f));
+			for (size_t i = 1; i < transforms.size(); i++)
+				group.transforms.push_back(transforms[i] * inverseBase);
+
+			nodeInstances.emplace_back(std::move(group));
+		}
 	}
 
-	// There are no textures to load
-	if (texturePaths.empty())
-		return;
+	computeTangents();
 
-	// Find the root path from the obj path
-	size_t      lastSlash = objPath.find_last_of("/\\");
-	std::string rootPath  = objPath.substr(0, lastSlash);
+	APP_LOG_TRACE("Number of materials: {}", materials.size());
+	APP_LOG_TRACE("Number of meshes: {}", meshes.size());
+	APP_LOG_TRACE("Number of primitives: {}", primitiveCount);
+	APP_LOG_TRACE("Number of geometries: {}", geometries.size());
+	APP_LOG_TRACE("Number of vertices: {}", vertices.size());
+	APP_LOG_TRACE("Number of indices: {}", indices.size());
+	APP_LOG_TRACE("Number of textures: {}", textures.size());
+	APP_LOG_TRACE("Number of instanced meshes: {}", nodeInstances.size());
+}
 
-	std::vector<Texture::CreateInfo> infos(texturePaths.size());
-	std::vector<std::stringstream>   filenames(texturePaths.size());
+// Eigen decomposition of a symmetric 3x3 matrix using cyclic Jacobi rotations. Eigenvectors are stored in
+// the columns of vectors, sorted by decreasing eigenvalue
+static void eigenSymmetric(glm::dmat3 a, glm::dvec3& values, glm::dmat3& vectors)
+{
+	vectors = glm::dmat3(1.0);
 
-	// Fill out create infos. Name and filename are allocate on the heap so that they can exists outside
-	// of this for loop.
-	for (uint32_t i = 0; i < texturePaths.size(); i++)
+	for (uint32_t sweep = 0; sweep < 32; sweep++)
 	{
-		char* name = new char[128];
-		sprintf(name, "Texture %d Model %d", i, m_modelCount);
-		infos[i].name = name;
+		double offDiagonal = std::abs(a[1][0]) + std::abs(a[2][0]) + std::abs(a[2][1]);
+		if (offDiagonal < 1e-30)
+			break;
 
-		filenames[i] << rootPath << "/" << texturePaths[i];
-		char* filename = new char[filenames[i].str().length() + 1];
-		strcpy(filename, filenames[i].str().c_str());
-		infos[i].filename = filename;
+		for (int p = 0; p < 2; p++)
+		{
+			for (int q = p + 1; q < 3; q++)
+			{
+				if (std::abs(a[q][p]) < 1e-30)
+					continue;
+
+				// Rotation that zeros out element (p, q)
+				double theta = (a[q][q] - a[p][p]) / (2.0 * a[q][p]);
+				double t     = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+				double c     = 1.0 / std::sqrt(t * t + 1.0);
+				double s     = t * c;
+
+				glm::dmat3 rotation(1.0);
+				rotation[p][p] = c;
+				rotation[q][q] = c;
+				rotation[q][p] = s;
+				rotation[p][q] = -s;
+
+				a       = glm::transpose(rotation) * a * rotation;
+				vectors = vectors * rotation;
+			}
+		}
+	}
 
-		infos[i].fileType = textureTypes[i];
+	values = { a[0][0], a[1][1], a[2][2] };
 
-		infos[i].pDevice        = m_device;
-		infos[i].pCommandSystem = m_commandSystem;
+	// Sort by decreasing eigenvalue
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = i + 1; j < 3; j++)
+		{
+			if (values[j] > values[i])
+			{
+				std::swap(values[i], values[j]);
+				std::swap(vectors[i], vectors[j]);
+			}
+		}
 	}
+}
 
-	// Create textures
-	textures = std::move(Texture::CreateBatch(infos, static_cast<uint32_t>(infos.size())));
+static void hashCombine(size_t& seed, size_t value)
+{
+	seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
 
-	// Free names and filenames
-	for (auto& info : infos)
+std::vector<SceneBuilder::ObjLoader::InstanceGroup> SceneBuilder::ObjLoader::findInstances() const
+{
+	// Canonical frame of a shape. The origin is the centroid and the axes are the principal components of
+	// the vertex positions, so two rigidly transformed copies have the same shape in their canonical frames
+	struct ShapeFrame
 	{
-		delete[] info.name;
-		delete[] info.filename;
-	}
+		glm::dmat4 frame       = glm::dmat4(1.0);
+		glm::dvec3 eigenvalues = glm::dvec3(0.0);
+		size_t     hash        = 0;
+	};
+
+	std::vector<ShapeFrame> frames(shapeRanges.size());
+	for (uint32_t s = 0; s < shapeRanges.size(); s++)
+	{
+		const ShapeRange& range = shapeRanges[s];
+
+		// Vertices are not shared between shapes, so the vertex range of a shape is the same as its index range
+		glm::dvec3 centroid(0.0);
+		for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+			centroid += glm::dvec3(vertices[i].pos);
+		centroid /= static_cast<double>(range.indexCount);
+
+		glm::dmat3 covariance(0.0);
+		for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+		{
+			glm::dvec3 d = glm::dvec3(vertices[i].pos) - centroid;
+			covariance  += glm::outerProduct(d, d);
+		}
+		covariance /= static_cast<double>(range.indexCount);
+
+		glm::dvec3 values;
+		glm::dmat3 vectors;
+		eigenSymmetric(covariance, values, vectors);
+
+		// Force a right handed frame so that the transforms between copies are proper rotations
+		glm::dvec3 axis0 = glm::normalize(vectors[0]);
+		glm::dvec3 axis1 = glm::normalize(vectors[1]);
+		glm::dvec3 axis2 = glm::cross(axis0, axis1);
+
+		frames[s].frame       = glm::dmat4(glm::dvec4(axis0, 0.0), glm::dvec4(axis1, 0.0), glm::dvec4(axis2, 0.0), glm::dvec4(centroid, 1.0));
+		frames[s].eigenvalues = values;
+
+		// The hash only uses values that do not depend on the orientation of the shape, quantized so that
+		// copies land in the same bucket. It only finds candidates, matchShapes compares every vertex after it
+		size_t hash = std::hash<uint32_t>()(range.indexCount);
+		hashCombine(hash, range.geometryCount);
+		for (uint32_t i = 0; i < 3; i++)
+			hashCombine(hash, std::hash<int64_t>()(static_cast<int64_t>(std::round(std::sqrt(std::max(values[i], 0.0)) * 1024.0))));
+		for (uint32_t t = range.firstIndex / 3; t < (range.firstIndex + range.indexCount) / 3; t++)
+			hashCombine(hash, std::hash<int32_t>()(matIndex[t]));
+
+		frames[s].hash = hash;
+	}
+
+	// Checks if shape b is a rigidly transformed copy of shape a and finds the transform
+	auto matchShapes = [&](uint32_t a, uint32_t b, glm::mat4& transform) {
+		const ShapeRange& rangeA = shapeRanges[a];
+		const ShapeRange& rangeB = shapeRanges[b];
+
+		if (rangeA.indexCount != rangeB.indexCount || rangeA.geometryCount != rangeB.geometryCount)
+			return false;
+
+		for (uint32_t g = 0; g < rangeA.geometryCount; g++)
+		{
+			const GeometryInfo& geometryA = geometries[rangeA.firstGeometry + g];
+			const GeometryInfo& geometryB = geometries[rangeB.firstGeometry + g];
+			if (geometryA.indexCount != geometryB.indexCount || geometryA.opaque != geometryB.opaque)
+				return false;
+		}
+
+		for (uint32_t i = 0; i < rangeA.indexCount; i++)
+		{
+			if (indices[rangeA.firstIndex + i] - rangeA.firstIndex != indices[rangeB.firstIndex + i] - rangeB.firstIndex)
+				return false;
+
+			// Attributes that a rigid transform does not change must be equal
+			const Vertex& vertexA = vertices[rangeA.firstIndex + i];
+			const Vertex& vertexB = vertices[rangeB.firstIndex + i];
+			if (vertexA.texCoord != vertexB.texCoord || vertexA.color != vertexB.color)
+				return false;
+		}
+
+		for (uint32_t t = 0; t < rangeA.indexCount / 3; t++)
+		{
+			if (matIndex[rangeA.firstIndex / 3 + t] != matIndex[rangeB.firstIndex / 3 + t])
+				return false;
+		}
+
+		// The principal axes are only known up to their sign, so try every flip that keeps the frame right handed.
+		// Shapes with repeated eigenvalues (symmetric shapes) have ambiguous axes and will usually fail here
+		const glm::dvec3 flips[4] = { { 1, 1, 1 }, { -1, -1, 1 }, { -1, 1, -1 }, { 1, -1, -1 } };
+		const double     radius   = std::sqrt(std::max(frames[a].eigenvalues[0] + frames[a].eigenvalues[1] + frames[a].eigenvalues[2], 0.0));
+
+		glm::dmat4 inverseA = glm::inverse(frames[a].frame);
+		for (const auto& flip : flips)
+		{
+			glm::dmat4 candidate = frames[b].frame * glm::scale(glm::dmat4(1.0), flip) * inverseA;
+			glm::dmat3 rotation  = glm::dmat3(candidate);
+
+			// The copies were transformed and written out in single precision, so every vertex of a must land on
+			// the vertex of b up to a few float ulps. Anything further apart is a different shape
+			bool match = true;
+			for (uint32_t i = 0; i < rangeA.indexCount && match; i++)
+			{
+				const Vertex& vertexA = vertices[rangeA.firstIndex + i];
+				const Vertex& vertexB = vertices[rangeB.firstIndex + i];
+
+				glm::dvec3 p         = glm::dvec3(candidate * glm::dvec4(glm::dvec3(vertexA.pos), 1.0));
+				double     tolerance = 1e-6 * (glm::length(glm::dvec3(vertexB.pos)) + radius);
+				match = glm::length(p - glm::dvec3(vertexB.pos)) <= tolerance;
+
+				glm::dvec3 n = rotation * glm::dvec3(vertexA.normal);
+				match = match && glm::length(n - glm::dvec3(vertexB.normal)) <= 1e-5;
+			}
+
+			if (match)
+			{
+				transform = glm::mat4(candidate);
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	// Group the shapes
+	std::vector<InstanceGroup>                         groups;
+	std::unordered_map<size_t, std::vector<uint32_t>>  buckets;
+	for (uint32_t s = 0; s < shapeRanges.size(); s++)
+	{
+		std::vector<uint32_t>& bucket = buckets[frames[s].hash];
+
+		bool found = false;
+		for (uint32_t g : bucket)
+		{
+			glm::mat4 transform;
+			if (matchShapes(groups[g].shapes[0], s, transform))
+			{
+				groups[g].shapes.push_back(s);
+				groups[g].transforms.push_back(transform);
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+		{
+			InstanceGroup group;
+			group.shapes.push_back(s);
+			group.transforms.push_back(glm::mat4(1.0f));
+
+			bucket.push_back(static_cast<uint32_t>(groups.size()));
+			groups.emplace_back(group);
+		}
+	}
+
+	// Only shapes that appear more than once are worth instancing
+	std::erase_if(groups, [](const InstanceGroup& group) { return group.shapes.size() < 2; });
+
+	return groups;
+}
+
+SceneBuilder::ObjLoader SceneBuilder::ObjLoader::extractShapes(const std::vector<uint32_t>& shapeIndices) const
+{
+	// Materials and textures are not copied. They stay shared with the original loader
+	ObjLoader out;
+	for (uint32_t s : shapeIndices)
+	{
+		const ShapeRange& range = shapeRanges[s];
+
+		uint32_t firstIndex  = static_cast<uint32_t>(out.indices.size());
+		uint32_t firstVertex = static_cast<uint32_t>(out.vertices.size());
+
+		ShapeRange newRange{};
+		newRange.firstIndex    = firstIndex;
+		newRange.indexCount    = range.indexCount;
+		newRange.firstVertex   = firstVertex;
+		newRange.vertexCount   = range.vertexCount;
+		newRange.firstGeometry = static_cast<uint32_t>(out.geometries.size());
+		newRange.geometryCount = range.geometryCount;
+		out.shapeRanges.push_back(newRange);
+
+		out.vertices.insert(out.vertices.end(), vertices.begin() + range.firstVertex, vertices.begin() + range.firstVertex + range.vertexCount);
+		out.matIndex.insert(out.matIndex.end(), matIndex.begin() + range.firstIndex / 3, matIndex.begin() + (range.firstIndex + range.indexCount) / 3);
+
+		for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+			out.indices.push_back(indices[i] - range.firstVertex + firstVertex);
+
+		for (uint32_t g = range.firstGeometry; g < range.firstGeometry + range.geometryCount; g++)
+		{
+			GeometryInfo geometry = geometries[g];
+			geometry.firstIndex   = geometry.firstIndex - range.firstIndex + firstIndex;
+			out.geometries.push_back(geometry);
+		}
+	}
+
+	return out;
+}
+
+void SceneBuilder::ObjLoader::generateLods(JobSystem* jobSystem)
+{
+	APP_PROFILE_FUNCTION();
+
+	// Geometries that are already small are not worth simplifying
+	const uint32_t minTriangles = 256;
+	const uint32_t maxLevels    = 4;
+
+	std::vector<std::vector<MeshSimplifier::Lod>> results(geometries.size());
+
+	// Simplify the geometries in parallel, one job per geometry
+	auto job = [&](uint32_t g, uint32_t) {
+		if (geometries[g].indexCount / 3 < 2 * minTriangles)
+			return;
+
+		results[g] = MeshSimplifier::BuildLodChain(vertices, &indices[geometries[g].firstIndex], geometries[g].indexCount, maxLevels, 0.5f, minTriangles);
+	};
+
+	uint32_t geometryCount = static_cast<uint32_t>(geometries.size());
+	if (jobSystem)
+		jobSystem->run(geometryCount, job);
+	else
+	{
+		for (uint32_t g = 0; g < geometryCount; g++)
+			job(g, 0);
+	}
+
+	// Append the levels to the index buffer. Material indices are appended in the same order so that the
+	// material of a simplified triangle can be found with its primitive ID
+	uint32_t lodCount = 0;
+	for (uint32_t g = 0; g < geometries.size(); g++)
+	{
+		uint32_t firstTriangle = geometries[g].firstIndex / 3;
+		for (const auto& lod : results[g])
+		{
+			LodInfo info{};
+			info.firstIndex = static_cast<uint32_t>(indices.size());
+			info.indexCount = static_cast<uint32_t>(lod.indices.size());
+			info.error      = lod.error;
+			geometries[g].lods.push_back(info);
+
+			indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+			for (uint32_t source : lod.sourceTriangles)
+				matIndex.push_back(matIndex[firstTriangle + source]);
+
+			lodCount++;
+		}
+	}
+
+	if (lodCount > 0)
+		APP_LOG_TRACE("Generated {} levels of detail", lodCount);
+}
+
+// --------------------------------------------------------------------------
+// Scene Builder
+//
+void SceneBuilder::init(const Device& device, const CommandSystem& commandSystem, Gui& gui)
+{
+	m_device        = &device;
+	m_commandSystem = &commandSystem;
+	m_gui           = &gui;
+
+	UploadContext::CreateInfo uploadInfo{};
+	uploadInfo.device = m_device;
+	uploadInfo.name   = "Model Upload Context";
+	m_uploadContext.init(uploadInfo);
+}
+
+void SceneBuilder::cleanup()
+{
+	m_uploadContext.cleanup();
+}
+
+Model SceneBuilder::loadModel(const std::string& filename)
+{
+	APP_PROFILE_FUNCTION();
+	APP_LOG_INFO("Loading model {}", filename);
+
+	// Load model
+	std::string extension = filename.substr(filename.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	bool isGltf = (extension == "glb" || extension == "gltf");
+
+	// Very large OBJ files are streamed to the GPU in chunks instead of being held in memory
+	std::error_code error;
+	uintmax_t       fileSize = std::filesystem::file_size(filename, error);
+	if (!isGltf && !error && fileSize >= m_streamingThreshold)
+		return loadObjStreamed(filename);
+
+	ObjLoader loader;
+	if (isGltf)
+		loader.loadGltf(filename);
+	else
+		loader.loadObj(filename);
+
+	Model::CreateInfo modelInfo{};
+
+	// Create textures. Textures that are already loaded by the scene are reused
+	std::vector<int32_t> textureIndices = createTextures(loader.textures, filename, modelInfo.textures);
+
+	// Move the materials into the scene table. From here on material indices and texture indices refer to the
+	// whole scene instead of this model
+	std::vector<int32_t> tableIndices = addMaterials(loader.materials, textureIndices);
+	for (auto& index : loader.matIndex)
+		index = tableIndices[index];
+
+	// Find shapes that are repeated in the file. Each repeated shape is loaded once as a part of the model. glTF
+	// files already describe their copies with nodes
+	std::vector<ObjLoader::InstanceGroup> groups = isGltf ? loader.nodeInstances : loader.findInstances();
+
+	std::vector<bool> instanced(loader.shapeRanges.size(), false);
+	for (const auto& group : groups)
+	{
+		for (uint32_t shape : group.shapes)
+			instanced[shape] = true;
+	}
+
+	std::vector<uint32_t> uniqueShapes;
+	for (uint32_t i = 0; i < loader.shapeRanges.size(); i++)
+	{
+		if (!instanced[i])
+			uniqueShapes.push_back(i);
+	}
+
+	// If every shape is repeated, the first repeated shape becomes the model itself and its copies are
+	// placed with local instances of the model
+	std::vector<glm::mat4> selfTransforms;
+	if (uniqueShapes.empty() && !groups.empty())
+	{
+		uniqueShapes.push_back(groups[0].shapes[0]);
+		selfTransforms.assign(groups[0].transforms.begin() + 1, groups[0].transforms.end());
+		groups.erase(groups.begin());
+	}
+
+	bool      split = !groups.empty() || !selfTransforms.empty();
+	ObjLoader uniqueMesh;
+	if (split)
+		uniqueMesh = loader.extractShapes(uniqueShapes);
+
+	ObjLoader& mainMesh = split ? uniqueMesh : loader;
+
+	Model model = createModel(mainMesh, modelInfo);
+
+	for (const auto& transform : selfTransforms)
+		model.addLocalInstance(Model::Instance(transform, model.getIndex()));
+
+	// Create the repeated shapes
+	uint32_t copyCount = static_cast<uint32_t>(selfTransforms.size());
+	for (const auto& group : groups)
+	{
+		ObjLoader partMesh = loader.extractShapes({ group.shapes[0] });
+
+		Model::CreateInfo partInfo{};
+		Model part = createModel(partMesh, partInfo);
+
+		for (const auto& transform : group.transforms)
+			model.addLocalInstance(Model::Instance(transform, part.getIndex()));
+
+		model.addPart(part);
+		copyCount += static_cast<uint32_t>(group.transforms.size());
+	}
+
+	if (split)
+		APP_LOG_INFO("Instanced {} repeated shapes as {} copies", groups.size() + (selfTransforms.empty() ? 0 : 1), copyCount);
+
+	m_uploadContext.submit();
+
+	return model;
+}
+
+Model SceneBuilder::createModel(ObjLoader& mesh, Model::CreateInfo& modelInfo)
+{
+	modelInfo.device     = m_device;
+	modelInfo.modelIndex = m_modelCount;
+
+	mesh.generateLods(m_jobSystem);
+
+	// A geometry whose triangles all use the same material stores it directly. The per triangle material
+	// indices are only needed when at least one geometry mixes materials
+	bool needsMaterialIndices = false;
+	for (auto& geometry : mesh.geometries)
+	{
+		auto first = mesh.matIndex.begin() + geometry.firstIndex / 3;
+		auto last  = first + geometry.indexCount / 3;
+
+		bool single = (first != last) && std::all_of(first, last, [&](int32_t index) { return index == *first; });
+		geometry.material = single ? *first : -1;
+
+		if (!single)
+			needsMaterialIndices = true;
+	}
+
+	uint32_t numIndices  = static_cast<uint32_t>(mesh.indices.size());
+	uint32_t numVertices = static_cast<uint32_t>(mesh.vertices.size());
+
+	Buffer::CreateInfo createInfo{};
+	createInfo.device        = m_device;
+	createInfo.commandSystem = m_commandSystem;
+	createInfo.uploadContext = &m_uploadContext;
+
+	if (m_device->isRtxSupported())
+		createInfo.flags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+
+	// Create vertex buffer
+	char vertexName[128];
+	sprintf(vertexName, "Vertex Buffer Model %d", m_modelCount);
+	createInfo.name        = vertexName;
+	createInfo.data        = mesh.vertices.data();
+	createInfo.dataSize    = sizeof(Vertex) * numVertices;
+	createInfo.dataCount   = numVertices;
+	modelInfo.vertexBuffer = Buffer::CreateVertexBuffer(createInfo);
+
+	// Create index buffer
+	char indexName[128];
+	sprintf(indexName, "Index Buffer Model %d", m_modelCount);
+	createInfo.name       = indexName;
+	createInfo.data       = mesh.indices.data();
+	createInfo.dataSize   = sizeof(uint32_t) * numIndices;
+	createInfo.dataCount  = numIndices;
+	modelInfo.indexBuffer = Buffer::CreateIndexBuffer(createInfo);
+
+	// Create material index buffer. The indices are stored as 16 bit values, two per 32 bit word
+	if (needsMaterialIndices)
+	{
+		std::vector<uint16_t> packedIndices((mesh.matIndex.size() + 1) & ~static_cast<size_t>(1), 0);
+		for (size_t i = 0; i < mesh.matIndex.size(); i++)
+			packedIndices[i] = static_cast<uint16_t>(mesh.matIndex[i]);
+
+		char materialIndexName[128];
+		sprintf(materialIndexName, "Material Index Storage Buffer Model %d", m_modelCount);
+		createInfo.name               = materialIndexName;
+		createInfo.data               = packedIndices.data();
+		createInfo.dataSize           = sizeof(uint16_t) * packedIndices.size();
+		createInfo.dataCount          = static_cast<uint32_t>(packedIndices.size());
+		modelInfo.materialIndexBuffer = Buffer::CreateStorageBuffer(createInfo);
+	}
+
+	modelInfo.geometryBuffer = createGeometryBuffer(mesh.geometries);
+	modelInfo.geometries     = mesh.geometries;
+
+	return storeModel(modelInfo, numVertices, numIndices);
+}
+
+Model SceneBuilder::storeModel(Model::CreateInfo& modelInfo, uint32_t numVertices, uint32_t numIndices)
+{
+	// Store buffer addresses
+	ObjectDescription desc;
+	desc.vertexAddress        = modelInfo.vertexBuffer.getDeviceAddress();
+	desc.indexAddress         = modelInfo.indexBuffer.getDeviceAddress();
+	desc.materialIndexAddress = (modelInfo.materialIndexBuffer.getBuffer() != VK_NULL_HANDLE) ? modelInfo.materialIndexBuffer.getDeviceAddress() : 0;
+	desc.geometryAddress      = modelInfo.geometryBuffer.getDeviceAddress();
+	m_objectDescriptions.emplace_back(desc);
+
+	// Store model info
+	m_modelInfos.emplace_back(m_modelCount, numVertices, numIndices, desc.vertexAddress, desc.indexAddress, modelInfo.geometries);
+	m_modelCount++;
+
+	return Model(modelInfo);
+}
+
+Buffer SceneBuilder::createGeometryBuffer(const std::vector<GeometryInfo>& geometries)
+{
+	// The hit shaders use the primitive offset to turn a geometry relative gl_PrimitiveID back into a triangle
+	// index for the whole model
+	std::vector<GeometryDescription> descriptions;
+	descriptions.reserve(geometries.size());
+	for (const auto& geometry : geometries)
+		descriptions.push_back({ geometry.firstIndex / 3, geometry.material });
+
+	char geometryName[128];
+	sprintf(geometryName, "Geometry Storage Buffer Model %d", m_modelCount);
+
+	Buffer::CreateInfo createInfo{};
+	createInfo.device        = m_device;
+	createInfo.commandSystem = m_commandSystem;
+	createInfo.uploadContext = &m_uploadContext;
+	createInfo.name          = geometryName;
+	createInfo.data          = descriptions.data();
+	createInfo.dataSize      = sizeof(GeometryDescription) * descriptions.size();
+	createInfo.dataCount     = static_cast<uint32_t>(descriptions.size());
+
+	return Buffer::CreateStorageBuffer(createInfo);
+}
+
+std::vector<int32_t> SceneBuilder::addMaterials(const std::vector<Material>& materials, const std::vector<int32_t>& textureIndices)
+{
+	// Materials are compared by their bytes, which only works because the struct has no padding
+	static_assert(sizeof(Material) == 24 * sizeof(float), "Material must not contain padding");
+
+	size_t previousCount = m_materials.size();
+
+	std::vector<int32_t> tableIndices;
+	tableIndices.reserve(materials.size());
+	for (Material material : materials)
+	{
+		for (int32_t* texture : { &material.albedoTexture, &material.normalTexture, &material.packedTexture })
+		{
+			if (*texture >= 0)
+				*texture = textureIndices[*texture];
+		}
+
+		std::string key(reinterpret_cast<const char*>(&material), sizeof(Material));
+		auto [it, inserted] = m_materialLookup.try_emplace(std::move(key), static_cast<int32_t>(m_materials.size()));
+		if (inserted)
+			m_materials.push_back(material);
+
+		tableIndices.push_back(it->second);
+	}
+
+	// The shaders read 16 bit material indices
+	if (m_materials.size() > UINT16_MAX + 1)
+	{
+		APP_LOG_CRITICAL("Scene has more than {} unique materials", UINT16_MAX + 1);
+		throw std::exception();
+	}
+
+	APP_LOG_TRACE("Added {} of {} materials to the material table", m_materials.size() - previousCount, materials.size());
+
+	return tableIndices;
+}
+
+// Reads a file one line at a time through a fixed size block, so the file is never fully in memory
+class LineReader
+{
+public:
+	LineReader(const std::string& filename, size_t blockSize)
+		: m_file(filename, std::ios::binary), m_block(blockSize)
+	{
+		if (!m_file.is_open())
+		{
+			APP_LOG_CRITICAL("Failed to open file: {}", filename);
+			throw std::exception();
+		}
+	}
+
+	bool next(std::string_view& line)
+	{
+		while (true)
+		{
+			const char* begin   = m_block.data() + m_begin;
+			const char* newline = static_cast<const char*>(memchr(begin, '\n', m_end - m_begin));
+			if (newline)
+			{
+				line     = std::string_view(begin, newline - begin);
+				m_begin += line.size() + 1;
+				trim(line);
+				return true;
+			}
+
+			if (m_file.eof())
+			{
+				if (m_begin == m_end)
+					return false;
+
+				line    = std::string_view(begin, m_end - m_begin);
+				m_begin = m_end;
+				trim(line);
+				return true;
+			}
+
+			// Move the partial line to the front and read more. Lines longer than the block grow it
+			memmove(m_block.data(), begin, m_end - m_begin);
+			m_end  -= m_begin;
+			m_begin = 0;
+			if (m_end == m_block.size())
+				m_block.resize(m_block.size() * 2);
+
+			m_file.read(m_block.data() + m_end, m_block.size() - m_end);
+			m_end += static_cast<size_t>(m_file.gcount());
+		}
+	}
+
+private:
+	std::ifstream     m_file;
+	std::vector<char> m_block;
+	size_t            m_begin = 0;
+	size_t            m_end   = 0;
+
+	static void trim(std::string_view& line)
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+	}
+};
+
+// Splits the next whitespace separated token off the front of a line
+static std::string_view nextToken(std::string_view& line)
+{
+	size_t begin = line.find_first_not_of(" \t");
+	if (begin == std::string_view::npos)
+	{
+		line = {};
+		return {};
+	}
+
+	size_t end = line.find_first_of(" \t", begin);
+	if (end == std::string_view::npos)
+		end = line.size();
+
+	std::string_view token = line.substr(begin, end - begin);
+	line.remove_prefix(end);
+	return token;
+}
+
+static float parseFloat(std::string_view token)
+{
+	float value = 0.0f;
+	std::from_chars(token.data(), token.data() + token.size(), value);
+	return value;
+}
+
+// Zero based indices of a face corner "v", "v/vt", "v//vn" or "v/vt/vn". Negative indices are relative to the
+// elements that were read so far. Missing indices are -1
+struct ObjCorner
+{
+	int64_t position = -1;
+	int64_t texCoord = -1;
+	int64_t normal   = -1;
+};
+
+static ObjCorner parseCorner(std::string_view token, uint64_t positionCount, uint64_t texCoordCount, uint64_t normalCount)
+{
+	ObjCorner corner;
+	int64_t*  indices[3] = { &corner.position, &corner.texCoord, &corner.normal };
+	uint64_t  counts[3]  = { positionCount, texCoordCount, normalCount };
+
+	for (int i = 0; i < 3 && !token.empty(); i++)
+	{
+		size_t           slash = token.find('/');
+		std::string_view part  = token.substr(0, slash);
+		token = (slash == std::string_view::npos) ? std::string_view() : token.substr(slash + 1);
+
+		int64_t index = 0;
+		if (part.empty() || std::from_chars(part.data(), part.data() + part.size(), index).ec != std::errc() || index == 0)
+			continue;
+
+		*indices[i] = (index < 0) ? static_cast<int64_t>(counts[i]) + index : index - 1;
+	}
+
+	return corner;
+}
+
+Model SceneBuilder::loadObjStreamed(const std::string& filename)
+{
+	APP_LOG_INFO("Streaming model {}", filename);
+
+	const size_t   blockSize      = 16ull * 1024 * 1024;
+	const uint32_t chunkTriangles = 1u << 20;
+	const uint32_t chunkVertices  = 1u << 20;
+
+	// First pass counts the elements, so every device buffer can be created at its final size, and checks the
+	// faces before anything is created
+	uint64_t positionCount = 0, normalCount = 0, texCoordCount = 0, triangleCount = 0;
+	bool     normalsMatch  = true, texCoordsMatch = true;
+	{
+		LineReader reader(filename, blockSize);
+		std::string_view line;
+		while (reader.next(line))
+		{
+			std::string_view type = nextToken(line);
+			if (type == "v")
+				positionCount++;
+			else if (type == "vn")
+				normalCount++;
+			else if (type == "vt")
+				texCoordCount++;
+			else if (type == "f")
+			{
+				uint32_t corners = 0;
+				for (std::string_view token = nextToken(line); !token.empty(); token = nextToken(line))
+				{
+					ObjCorner corner = parseCorner(token, positionCount, texCoordCount, normalCount);
+					if (corner.position < 0 || corner.position >= static_cast<int64_t>(positionCount))
+					{
+						APP_LOG_CRITICAL("Streamed models must define vertices before the faces that use them: {}", filename);
+						throw std::exception();
+					}
+
+					normalsMatch   &= (corner.normal == corner.position);
+					texCoordsMatch &= (corner.texCoord == corner.position);
+					corners++;
+				}
+				if (corners >= 3)
+					triangleCount += corners - 2;
+			}
+		}
+	}
+
+	if (triangleCount == 0 || positionCount == 0)
+	{
+		APP_LOG_CRITICAL("Model has no triangles: {}", filename);
+		throw std::exception();
+	}
+
+	if (positionCount > UINT32_MAX || triangleCount * 3 > UINT32_MAX)
+	{
+		APP_LOG_CRITICAL("Model is too large for 32 bit indices: {}", filename);
+		throw std::exception();
+	}
+
+	// Vertices are welded by their position index. Normals and texture coordinates are only kept when there is
+	// one per position and every corner uses it, which is how scanned meshes are usually written. Otherwise smooth
+	// normals are computed
+	bool readNormals   = (normalCount == positionCount) && normalsMatch;
+	bool readTexCoords = (texCoordCount == positionCount) && texCoordsMatch;
+
+	if (normalCount > 0 && !readNormals)
+		APP_LOG_WARN("Normals of {} are not indexed like its positions, computing smooth normals", filename);
+	if (texCoordCount > 0 && !readTexCoords)
+		APP_LOG_WARN("Texture coordinates of {} are not indexed like its positions, ignoring them", filename);
+
+	uint32_t numVertices = static_cast<uint32_t>(positionCount);
+	uint32_t numIndices  = static_cast<uint32_t>(triangleCount * 3);
+
+	Model::CreateInfo modelInfo{};
+	modelInfo.device     = m_device;
+	modelInfo.modelIndex = m_modelCount;
+
+	Buffer::CreateInfo createInfo{};
+	createInfo.device        = m_device;
+	createInfo.commandSystem = m_commandSystem;
+
+	if (m_device->isRtxSupported())
+		createInfo.flags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+
+	// Create the buffers empty. They are filled through the upload context while parsing
+	char vertexName[128];
+	sprintf(vertexName, "Vertex Buffer Model %d", m_modelCount);
+	createInfo.name        = vertexName;
+	createInfo.data        = nullptr;
+	createInfo.dataSize    = sizeof(Vertex) * numVertices;
+	createInfo.dataCount   = numVertices;
+	modelInfo.vertexBuffer = Buffer::CreateVertexBuffer(createInfo);
+
+	char indexName[128];
+	sprintf(indexName, "Index Buffer Model %d", m_modelCount);
+	createInfo.name       = indexName;
+	createInfo.dataSize   = sizeof(uint32_t) * numIndices;
+	createInfo.dataCount  = numIndices;
+	modelInfo.indexBuffer = Buffer::CreateIndexBuffer(createInfo);
+
+	// Second pass parses the file. Positions stay in memory for the bounds and normals, indices are uploaded
+	// one chunk at a time and each chunk becomes its own geometry
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals(numVertices, glm::vec3(0.0f));
+	std::vector<glm::vec2> texCoords;
+	positions.reserve(numVertices);
+	if (readTexCoords)
+		texCoords.reserve(numVertices);
+
+	std::vector<GeometryInfo> geometries;
+	std::vector<uint32_t>     chunk;
+	chunk.reserve(chunkTriangles * 3);
+
+	uint32_t uploadedIndices = 0;
+	uint32_t normalIndex     = 0;
+
+	auto flushChunk = [&]() {
+		if (chunk.empty())
+			return;
+
+		GeometryInfo geometry{};
+		geometry.firstIndex = uploadedIndices;
+		geometry.indexCount = static_cast<uint32_t>(chunk.size());
+		geometry.minBounds  = glm::vec3(std::numeric_limits<float>::max());
+		geometry.maxBounds  = glm::vec3(std::numeric_limits<float>::lowest());
+		for (uint32_t index : chunk)
+		{
+			geometry.minBounds = glm::min(geometry.minBounds, positions[index]);
+			geometry.maxBounds = glm::max(geometry.maxBounds, positions[index]);
+		}
+		geometries.push_back(geometry);
+
+		m_uploadContext.upload(modelInfo.indexBuffer.getBuffer(), sizeof(uint32_t) * uploadedIndices, chunk.data(), sizeof(uint32_t) * chunk.size());
+		uploadedIndices += static_cast<uint32_t>(chunk.size());
+		chunk.clear();
+	};
+
+	{
+		LineReader reader(filename, blockSize);
+		std::string_view line;
+		std::vector<uint32_t> face;
+		while (reader.next(line))
+		{
+			std::string_view type = nextToken(line);
+			if (type == "v")
+			{
+				glm::vec3 p;
+				p.x = parseFloat(nextToken(line));
+				p.y = parseFloat(nextToken(line));
+				p.z = parseFloat(nextToken(line));
+				positions.push_back(p);
+			}
+			else if (type == "vn" && readNormals)
+			{
+				glm::vec3& n = normals[normalIndex++];
+				n.x = parseFloat(nextToken(line));
+				n.y = parseFloat(nextToken(line));
+				n.z = parseFloat(nextToken(line));
+			}
+			else if (type == "vt" && readTexCoords)
+			{
+				glm::vec2 t;
+				t.x = parseFloat(nextToken(line));
+				t.y = parseFloat(nextToken(line));
+				texCoords.push_back(t);
+			}
+			else if (type == "f")
+			{
+				// Only the position index of each corner is used, the first pass checked the others and the range
+				face.clear();
+				for (std::string_view token = nextToken(line); !token.empty(); token = nextToken(line))
+					face.push_back(static_cast<uint32_t>(parseCorner(token, positions.size(), 0, 0).position));
+
+				// Triangulate as a fan
+				for (size_t i = 2; i < face.size(); i++)
+				{
+					uint32_t v0 = face[0], v1 = face[i - 1], v2 = face[i];
+					chunk.push_back(v0);
+					chunk.push_back(v1);
+					chunk.push_back(v2);
+
+					if (!readNormals)
+					{
+						glm::vec3 n = glm::cross(positions[v1] - positions[v0], positions[v2] - positions[v0]);
+						normals[v0] += n;
+						normals[v1] += n;
+						normals[v2] += n;
+					}
+
+					if (chunk.size() >= chunkTriangles * 3)
+						flushChunk();
+				}
+			}
+		}
+	}
+	flushChunk();
+
+	// Vertices are assembled and uploaded one chunk at a time
+	{
+		std::vector<Vertex> vertices;
+		vertices.reserve(std::min(numVertices, chunkVertices));
+		for (uint32_t first = 0; first < numVertices; first += chunkVertices)
+		{
+			uint32_t count = std::min(chunkVertices, numVertices - first);
+
+			vertices.assign(count, Vertex{});
+			for (uint32_t i = 0; i < count; i++)
+			{
+				Vertex& vertex = vertices[i];
+				vertex.pos = positions[first + i];
+
+				float length = glm::length(normals[first + i]);
+				if (length > 0.0f)
+					vertex.normal = normals[first + i] / length;
+
+				if (readTexCoords)
+					vertex.texCoord = texCoords[first + i];
+			}
+
+			m_uploadContext.upload(modelInfo.vertexBuffer.getBuffer(), sizeof(Vertex) * first, vertices.data(), sizeof(Vertex) * count);
+		}
+	}
+
+	// Single default material, converted from SRGB to linear like the other OBJ materials. Every geometry
+	// uses it, so no material index buffer is needed
+	Material material;
+	material.ambient  = glm::pow(material.ambient, glm::vec3(2.2f));
+	material.diffuse  = glm::pow(material.diffuse, glm::vec3(2.2f));
+	material.specular = glm::pow(material.specular, glm::vec3(2.2f));
+
+	int32_t tableIndex = addMaterials({ material }, {})[0];
+	for (auto& geometry : geometries)
+		geometry.material = tableIndex;
+
+	modelInfo.geometryBuffer = createGeometryBuffer(geometries);
+	modelInfo.geometries     = geometries;
+
+	// Only creates the dummy texture if nothing else has been loaded
+	createTextures({}, filename, modelInfo.textures);
+
+	APP_LOG_TRACE("Number of vertices: {}", numVertices);
+	APP_LOG_TRACE("Number of indices: {}", numIndices);
+	APP_LOG_TRACE("Number of geometries: {}", geometries.size());
+
+	Model model = storeModel(modelInfo, numVertices, numIndices);
+	m_uploadContext.submit();
+
+	return model;
+}
+
+Model::Instance SceneBuilder::createInstance(const Model& model, glm::mat4 transform)
+{
+	Model::Instance instance;
+	instance.transform = transform;
+	instance.objectID  = model.getIndex();
+
+	m_instances.emplace_back(instance);
+
+	// Place the repeated shapes of the model relative to this instance
+	for (const auto& local : model.getLocalInstances())
+		m_instances.emplace_back(transform * local.transform, local.objectID);
+
+	return instance;
+}
+
+std::vector<int32_t> SceneBuilder::createTextures(const std::vector<ObjLoader::TextureSource>& textureSources, const std::string& objPath, std::vector<Texture>& textures)
+{
+	// We need to have at least one texture so that the pipeline does not complain. So we create a
+	// dummy texture if there are currently no textures to load and no previous textures loaded
+	if (textureSources.empty() && m_textureInfo.empty())
+	{
+		Texture::CreateInfo textureInfo{};
+		textureInfo.pDevice        = m_device;
+		textureInfo.pCommandSystem = m_commandSystem;
+		textureInfo.extent         = {1, 1};
+		textureInfo.name           = "Dummy Texture";
+
+		std::vector<Texture> texture; 
+		texture.emplace_back(Texture::Create(textureInfo));
+		textures = std::move(texture);
+
+		m_textureInfo.emplace_back(textures[0].getDescriptor());
+		m_textureStreamInfo.emplace_back(textures[0].getStreamInfo());
+		return {};
+	}
+
+	// There are no textures to load
+	if (textureSources.empty())
+		return {};
+
+	// Find the root path from the obj path
+	size_t      lastSlash = objPath.find_last_of("/\\");
+	std::string rootPath  = objPath.substr(0, lastSlash);
+
+	// Look every texture up in the scene cache. A texture is identified by its canonical file path, or by the
+	// model file and image index if it is embedded, together with the way it is sampled. A packed texture is
+	// identified by the maps it holds
+	auto sourceKey = [&](const ObjLoader::TextureSource& source) {
+		std::error_code error;
+		std::string     key = source.fileData
+			? std::filesystem::weakly_canonical(objPath, error).string() + "#" + std::to_string(source.image)
+			: std::filesystem::weakly_canonical(rootPath + "/" + source.path, error).string();
+		return key + "|" + std::to_string(static_cast<int>(source.type)) + "|" + std::to_string(static_cast<int>(source.channel));
+	};
+
+	// Textures that are new to the scene are only added to the cache once they were created, so a failed batch
+	// does not leave behind entries that point past the end of the scene textures
+	std::vector<int32_t>                     textureIndices(textureSources.size(), -1);
+	std::vector<uint32_t>                    newSources;
+	std::unordered_map<std::string, int32_t> newIndices;
+	for (uint32_t i = 0; i < textureSources.size(); i++)
+	{
+		const ObjLoader::TextureSource& source = textureSources[i];
+
+		std::string key;
+		if (source.type == Texture::FileType::PACKED)
+		{
+			for (const auto& map : source.maps)
+				key += (map.type == Texture::FileType::NONE) ? "-;" : sourceKey(map) + ";";
+		}
+		else
+			key = sourceKey(source);
+
+		auto cached = m_textureCache.find(key);
+		if (cached != m_textureCache.end())
+		{
+			textureIndices[i] = cached->second;
+			continue;
+		}
+
+		auto [it, inserted] = newIndices.try_emplace(key, static_cast<int32_t>(m_textureInfo.size() + newSources.size()));
+		if (inserted)
+			newSources.push_back(i);
+
+		textureIndices[i] = it->second;
+	}
+
+	APP_LOG_TRACE("Reusing {} of {} textures", textureSources.size() - newSources.size(), textureSources.size());
+
+	if (newSources.empty())
+		return textureIndices;
+
+	std::vector<Texture::CreateInfo> infos(newSources.size());
+
+	// Fill out create infos. Names and filenames are allocated on the heap so that they can exists outside
+	// of this for loop. Embedded images are loaded from memory, but their filename is the model file so they
+	// are cached next to it
+	auto copyString = [](const std::string& string) {
+		char* copy = new char[string.length() + 1];
+		strcpy(copy, string.c_str());
+		return copy;
+	};
+
+	auto sourceFile = [&](const ObjLoader::TextureSource& source) {
+		return source.fileData ? objPath : rootPath + "/" + source.path;
+	};
+
+	for (uint32_t i = 0; i < newSources.size(); i++)
+	{
+		const ObjLoader::TextureSource& source = textureSources[newSources[i]];
+
+		char* name = new char[128];
+		sprintf(name, "Texture %d Model %d", newSources[i], m_modelCount);
+		infos[i].name = name;
+
+		infos[i].fileType = source.type;
+
+		if (source.type == Texture::FileType::PACKED)
+		{
+			// The maps can come from any number of files, so the cache is named after the first map and the
+			// combination of maps. The maps are named relative to the model, so the name does not change when
+			// the model is moved
+			std::string mapsKey;
+			for (const auto& map : source.maps)
+			{
+				if (map.type == Texture::FileType::NONE)
+					mapsKey += "-;";
+				else
+					mapsKey += (map.fileData ? "#" + std::to_string(map.image) : map.path) + "|" + std::to_string(static_cast<int>(map.channel)) + ";";
+			}
+
+			std::string cachePath;
+			for (uint32_t map = 0; map < source.maps.size() && map < 3; map++)
+			{
+				if (source.maps[map].type == Texture::FileType::NONE)
+					continue;
+
+				infos[i].maps[map].type     = source.maps[map].type;
+				infos[i].maps[map].filename = copyString(sourceFile(source.maps[map]));
+				infos[i].maps[map].fileData = source.maps[map].fileData;
+				infos[i].maps[map].fileSize = source.maps[map].fileSize;
+				infos[i].maps[map].channel  = source.maps[map].channel;
+
+				if (cachePath.empty())
+				{
+					std::stringstream stream;
+					stream << infos[i].maps[map].filename << "." << std::hex << hashBytes(mapsKey.data(), mapsKey.size());
+					cachePath = stream.str();
+				}
+			}
+
+			infos[i].cachePath = copyString(cachePath);
+		}
+		else
+		{
+			infos[i].filename = copyString(sourceFile(source));
+			if (source.fileData)
+				infos[i].cachePath = copyString(objPath + ".image" + std::to_string(source.image));
+
+			infos[i].fileData = source.fileData;
+			infos[i].fileSize = source.fileSize;
+			infos[i].channel  = source.channel;
+		}
+
+		infos[i].pDevice        = m_device;
+		infos[i].pCommandSystem = m_commandSystem;
+		infos[i].stream         = m_streamTextures;
+	}
+
+	// Create textures. The model that loads a texture first owns it
+	textures = std::move(Texture::CreateBatch(infos, static_cast<uint32_t>(infos.size())));
+	for (const auto& texture : textures)
+	{
+		m_textureInfo.emplace_back(texture.getDescriptor());
+		m_textureStreamInfo.emplace_back(texture.getStreamInfo());
+	}
+
+	m_textureCache.insert(newIndices.begin(), newIndices.end());
+
+	// Free names and filenames
+	for (auto& info : infos)
+	{
+		delete[] info.name;
+		delete[] info.filename;
+		delete[] info.cachePath;
+
+		for (auto& map : info.maps)
+			delete[] map.filename;
+	}
+
+	return textureIndices;
 }
@@ -3,14 +3,20 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <unordered_map>
+
 #include "logging.h"
 #include "Gui.h"
+#include "mesh_simplifier.h"
+#include "gltf.h"
 
 #include "Core/device.h"
 #include "Core/buffer.h"
 #include "Core/rendering_structures.h"
 #include "Core/command.h"
 #include "Core/texture.h"
+#include "Core/upload_context.h"
+#include "Core/job_system.h"
 
 struct Material
 {
@@ -27,21 +33,57 @@ struct Material
 	int32_t   illum         = 0;
 
 	glm::vec3 emission      = { 0.0f, 0.0f, 0.0f };
-	int32_t   textureID     = -1;
+	int32_t   albedoTexture = -1;
 
 	float     roughness     = 1.0f;
 	float     metallic      = 0.0f;
 
 	uint32_t  textureMask   = 0x00000000;
+
+	// Index of each texture in the scene texture array. Materials can share textures. The alpha, roughness and
+	// metalness maps are packed into the red, green and blue channels of one texture
+	int32_t   normalTexture = -1;
+	int32_t   packedTexture = -1;
+
+	// Fragments and hits with a lower albedo alpha are discarded
+	float     alphaCutoff   = 0.1f;
 };
 
 struct ObjectDescription
 {
 	uint64_t vertexAddress;
 	uint64_t indexAddress;
-	uint64_t materialAddress;
-	uint64_t materialIndexAddress;
-	uint32_t textureOffset;
+	uint64_t materialIndexAddress; // 0 if every geometry of the model has a single material
+	uint64_t geometryAddress;
+};
+
+// Per geometry data read by the shaders
+struct GeometryDescription
+{
+	uint32_t primitiveOffset;
+	int32_t  material;
+};
+
+// A simplified version of a geometry. Its indices are stored after the full detail indices of the model
+struct LodInfo
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	float    error      = 0.0f; // Approximate geometric error in object space
+};
+
+// A contiguous range of a model's index buffer. Every OBJ shape is split into an opaque and an alpha
+// tested range, and each becomes its own BLAS geometry
+struct GeometryInfo
+{
+	uint32_t  firstIndex = 0;
+	uint32_t  indexCount = 0;
+	bool      opaque     = true;
+	glm::vec3 minBounds  = glm::vec3(0.0f);
+	glm::vec3 maxBounds  = glm::vec3(0.0f);
+	int32_t   material   = -1; // Scene material of every triangle, -1 if the triangles use different materials
+
+	std::vector<LodInfo> lods; // Raster only, each level is coarser than the previous
 };
 
 struct ModelInfo
@@ -51,6 +93,8 @@ struct ModelInfo
 	uint32_t indexCount;
 	uint64_t vertexAddress;
 	uint64_t indexAddress;
+
+	std::vector<GeometryInfo> geometries;
 };
 
 class Model
@@ -61,10 +105,11 @@ public:
 	{
 		Buffer vertexBuffer;
 		Buffer indexBuffer;
-		Buffer materialBuffer;
 		Buffer materialIndexBuffer;
+		Buffer geometryBuffer;
 
-		std::vector<Texture> textures;
+		std::vector<Texture>      textures;
+		std::vector<GeometryInfo> geometries;
 
 		uint32_t modelIndex  = 0;
 		const Device* device = nullptr;
@@ -87,15 +132,26 @@ public:
 	Model(Model::CreateInfo info)
 		: m_vertexBuffer       (info.vertexBuffer),
 		  m_indexBuffer        (info.indexBuffer),
-		  m_materialBuffer     (info.materialBuffer),
 		  m_materialIndexBuffer(info.materialIndexBuffer),
+		  m_geometryBuffer     (info.geometryBuffer),
 		  m_device             (info.device),
 	      m_index              (info.modelIndex),
-	      m_textures           (info.textures){}
+	      m_textures           (info.textures),
+		  m_geometries         (info.geometries) {}
 
 	Buffer& getVertexBuffer() { return m_vertexBuffer; }
 	Buffer& getIndexBuffer() { return m_indexBuffer; }
 	uint32_t getIndex() const { return m_index; }
+	const std::vector<GeometryInfo>& getGeometries() const { return m_geometries; }
+
+	// Shapes that are repeated in the source file are loaded once as a separate part and placed with local
+	// instances. A local instance can also point back to this model if the whole model is a repeated shape
+	const std::vector<Model>& getParts() const { return m_parts; }
+	const std::vector<Instance>& getLocalInstances() const { return m_localInstances; }
+	Model& getPart(uint32_t objectID);
+
+	void addPart(const Model& part) { m_parts.push_back(part); }
+	void addLocalInstance(const Instance& instance) { m_localInstances.push_back(instance); }
 
 	void cleanup();
 
@@ -104,10 +160,14 @@ private:
 
 	Buffer m_vertexBuffer;
 	Buffer m_indexBuffer;
-	Buffer m_materialBuffer;
 	Buffer m_materialIndexBuffer;
+	Buffer m_geometryBuffer;
 
-	std::vector<Texture> m_textures;
+	std::vector<Texture>      m_textures;
+	std::vector<GeometryInfo> m_geometries;
+
+	std::vector<Model>    m_parts;
+	std::vector<Instance> m_localInstances;
 
 	uint32_t m_index = 0;
 };
@@ -120,9 +180,20 @@ public:
 
 	void init(const Device& device, const CommandSystem& commandSystem, Gui& gui);
 
+	// Buffers of a model are uploaded in one submission that the next graphics work waits for on the GPU
 	Model loadModel(const std::string& filename);
 	Model::Instance createInstance(const Model& model, glm::mat4 transform);
 
+	// OBJ files at least this large are streamed to the GPU. Streamed models have a single material and no
+	// textures, instancing or levels of detail
+	void setStreamingThreshold(uint64_t bytes) { m_streamingThreshold = bytes; }
+
+	// Only load the small levels of compressed textures and leave the rest to a TextureStreamer
+	void setTextureStreaming(bool enable) { m_streamTextures = enable; }
+
+	// Levels of detail are generated on the job system. Without one they are generated on the calling thread
+	void setJobSystem(JobSystem* jobSystem) { m_jobSystem = jobSystem; }
+
 	void setLightPosition(glm::vec3 pos) { m_gui->setInitialLightPosition(pos); }
 	void setBackgroundColor(glm::vec3 color) { m_gui->setInitialBackground(color); }
 	
@@ -130,37 +201,130 @@ public:
 
 	const std::vector<ModelInfo>& getModelInformation() const { return m_modelInfos; }
 	const std::vector<ObjectDescription>& getObjectDescriptions() const { return m_objectDescriptions; }
+	const std::vector<Material>& getMaterials() const { return m_materials; }
 	const std::vector<Model::Instance>& getInstances() const { return m_instances; }
 	const std::vector<VkDescriptorImageInfo>& getTextureInfo() const { return m_textureInfo; }
+	const std::vector<Texture::StreamInfo>& getTextureStreamInfo() const { return m_textureStreamInfo; }
+
+	void cleanup();
 
 private:
-	// Object loader
+	// Object loader. Also loads glTF files into the same layout
 	struct ObjLoader
 	{
+		// A texture file relative to the model, or an encoded image stored inside the model file
+		struct TextureSource
+		{
+			std::string        path;
+			Texture::FileType  type     = Texture::FileType::NONE;
+			const uint8_t*     fileData = nullptr;
+			size_t             fileSize = 0;
+			VkComponentSwizzle channel  = VK_COMPONENT_SWIZZLE_IDENTITY;
+			int32_t            image    = -1; // glTF image index of an embedded image
+
+			// FileType::PACKED: the alpha, roughness and metalness maps that go into the red, green and blue
+			// channels. Maps that are not used have the type NONE
+			std::vector<TextureSource> maps;
+		};
+
 		std::vector<Vertex>            vertices;
 		std::vector<uint32_t>          indices;
 		std::vector<Material>          materials;
 		std::vector<int32_t>           matIndex;
-		std::vector<std::string>       textures;
-		std::vector<Texture::FileType> textureTypes;
+		std::vector<TextureSource>     textures;
+		std::vector<GeometryInfo>      geometries;
+
+		// Keeps the mapped glTF file alive while its embedded textures are uploaded
+		std::shared_ptr<GltfFile> gltf;
+
+		// Index, vertex and geometry range of every shape
+		struct ShapeRange
+		{
+			uint32_t firstIndex    = 0;
+			uint32_t indexCount    = 0;
+			uint32_t firstVertex   = 0;
+			uint32_t vertexCount   = 0;
+			uint32_t firstGeometry = 0;
+			uint32_t geometryCount = 0;
+		};
+		std::vector<ShapeRange> shapeRanges;
+
+		// Shapes that are exact copies of each other up to a rigid transform. The first shape is the prototype
+		// and each transform places the prototype onto the shape with the same index
+		struct InstanceGroup
+		{
+			std::vector<uint32_t>  shapes;
+			std::vector<glm::mat4> transforms;
+		};
+
+		// glTF meshes that are placed by more than one node. Filled by loadGltf instead of searching for copies
+		std::vector<InstanceGroup> nodeInstances;
 
 		void loadObj(const std::string& filename);
+		void loadGltf(const std::string& filename);
+
+		// Reads the meshes, materials and nodes of the glTF file that is already loaded into gltf
+		void readGltf();
+
+		int32_t addTexture(const std::string& path, Texture::FileType type);
+		int32_t addPackedTexture(const TextureSource& alpha, const TextureSource& rough, const TextureSource& metal);
+		void addGeometry(uint32_t firstIndex, uint32_t indexCount, bool opaque);
+		void computeTangents();
+
+		// Only valid for OBJ data, where every index has its own vertex
+		std::vector<InstanceGroup> findInstances() const;
+		ObjLoader extractShapes(const std::vector<uint32_t>& shapeIndices) const;
+
+		// Appends simplified versions of every geometry to the end of the index buffer. This must be called
+		// last since the shape ranges no longer cover the whole index buffer afterwards. The geometries are
+		// simplified on the job system when one is given
+		void generateLods(JobSystem* jobSystem);
 	};
 
 	std::vector<ModelInfo>             m_modelInfos;
 	std::vector<ObjectDescription>     m_objectDescriptions;
 	std::vector<Model::Instance>       m_instances;
 	std::vector<VkDescriptorImageInfo> m_textureInfo;
+	std::vector<Texture::StreamInfo>   m_textureStreamInfo; // Same order as m_textureInfo
+
+	// Canonical texture source and sampling to its index in m_textureInfo
+	std::unordered_map<std::string, int32_t> m_textureCache;
 
-	uint32_t m_modelCount = 0;
+	// Scene wide material table. The lookup maps the raw bytes of a material to its index in the table
+	std::vector<Material>                    m_materials;
+	std::unordered_map<std::string, int32_t> m_materialLookup;
+
+	uint32_t m_modelCount         = 0;
+	uint64_t m_streamingThreshold = 1ull << 30;
+	bool     m_streamTextures     = false;
 
 	const Device*        m_device        = nullptr;
 	const CommandSystem* m_commandSystem = nullptr;
 	Gui*                 m_gui           = nullptr;
+	JobSystem*           m_jobSystem     = nullptr;
+
+	UploadContext m_uploadContext;
+
+	Model createModel(ObjLoader& mesh, Model::CreateInfo& modelInfo);
+	Model storeModel(Model::CreateInfo& modelInfo, uint32_t numVertices, uint32_t numIndices);
+
+	Buffer createGeometryBuffer(const std::vector<GeometryInfo>& geometries);
+
+	/**
+	 * Add materials to the scene wide material table. Materials that are already in the table are reused.
+	 *
+	 * @param materials: Materials of a model. Their texture indices refer to the textures of the model.
+	 * @param textureIndices: Scene texture index of each texture of the model.
+	 *
+	 * @return The table index of each material.
+	 */
+	std::vector<int32_t> addMaterials(const std::vector<Material>& materials, const std::vector<int32_t>& textureIndices);
+
+	Model loadObjStreamed(const std::string& filename);
 
-	void createTextures(
-		const std::vector<std::string>&       texturePaths, 
-		const std::vector<Texture::FileType>& textureTypes, 
-		const std::string&                    objPath, 
-		std::vector<Texture>&                 textures);
+	// Creates the textures that the scene does not have yet and returns the scene texture index of every source
+	std::vector<int32_t> createTextures(
+		const std::vector<ObjLoader::TextureSource>& textureSources,
+		const std::string&                           objPath,
+		std::vector<Texture>&                        textures);
 };
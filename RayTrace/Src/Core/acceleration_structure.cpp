@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "acceleration_structure.h"
 
+#include "Application/cpu_profiler.h"
+
 void AccelerationStructure::init(const std::vector<ModelInfo>& models, const std::vector<Model::Instance>& instances, const Device& device, const CommandSystem& commandSystem)
 {
 	APP_LOG_INFO("Initializing acceleration structure");
@@ -31,6 +33,7 @@ void AccelerationStructure::cleanup()
 
 void AccelerationStructure::createBlas(const std::vector<ModelInfo>& models)
 {
+	APP_PROFILE_FUNCTION();
 	APP_LOG_INFO("Creating BLAS");
 
 	uint32_t blasCount = static_cast<uint32_t>(models.size());
@@ -52,18 +55,26 @@ void AccelerationStructure::createBlas(const std::vector<ModelInfo>& models)
 		VkAccelerationStructureGeometryKHR geometry{};
 		geometry.sType              = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
 		geometry.geometryType       = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-		geometry.flags              = VK_GEOMETRY_NO_DUPLICATE_ANY_HIT_INVOCATION_BIT_KHR;
 		geometry.geometry.triangles = triangles;
 
-		VkAccelerationStructureBuildRangeInfoKHR offset{};
-		offset.firstVertex     = 0;
-		offset.primitiveCount  = model.indexCount / 3;
-		offset.primitiveOffset = 0;
-		offset.transformOffset = 0;
-
+		// One geometry per shape so the builder can fit each part separately. They all share the same
+		// vertex and index buffers and only differ by their offset into the index buffer
 		BlasInput input;
-		input.geometry.emplace_back(geometry);
-		input.buildRangeInfo.emplace_back(offset);
+		for (const auto& part : model.geometries)
+		{
+			// Opaque geometry never invokes the any-hit shaders
+			geometry.flags = part.opaque ? VK_GEOMETRY_OPAQUE_BIT_KHR : VK_GEOMETRY_NO_DUPLICATE_ANY_HIT_INVOCATION_BIT_KHR;
+
+			VkAccelerationStructureBuildRangeInfoKHR offset{};
+			offset.firstVertex     = 0;
+			offset.primitiveCount  = part.indexCount / 3;
+			offset.primitiveOffset = part.firstIndex * sizeof(uint32_t);
+			offset.transformOffset = 0;
+
+			input.geometry.emplace_back(geometry);
+			input.buildRangeInfo.emplace_back(offset);
+		}
+
 		blasInputs.emplace_back(input);
 	}
 
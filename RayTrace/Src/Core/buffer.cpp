@@ -1,6 +1,8 @@
 #include "pch.h"
 
 #include "buffer.h"
+#include "staging_window.h"
+#include "upload_context.h"
 
 Buffer Buffer::CreateVertexBuffer(CreateInfo& info)
 {
@@ -11,6 +13,7 @@ Buffer Buffer::CreateVertexBuffer(CreateInfo& info)
         info.dataCount,
         *info.device,
         *info.commandSystem,
+        info.uploadContext,
         info.name);
 }
 
@@ -23,6 +26,7 @@ Buffer Buffer::CreateIndexBuffer(CreateInfo& info)
         info.dataCount,
         *info.device,
         *info.commandSystem,
+        info.uploadContext,
         info.name);
 }
 
@@ -31,17 +35,19 @@ Buffer Buffer::CreateUniformBuffer(CreateInfo& info)
     APP_LOG_INFO("Creating buffer ({})", info.name);
 
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    Allocation allocation;
 
     Buffer::CreateBuffer(
         info.dataSize,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | info.flags,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        buffer, memory,
-        *info.device);
+        buffer, allocation,
+        *info.device,
+        MemoryCategory::OTHER,
+        info.name);
 
     // Create custom buffer and map memory
-    auto uniformBuffer = Buffer(*info.device, buffer, memory, info.dataSize, 0, info.name);
+    auto uniformBuffer = Buffer(*info.device, buffer, allocation, info.dataSize, 0, info.name);
     uniformBuffer.map();
 
     return uniformBuffer;
@@ -56,6 +62,7 @@ Buffer Buffer::CreateStorageBuffer(CreateInfo& info)
         info.dataCount,
         *info.device,
         *info.commandSystem,
+        info.uploadContext,
         info.name);
 }
 
@@ -64,16 +71,18 @@ Buffer Buffer::CreateScratchBuffer(CreateInfo& info)
     APP_LOG_INFO("Creating buffer ({})", info.name);
 
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    Allocation allocation;
 
     Buffer::CreateBuffer(
         info.dataSize,
         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | info.flags,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        buffer, memory,
-        *info.device);
+        buffer, allocation,
+        *info.device,
+        MemoryCategory::ACCELERATION_STRUCTURE,
+        info.name);
 
-    return Buffer(*info.device, buffer, memory, info.dataSize, 0, info.name);
+    return Buffer(*info.device, buffer, allocation, info.dataSize, 0, info.name);
 }
 
 Buffer Buffer::CreateAccelerationStructureBuffer(CreateInfo& info)
@@ -81,16 +90,18 @@ Buffer Buffer::CreateAccelerationStructureBuffer(CreateInfo& info)
     APP_LOG_INFO("Creating buffer ({})", info.name);
 
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    Allocation allocation;
 
     Buffer::CreateBuffer(
         info.dataSize,
         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT | info.flags,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        buffer, memory,
-        *info.device);
+        buffer, allocation,
+        *info.device,
+        MemoryCategory::ACCELERATION_STRUCTURE,
+        info.name);
 
-    return Buffer(*info.device, buffer, memory, info.dataSize, 0, info.name);
+    return Buffer(*info.device, buffer, allocation, info.dataSize, 0, info.name);
 }
 
 Buffer Buffer::CreateAccelerationStructureInstanceBuffer(CreateInfo& info)
@@ -102,6 +113,7 @@ Buffer Buffer::CreateAccelerationStructureInstanceBuffer(CreateInfo& info)
         info.dataCount,
         *info.device,
         *info.commandSystem,
+        info.uploadContext,
         info.name);
 }
 
@@ -110,20 +122,51 @@ Buffer Buffer::CreateShaderBindingTableBuffer(CreateInfo& info)
     APP_LOG_INFO("Creating buffer ({})", info.name);
 
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    Allocation allocation;
 
     Buffer::CreateBuffer(
         info.dataSize,
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | info.flags,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        buffer, memory,
-        *info.device);
+        buffer, allocation,
+        *info.device,
+        MemoryCategory::OTHER,
+        info.name);
+
+    return Buffer(*info.device, buffer, allocation, info.dataSize, info.dataCount, info.name);
+}
+
+Buffer Buffer::CreateReadbackBuffer(CreateInfo& info)
+{
+    APP_LOG_INFO("Creating buffer ({})", info.name);
+
+    VkBuffer buffer;
+    Allocation allocation;
+
+    Buffer::CreateBuffer(
+        info.dataSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | info.flags,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        buffer, allocation,
+        *info.device,
+        MemoryCategory::OTHER,
+        info.name);
 
-    return Buffer(*info.device, buffer, memory, info.dataSize, info.dataCount, info.name);
+    auto readbackBuffer = Buffer(*info.device, buffer, allocation, info.dataSize, info.dataCount, info.name);
+    readbackBuffer.map();
+
+    if (info.data)
+        memcpy(readbackBuffer.getMap(), info.data, static_cast<size_t>(info.dataSize));
+
+    return readbackBuffer;
 }
 
 VkDeviceAddress Buffer::getDeviceAddress() const
 {
+    // Empty buffers are never created and have no address
+    if (m_buffer == VK_NULL_HANDLE)
+        return 0;
+
     VkBufferDeviceAddressInfo info{};
     info.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
     info.buffer = m_buffer;
@@ -133,20 +176,27 @@ VkDeviceAddress Buffer::getDeviceAddress() const
 
 void Buffer::map()
 {
-    vkMapMemory(m_device->getLogical(), m_memory, 0, m_size, 0, &m_map);
+    // Host visible blocks are mapped for as long as they live
+    m_map = m_allocation.map;
 }
 
 void Buffer::unmap()
 {
-    vkUnmapMemory(m_device->getLogical(), m_memory);
+    m_map = nullptr;
 }
 
 void Buffer::cleanup()
 {
+    // Buffers that were never created have nothing to destroy
+    if (m_buffer == VK_NULL_HANDLE)
+        return;
+
     APP_LOG_INFO("Destroying buffer ({})", m_name);
 
-    vkDestroyBuffer(m_device->getLogical(), m_buffer, nullptr);
-    vkFreeMemory(m_device->getLogical(), m_memory, nullptr);
+    Buffer::DestroyBuffer(m_buffer, m_allocation, *m_device);
+
+    m_buffer = VK_NULL_HANDLE;
+    m_map    = nullptr;
 }
 
 void Buffer::Update(BufferType type, Buffer& buffer, const void* data)
@@ -164,8 +214,10 @@ void Buffer::CreateBuffer(
     VkBufferUsageFlags    usage, 
     VkMemoryPropertyFlags properties, 
     VkBuffer&             buffer, 
-    VkDeviceMemory&       bufferMemory, 
-    const Device&         device)
+    Allocation&           allocation,
+    const Device&         device,
+    MemoryCategory        category,
+    const std::string&    name)
 {
     // Create buffer
     VkBufferCreateInfo bufferInfo{};
@@ -174,6 +226,15 @@ void Buffer::CreateBuffer(
     bufferInfo.usage       = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    // Buffers that the transfer queue may fill are shared with it, so no ownership transfer is needed
+    uint32_t families[] = { device.getIndices().graphicsFamily.value(), device.getTransferFamily() };
+    if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && families[0] != families[1])
+    {
+        bufferInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices   = families;
+    }
+
     if (vkCreateBuffer(device.getLogical(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
     {
         APP_LOG_CRITICAL("Failed to create buffer");
@@ -184,26 +245,15 @@ void Buffer::CreateBuffer(
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device.getLogical(), buffer, &memRequirements);
 
-    // Memory allocation flags
-    VkMemoryAllocateFlagsInfo allocFlags{};
-    allocFlags.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-    allocFlags.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-
-    // Memory allocation information
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.pNext           = &allocFlags;
-    allocInfo.allocationSize  = memRequirements.size;
-    allocInfo.memoryTypeIndex = Device::findMemoryType(memRequirements.memoryTypeBits, properties, device.getPhysical());
-
-    if (vkAllocateMemory(device.getLogical(), &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-    {
-        APP_LOG_CRITICAL("Failed to allocate buffer memory");
-        throw;
-    }
+    // Sub-allocate and bind memory
+    allocation = device.getAllocator().allocate(memRequirements, properties, true, category, name);
+    vkBindBufferMemory(device.getLogical(), buffer, allocation.memory, allocation.offset);
+}
 
-    // Bind memory
-    vkBindBufferMemory(device.getLogical(), buffer, bufferMemory, 0);
+void Buffer::DestroyBuffer(VkBuffer buffer, Allocation& allocation, const Device& device)
+{
+    vkDestroyBuffer(device.getLogical(), buffer, nullptr);
+    device.getAllocator().free(allocation);
 }
 
 void Buffer::CopyBuffer(
@@ -234,6 +284,7 @@ Buffer::Buffer(
     const uint32_t dataCount,
     const Device& device,
     const CommandSystem& commandPool,
+    UploadContext* uploadContext,
     const std::string name)
 {
     m_device = &device;
@@ -242,39 +293,44 @@ Buffer::Buffer(
     m_size = dataSize;
     m_count = dataCount;
 
+    // Vulkan does not allow buffers of zero bytes, so an empty buffer (like the geometry buffer of a model
+    // without geometries) is left uncreated
+    if (dataSize == 0)
+        return;
+
     APP_LOG_INFO("Creating buffer ({})", name);
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
+    // Create buffer. Staged buffers that are not geometry are acceleration structure instances
+    const VkBufferUsageFlags geometryUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
-    // Create staging buffer
-    Buffer::CreateBuffer(
-        dataSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingMemory,
-        *m_device);
-
-    // Transfer buffer data into staging buffer memory
-    void* deviceData;
-    vkMapMemory(m_device->getLogical(), stagingMemory, 0, dataSize, 0, &deviceData);
-    memcpy(deviceData, data, (size_t)dataSize);
-    vkUnmapMemory(m_device->getLogical(), stagingMemory);
-
-    // Create buffer
     Buffer::CreateBuffer(
         dataSize,
         VK_BUFFER_USAGE_TRANSFER_DST_BIT | type,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_buffer, m_memory,
-        *m_device);
+        m_buffer, m_allocation,
+        *m_device,
+        (type & geometryUsage) ? MemoryCategory::GEOMETRY : MemoryCategory::ACCELERATION_STRUCTURE,
+        name);
 
-    // Copy staging buffer to device buffer
-    Buffer::CopyBuffer(
-        stagingBuffer, m_buffer,
-        dataSize,
-        commandPool, m_device->getGraphicsQueue());
+    // Buffers created without data are filled later, usually in chunks through a staging window
+    if (!data)
+        return;
+
+    if (uploadContext)
+    {
+        uploadContext->upload(m_buffer, 0, data, dataSize);
+        return;
+    }
 
-    vkDestroyBuffer(m_device->getLogical(), stagingBuffer, nullptr);
-    vkFreeMemory(m_device->getLogical(), stagingMemory, nullptr);
+    // Upload through a staging window that is never larger than the window size, so creating a large
+    // buffer does not need a second allocation of the same size
+    StagingWindow::CreateInfo windowInfo{};
+    windowInfo.device        = m_device;
+    windowInfo.commandSystem = &commandPool;
+    windowInfo.size          = std::min<VkDeviceSize>(dataSize, windowInfo.size);
+    windowInfo.name          = "Buffer Staging Window";
+
+    StagingWindow window = StagingWindow::Create(windowInfo);
+    window.upload(m_buffer, 0, data, dataSize);
+    window.cleanup();
 }
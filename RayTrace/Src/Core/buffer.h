@@ -4,6 +4,8 @@
 #include "device.h"
 #include "command.h"
 
+class UploadContext;
+
 enum class BufferType
 {
 	NONE = 0,
@@ -19,6 +21,9 @@ enum class BufferType
 class Buffer
 {
 public:
+	// Staged buffers (vertex, index, storage) are created empty when data is null, so they can be filled in
+	// chunks with a StagingWindow. With an upload context their data is only recorded into it and is copied
+	// once the context is submitted
 	struct CreateInfo
 	{
 		const void*          data          = nullptr;
@@ -26,6 +31,7 @@ public:
 		uint32_t             dataCount     = 0;
 		const Device*        device        = nullptr;
 		const CommandSystem* commandSystem = nullptr;
+		UploadContext*       uploadContext = nullptr;
 		const char*          name          = "";
 		VkBufferUsageFlags   flags         = 0;
 	};
@@ -41,12 +47,16 @@ public:
 	static Buffer CreateAccelerationStructureInstanceBuffer(CreateInfo& info);
 	static Buffer CreateShaderBindingTableBuffer(CreateInfo& info);
 
+	// Host visible storage buffer that stays mapped, for data that the shaders write and the CPU reads back
+	static Buffer CreateReadbackBuffer(CreateInfo& info);
+
 	void map();
 	void unmap();
 
 	const VkBuffer& getBuffer() const { return m_buffer; }
 	const uint32_t getCount() const { return m_count; }
 	const VkDeviceSize getSize() const { return m_size; }
+	const Allocation& getAllocation() const { return m_allocation; }
 	void* getMap() { return m_map; }
 	VkDeviceAddress getDeviceAddress() const;
 
@@ -54,13 +64,20 @@ public:
 
 	static void Update(BufferType type, Buffer& buffer, const void* data);
 
+	// The memory is sub-allocated from the device's allocator and reported under the category and name. Host
+	// visible memory is mapped at allocation.map
 	static void CreateBuffer(
 		VkDeviceSize size,
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkBuffer& buffer,
-		VkDeviceMemory& bufferMemory,
-		const Device& device);
+		Allocation& allocation,
+		const Device& device,
+		MemoryCategory category,
+		const std::string& name = "");
+
+	// Destroy a buffer made with CreateBuffer and free its memory
+	static void DestroyBuffer(VkBuffer buffer, Allocation& allocation, const Device& device);
 
 	static void CopyBuffer(
 		VkBuffer srcBuffer,
@@ -73,8 +90,8 @@ private:
 	const Device* m_device = nullptr;
 	std::string   m_name = "";
 
-	VkBuffer       m_buffer = VK_NULL_HANDLE;
-	VkDeviceMemory m_memory = VK_NULL_HANDLE;
+	VkBuffer   m_buffer     = VK_NULL_HANDLE;
+	Allocation m_allocation;
 
 	VkDeviceSize m_size  = 0;
 	uint32_t     m_count = 0;
@@ -89,22 +106,23 @@ private:
 		const uint32_t        dataCount,
 		const Device&         device,
 		const CommandSystem&  commandSystem,
+		UploadContext*        uploadContext,
 		const std::string     name);
 
 	// Custom buffer
 	Buffer(
 		const Device&     device,
 		VkBuffer          buffer,
-		VkDeviceMemory    memory,
+		Allocation        allocation,
 		VkDeviceSize      size,
 		uint32_t          count,
 		std::string       name)
 		:
-		m_device(&device),
-		m_buffer(buffer),
-		m_memory(memory),
-		m_size  (size),
-		m_count (count),
-		m_name  (name)
+		m_device    (&device),
+		m_buffer    (buffer),
+		m_allocation(allocation),
+		m_size      (size),
+		m_count     (count),
+		m_name      (name)
 	{}
 };
@@ -2,19 +2,70 @@
 
 #include "command.h"
 
-void CommandSystem::init(const Device& device, uint32_t bufferCount)
+void CommandSystem::init(const Device& device, uint32_t framesInFlight, uint32_t buffersPerFrame, uint32_t threadCount)
 {
-	m_device = &device;
-
-	m_buffers.resize(bufferCount);
+	m_device      = &device;
+	m_threadCount = std::max(threadCount, 1u);
 
 	createCommandPool();
-    createGraphicsBuffers(bufferCount);
+    createFrames(framesInFlight, buffersPerFrame);
+}
+
+void CommandSystem::resetFrame(uint32_t frameIndex)
+{
+    // One reset per pool is cheaper than resetting every command buffer on its own
+    Frame& frame = m_frames[frameIndex];
+    vkResetCommandPool(m_device->getLogical(), frame.pool, 0);
+
+    for (auto& thread : frame.threads)
+    {
+        vkResetCommandPool(m_device->getLogical(), thread.pool, 0);
+        thread.used = 0;
+    }
 }
 
-VkCommandBuffer CommandSystem::getCommandBuffer(uint32_t index)
+VkCommandBuffer CommandSystem::getCommandBuffer(uint32_t frameIndex, uint32_t buffer)
 {
-    return m_buffers[index];
+    return m_frames[frameIndex].buffers[buffer];
+}
+
+VkCommandBuffer CommandSystem::beginSecondary(uint32_t frameIndex, uint32_t thread, const VkCommandBufferInheritanceInfo& inheritance)
+{
+    ThreadPool& pool = m_frames[frameIndex].threads[thread];
+
+    // Secondaries are kept across frames and only allocated when a frame needs more than before
+    if (pool.used == pool.secondaries.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool        = pool.pool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(m_device->getLogical(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            APP_LOG_CRITICAL("Failed to allocate secondary command buffer");
+            throw std::exception();
+        }
+
+        pool.secondaries.push_back(commandBuffer);
+    }
+
+    VkCommandBuffer commandBuffer = pool.secondaries[pool.used++];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        APP_LOG_CRITICAL("Failed to begin secondary command buffer");
+        throw std::exception();
+    }
+
+    return commandBuffer;
 }
 
 VkCommandBuffer CommandSystem::beginSingleTimeCommands() const
@@ -50,17 +101,44 @@ void CommandSystem::endSingleTimeCommands(VkCommandBuffer commandBuffer, const V
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers    = &commandBuffer;
 
-    vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(queue);
+    // Only wait for this submission instead of everything on the queue
+    QueueTimeline& timeline = m_device->getTimeline(queue);
+    timeline.wait(timeline.submit(submitInfo));
 
     // Free command buffer
     vkFreeCommandBuffers(m_device->getLogical(), m_pool, 1, &commandBuffer);
 }
 
+uint64_t CommandSystem::submitSingleTimeCommands(VkCommandBuffer commandBuffer, const VkQueue& queue) const
+{
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &commandBuffer;
+
+    return m_device->getTimeline(queue).submit(submitInfo);
+}
+
+void CommandSystem::freeSingleTimeCommands(VkCommandBuffer commandBuffer) const
+{
+    vkFreeCommandBuffers(m_device->getLogical(), m_pool, 1, &commandBuffer);
+}
+
 void CommandSystem::cleanup()
 {
     APP_LOG_INFO("Destroying command system");
 
+    for (auto& frame : m_frames)
+    {
+        for (auto& thread : frame.threads)
+            vkDestroyCommandPool(m_device->getLogical(), thread.pool, nullptr);
+
+        vkDestroyCommandPool(m_device->getLogical(), frame.pool, nullptr);
+    }
+    m_frames.clear();
+
     vkDestroyCommandPool(m_device->getLogical(), m_pool, nullptr);
 }
 
@@ -68,38 +146,58 @@ void CommandSystem::createCommandPool()
 {
     APP_LOG_INFO("Initializing command pool");
 
-    // Create a command pool for the graphics family
-    QueueFamilyIndices queueFamilyIndices = m_device->getIndices();
-    VkCommandPoolCreateInfo poolInfo{};
-    poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+    // Single time command buffers are freed one by one
+    m_pool = createPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-    if (vkCreateCommandPool(m_device->getLogical(), &poolInfo, nullptr, &m_pool) != VK_SUCCESS)
+    APP_LOG_INFO("Command pool initialization successful");
+}
+
+void CommandSystem::createFrames(uint32_t framesInFlight, uint32_t buffersPerFrame)
+{
+    APP_LOG_INFO("Allocating {} command buffers for each of {} frames, {} recording threads", buffersPerFrame, framesInFlight, m_threadCount);
+
+    m_frames.resize(framesInFlight);
+    for (auto& frame : m_frames)
     {
-        APP_LOG_CRITICAL("Failed to create command pool");
-        throw;
+        // Frame pools are only ever reset as a whole
+        frame.pool = createPool(0);
+
+        frame.buffers.resize(buffersPerFrame);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool        = frame.pool;
+        allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = buffersPerFrame;
+
+        if (vkAllocateCommandBuffers(m_device->getLogical(), &allocInfo, frame.buffers.data()) != VK_SUCCESS)
+        {
+            APP_LOG_CRITICAL("Failed to allocate command buffers");
+            throw;
+        }
+
+        frame.threads.resize(m_threadCount);
+        for (auto& thread : frame.threads)
+            thread.pool = createPool(0);
     }
 
-    APP_LOG_INFO("Command pool initialization successful");
+    APP_LOG_INFO("Command buffer allocation successful");
 }
 
-void CommandSystem::createGraphicsBuffers(uint32_t count)
+VkCommandPool CommandSystem::createPool(VkCommandPoolCreateFlags flags) const
 {
-    APP_LOG_INFO("Allocating {} command buffers for graphics rendering", count);
-
-    // Allocate command buffers for the main render loop
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool        = m_pool;
-    allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = count;
+    // Every pool is of the graphics family
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags            = flags;
+    poolInfo.queueFamilyIndex = m_device->getIndices().graphicsFamily.value();
 
-    if (vkAllocateCommandBuffers(m_device->getLogical(), &allocInfo, m_buffers.data()) != VK_SUCCESS)
+    VkCommandPool pool;
+    if (vkCreateCommandPool(m_device->getLogical(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
     {
-        APP_LOG_CRITICAL("Failed to allocate command buffers");
+        APP_LOG_CRITICAL("Failed to create command pool");
         throw;
     }
 
-    APP_LOG_INFO("Command buffer allocation successful");
+    return pool;
 }
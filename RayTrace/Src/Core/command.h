@@ -6,22 +6,72 @@
 class CommandSystem
 {
 public:
-	void init(const Device& device, uint32_t bufferCount);
+	/**
+	 * Every frame in flight has its own pool for its primary command buffers and one pool per recording thread
+	 * for secondary command buffers. The pools of a frame are reset all at once by resetFrame().
+	 *
+	 * @param device: The device.
+	 * @param framesInFlight: Number of frames in flight.
+	 * @param buffersPerFrame: Number of primary command buffers of each frame.
+	 * @param threadCount: Number of threads that record secondary command buffers.
+	 */
+	void init(const Device& device, uint32_t framesInFlight, uint32_t buffersPerFrame = 1, uint32_t threadCount = 1);
 
-	VkCommandBuffer getCommandBuffer(uint32_t index);
+	/**
+	 * Reset the pools of a frame, which returns all of its command buffers to the initial state. The GPU must be
+	 * done with the last submission of the frame.
+	 *
+	 * @param frameIndex: The frame in flight.
+	 */
+	void resetFrame(uint32_t frameIndex);
+
+	VkCommandBuffer getCommandBuffer(uint32_t frameIndex, uint32_t buffer = 0);
+
+	/**
+	 * Begin a secondary command buffer of a frame. Secondary command buffers are only valid until the frame is
+	 * reset again.
+	 *
+	 * @param frameIndex: The frame in flight.
+	 * @param thread: The recording thread. Each thread must only use its own index.
+	 * @param inheritance: The render pass and framebuffer that the commands continue.
+	 */
+	VkCommandBuffer beginSecondary(uint32_t frameIndex, uint32_t thread, const VkCommandBufferInheritanceInfo& inheritance);
+
+	uint32_t getThreadCount() const { return m_threadCount; }
 
 	VkCommandBuffer beginSingleTimeCommands() const;
 
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer, const VkQueue& queue) const;
 
+	// Submit without waiting. The command buffer must be freed once the returned timeline value of the queue is reached
+	uint64_t submitSingleTimeCommands(VkCommandBuffer commandBuffer, const VkQueue& queue) const;
+	void freeSingleTimeCommands(VkCommandBuffer commandBuffer) const;
+
 	void cleanup();
 
 private:
-	VkCommandPool                m_pool = VK_NULL_HANDLE;
-	std::vector<VkCommandBuffer> m_buffers;
+	struct ThreadPool
+	{
+		VkCommandPool                pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> secondaries;
+		uint32_t                     used = 0; // Secondaries handed out since the last reset
+	};
+
+	struct Frame
+	{
+		VkCommandPool                pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers;
+		std::vector<ThreadPool>      threads;
+	};
+
+	VkCommandPool      m_pool = VK_NULL_HANDLE; // Single time commands
+	std::vector<Frame> m_frames;
+	uint32_t           m_threadCount = 1;
 
 	const Device* m_device = nullptr;
 
 	void createCommandPool();
-	void createGraphicsBuffers(uint32_t count);
-};
\ No newline at end of file
+	void createFrames(uint32_t framesInFlight, uint32_t buffersPerFrame);
+
+	VkCommandPool createPool(VkCommandPoolCreateFlags flags) const;
+};
@@ -75,6 +75,11 @@ void DescriptorSet::addBufferWrite(Buffer buffer, BufferType type, VkDeviceSize
 	bufferInfo.offset = offset;
 	bufferInfo.range  = buffer.getSize();
 
+	addBufferWrite(bufferInfo, type, binding);
+}
+
+void DescriptorSet::addBufferWrite(VkDescriptorBufferInfo bufferInfo, BufferType type, uint32_t binding)
+{
 	m_writeBufferInfos.emplace_back(bufferInfo);
 
 	// Descriptor write
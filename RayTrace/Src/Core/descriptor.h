@@ -16,7 +16,9 @@ enum class SceneBinding
 {
 	GLOBAL   = 0,
 	OBJ_DESC = 1,
-	TEXTURE
+	TEXTURE  = 2,
+	MATERIAL = 3,
+	FEEDBACK = 4
 };
 
 enum class RtxBinding
@@ -157,6 +159,15 @@ public:
 	 */
 	void addBufferWrite(Buffer buffer, BufferType type, VkDeviceSize offset, uint32_t binding);
 
+	/**
+	 * Add a buffer write for a buffer that is not owned by a Buffer.
+	 *
+	 * @param bufferInfo: A VkDescriptorBufferInfo that specifies the buffer, offset, and range.
+	 * @param type: The buffer type.
+	 * @param binding: The binding of the buffer.
+	 */
+	void addBufferWrite(VkDescriptorBufferInfo bufferInfo, BufferType type, uint32_t binding);
+
 	/**
 	 * Add an image write.
 	 * 
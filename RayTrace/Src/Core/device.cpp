@@ -12,6 +12,19 @@ void Device::init(VkInstance& instance, VkSurfaceKHR& surface, std::vector<const
 
 	if (m_enabledRaytracing)
 		loadDeviceExtensionsRayTrace(m_logical);
+
+	setupTimelines();
+
+	PipelineCache::CreateInfo cacheInfo{};
+	cacheInfo.physical = m_physical;
+	cacheInfo.logical  = m_logical;
+	m_pipelineCache.init(cacheInfo);
+
+	MemoryAllocator::CreateInfo allocatorInfo{};
+	allocatorInfo.physical     = m_physical;
+	allocatorInfo.logical      = m_logical;
+	allocatorInfo.memoryBudget = m_memoryBudget;
+	m_allocator.init(allocatorInfo);
 }
 
 VkFormat Device::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const
@@ -90,13 +103,59 @@ uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags prope
 	throw;
 }
 
+QueueTimeline& Device::getTimeline(const VkQueue& queue) const
+{
+	if (queue == m_graphicsQueue)
+		return m_graphicsTimeline;
+	else if (queue == m_computeQueue)
+		return m_computeTimeline;
+	else if (queue == m_transferQueue)
+		return m_transferTimeline;
+
+	APP_LOG_CRITICAL("Queue has no timeline");
+	throw std::exception();
+}
+
 void Device::cleanup()
 {
 	APP_LOG_INFO("Destroying devices");
 
+	// Deferred releases may free allocations, so the timelines go first
+	m_transferTimeline.cleanup();
+	m_computeTimeline.cleanup();
+	m_graphicsTimeline.cleanup();
+
+	m_pipelineCache.save();
+	m_pipelineCache.cleanup();
+
+	m_allocator.cleanup();
 	vkDestroyDevice(m_logical, nullptr);
 }
 
+void Device::setupTimelines()
+{
+	QueueTimeline::CreateInfo timelineInfo{};
+	timelineInfo.device = m_logical;
+	timelineInfo.queue  = m_graphicsQueue;
+	timelineInfo.name   = "Graphics";
+	m_graphicsTimeline.init(timelineInfo);
+
+	// A queue handle is externally synchronized, so a shared queue must not get a second timeline
+	if (m_computeQueue != m_graphicsQueue)
+	{
+		timelineInfo.queue = m_computeQueue;
+		timelineInfo.name  = "Compute";
+		m_computeTimeline.init(timelineInfo);
+	}
+
+	if (m_transferQueue != m_graphicsQueue && m_transferQueue != m_computeQueue)
+	{
+		timelineInfo.queue = m_transferQueue;
+		timelineInfo.name  = "Transfer";
+		m_transferTimeline.init(timelineInfo);
+	}
+}
+
 void Device::pickPhysicalDevice(VkInstance& instance, VkSurfaceKHR& surface)
 {
 	APP_LOG_INFO("Choosing physical device");
@@ -179,9 +238,13 @@ void Device::createLogicalDevice()
 	// Queue family create infos
 	std::set<uint32_t> uniqueQueueFamilies = {
 		m_indices.graphicsFamily.value(),
-		m_indices.presentFamily.value()
+		m_indices.presentFamily.value(),
+		m_indices.computeFamily.value()
 	};
 
+	if (m_indices.transferFamily.has_value())
+		uniqueQueueFamilies.insert(m_indices.transferFamily.value());
+
 	float queuePriority = 1.0f;
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -199,11 +262,17 @@ void Device::createLogicalDevice()
 	bufferDeviceFeatures.sType               = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
 	bufferDeviceFeatures.bufferDeviceAddress = VK_TRUE;
 
+	// Timeline semaphores
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+	timelineFeatures.pNext             = &bufferDeviceFeatures;
+
 	VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
 	descriptorIndexingFeatures.sType                                     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
 	descriptorIndexingFeatures.runtimeDescriptorArray                    = VK_TRUE;
 	descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
-	descriptorIndexingFeatures.pNext                                     = &bufferDeviceFeatures;
+	descriptorIndexingFeatures.pNext                                     = &timelineFeatures;
 
 	// Acceleration structure
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeatures{};
@@ -236,6 +305,25 @@ void Device::createLogicalDevice()
 	deviceFeatures.pNext                      = &descriptorIndexingFeatures;
 	setDeviceFeatures(deviceFeatures);
 
+	// Memory budgets are optional and only used for reporting
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(m_physical, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(m_physical, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+		{
+			m_deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			m_memoryBudget = true;
+		}
+	}
+
+	if (!m_memoryBudget)
+		APP_LOG_WARN("Memory budget extension is not supported, heap budgets will be the heap sizes");
+
 	// Device create
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -256,6 +344,11 @@ void Device::createLogicalDevice()
 	vkGetDeviceQueue(m_logical, m_indices.presentFamily.value(), 0, &m_presentQueue);
 	vkGetDeviceQueue(m_logical, m_indices.computeFamily.value(), 0, &m_computeQueue);
 
+	if (m_indices.transferFamily.has_value())
+		vkGetDeviceQueue(m_logical, m_indices.transferFamily.value(), 0, &m_transferQueue);
+	else
+		m_transferQueue = m_graphicsQueue;
+
 	APP_LOG_INFO("Logical device initialization successful");
 }
 
@@ -315,6 +408,29 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device, VkSurfaceK
 		i++;
 	}
 
+	// A family that can compute but not draw usually maps to the async compute engines. Compute work submitted there
+	// overlaps the graphics queue instead of queueing behind it
+	for (uint32_t j = 0; j < queueFamilyCount; j++)
+	{
+		VkQueueFlags flags = queueFamilies[j].queueFlags;
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			indices.computeFamily = j;
+			break;
+		}
+	}
+
+	// A family that can only transfer usually maps to the copy engines, which run alongside graphics work
+	for (uint32_t j = 0; j < queueFamilyCount; j++)
+	{
+		VkQueueFlags flags = queueFamilies[j].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			indices.transferFamily = j;
+			break;
+		}
+	}
+
 	return indices;
 }
 
@@ -363,4 +479,18 @@ void Device::setDeviceFeatures(VkPhysicalDeviceFeatures2& deviceFeatures)
 		deviceFeatures.features.geometryShader = VK_TRUE;
 	else
 		APP_LOG_WARN("Requested device with geometry shaders but it is not supported. MAY CAUSE ERRORS");
+
+	// BC texture compression. Textures are uploaded uncompressed without it
+	m_textureCompressionBC = supportedFeatures.textureCompressionBC;
+	if (m_textureCompressionBC)
+		deviceFeatures.features.textureCompressionBC = VK_TRUE;
+	else
+		APP_LOG_WARN("BC texture compression is not supported. Textures will be uncompressed");
+
+	// Stores and atomics in fragment shaders. The raster pass does not request texture levels without them
+	m_fragmentStores = supportedFeatures.fragmentStoresAndAtomics;
+	if (m_fragmentStores)
+		deviceFeatures.features.fragmentStoresAndAtomics = VK_TRUE;
+	else
+		APP_LOG_WARN("Fragment stores and atomics are not supported. The raster pass will not stream textures");
 }
@@ -3,12 +3,16 @@
 #include "Application/logging.h"
 
 #include "extensions.h"
+#include "memory_allocator.h"
+#include "queue_timeline.h"
+#include "pipeline_cache.h"
 
 struct QueueFamilyIndices
 {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
-	std::optional<uint32_t> computeFamily;
+	std::optional<uint32_t> computeFamily;  // Family without graphics when there is one
+	std::optional<uint32_t> transferFamily; // Family without graphics and compute. Not required
 
 	bool isComplete() const
 	{
@@ -41,8 +45,47 @@ public:
 	const VkQueue& getGraphicsQueue() const { return m_graphicsQueue; }
 	const VkQueue& getPresentQueue() const { return m_presentQueue; }
 	const VkQueue& getComputeQueue() const { return m_computeQueue; }
+
+	/**
+	 * @return True if the compute queue belongs to a family without graphics, so its work can run alongside the
+	 * graphics queue.
+	 */
+	bool isAsyncComputeSupported() const { return m_indices.computeFamily != m_indices.graphicsFamily; }
+
+	/**
+	 * The queue of the transfer only family, or the graphics queue when the device has no such family.
+	 */
+	const VkQueue& getTransferQueue() const { return m_transferQueue; }
+	uint32_t getTransferFamily() const { return m_indices.transferFamily.value_or(m_indices.graphicsFamily.value()); }
 	const VkPhysicalDeviceRayTracingPipelinePropertiesKHR& getRtxProperties() const { return m_rtxProperties; }
 
+	/**
+	 * @return The allocator that every buffer and image takes its memory from. It is internally synchronized, so
+	 * it can be used through a const device.
+	 */
+	MemoryAllocator& getAllocator() const { return m_allocator; }
+
+	/**
+	 * Every submission goes through the timeline of its queue. Queues that share a handle share a timeline, so the
+	 * compute and transfer timelines are the graphics one when the device has no separate queue for them.
+	 */
+	QueueTimeline& getGraphicsTimeline() const { return m_graphicsTimeline; }
+	QueueTimeline& getComputeTimeline() const { return getTimeline(m_computeQueue); }
+	QueueTimeline& getTransferTimeline() const { return getTimeline(m_transferQueue); }
+
+	/**
+	 * @param queue: The graphics, compute or transfer queue.
+	 *
+	 * @return The timeline that submissions to the queue go through.
+	 */
+	QueueTimeline& getTimeline(const VkQueue& queue) const;
+
+	/**
+	 * @return The cache that every pipeline is created with. It is loaded from disk at initialization and written
+	 * back at cleanup.
+	 */
+	VkPipelineCache getPipelineCache() const { return m_pipelineCache.getCache(); }
+
 	/**
 	 * Wait for the entire GPU to be idle.
 	 */
@@ -53,6 +96,21 @@ public:
 	 */
 	bool isRtxSupported() const { return m_enabledRaytracing; }
 
+	/**
+	 * @return True if BC compressed formats can be sampled.
+	 */
+	bool isTextureCompressionSupported() const { return m_textureCompressionBC; }
+
+	/**
+	 * @return True if fragment shaders can write storage buffers, like the texture feedback of the raster pass.
+	 */
+	bool areFragmentStoresSupported() const { return m_fragmentStores; }
+
+	/**
+	 * @return True if VK_EXT_memory_budget is enabled and the allocator reports real heap budgets.
+	 */
+	bool isMemoryBudgetSupported() const { return m_memoryBudget; }
+
 	VkFormat findSupportedFormat(
 		const std::vector<VkFormat>& candidates,
 		VkImageTiling tiling,
@@ -74,6 +132,7 @@ private:
 	VkQueue            m_graphicsQueue = VK_NULL_HANDLE;
 	VkQueue            m_presentQueue  = VK_NULL_HANDLE;
 	VkQueue            m_computeQueue  = VK_NULL_HANDLE;
+	VkQueue            m_transferQueue = VK_NULL_HANDLE;
 
 	std::vector<const char*> m_instanceLayers;
 	std::vector<const char*> m_deviceExtensions;
@@ -81,6 +140,20 @@ private:
 	VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtxProperties{};
 	bool                                            m_enabledRaytracing = false;
 
+	bool m_textureCompressionBC = false;
+	bool m_fragmentStores       = false;
+	bool m_memoryBudget         = false;
+
+	mutable MemoryAllocator m_allocator;
+
+	mutable QueueTimeline m_graphicsTimeline;
+	mutable QueueTimeline m_computeTimeline;
+	mutable QueueTimeline m_transferTimeline;
+
+	PipelineCache m_pipelineCache;
+
+	void setupTimelines();
+
 	void pickPhysicalDevice(VkInstance& instance, VkSurfaceKHR& surface);
 	void createLogicalDevice();
 
@@ -0,0 +1,186 @@
+#include "pch.h"
+#include "gpu_profiler.h"
+
+void GpuProfiler::init(CreateInfo& info)
+{
+	APP_LOG_INFO("Initializing GPU profiler ({} scopes per frame)", info.maxScopes);
+
+	m_device      = info.device;
+	m_maxScopes   = info.maxScopes;
+	m_historySize = std::max(info.historySize, 1u);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_device->getPhysical(), &properties);
+	m_period = properties.limits.timestampPeriod;
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_device->getPhysical(), &familyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_device->getPhysical(), &familyCount, families.data());
+
+	for (const auto& family : families)
+		m_familyValidBits.push_back(family.timestampValidBits);
+
+	if (!isSupported(m_device->getIndices().graphicsFamily.value()))
+		APP_LOG_WARN("Graphics queue does not support timestamps, GPU timings will be empty");
+
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = m_maxScopes * 2;
+
+	m_frames.resize(info.framesInFlight);
+	for (auto& frame : m_frames)
+	{
+		if (vkCreateQueryPool(m_device->getLogical(), &poolInfo, nullptr, &frame.pool) != VK_SUCCESS)
+		{
+			APP_LOG_CRITICAL("Failed to create timestamp query pool");
+			throw std::exception();
+		}
+	}
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer cmdBuf, uint32_t frameIndex)
+{
+	m_frameIndex = frameIndex;
+	Frame& frame = m_frames[frameIndex];
+
+	if (frame.recorded)
+		readFrame(frame);
+
+	frame.scopes.clear();
+	frame.recorded = true;
+
+	vkCmdResetQueryPool(cmdBuf, frame.pool, 0, m_maxScopes * 2);
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer cmdBuf, const char* name)
+{
+	Frame& frame = m_frames[m_frameIndex];
+	if (frame.scopes.size() >= m_maxScopes)
+		return INVALID_SCOPE;
+
+	uint32_t scope = static_cast<uint32_t>(frame.scopes.size());
+	frame.scopes.push_back(findTiming(name));
+
+	vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, scope * 2);
+
+	return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer cmdBuf, uint32_t scope)
+{
+	if (scope == INVALID_SCOPE)
+		return;
+
+	vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_frames[m_frameIndex].pool, scope * 2 + 1);
+}
+
+bool GpuProfiler::writeCsv(const std::string& filename) const
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		APP_LOG_ERROR("Failed to open GPU timings {}", filename);
+		return false;
+	}
+
+	file << "frame";
+	for (const auto& timing : m_timings)
+		file << "," << timing.name;
+	file << "\n";
+
+	// The ring is only full once historySize frames were read
+	uint32_t first = (m_historyOffset + m_historySize - m_sampleCount) % m_historySize;
+	for (uint32_t i = 0; i < m_sampleCount; i++)
+	{
+		uint32_t index = (first + i) % m_historySize;
+
+		file << i;
+		for (const auto& timing : m_timings)
+			file << "," << timing.history[index];
+		file << "\n";
+	}
+
+	APP_LOG_INFO("Wrote {} frames of GPU timings to {}", m_sampleCount, filename);
+	return true;
+}
+
+void GpuProfiler::cleanup()
+{
+	if (m_frames.empty())
+		return;
+
+	APP_LOG_INFO("Destroying GPU profiler");
+
+	for (auto& frame : m_frames)
+		vkDestroyQueryPool(m_device->getLogical(), frame.pool, nullptr);
+
+	m_frames.clear();
+}
+
+void GpuProfiler::readFrame(Frame& frame)
+{
+	if (frame.scopes.empty())
+		return;
+
+	// Each query is followed by its availability, so scopes that were never ended are skipped instead of waited on
+	uint32_t              queryCount = static_cast<uint32_t>(frame.scopes.size()) * 2;
+	std::vector<uint64_t> results(queryCount * 2, 0);
+
+	vkGetQueryPoolResults(
+		m_device->getLogical(),
+		frame.pool,
+		0, queryCount,
+		results.size() * sizeof(uint64_t), results.data(),
+		2 * sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	std::vector<float> values(m_timings.size(), 0.0f);
+	for (size_t i = 0; i < frame.scopes.size(); i++)
+	{
+		const uint64_t* begin = &results[i * 4];
+		const uint64_t* end   = &results[i * 4 + 2];
+		if (begin[1] == 0 || end[1] == 0 || end[0] < begin[0])
+			continue;
+
+		values[frame.scopes[i]] += static_cast<float>(end[0] - begin[0]) * m_period / 1000000.0f;
+	}
+
+	for (size_t i = 0; i < m_timings.size(); i++)
+	{
+		Timing& timing = m_timings[i];
+		timing.history[m_historyOffset] = values[i];
+		timing.latest                   = values[i];
+	}
+
+	m_historyOffset = (m_historyOffset + 1) % m_historySize;
+	m_sampleCount   = std::min(m_sampleCount + 1, m_historySize);
+
+	// Entries that were never written are zero, so the sum only covers the frames that were read
+	for (auto& timing : m_timings)
+	{
+		float sum = 0.0f;
+		for (float value : timing.history)
+			sum += value;
+
+		timing.average = sum / m_sampleCount;
+	}
+}
+
+uint32_t GpuProfiler::findTiming(const char* name)
+{
+	for (uint32_t i = 0; i < m_timings.size(); i++)
+	{
+		if (m_timings[i].name == name)
+			return i;
+	}
+
+	Timing timing;
+	timing.name = name;
+	timing.history.resize(m_historySize, 0.0f);
+	m_timings.push_back(timing);
+
+	return static_cast<uint32_t>(m_timings.size() - 1);
+}
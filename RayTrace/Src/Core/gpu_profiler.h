@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Application/logging.h"
+#include "device.h"
+
+/*****************************************************************************************************************
+ *
+ * @class GpuProfiler
+ *
+ * Measures the GPU time of named scopes with timestamp queries. Every frame in flight has its own query pool, and
+ * its results are read when the frame comes around again. The GPU is done with it by then, so reading never
+ * stalls. The timings trail the current frame by the number of frames in flight.
+ *
+ * Scopes with the same name in one frame are added together. Every name keeps a rolling history of its timings
+ * in milliseconds, which can be shown as a graph or written to a CSV file. Scopes can be recorded on any queue
+ * whose family supports timestamps, which isSupported() tells.
+ *
+ * The profiler is not thread safe. The creator of the profiler is responsible for calling its cleanup().
+ *
+ * Example Usage:
+ *     GpuProfiler::CreateInfo info{};
+ *     info.device         = &device;
+ *     info.framesInFlight = 2;
+ *     profiler.init(info);
+ *
+ *     profiler.beginFrame(cmdBuf, frameIndex);
+ *     uint32_t scope = profiler.beginScope(cmdBuf, "Trace");
+ *     vkCmdTraceRaysKHR(cmdBuf, ...);
+ *     profiler.endScope(cmdBuf, scope);
+ *
+ *     const auto& timings = profiler.getTimings();
+ *
+ *     profiler.cleanup();
+ *
+ */
+class GpuProfiler
+{
+public:
+	struct CreateInfo
+	{
+		const Device* device         = nullptr;
+		uint32_t      framesInFlight = 2;
+		uint32_t      maxScopes      = 32;  // Per frame
+		uint32_t      historySize    = 256; // Frames that are kept for the graphs and the CSV export
+	};
+
+	struct Timing
+	{
+		std::string        name;
+		std::vector<float> history; // Ring of milliseconds. The oldest entry is at getHistoryOffset()
+		float              latest  = 0.0f;
+		float              average = 0.0f; // Over the whole history
+	};
+
+	static constexpr uint32_t INVALID_SCOPE = UINT32_MAX;
+
+	GpuProfiler() = default;
+
+	void init(CreateInfo& info);
+
+	/**
+	 * Read the timings of the last use of a frame and reset its queries. Must be recorded before any scope of the
+	 * frame, outside of a render pass. The GPU must be done with the last use of the frame.
+	 *
+	 * @param cmdBuf: The first graphics command buffer of the frame.
+	 * @param frameIndex: The frame in flight.
+	 */
+	void beginFrame(VkCommandBuffer cmdBuf, uint32_t frameIndex);
+
+	/**
+	 * Write the timestamp that starts a scope.
+	 *
+	 * @param cmdBuf: Command buffer of any queue that supports timestamps.
+	 * @param name: Name of the scope. Scopes of the same name are added together.
+	 *
+	 * @return The scope to end, or INVALID_SCOPE if the frame has no queries left.
+	 */
+	uint32_t beginScope(VkCommandBuffer cmdBuf, const char* name);
+	void endScope(VkCommandBuffer cmdBuf, uint32_t scope);
+
+	/**
+	 * @param family: A queue family index.
+	 *
+	 * @return True if command buffers of the family can write timestamps.
+	 */
+	bool isSupported(uint32_t family) const { return family < m_familyValidBits.size() && m_familyValidBits[family] > 0; }
+
+	const std::vector<Timing>& getTimings() const { return m_timings; }
+	uint32_t getHistoryOffset() const { return m_historyOffset; }
+
+	/**
+	 * Write the history of every scope to a CSV file. Each row is one frame, oldest first.
+	 *
+	 * @param filename: The file to write.
+	 *
+	 * @return False if the file could not be opened.
+	 */
+	bool writeCsv(const std::string& filename) const;
+
+	void cleanup();
+
+private:
+	struct Frame
+	{
+		VkQueryPool           pool     = VK_NULL_HANDLE;
+		std::vector<uint32_t> scopes;           // Timing index of each scope that was recorded
+		bool                  recorded = false; // True once the frame was recorded and its queries can be read
+	};
+
+	const Device* m_device = nullptr;
+
+	uint32_t m_maxScopes   = 0;
+	uint32_t m_historySize = 0;
+	float    m_period      = 1.0f; // Nanoseconds per tick
+
+	std::vector<uint32_t> m_familyValidBits;
+
+	std::vector<Frame> m_frames;
+	uint32_t           m_frameIndex = 0;
+
+	std::vector<Timing> m_timings;
+	uint32_t            m_historyOffset = 0;
+	uint32_t            m_sampleCount   = 0;
+
+	void readFrame(Frame& frame);
+
+	uint32_t findTiming(const char* name);
+};
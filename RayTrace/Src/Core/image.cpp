@@ -24,9 +24,10 @@ Image Image::CreateImage(CreateInfo& createInfo)
     imageInfo.usage         = createInfo.usage;
     imageInfo.samples       = createInfo.numSamples;
     imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags         = createInfo.flags;
 
     if (createInfo.layerCount == 6)
-        imageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+        imageInfo.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 
     if (vkCreateImage(createInfo.device->getLogical(), &imageInfo, nullptr, &image.image) != VK_SUCCESS)
     {
@@ -34,23 +35,19 @@ Image Image::CreateImage(CreateInfo& createInfo)
         throw;
     }
 
-    // Allocate memory
+    // Sub-allocate memory. Linear images may share blocks with buffers, optimal images may not
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(createInfo.device->getLogical(), image.image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize  = memRequirements.size;
-    allocInfo.memoryTypeIndex = Device::findMemoryType(memRequirements.memoryTypeBits, createInfo.properties, createInfo.device->getPhysical());
+    // Images that are rendered into are render targets, everything else is a texture
+    const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    MemoryCategory category = (createInfo.usage & attachmentUsage) ? MemoryCategory::RENDER_TARGET : MemoryCategory::TEXTURE;
 
-    if (vkAllocateMemory(createInfo.device->getLogical(), &allocInfo, nullptr, &image.memory) != VK_SUCCESS)
-    {
-        APP_LOG_CRITICAL("Failed allocate image memory ({})", createInfo.name);
-        throw;
-    }
+    bool linear      = (createInfo.tiling == VK_IMAGE_TILING_LINEAR);
+    image.allocation = createInfo.device->getAllocator().allocate(memRequirements, createInfo.properties, linear, category, createInfo.name);
 
     // Bind image memory
-    vkBindImageMemory(createInfo.device->getLogical(), image.image, image.memory, 0);
+    vkBindImageMemory(createInfo.device->getLogical(), image.image, image.allocation.memory, image.allocation.offset);
 
     image.format = createInfo.format;
     image.numSamples = createInfo.numSamples;
@@ -71,10 +68,7 @@ void Image::SetupImageView(Image& image, ImageViewSetupInfo& info)
     else
         createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 
-    createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components = info.components;
 
     createInfo.subresourceRange.aspectMask     = info.aspectFlags;
     createInfo.subresourceRange.baseMipLevel   = 0;
@@ -82,6 +76,14 @@ void Image::SetupImageView(Image& image, ImageViewSetupInfo& info)
     createInfo.subresourceRange.baseArrayLayer = 0;
     createInfo.subresourceRange.layerCount     = info.layerCount;
 
+    // Images with extended usage can have usages that the format of this view does not support
+    VkImageViewUsageCreateInfo usageInfo{};
+    usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+    usageInfo.usage = info.usage;
+
+    if (info.usage != 0)
+        createInfo.pNext = &usageInfo;
+
     if (vkCreateImageView(info.device->getLogical(), &createInfo, nullptr, &image.view) != VK_SUCCESS)
     {
         APP_LOG_CRITICAL("Failed to create image view");
@@ -168,6 +170,6 @@ void Image::cleanup(const VkDevice& device)
     if (view != VK_NULL_HANDLE)
         vkDestroyImageView(device, view, nullptr);
 
-    if (memory != VK_NULL_HANDLE)
-        vkFreeMemory(device, memory, nullptr);
+    if (allocation.owner)
+        allocation.owner->free(allocation);
 }
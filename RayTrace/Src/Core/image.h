@@ -5,9 +5,9 @@
 class Image
 {
 public:
-	VkImage        image  = VK_NULL_HANDLE;
-	VkImageView    view   = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkImage     image      = VK_NULL_HANDLE;
+	VkImageView view       = VK_NULL_HANDLE;
+	Allocation  allocation;
 
 	VkFormat              format     = VK_FORMAT_UNDEFINED;
 	VkSampleCountFlagBits numSamples = VK_SAMPLE_COUNT_1_BIT;
@@ -25,6 +25,7 @@ public:
 		VkImageTiling         tiling     = VK_IMAGE_TILING_OPTIMAL;
 		VkImageUsageFlags     usage      = 0;
 		VkMemoryPropertyFlags properties = 0;
+		VkImageCreateFlags    flags      = 0;
 		const Device*         device     = nullptr;
 		const char*           name       = "";
 	};
@@ -35,6 +36,8 @@ public:
 		VkImageAspectFlags aspectFlags = 0;
 		uint32_t           mipLevels   = 0;
 		uint32_t           layerCount  = 0;
+		VkComponentMapping components  = {}; // Identity by default
+		VkImageUsageFlags  usage       = 0;  // Subset of the image usage that the view supports. All of it by default
 		const Device*      device       = nullptr;
 	};
 
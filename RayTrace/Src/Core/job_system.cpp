@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "job_system.h"
+
+#include "Application/cpu_profiler.h"
+
+void JobSystem::init(CreateInfo& info)
+{
+	uint32_t threadCount = info.threadCount;
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	APP_LOG_INFO("Initializing job system ({} threads)", threadCount);
+
+	m_running = true;
+
+	for (uint32_t i = 1; i < threadCount; i++)
+		m_workers.emplace_back(&JobSystem::workerThread, this, i);
+}
+
+void JobSystem::run(uint32_t jobCount, const std::function<void(uint32_t job, uint32_t thread)>& job)
+{
+	if (jobCount == 0)
+		return;
+
+	// A single job is not worth waking the workers
+	if (jobCount == 1 || m_workers.empty())
+	{
+		for (uint32_t i = 0; i < jobCount; i++)
+			job(i, 0);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		// Workers that woke up late for the previous run may still be reading its counters
+		m_done.wait(lock, [this]() { return m_active == 0; });
+
+		m_job       = &job;
+		m_jobCount  = jobCount;
+		m_next      = 0;
+		m_remaining = jobCount;
+		m_generation++;
+	}
+	m_start.notify_all();
+
+	work(job, jobCount, 0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this]() { return m_remaining == 0 && m_active == 0; });
+
+	m_job = nullptr;
+}
+
+void JobSystem::cleanup()
+{
+	if (m_workers.empty())
+		return;
+
+	APP_LOG_INFO("Destroying job system");
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_start.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+}
+
+void JobSystem::workerThread(uint32_t thread)
+{
+	APP_PROFILE_THREAD("Job Worker " + std::to_string(thread));
+
+	uint64_t generation = 0;
+
+	for (;;)
+	{
+		const std::function<void(uint32_t, uint32_t)>* job      = nullptr;
+		uint32_t                                       jobCount = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [&]() { return !m_running || m_generation != generation; });
+
+			if (!m_running)
+				return;
+
+			generation = m_generation;
+			job        = m_job;
+			jobCount   = m_jobCount;
+			m_active++;
+		}
+
+		// The run may already be finished, in which case there are no jobs left to take
+		if (job)
+			work(*job, jobCount, thread);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_active--;
+		}
+		m_done.notify_all();
+	}
+}
+
+void JobSystem::work(const std::function<void(uint32_t, uint32_t)>& job, uint32_t jobCount, uint32_t thread)
+{
+	for (;;)
+	{
+		uint32_t index = m_next.fetch_add(1);
+		if (index >= jobCount)
+			return;
+
+		job(index, thread);
+
+		if (m_remaining.fetch_sub(1) == 1)
+		{
+			// Taking the lock orders the notify after the wait of run()
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done.notify_all();
+		}
+	}
+}
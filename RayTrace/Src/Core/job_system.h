@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Application/logging.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/*****************************************************************************************************************
+ *
+ * @class JobSystem
+ *
+ * A fixed set of worker threads that run the jobs of one call to run() in parallel. The calling thread works on
+ * the jobs as well and run() returns once all of them are done, so the jobs can reference the caller's stack.
+ *
+ * Every job is told the index of the thread that runs it. The calling thread is always thread 0 and the workers
+ * are 1 to getThreadCount() - 1, so per thread resources like command pools can be indexed without locking.
+ *
+ * run() must only be called from one thread at a time.
+ *
+ * Example Usage:
+ *     JobSystem::CreateInfo info{};
+ *     jobSystem.init(info);
+ *
+ *     std::vector<VkCommandBuffer> cmdBufs(jobCount);
+ *     jobSystem.run(jobCount, [&](uint32_t job, uint32_t thread) {
+ *         cmdBufs[job] = record(job, pools[thread]);
+ *     });
+ *
+ *     jobSystem.cleanup();
+ *
+ */
+class JobSystem
+{
+public:
+	struct CreateInfo
+	{
+		uint32_t threadCount = 0; // Including the calling thread. Zero uses every hardware thread
+	};
+
+	JobSystem() = default;
+
+	void init(CreateInfo& info);
+
+	/**
+	 * Run jobs on every thread and wait for them.
+	 *
+	 * @param jobCount: Number of jobs.
+	 * @param job: Called once per job with the job index and the index of the thread that runs it.
+	 */
+	void run(uint32_t jobCount, const std::function<void(uint32_t job, uint32_t thread)>& job);
+
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+	void cleanup();
+
+private:
+	std::vector<std::thread> m_workers;
+
+	std::mutex              m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+
+	// The jobs of the current run
+	const std::function<void(uint32_t, uint32_t)>* m_job = nullptr;
+
+	uint32_t              m_jobCount   = 0;
+	uint64_t              m_generation = 0; // Incremented by every run, so a worker never runs the same jobs twice
+	uint32_t              m_active     = 0; // Workers that are inside the jobs of a run
+	std::atomic<uint32_t> m_next       = 0;
+	std::atomic<uint32_t> m_remaining  = 0;
+	bool                  m_running    = false;
+
+	void workerThread(uint32_t thread);
+
+	// Take jobs until none are left
+	void work(const std::function<void(uint32_t, uint32_t)>& job, uint32_t jobCount, uint32_t thread);
+};
@@ -0,0 +1,443 @@
+#include "pch.h"
+#include "memory_allocator.h"
+#include "utilities.h"
+
+#include <algorithm>
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void MemoryAllocator::init(CreateInfo& info)
+{
+	APP_LOG_INFO("Initializing memory allocator");
+
+	m_device       = info.logical;
+	m_physical     = info.physical;
+	m_blockSize    = info.blockSize;
+	m_memoryBudget = info.memoryBudget;
+
+	vkGetPhysicalDeviceMemoryProperties(info.physical, &m_memoryProperties);
+
+	// One pool for linear and one for optimal resources per memory type
+	m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+	m_heapReserved.resize(m_memoryProperties.memoryHeapCount, 0);
+}
+
+Allocation MemoryAllocator::allocate(
+	const VkMemoryRequirements& requirements,
+	VkMemoryPropertyFlags       properties,
+	bool                        linear,
+	MemoryCategory              category,
+	const std::string&          name)
+{
+	uint32_t     memoryType = 0;
+	VkDeviceSize blockSize  = 0;
+
+	// First memory type with the properties, the same choice as Device::findMemoryType
+	for (memoryType = 0; memoryType < m_memoryProperties.memoryTypeCount; memoryType++)
+		if ((requirements.memoryTypeBits & (1 << memoryType)) && (m_memoryProperties.memoryTypes[memoryType].propertyFlags & properties) == properties)
+			break;
+
+	if (memoryType == m_memoryProperties.memoryTypeCount)
+	{
+		APP_LOG_CRITICAL("Failed to find suitable memory type");
+		throw std::exception();
+	}
+
+	blockSize = getBlockSize(memoryType);
+
+	uint32_t heap = m_memoryProperties.memoryTypes[memoryType].heapIndex;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Allocation allocation;
+	allocation.owner = this;
+	allocation.size  = requirements.size;
+	allocation.pool  = memoryType * 2 + (linear ? 0 : 1);
+	allocation.id    = m_nextId++;
+
+	Record record;
+	record.name     = name;
+	record.category = category;
+	record.size     = requirements.size;
+	record.heap     = heap;
+
+	m_stats.categoryBytes[static_cast<size_t>(category)] += requirements.size;
+
+	// Large resources would leave most of a block unusable
+	if (requirements.size > blockSize / 2)
+	{
+		allocation.memory    = allocateMemory(requirements.size, memoryType, &allocation.map);
+		allocation.dedicated = true;
+
+		m_stats.dedicatedCount++;
+		m_stats.allocationCount++;
+		m_stats.reservedBytes += requirements.size;
+		m_stats.usedBytes     += requirements.size;
+		m_heapReserved[heap]  += requirements.size;
+
+		record.dedicated = true;
+		m_records.emplace(allocation.id, record);
+
+		return allocation;
+	}
+
+	Pool& pool = m_pools[allocation.pool];
+
+	// First block with a free range that fits, otherwise a new block in the first free slot
+	uint32_t     blockIndex = 0;
+	VkDeviceSize offset     = 0;
+	for (blockIndex = 0; blockIndex < pool.blocks.size(); blockIndex++)
+	{
+		Block& block = pool.blocks[blockIndex];
+		if (block.memory != VK_NULL_HANDLE && allocateFromBlock(block, requirements.size, requirements.alignment, offset))
+			break;
+	}
+
+	if (blockIndex == pool.blocks.size())
+	{
+		for (blockIndex = 0; blockIndex < pool.blocks.size(); blockIndex++)
+			if (pool.blocks[blockIndex].memory == VK_NULL_HANDLE)
+				break;
+
+		if (blockIndex == pool.blocks.size())
+			pool.blocks.emplace_back();
+
+		APP_LOG_TRACE("Allocating memory block (type {}, {} bytes)", memoryType, blockSize);
+
+		Block& block = pool.blocks[blockIndex];
+		void*  map   = nullptr;
+		block.memory = allocateMemory(blockSize, memoryType, &map);
+		block.size   = blockSize;
+		block.map    = static_cast<uint8_t*>(map);
+		InsertFreeRange(block, 0, blockSize);
+
+		m_stats.blockCount++;
+		m_stats.reservedBytes += blockSize;
+		m_heapReserved[heap]  += blockSize;
+
+		allocateFromBlock(block, requirements.size, requirements.alignment, offset);
+	}
+
+	Block& block = pool.blocks[blockIndex];
+	block.allocationCount++;
+
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.block  = blockIndex;
+	allocation.map    = block.map ? block.map + offset : nullptr;
+
+	m_stats.allocationCount++;
+	m_stats.usedBytes += requirements.size;
+
+	m_records.emplace(allocation.id, record);
+
+	return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_stats.allocationCount--;
+	m_stats.usedBytes -= allocation.size;
+
+	auto record = m_records.find(allocation.id);
+	uint32_t heap = record->second.heap;
+	m_stats.categoryBytes[static_cast<size_t>(record->second.category)] -= allocation.size;
+	m_records.erase(record);
+
+	if (allocation.dedicated)
+	{
+		vkFreeMemory(m_device, allocation.memory, nullptr);
+
+		m_stats.dedicatedCount--;
+		m_stats.reservedBytes -= allocation.size;
+		m_heapReserved[heap]  -= allocation.size;
+	}
+	else
+	{
+		Pool&  pool  = m_pools[allocation.pool];
+		Block& block = pool.blocks[allocation.block];
+
+		freeRange(block, allocation.offset, allocation.size);
+		block.allocationCount--;
+
+		// Release empty blocks, except one per pool so that a resource that is recreated every frame or on every
+		// resize does not allocate a block each time
+		uint32_t liveBlocks = 0;
+		for (const auto& b : pool.blocks)
+			liveBlocks += (b.memory != VK_NULL_HANDLE) ? 1 : 0;
+
+		if (block.allocationCount == 0 && liveBlocks > 1)
+		{
+			APP_LOG_TRACE("Releasing memory block ({} bytes)", block.size);
+
+			vkFreeMemory(m_device, block.memory, nullptr);
+
+			m_stats.blockCount--;
+			m_stats.reservedBytes -= block.size;
+			m_heapReserved[heap]  -= block.size;
+
+			block = Block();
+		}
+	}
+
+	allocation = Allocation();
+}
+
+MemoryAllocator::Stats MemoryAllocator::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+std::vector<MemoryAllocator::HeapBudget> MemoryAllocator::getHeapBudgets() const
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	properties.pNext = m_memoryBudget ? &budgetProperties : nullptr;
+	vkGetPhysicalDeviceMemoryProperties2(m_physical, &properties);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<HeapBudget> budgets(m_memoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+	{
+		HeapBudget& budget = budgets[i];
+		budget.size        = m_memoryProperties.memoryHeaps[i].size;
+		budget.reserved    = m_heapReserved[i];
+		budget.deviceLocal = (m_memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+		// Without the extension the whole heap is the budget and only this allocator's memory is known
+		budget.budget = m_memoryBudget ? budgetProperties.heapBudget[i] : budget.size;
+		budget.usage  = m_memoryBudget ? budgetProperties.heapUsage[i] : budget.reserved;
+	}
+
+	return budgets;
+}
+
+bool MemoryAllocator::writeReport(const std::string& filename) const
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		APP_LOG_ERROR("Failed to open memory report {}", filename);
+		return false;
+	}
+
+	std::vector<HeapBudget> budgets = getHeapBudgets();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	file << "{\n";
+	file << "  \"memoryBudgetExtension\": " << (m_memoryBudget ? "true" : "false") << ",\n";
+
+	file << "  \"heaps\": [\n";
+	for (size_t i = 0; i < budgets.size(); i++)
+	{
+		const HeapBudget& budget = budgets[i];
+		file << "    { \"index\": " << i
+			<< ", \"deviceLocal\": " << (budget.deviceLocal ? "true" : "false")
+			<< ", \"size\": " << budget.size
+			<< ", \"budget\": " << budget.budget
+			<< ", \"usage\": " << budget.usage
+			<< ", \"reserved\": " << budget.reserved << " }"
+			<< (i + 1 < budgets.size() ? ",\n" : "\n");
+	}
+	file << "  ],\n";
+
+	file << "  \"totals\": { \"blocks\": " << m_stats.blockCount
+		<< ", \"dedicated\": " << m_stats.dedicatedCount
+		<< ", \"allocations\": " << m_stats.allocationCount
+		<< ", \"reserved\": " << m_stats.reservedBytes
+		<< ", \"used\": " << m_stats.usedBytes << " },\n";
+
+	file << "  \"categories\": {\n";
+	for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::ENUM_MAX); i++)
+	{
+		file << "    " << quoteJson(GetCategoryName(static_cast<MemoryCategory>(i))) << ": " << m_stats.categoryBytes[i]
+			<< (i + 1 < static_cast<size_t>(MemoryCategory::ENUM_MAX) ? ",\n" : "\n");
+	}
+	file << "  },\n";
+
+	// Largest resources first
+	std::vector<const Record*> records;
+	records.reserve(m_records.size());
+	for (const auto& [id, record] : m_records)
+		records.push_back(&record);
+
+	std::sort(records.begin(), records.end(), [](const Record* a, const Record* b) { return a->size > b->size; });
+
+	file << "  \"resources\": [\n";
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const Record& record = *records[i];
+		file << "    { \"name\": " << quoteJson(record.name)
+			<< ", \"category\": " << quoteJson(GetCategoryName(record.category))
+			<< ", \"size\": " << record.size
+			<< ", \"heap\": " << record.heap
+			<< ", \"dedicated\": " << (record.dedicated ? "true" : "false") << " }"
+			<< (i + 1 < records.size() ? ",\n" : "\n");
+	}
+	file << "  ]\n";
+	file << "}\n";
+
+	APP_LOG_INFO("Wrote memory report {} ({} resources)", filename, records.size());
+	return true;
+}
+
+const char* MemoryAllocator::GetCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+		case MemoryCategory::GEOMETRY:               return "Geometry";
+		case MemoryCategory::TEXTURE:                return "Textures";
+		case MemoryCategory::ACCELERATION_STRUCTURE: return "Acceleration Structures";
+		case MemoryCategory::RENDER_TARGET:          return "Render Targets";
+		case MemoryCategory::STAGING:                return "Staging";
+		default:                                     return "Other";
+	}
+}
+
+void MemoryAllocator::cleanup()
+{
+	APP_LOG_INFO("Destroying memory allocator");
+
+	if (m_stats.allocationCount > 0)
+	{
+		APP_LOG_WARN("{} allocations were not freed ({} bytes)", m_stats.allocationCount, m_stats.usedBytes);
+		for (const auto& [id, record] : m_records)
+			APP_LOG_WARN("    {} ({} bytes)", record.name, record.size);
+	}
+
+	for (auto& pool : m_pools)
+		for (auto& block : pool.blocks)
+			if (block.memory != VK_NULL_HANDLE)
+				vkFreeMemory(m_device, block.memory, nullptr);
+
+	m_pools.clear();
+	m_records.clear();
+	m_stats = Stats();
+}
+
+VkDeviceMemory MemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, void** map)
+{
+	// Buffers that are bound to the memory may need their device address
+	VkMemoryAllocateFlagsInfo allocFlags{};
+	allocFlags.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+	allocFlags.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext           = &allocFlags;
+	allocInfo.allocationSize  = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to allocate device memory ({} bytes)", size);
+		throw std::exception();
+	}
+
+	// Host visible memory stays mapped until it is freed
+	*map = nullptr;
+	if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, map);
+
+	return memory;
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType) const
+{
+	// Keep small heaps (e.g. the host visible window into VRAM) from being taken by a few blocks
+	uint32_t     heapIndex = m_memoryProperties.memoryTypes[memoryType].heapIndex;
+	VkDeviceSize heapSize  = m_memoryProperties.memoryHeaps[heapIndex].size;
+
+	return std::min(m_blockSize, heapSize / 8);
+}
+
+bool MemoryAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+	// The smallest free range that still fits once its start is aligned
+	for (auto it = block.freeBySize.lower_bound(size); it != block.freeBySize.end(); it++)
+	{
+		VkDeviceSize rangeSize   = it->first;
+		VkDeviceSize rangeOffset = it->second;
+		VkDeviceSize aligned     = AlignUp(rangeOffset, alignment);
+
+		if (aligned + size > rangeOffset + rangeSize)
+			continue;
+
+		block.freeBySize.erase(it);
+		block.freeByOffset.erase(rangeOffset);
+
+		// The padding in front and the rest behind stay free
+		if (aligned > rangeOffset)
+			InsertFreeRange(block, rangeOffset, aligned - rangeOffset);
+
+		if (aligned + size < rangeOffset + rangeSize)
+			InsertFreeRange(block, aligned + size, rangeOffset + rangeSize - aligned - size);
+
+		offset = aligned;
+		return true;
+	}
+
+	return false;
+}
+
+void MemoryAllocator::freeRange(Block& block, VkDeviceSize offset, VkDeviceSize size)
+{
+	// Merge with the free range behind
+	auto next = block.freeByOffset.lower_bound(offset);
+	if (next != block.freeByOffset.end() && next->first == offset + size)
+	{
+		size += next->second;
+		EraseFreeRange(block, next->first, next->second);
+	}
+
+	// Merge with the free range in front
+	auto prev = block.freeByOffset.lower_bound(offset);
+	if (prev != block.freeByOffset.begin())
+	{
+		prev--;
+		if (prev->first + prev->second == offset)
+		{
+			offset  = prev->first;
+			size   += prev->second;
+			EraseFreeRange(block, prev->first, prev->second);
+		}
+	}
+
+	InsertFreeRange(block, offset, size);
+}
+
+void MemoryAllocator::InsertFreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size)
+{
+	block.freeByOffset[offset] = size;
+	block.freeBySize.emplace(size, offset);
+}
+
+void MemoryAllocator::EraseFreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size)
+{
+	auto range = block.freeBySize.equal_range(size);
+	for (auto it = range.first; it != range.second; it++)
+	{
+		if (it->second == offset)
+		{
+			block.freeBySize.erase(it);
+			break;
+		}
+	}
+
+	block.freeByOffset.erase(offset);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "Application/logging.h"
+
+#include <map>
+#include <unordered_map>
+#include <mutex>
+
+class MemoryAllocator;
+
+// What a resource is used for. Usage is reported per category
+enum class MemoryCategory
+{
+	GEOMETRY = 0,           // Vertex, index and other scene storage buffers
+	TEXTURE,
+	ACCELERATION_STRUCTURE, // Acceleration structures, their scratch and instance buffers
+	RENDER_TARGET,          // Attachments and images that are rendered into
+	STAGING,
+	OTHER,
+	ENUM_MAX
+};
+
+// A range of device memory handed out by the MemoryAllocator. Resources are bound to the memory at the offset
+struct Allocation
+{
+	VkDeviceMemory   memory    = VK_NULL_HANDLE;
+	VkDeviceSize     offset    = 0;
+	VkDeviceSize     size      = 0;
+	void*            map       = nullptr; // Host address of the range when the memory is host visible
+	MemoryAllocator* owner     = nullptr;
+	uint32_t         pool      = 0;
+	uint32_t         block     = 0;
+	bool             dedicated = false;   // The range is a whole VkDeviceMemory of its own
+	uint64_t         id        = 0;       // Key of the resource in the memory report
+};
+
+/*****************************************************************************************************************
+ *
+ * @class MemoryAllocator
+ *
+ * Sub-allocates buffers and images out of large blocks of device memory instead of one vkAllocateMemory per
+ * resource, which keeps the allocation count far below maxMemoryAllocationCount and the allocation cost off the
+ * loading path.
+ *
+ * Each memory type has two pools, one for buffers and linear images and one for optimal images, so neighbouring
+ * resources never have to be separated by bufferImageGranularity. Free ranges of a block are kept ordered by size
+ * and by offset. An allocation takes the smallest range that fits after alignment, and a freed range is merged with
+ * its free neighbours. Resources larger than half a block get a dedicated allocation.
+ *
+ * Host visible blocks are mapped once for their lifetime, so every host visible allocation has a map pointer.
+ *
+ * Every allocation is recorded with its name and category. getStats() sums them per category, getHeapBudgets()
+ * reports the budget of each heap (from VK_EXT_memory_budget when the device supports it) and writeReport() dumps
+ * all of it together with every live resource to a JSON file.
+ *
+ * The allocator is owned by the Device and is safe to use from multiple threads.
+ *
+ * Example Usage:
+ *     VkMemoryRequirements requirements;
+ *     vkGetBufferMemoryRequirements(device.getLogical(), buffer, &requirements);
+ *
+ *     Allocation allocation = device.getAllocator().allocate(
+ *         requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, MemoryCategory::GEOMETRY, "Vertex Buffer");
+ *     vkBindBufferMemory(device.getLogical(), buffer, allocation.memory, allocation.offset);
+ *
+ *     device.getAllocator().free(allocation);
+ *
+ */
+class MemoryAllocator
+{
+public:
+	struct CreateInfo
+	{
+		VkPhysicalDevice physical     = VK_NULL_HANDLE;
+		VkDevice         logical      = VK_NULL_HANDLE;
+		VkDeviceSize     blockSize    = 64ull * 1024 * 1024; // Largest block. Small heaps get smaller blocks
+		bool             memoryBudget = false;               // VK_EXT_memory_budget is enabled
+	};
+
+	struct Stats
+	{
+		uint32_t     blockCount      = 0;
+		uint32_t     dedicatedCount  = 0;
+		uint32_t     allocationCount = 0;
+		VkDeviceSize reservedBytes   = 0; // Bytes of VkDeviceMemory, blocks and dedicated allocations
+		VkDeviceSize usedBytes       = 0; // Bytes handed out to resources
+
+		VkDeviceSize categoryBytes[static_cast<size_t>(MemoryCategory::ENUM_MAX)] = {};
+	};
+
+	struct HeapBudget
+	{
+		VkDeviceSize size        = 0;
+		VkDeviceSize budget      = 0; // What the process can use before it is likely to fail or be paged
+		VkDeviceSize usage       = 0; // What the process uses, including memory that was not allocated here
+		VkDeviceSize reserved    = 0; // Part of the usage that was allocated here
+		bool         deviceLocal = false;
+	};
+
+	MemoryAllocator() = default;
+
+	void init(CreateInfo& info);
+
+	/**
+	 * Allocate memory for a resource.
+	 *
+	 * @param requirements: The memory requirements of the resource.
+	 * @param properties: The memory properties that the memory type must have.
+	 * @param linear: True for buffers and linear images, false for optimal images.
+	 * @param category: What the resource is used for.
+	 * @param name: Name of the resource in the memory report.
+	 *
+	 * @return The allocation. Bind the resource at its offset.
+	 */
+	Allocation allocate(
+		const VkMemoryRequirements& requirements,
+		VkMemoryPropertyFlags       properties,
+		bool                        linear,
+		MemoryCategory              category,
+		const std::string&          name);
+
+	// Return an allocation to its block. The allocation is reset
+	void free(Allocation& allocation);
+
+	Stats getStats() const;
+	std::vector<HeapBudget> getHeapBudgets() const;
+
+	/**
+	 * Write the heap budgets, the usage per category and every live resource to a JSON file.
+	 *
+	 * @param filename: The file to write.
+	 *
+	 * @return False if the file could not be written.
+	 */
+	bool writeReport(const std::string& filename) const;
+
+	static const char* GetCategoryName(MemoryCategory category);
+
+	void cleanup();
+
+private:
+	struct Block
+	{
+		VkDeviceMemory memory          = VK_NULL_HANDLE;
+		VkDeviceSize   size            = 0;
+		uint8_t*       map             = nullptr;
+		uint32_t       allocationCount = 0;
+
+		std::map<VkDeviceSize, VkDeviceSize>      freeByOffset; // Offset -> size
+		std::multimap<VkDeviceSize, VkDeviceSize> freeBySize;   // Size -> offset
+	};
+
+	// Blocks of one memory type and resource kind. Released blocks keep their slot so block indices stay valid
+	struct Pool
+	{
+		std::vector<Block> blocks;
+	};
+
+	// A live resource in the memory report
+	struct Record
+	{
+		std::string    name;
+		MemoryCategory category  = MemoryCategory::OTHER;
+		VkDeviceSize   size      = 0;
+		uint32_t       heap      = 0;
+		bool           dedicated = false;
+	};
+
+	VkDevice                         m_device   = VK_NULL_HANDLE;
+	VkPhysicalDevice                 m_physical = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+	VkDeviceSize                     m_blockSize    = 0;
+	bool                             m_memoryBudget = false;
+
+	std::vector<Pool>         m_pools;
+	Stats                     m_stats;
+	std::vector<VkDeviceSize> m_heapReserved;
+
+	std::unordered_map<uint64_t, Record> m_records;
+	uint64_t                             m_nextId = 1;
+
+	mutable std::mutex m_mutex;
+
+	VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, void** map);
+	VkDeviceSize getBlockSize(uint32_t memoryType) const;
+
+	bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+	void freeRange(Block& block, VkDeviceSize offset, VkDeviceSize size);
+
+	static void InsertFreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size);
+	static void EraseFreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size);
+};
@@ -0,0 +1,255 @@
+#include "pch.h"
+#include "mip_generator.h"
+
+void MipGenerator::init(CreateInfo& info)
+{
+	APP_LOG_INFO("Initializing mip generator");
+
+	m_device = info.device;
+
+	// Level 0, the storage views of the other levels and the workgroup counters
+	auto layoutBuilder = DescriptorSetLayout::Builder(*m_device);
+	layoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+	for (uint32_t level = 1; level <= s_maxLevels; level++)
+		layoutBuilder.addBinding(level, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+	layoutBuilder.addBinding(s_maxLevels + 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+	m_layout = layoutBuilder.buildLayout("Mip Generation Descriptor Set Layout");
+
+	// Pipeline
+	ShaderSet shaders(*m_device);
+	shaders.addShader(ShaderStage::COMP, "../../Shaders/mipgen_comp.spv");
+
+	auto builder = Pipeline::Builder(*m_device);
+	builder.addComputeBase();
+	builder.linkDescriptorSetLayouts(&m_layout.layout, 1);
+	builder.linkComputePushConstants(sizeof(PushConstants));
+	builder.linkComputeShader(shaders);
+	m_pipeline = builder.buildComputePipeline("Mip Generation Pipeline");
+
+	shaders.cleanup();
+
+	// Level 0 is read with one bilinear tap per 2x2 footprint
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter    = VK_FILTER_LINEAR;
+	samplerInfo.minFilter    = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.minLod       = 0.0f;
+	samplerInfo.maxLod       = 0.0f;
+
+	if (vkCreateSampler(m_device->getLogical(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create mip generation sampler");
+		throw std::exception();
+	}
+}
+
+MipGenerator::Resources MipGenerator::record(VkCommandBuffer cmdBuf, const std::vector<Target>& targets)
+{
+	Resources resources;
+	if (targets.empty())
+		return resources;
+
+	uint32_t targetCount = static_cast<uint32_t>(targets.size());
+
+	DescriptorPool::CreateInfo poolInfo{};
+	poolInfo.pDevice  = m_device;
+	poolInfo.name     = "Mip Generation Descriptor Pool";
+	poolInfo.maxSets  = targetCount;
+	poolInfo.poolSize = 3;
+
+	poolInfo.combinedImageSamplerCount = targetCount;
+	poolInfo.storageImageCount         = targetCount * s_maxLevels;
+	poolInfo.storageBufferCount        = targetCount;
+
+	resources.pool.init(poolInfo);
+
+	// One workgroup counter per image
+	Buffer::CreateBuffer(
+		sizeof(uint32_t) * targetCount,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		resources.counters, resources.counterMemory,
+		*m_device,
+		MemoryCategory::OTHER,
+		"Mip Generation Counters");
+
+	vkCmdFillBuffer(cmdBuf, resources.counters, 0, VK_WHOLE_SIZE, 0);
+
+	// Level 0 becomes readable and the other levels writable for every image at once
+	std::vector<VkImageMemoryBarrier> barriers;
+	for (const auto& target : targets)
+	{
+		VkImageMemoryBarrier barrier = Image::CreateImageMemoryBarrier(target.image);
+		barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers.push_back(barrier);
+
+		barrier.subresourceRange.baseMipLevel = 1;
+		barrier.subresourceRange.levelCount   = target.mipLevels - 1;
+		barrier.oldLayout                     = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout                     = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask                 = 0;
+		barrier.dstAccessMask                 = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barriers.push_back(barrier);
+	}
+
+	VkMemoryBarrier counterBarrier{};
+	counterBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(
+		cmdBuf,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &counterBarrier,
+		0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline.pipeline);
+
+	// One dispatch per image. The images are independent, so the dispatches can overlap
+	for (uint32_t i = 0; i < targetCount; i++)
+	{
+		const Target& target = targets[i];
+		bool          srgb   = (target.format == VK_FORMAT_R8G8B8A8_SRGB);
+
+		VkDescriptorImageInfo sourceInfo{};
+		sourceInfo.sampler     = m_sampler;
+		sourceInfo.imageView   = createView(target.image, target.format, 0);
+		sourceInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		resources.views.push_back(sourceInfo.imageView);
+
+		// Levels that the image does not have are bound to its last level and never written
+		std::vector<VkImageView> levelViews;
+		for (uint32_t level = 1; level < target.mipLevels; level++)
+		{
+			levelViews.push_back(createView(target.image, VK_FORMAT_R8G8B8A8_UNORM, level));
+			resources.views.push_back(levelViews.back());
+		}
+
+		DescriptorSet set = resources.pool.allocateDescriptorSet(m_layout);
+		set.setTotalWriteCounts(1, s_maxLevels + 1, 0);
+		set.addImageWrite(sourceInfo, 0);
+
+		for (uint32_t level = 1; level <= s_maxLevels; level++)
+		{
+			VkDescriptorImageInfo levelInfo{};
+			levelInfo.imageView   = levelViews[std::min<size_t>(level, levelViews.size()) - 1];
+			levelInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			set.addImageWrite(levelInfo, level, true);
+		}
+
+		VkDescriptorBufferInfo counterInfo{};
+		counterInfo.buffer = resources.counters;
+		counterInfo.offset = 0;
+		counterInfo.range  = VK_WHOLE_SIZE;
+		set.addBufferWrite(counterInfo, BufferType::STORAGE, s_maxLevels + 1);
+		set.update(*m_device);
+
+		// Every workgroup covers a 64x64 tile of level 0
+		uint32_t groupsX = (target.width + 63) / 64;
+		uint32_t groupsY = (target.height + 63) / 64;
+
+		PushConstants constants{};
+		constants.levelCount = target.mipLevels - 1;
+		constants.groupCount = groupsX * groupsY;
+		constants.counter    = i;
+		constants.srgb       = srgb ? 1 : 0;
+
+		vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline.layout, 0, 1, &set.getSet(), 0, nullptr);
+		vkCmdPushConstants(cmdBuf, m_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &constants);
+		vkCmdDispatch(cmdBuf, groupsX, groupsY, 1);
+	}
+
+	// The built levels become readable by the shaders that sample the textures
+	barriers.clear();
+	for (const auto& target : targets)
+	{
+		VkImageMemoryBarrier barrier = Image::CreateImageMemoryBarrier(target.image);
+		barrier.subresourceRange.baseMipLevel = 1;
+		barrier.subresourceRange.levelCount   = target.mipLevels - 1;
+		barrier.oldLayout                     = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout                     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask                 = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask                 = VK_ACCESS_SHADER_READ_BIT;
+		barriers.push_back(barrier);
+	}
+
+	vkCmdPipelineBarrier(
+		cmdBuf,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	return resources;
+}
+
+void MipGenerator::release(Resources& resources)
+{
+	for (auto view : resources.views)
+		vkDestroyImageView(m_device->getLogical(), view, nullptr);
+	resources.views.clear();
+
+	if (resources.pool.getPool() != VK_NULL_HANDLE)
+		resources.pool.cleanup();
+
+	if (resources.counters != VK_NULL_HANDLE)
+		Buffer::DestroyBuffer(resources.counters, resources.counterMemory, *m_device);
+	resources.counters = VK_NULL_HANDLE;
+}
+
+bool MipGenerator::IsSupported(VkFormat format, uint32_t width, uint32_t height)
+{
+	bool rgba8 = (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB);
+	return rgba8 && width <= 4096 && height <= 4096 && std::max(width, height) > 1;
+}
+
+void MipGenerator::cleanup()
+{
+	if (!m_device)
+		return;
+
+	vkDestroySampler(m_device->getLogical(), m_sampler, nullptr);
+	m_pipeline.cleanup(*m_device);
+	m_layout.cleanup(*m_device);
+
+	m_device = nullptr;
+}
+
+VkImageView MipGenerator::createView(VkImage image, VkFormat format, uint32_t level)
+{
+	// Restrict the usage to what the format of the view supports. The sRGB view of an image with storage usage
+	// would otherwise be invalid
+	VkImageViewUsageCreateInfo usageInfo{};
+	usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+	usageInfo.usage = (level == 0) ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_STORAGE_BIT;
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.pNext                           = &usageInfo;
+	viewInfo.image                           = image;
+	viewInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format                          = format;
+	viewInfo.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel   = level;
+	viewInfo.subresourceRange.levelCount     = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount     = 1;
+
+	VkImageView view;
+	if (vkCreateImageView(m_device->getLogical(), &viewInfo, nullptr, &view) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create mip generation image view");
+		throw std::exception();
+	}
+
+	return view;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Application/logging.h"
+
+#include "device.h"
+#include "buffer.h"
+#include "descriptor.h"
+#include "pipeline.h"
+#include "shader.h"
+
+/*****************************************************************************************************************
+ *
+ * @class MipGenerator
+ *
+ * Builds the mip chain of RGBA8 images with a compute shader instead of a blit per level. Each image is reduced
+ * in a single dispatch, and the images of one call share the barriers before and after their dispatches, so a
+ * batch of textures costs two barriers instead of two per level of every texture.
+ *
+ * Levels are averaged in linear space. sRGB images are read through their sRGB view and written through UNORM
+ * views, so they must be created with GetImageFlags() and VK_IMAGE_USAGE_STORAGE_BIT.
+ *
+ * The creator of the generator is responsible for calling its cleanup(), and every Resources returned by record()
+ * must be released once its commands are done.
+ *
+ * Example Usage:
+ *     MipGenerator::CreateInfo info{};
+ *     info.device = &device;
+ *     generator.init(info);
+ *
+ *     MipGenerator::Resources resources = generator.record(cmdBuf, targets);
+ *     // Submit cmdBuf and wait for it
+ *     generator.release(resources);
+ *
+ *     generator.cleanup();
+ *
+ */
+class MipGenerator
+{
+public:
+	struct CreateInfo
+	{
+		const Device* device = nullptr;
+	};
+
+	// An image whose level 0 was written by a transfer and is still in transfer dst layout
+	struct Target
+	{
+		VkImage  image     = VK_NULL_HANDLE;
+		VkFormat format    = VK_FORMAT_UNDEFINED;
+		uint32_t width     = 0;
+		uint32_t height    = 0;
+		uint32_t mipLevels = 0;
+	};
+
+	// Everything that the commands of one record() refer to
+	struct Resources
+	{
+		DescriptorPool           pool;
+		std::vector<VkImageView> views;
+		VkBuffer                 counters = VK_NULL_HANDLE;
+		Allocation               counterMemory;
+	};
+
+	MipGenerator() = default;
+
+	void init(CreateInfo& info);
+
+	/**
+	 * Record the mip generation of a group of images. Every image ends in shader read only layout.
+	 *
+	 * @param cmdBuf: The command buffer to record into.
+	 * @param targets: The images. Each must pass IsSupported().
+	 *
+	 * @return The resources that the commands use.
+	 */
+	Resources record(VkCommandBuffer cmdBuf, const std::vector<Target>& targets);
+	void release(Resources& resources);
+
+	bool isInitialized() const { return m_device != nullptr; }
+
+	// RGBA8 images up to 4096 texels on a side, the most that a single dispatch can reduce
+	static bool IsSupported(VkFormat format, uint32_t width, uint32_t height);
+	static VkImageCreateFlags GetImageFlags() { return VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT; }
+
+	void cleanup();
+
+private:
+	static const uint32_t s_maxLevels = 12;
+
+	struct PushConstants
+	{
+		uint32_t levelCount = 0;
+		uint32_t groupCount = 0;
+		uint32_t counter    = 0;
+		uint32_t srgb       = 0;
+	};
+
+	const Device* m_device = nullptr;
+
+	DescriptorSetLayout m_layout;
+	Pipeline            m_pipeline;
+	VkSampler           m_sampler = VK_NULL_HANDLE;
+
+	VkImageView createView(VkImage image, VkFormat format, uint32_t level);
+};
@@ -46,7 +46,7 @@ Pipeline Pipeline::Builder::buildGraphicsPipeline(Pipeline::PipelineType type, c
 
 	// Build pipeline
 	VkPipeline pipeline;
-	if (vkCreateGraphicsPipelines(m_device->getLogical(), VK_NULL_HANDLE, 1, &m_pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+	if (vkCreateGraphicsPipelines(m_device->getLogical(), m_device->getPipelineCache(), 1, &m_pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
 	{
 		APP_LOG_CRITICAL("Failed to create pipeline ({})", name);
 		throw;
@@ -70,7 +70,31 @@ Pipeline Pipeline::Builder::buildRtxPipeline(const std::string name)
 
 	// Build pipeline
 	VkPipeline pipeline;
-	if (vkCreateRayTracingPipelinesKHR(m_device->getLogical(), {}, {}, 1, &m_rtxPipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+	if (vkCreateRayTracingPipelinesKHR(m_device->getLogical(), {}, m_device->getPipelineCache(), 1, &m_rtxPipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create pipeline ({})", name);
+		throw;
+	}
+
+	return Pipeline(pipeline, layout, name);
+}
+
+Pipeline Pipeline::Builder::buildComputePipeline(const std::string name)
+{
+	APP_LOG_INFO("Building pipeline ({})", name);
+
+	// Build layout
+	VkPipelineLayout layout;
+	if (vkCreatePipelineLayout(m_device->getLogical(), &m_pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create pipeline layout ({})", name);
+		throw;
+	}
+	m_computePipelineInfo.layout = layout;
+
+	// Build pipeline
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(m_device->getLogical(), m_device->getPipelineCache(), 1, &m_computePipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
 	{
 		APP_LOG_CRITICAL("Failed to create pipeline ({})", name);
 		throw;
@@ -94,6 +118,7 @@ void Pipeline::Builder::reset()
 	m_pushConstantRange    = VkPushConstantRange{};
 	m_pipelineLayoutInfo   = VkPipelineLayoutCreateInfo{};
 	m_pipelineInfo         = VkGraphicsPipelineCreateInfo{};
+	m_computePipelineInfo  = VkComputePipelineCreateInfo{};
 }
 
 void Pipeline::Builder::addGraphicsBase()
@@ -243,6 +268,27 @@ void Pipeline::Builder::linkRtxShaders(ShaderSet& shaders)
 	m_rtxPipelineInfo.pGroups    = shaders.getShaderGroup();
 }
 
+void Pipeline::Builder::addComputeBase()
+{
+	m_pipelineLayoutInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	m_computePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+}
+
+void Pipeline::Builder::linkComputePushConstants(uint32_t size)
+{
+	m_pushConstantRange.offset     = 0;
+	m_pushConstantRange.size       = size;
+	m_pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	m_pipelineLayoutInfo.pPushConstantRanges    = &m_pushConstantRange;
+	m_pipelineLayoutInfo.pushConstantRangeCount = 1;
+}
+
+void Pipeline::Builder::linkComputeShader(ShaderSet& shaders)
+{
+	m_computePipelineInfo.stage = shaders.getStages()[0];
+}
+
 /*****************************************************************************************************************
  *
  * Pipeline
@@ -35,10 +35,12 @@ public:
 
 		Pipeline buildGraphicsPipeline(Pipeline::PipelineType type, const std::string name);
 		Pipeline buildRtxPipeline(const std::string name);
+		Pipeline buildComputePipeline(const std::string name);
 		void reset();
 
 		void addGraphicsBase();
 		void addRtxBase();
+		void addComputeBase();
 
 		void linkRenderPass(RenderPass& pass);
 		void linkShaders(ShaderSet& shaders);
@@ -48,6 +50,9 @@ public:
 		void linkRtxPushConstants(uint32_t size);
 		void linkRtxShaders(ShaderSet& shaders);
 
+		void linkComputePushConstants(uint32_t size);
+		void linkComputeShader(ShaderSet& shaders);
+
 		void enableMultisampling(VkSampleCountFlagBits sampleCount);
 		void disableFaceCulling() { m_rasterizer.cullMode = VK_CULL_MODE_NONE; }
 		void disableDepthTesting() { m_depthStencil.depthTestEnable = VK_FALSE; }
@@ -73,12 +78,16 @@ public:
 		VkGraphicsPipelineCreateInfo m_pipelineInfo{};
 
 		VkRayTracingPipelineCreateInfoKHR m_rtxPipelineInfo{};
+
+		VkComputePipelineCreateInfo m_computePipelineInfo{};
 	};
 
 	// Pipeline Class
 	VkPipeline       pipeline = VK_NULL_HANDLE;
 	VkPipelineLayout layout   = VK_NULL_HANDLE;
 
+	Pipeline() = default;
+
 	Pipeline(VkPipeline _pipeline, VkPipelineLayout _layout, const std::string name)
 		: pipeline(_pipeline), layout(_layout), m_name(name) {}
 
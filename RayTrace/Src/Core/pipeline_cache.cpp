@@ -0,0 +1,165 @@
+#include "pch.h"
+#include "pipeline_cache.h"
+#include "utilities.h"
+
+#include <filesystem>
+#include <cstring>
+
+void PipelineCache::init(CreateInfo& info)
+{
+	APP_LOG_INFO("Initializing pipeline cache");
+
+	m_device   = info.logical;
+	m_filename = info.filename;
+
+	vkGetPhysicalDeviceProperties(info.physical, &m_properties);
+
+	std::vector<char> data = loadFile();
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData    = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_cache) == VK_SUCCESS)
+		return;
+
+	// The driver can still refuse data that passed the header checks, so try again without it
+	APP_LOG_WARN("Pipeline cache data was rejected by the driver, starting with an empty cache");
+
+	cacheInfo.initialDataSize = 0;
+	cacheInfo.pInitialData    = nullptr;
+
+	if (vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_cache) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create pipeline cache");
+		throw std::exception();
+	}
+}
+
+bool PipelineCache::save() const
+{
+	if (m_cache == VK_NULL_HANDLE)
+		return false;
+
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(m_device, m_cache, &dataSize, nullptr) != VK_SUCCESS)
+	{
+		APP_LOG_ERROR("Failed to get the size of the pipeline cache");
+		return false;
+	}
+
+	std::vector<char> data(dataSize);
+	if (dataSize > 0 && vkGetPipelineCacheData(m_device, m_cache, &dataSize, data.data()) != VK_SUCCESS)
+	{
+		APP_LOG_ERROR("Failed to get the data of the pipeline cache");
+		return false;
+	}
+	data.resize(dataSize);
+
+	FileHeader header = createHeader(data);
+
+	// Write a temporary file first, so the old cache is only replaced by a complete one
+	std::string tempFilename = m_filename + ".tmp";
+	{
+		std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			APP_LOG_ERROR("Failed to open pipeline cache {}", tempFilename);
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		file.flush();
+
+		if (!file.good())
+		{
+			APP_LOG_ERROR("Failed to write pipeline cache {}", tempFilename);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFilename, m_filename, error);
+	if (error)
+	{
+		APP_LOG_ERROR("Failed to replace pipeline cache {}: {}", m_filename, error.message());
+		std::filesystem::remove(tempFilename, error);
+		return false;
+	}
+
+	APP_LOG_INFO("Saved pipeline cache to {} ({} bytes)", m_filename, data.size());
+	return true;
+}
+
+void PipelineCache::cleanup()
+{
+	APP_LOG_INFO("Destroying pipeline cache");
+
+	vkDestroyPipelineCache(m_device, m_cache, nullptr);
+	m_cache = VK_NULL_HANDLE;
+}
+
+std::vector<char> PipelineCache::loadFile() const
+{
+	std::ifstream file(m_filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		APP_LOG_INFO("No pipeline cache found at {}", m_filename);
+		return {};
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	if (fileSize < sizeof(FileHeader))
+	{
+		APP_LOG_WARN("Pipeline cache {} is too small, ignoring it", m_filename);
+		return {};
+	}
+
+	FileHeader header{};
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (header.magic != MAGIC || header.version != VERSION || header.dataSize != fileSize - sizeof(FileHeader))
+	{
+		APP_LOG_WARN("Pipeline cache {} is not valid, ignoring it", m_filename);
+		return {};
+	}
+
+	// The data is only usable by the exact device and driver that wrote it
+	if (header.vendorID != m_properties.vendorID || header.deviceID != m_properties.deviceID ||
+		header.driverVersion != m_properties.driverVersion ||
+		std::memcmp(header.uuid, m_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		APP_LOG_INFO("Pipeline cache {} was written by another device or driver, ignoring it", m_filename);
+		return {};
+	}
+
+	std::vector<char> data(static_cast<size_t>(header.dataSize));
+	file.read(data.data(), data.size());
+
+	if (!file.good() || hashBytes(data.data(), data.size()) != header.dataHash)
+	{
+		APP_LOG_WARN("Pipeline cache {} is damaged, ignoring it", m_filename);
+		return {};
+	}
+
+	APP_LOG_INFO("Loaded pipeline cache from {} ({} bytes)", m_filename, data.size());
+	return data;
+}
+
+PipelineCache::FileHeader PipelineCache::createHeader(const std::vector<char>& data) const
+{
+	FileHeader header{};
+	header.magic         = MAGIC;
+	header.version       = VERSION;
+	header.vendorID      = m_properties.vendorID;
+	header.deviceID      = m_properties.deviceID;
+	header.driverVersion = m_properties.driverVersion;
+	header.dataSize      = data.size();
+	header.dataHash      = hashBytes(data.data(), data.size());
+	std::memcpy(header.uuid, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	return header;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Application/logging.h"
+
+/*****************************************************************************************************************
+ *
+ * @class PipelineCache
+ *
+ * A VkPipelineCache that is kept on disk across runs, so pipelines that were compiled once are not compiled from
+ * SPIR-V again on the next launch. The file starts with a header of the device and driver that wrote it. A file of
+ * a different device or driver, or one that is damaged, is ignored and the cache starts empty.
+ *
+ * save() writes the cache to a temporary file and then replaces the old file with it, so a crash while saving
+ * never leaves a half written cache behind.
+ *
+ * The cache is owned by the Device, which loads it when it is initialized and saves it when it is cleaned up. It
+ * is internally synchronized, so pipelines can be created with it from any thread.
+ *
+ * Example Usage:
+ *     PipelineCache::CreateInfo info{};
+ *     info.physical = physicalDevice;
+ *     info.logical  = logicalDevice;
+ *     info.filename = "pipeline_cache.bin";
+ *     cache.init(info);
+ *
+ *     vkCreateGraphicsPipelines(logicalDevice, cache.getCache(), 1, &pipelineInfo, nullptr, &pipeline);
+ *
+ *     cache.save();
+ *     cache.cleanup();
+ *
+ */
+class PipelineCache
+{
+public:
+	struct CreateInfo
+	{
+		VkPhysicalDevice physical = VK_NULL_HANDLE;
+		VkDevice         logical  = VK_NULL_HANDLE;
+		std::string      filename = "pipeline_cache.bin";
+	};
+
+	PipelineCache() = default;
+
+	void init(CreateInfo& info);
+
+	VkPipelineCache getCache() const { return m_cache; }
+
+	/**
+	 * Write the cache to its file.
+	 *
+	 * @return False if the file could not be written. The old file is kept in that case.
+	 */
+	bool save() const;
+
+	void cleanup();
+
+private:
+	// Written in front of the data of the driver
+	struct FileHeader
+	{
+		uint32_t magic         = 0;
+		uint32_t version       = 0;
+		uint32_t vendorID      = 0;
+		uint32_t deviceID      = 0;
+		uint32_t driverVersion = 0;
+		uint8_t  uuid[VK_UUID_SIZE]{};
+		uint64_t dataSize      = 0;
+		uint64_t dataHash      = 0;
+	};
+
+	static constexpr uint32_t MAGIC   = 0x43505452; // "RTPC"
+	static constexpr uint32_t VERSION = 1;
+
+	VkDevice        m_device = VK_NULL_HANDLE;
+	VkPipelineCache m_cache  = VK_NULL_HANDLE;
+	std::string     m_filename;
+
+	VkPhysicalDeviceProperties m_properties{};
+
+	std::vector<char> loadFile() const;
+
+	FileHeader createHeader(const std::vector<char>& data) const;
+};
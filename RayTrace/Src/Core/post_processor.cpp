@@ -0,0 +1,366 @@
+#include "pch.h"
+#include "post_processor.h"
+
+void PostProcessor::init(CreateInfo& info)
+{
+	APP_LOG_INFO("Initializing post processor ({} frames)", info.framesInFlight);
+
+	m_device         = info.device;
+	m_extent         = info.extent;
+	m_sourceFormat   = info.sourceFormat;
+	m_profiler       = info.profiler;
+	m_graphicsFamily = m_device->getIndices().graphicsFamily.value();
+	m_computeFamily  = m_device->getIndices().computeFamily.value();
+
+	if (!m_device->isAsyncComputeSupported())
+		APP_LOG_WARN("No async compute family, post processing shares the graphics family");
+
+	// Rendered image and tone mapped output
+	auto layoutBuilder = DescriptorSetLayout::Builder(*m_device);
+	layoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+	layoutBuilder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+	m_layout = layoutBuilder.buildLayout("Post Compute Descriptor Set Layout");
+
+	// Pipeline
+	ShaderSet shaders(*m_device);
+	shaders.addShader(ShaderStage::COMP, "../../Shaders/post_comp.spv");
+
+	auto builder = Pipeline::Builder(*m_device);
+	builder.addComputeBase();
+	builder.linkDescriptorSetLayouts(&m_layout.layout, 1);
+	builder.linkComputePushConstants(sizeof(PostPushConstants));
+	builder.linkComputeShader(shaders);
+	m_pipeline = builder.buildComputePipeline("Post Compute Pipeline");
+
+	shaders.cleanup();
+
+	// Both images are read texel for texel
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter    = VK_FILTER_NEAREST;
+	samplerInfo.minFilter    = VK_FILTER_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.minLod       = 0.0f;
+	samplerInfo.maxLod       = 0.0f;
+
+	if (vkCreateSampler(m_device->getLogical(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create post processing sampler");
+		throw std::exception();
+	}
+
+	// Command buffers of the compute queue
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = m_computeFamily;
+
+	if (vkCreateCommandPool(m_device->getLogical(), &poolInfo, nullptr, &m_pool) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create post processing command pool");
+		throw std::exception();
+	}
+
+	DescriptorPool::CreateInfo descriptorPoolInfo{};
+	descriptorPoolInfo.pDevice  = m_device;
+	descriptorPoolInfo.name     = "Post Compute Descriptor Pool";
+	descriptorPoolInfo.maxSets  = info.framesInFlight;
+	descriptorPoolInfo.poolSize = 2;
+
+	descriptorPoolInfo.combinedImageSamplerCount = info.framesInFlight;
+	descriptorPoolInfo.storageImageCount         = info.framesInFlight;
+
+	m_descriptorPool.init(descriptorPoolInfo);
+
+	// Frames
+	m_frames.resize(info.framesInFlight);
+	for (uint32_t i = 0; i < info.framesInFlight; i++)
+	{
+		Frame& frame = m_frames[i];
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool        = m_pool;
+		allocInfo.commandBufferCount = 1;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if (vkAllocateCommandBuffers(m_device->getLogical(), &allocInfo, &frame.cmdBuf) != VK_SUCCESS ||
+			vkCreateSemaphore(m_device->getLogical(), &semaphoreInfo, nullptr, &frame.renderDone) != VK_SUCCESS ||
+			vkCreateSemaphore(m_device->getLogical(), &semaphoreInfo, nullptr, &frame.postDone) != VK_SUCCESS)
+		{
+			APP_LOG_CRITICAL("Failed to create post processing frame {}", i);
+			throw std::exception();
+		}
+
+		frame.set = m_descriptorPool.allocateDescriptorSet(m_layout);
+		createImages(frame, i);
+	}
+}
+
+void PostProcessor::resize(VkExtent2D extent)
+{
+	m_extent = extent;
+
+	for (uint32_t i = 0; i < m_frames.size(); i++)
+	{
+		destroyImages(m_frames[i]);
+		createImages(m_frames[i], i);
+	}
+}
+
+VkSemaphore PostProcessor::submit(VkCommandBuffer cmdBuf, VkImage renderedImage, uint32_t frameIndex, const PostPushConstants& constants)
+{
+	Frame& frame = m_frames[frameIndex];
+
+	// Copy the rendered image once the trace or the raster pass wrote it. The copy of the last use of this frame
+	// was read before the swapchain's wait on the frame returned, so its contents can be discarded
+	Image::TransitionInfo renderedInfo{};
+	renderedInfo.oldLayout     = VK_IMAGE_LAYOUT_GENERAL;
+	renderedInfo.newLayout     = VK_IMAGE_LAYOUT_GENERAL;
+	renderedInfo.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	renderedInfo.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	renderedInfo.srcStageMask  = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	renderedInfo.dstStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	Image::TransitionImage(cmdBuf, renderedImage, renderedInfo);
+
+	Image::TransitionInfo sourceInfo{};
+	sourceInfo.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+	sourceInfo.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	sourceInfo.srcAccessMask = 0;
+	sourceInfo.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	sourceInfo.srcStageMask  = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	sourceInfo.dstStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	Image::TransitionImage(cmdBuf, frame.source.image, sourceInfo);
+
+	VkImageCopy region{};
+	region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.extent         = { m_extent.width, m_extent.height, 1 };
+
+	vkCmdCopyImage(
+		cmdBuf,
+		renderedImage, VK_IMAGE_LAYOUT_GENERAL,
+		frame.source.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &region);
+
+	// The next frame renders into the image again, but not before the copy has read it
+	renderedInfo.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	renderedInfo.dstAccessMask = 0;
+	renderedInfo.srcStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	renderedInfo.dstStageMask  = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	Image::TransitionImage(cmdBuf, renderedImage, renderedInfo);
+
+	// Release the copy to the compute queue
+	sourceInfo.oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	sourceInfo.newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	sourceInfo.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+	sourceInfo.dstAccessMask       = 0;
+	sourceInfo.srcQueueFamilyIndex = getBarrierFamily(m_graphicsFamily);
+	sourceInfo.dstQueueFamilyIndex = getBarrierFamily(m_computeFamily);
+	sourceInfo.srcStageMask        = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	sourceInfo.dstStageMask        = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	Image::TransitionImage(cmdBuf, frame.source.image, sourceInfo);
+
+	if (vkEndCommandBuffer(cmdBuf) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to record scene command buffer");
+		throw std::exception();
+	}
+
+	VkSubmitInfo renderSubmit{};
+	renderSubmit.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	renderSubmit.commandBufferCount   = 1;
+	renderSubmit.pCommandBuffers      = &cmdBuf;
+	renderSubmit.signalSemaphoreCount = 1;
+	renderSubmit.pSignalSemaphores    = &frame.renderDone;
+
+	m_device->getGraphicsTimeline().submit(renderSubmit);
+
+	// Post processing
+	vkResetCommandBuffer(frame.cmdBuf, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(frame.cmdBuf, &beginInfo);
+
+	// Acquire the copy. With one family the release already changed the layout
+	if (m_computeFamily != m_graphicsFamily)
+	{
+		sourceInfo.srcAccessMask = 0;
+		sourceInfo.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		sourceInfo.srcStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		sourceInfo.dstStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		Image::TransitionImage(frame.cmdBuf, frame.source.image, sourceInfo);
+	}
+
+	Image::TransitionInfo targetInfo{};
+	targetInfo.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+	targetInfo.newLayout     = VK_IMAGE_LAYOUT_GENERAL;
+	targetInfo.srcAccessMask = 0;
+	targetInfo.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	targetInfo.srcStageMask  = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	targetInfo.dstStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	Image::TransitionImage(frame.cmdBuf, frame.target.image, targetInfo);
+
+	vkCmdBindPipeline(frame.cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline.pipeline);
+	vkCmdBindDescriptorSets(frame.cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline.layout, 0, 1, &frame.set.getSet(), 0, nullptr);
+	vkCmdPushConstants(frame.cmdBuf, m_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PostPushConstants), &constants);
+	uint32_t scope = GpuProfiler::INVALID_SCOPE;
+	if (m_profiler && m_profiler->isSupported(m_computeFamily))
+		scope = m_profiler->beginScope(frame.cmdBuf, "Tone Map");
+
+	vkCmdDispatch(frame.cmdBuf, (m_extent.width + 7) / 8, (m_extent.height + 7) / 8, 1);
+
+	if (m_profiler)
+		m_profiler->endScope(frame.cmdBuf, scope);
+
+	// Release the output to the graphics queue
+	targetInfo.oldLayout           = VK_IMAGE_LAYOUT_GENERAL;
+	targetInfo.newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	targetInfo.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+	targetInfo.dstAccessMask       = 0;
+	targetInfo.srcQueueFamilyIndex = getBarrierFamily(m_computeFamily);
+	targetInfo.dstQueueFamilyIndex = getBarrierFamily(m_graphicsFamily);
+	targetInfo.srcStageMask        = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	targetInfo.dstStageMask        = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	Image::TransitionImage(frame.cmdBuf, frame.target.image, targetInfo);
+
+	vkEndCommandBuffer(frame.cmdBuf);
+
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	VkSubmitInfo postSubmit{};
+	postSubmit.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	postSubmit.waitSemaphoreCount   = 1;
+	postSubmit.pWaitSemaphores      = &frame.renderDone;
+	postSubmit.pWaitDstStageMask    = &waitStage;
+	postSubmit.commandBufferCount   = 1;
+	postSubmit.pCommandBuffers      = &frame.cmdBuf;
+	postSubmit.signalSemaphoreCount = 1;
+	postSubmit.pSignalSemaphores    = &frame.postDone;
+
+	m_device->getComputeTimeline().submit(postSubmit);
+
+	return frame.postDone;
+}
+
+void PostProcessor::acquire(VkCommandBuffer cmdBuf, uint32_t frameIndex)
+{
+	// With one family the release already changed the layout and the semaphore wait makes the writes visible
+	if (m_computeFamily == m_graphicsFamily)
+		return;
+
+	Image::TransitionInfo targetInfo{};
+	targetInfo.oldLayout           = VK_IMAGE_LAYOUT_GENERAL;
+	targetInfo.newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	targetInfo.srcAccessMask       = 0;
+	targetInfo.dstAccessMask       = VK_ACCESS_SHADER_READ_BIT;
+	targetInfo.srcQueueFamilyIndex = m_computeFamily;
+	targetInfo.dstQueueFamilyIndex = m_graphicsFamily;
+	targetInfo.srcStageMask        = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	targetInfo.dstStageMask        = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	Image::TransitionImage(cmdBuf, m_frames[frameIndex].target.image, targetInfo);
+}
+
+void PostProcessor::cleanup()
+{
+	if (!m_device)
+		return;
+
+	APP_LOG_INFO("Destroying post processor");
+
+	for (auto& frame : m_frames)
+	{
+		destroyImages(frame);
+		vkDestroySemaphore(m_device->getLogical(), frame.renderDone, nullptr);
+		vkDestroySemaphore(m_device->getLogical(), frame.postDone, nullptr);
+	}
+	m_frames.clear();
+
+	vkDestroyCommandPool(m_device->getLogical(), m_pool, nullptr);
+	vkDestroySampler(m_device->getLogical(), m_sampler, nullptr);
+	m_descriptorPool.cleanup();
+	m_pipeline.cleanup(*m_device);
+	m_layout.cleanup(*m_device);
+
+	m_device = nullptr;
+}
+
+void PostProcessor::createImages(Frame& frame, uint32_t index)
+{
+	char name[128];
+
+	Image::CreateInfo imageInfo{};
+	imageInfo.width      = m_extent.width;
+	imageInfo.height     = m_extent.height;
+	imageInfo.mipLevels  = 1;
+	imageInfo.layerCount = 1;
+	imageInfo.numSamples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling     = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	imageInfo.device     = m_device;
+
+	Image::ImageViewSetupInfo viewInfo{};
+	viewInfo.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.mipLevels   = 1;
+	viewInfo.layerCount  = 1;
+	viewInfo.device      = m_device;
+
+	// Copy of the rendered image
+	sprintf(name, "Post Source %u", index);
+	imageInfo.name   = name;
+	imageInfo.format = m_sourceFormat;
+	imageInfo.usage  = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	frame.source     = Image::CreateImage(imageInfo);
+
+	viewInfo.format = m_sourceFormat;
+	Image::SetupImageView(frame.source, viewInfo);
+
+	// Tone mapped output. Half floats keep the precision of what the fragment shader used to write
+	sprintf(name, "Post Target %u", index);
+	imageInfo.name   = name;
+	imageInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	imageInfo.usage  = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	frame.target     = Image::CreateImage(imageInfo);
+
+	viewInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	Image::SetupImageView(frame.target, viewInfo);
+
+	frame.output.sampler     = m_sampler;
+	frame.output.imageView   = frame.target.view;
+	frame.output.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	// Descriptors
+	VkDescriptorImageInfo sourceDescriptor{};
+	sourceDescriptor.sampler     = m_sampler;
+	sourceDescriptor.imageView   = frame.source.view;
+	sourceDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorImageInfo targetDescriptor{};
+	targetDescriptor.imageView   = frame.target.view;
+	targetDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	frame.set.setTotalWriteCounts(0, 2, 0);
+	frame.set.addImageWrite(sourceDescriptor, 0);
+	frame.set.addImageWrite(targetDescriptor, 1, true);
+	frame.set.update(*m_device);
+}
+
+void PostProcessor::destroyImages(Frame& frame)
+{
+	frame.source.cleanup(m_device->getLogical());
+	frame.target.cleanup(m_device->getLogical());
+}
+
+uint32_t PostProcessor::getBarrierFamily(uint32_t family) const
+{
+	return (m_computeFamily == m_graphicsFamily) ? VK_QUEUE_FAMILY_IGNORED : family;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Application/logging.h"
+
+#include "device.h"
+#include "image.h"
+#include "descriptor.h"
+#include "pipeline.h"
+#include "shader.h"
+#include "rendering_structures.h"
+#include "gpu_profiler.h"
+
+/*****************************************************************************************************************
+ *
+ * @class PostProcessor
+ *
+ * Tone maps the rendered image with a compute shader on the compute queue. Each frame in flight has its own copy
+ * of the rendered image and its own output, so the post work of one frame runs on the compute queue while the
+ * graphics queue already traces or rasterizes the next one.
+ *
+ * A frame is split into two graphics submissions. submit() ends the commands that render the scene, copies the
+ * rendered image and hands the copy to the compute queue. acquire() takes the output back in the commands that
+ * draw it to the swapchain, which must wait on the semaphore that submit() returned. When the compute family is
+ * a different one than the graphics family the images change owner with release and acquire barriers.
+ *
+ * The creator of the post processor is responsible for calling its cleanup().
+ *
+ * Example Usage:
+ *     PostProcessor::CreateInfo info{};
+ *     info.device         = &device;
+ *     info.extent         = swapchain.getExtent();
+ *     info.sourceFormat   = offscreenTexture.getImage().format;
+ *     info.framesInFlight = 2;
+ *     postProcessor.init(info);
+ *
+ *     VkSemaphore postDone = postProcessor.submit(sceneCmdBuf, offscreenTexture.getImage().image, frame, constants);
+ *     postProcessor.acquire(presentCmdBuf, frame);
+ *     // Sample postProcessor.getOutput(frame), submit presentCmdBuf waiting on postDone
+ *
+ *     postProcessor.cleanup();
+ *
+ */
+class PostProcessor
+{
+public:
+	struct CreateInfo
+	{
+		const Device* device         = nullptr;
+		VkExtent2D    extent         = { 0, 0 };
+		VkFormat      sourceFormat   = VK_FORMAT_UNDEFINED; // Format of the rendered image
+		uint32_t      framesInFlight = 2;
+		GpuProfiler*  profiler       = nullptr; // Optional, times the tone mapping
+	};
+
+	PostProcessor() = default;
+
+	void init(CreateInfo& info);
+
+	/**
+	 * Recreate the images for a new window size. The GPU must be idle.
+	 *
+	 * @param extent: The new size of the rendered image.
+	 */
+	void resize(VkExtent2D extent);
+
+	/**
+	 * End and submit the scene commands with a copy of the rendered image, then submit the post processing of the
+	 * copy to the compute queue.
+	 *
+	 * @param cmdBuf: The graphics command buffer that rendered the scene. It is ended here.
+	 * @param renderedImage: The rendered image. Must be in general layout.
+	 * @param frameIndex: The frame in flight.
+	 * @param constants: The post settings of the frame.
+	 *
+	 * @return The semaphore that signals once the output of the frame is written.
+	 */
+	VkSemaphore submit(VkCommandBuffer cmdBuf, VkImage renderedImage, uint32_t frameIndex, const PostPushConstants& constants);
+
+	/**
+	 * Record the barrier that makes the output of a frame readable by fragment shaders on the graphics queue.
+	 *
+	 * @param cmdBuf: The graphics command buffer that draws the output.
+	 * @param frameIndex: The frame in flight.
+	 */
+	void acquire(VkCommandBuffer cmdBuf, uint32_t frameIndex);
+
+	// Output of a frame for a combined image sampler. Valid in the commands after acquire()
+	const VkDescriptorImageInfo& getOutput(uint32_t frameIndex) const { return m_frames[frameIndex].output; }
+
+	void cleanup();
+
+private:
+	struct Frame
+	{
+		Image source; // Copy of the rendered image
+		Image target; // Tone mapped image
+
+		VkDescriptorImageInfo output{};
+
+		DescriptorSet   set;
+		VkCommandBuffer cmdBuf     = VK_NULL_HANDLE;
+		VkSemaphore     renderDone = VK_NULL_HANDLE; // Graphics -> compute
+		VkSemaphore     postDone   = VK_NULL_HANDLE; // Compute -> graphics
+	};
+
+	const Device* m_device       = nullptr;
+	VkExtent2D    m_extent       = { 0, 0 };
+	VkFormat      m_sourceFormat = VK_FORMAT_UNDEFINED;
+
+	GpuProfiler* m_profiler = nullptr;
+
+	uint32_t m_graphicsFamily = 0;
+	uint32_t m_computeFamily  = 0;
+
+	VkCommandPool       m_pool    = VK_NULL_HANDLE;
+	VkSampler           m_sampler = VK_NULL_HANDLE;
+	DescriptorPool      m_descriptorPool;
+	DescriptorSetLayout m_layout;
+	Pipeline            m_pipeline;
+
+	std::vector<Frame> m_frames;
+
+	void createImages(Frame& frame, uint32_t index);
+	void destroyImages(Frame& frame);
+
+	// Family index for an ownership transfer barrier, ignored when both queues are of the same family
+	uint32_t getBarrierFamily(uint32_t family) const;
+};
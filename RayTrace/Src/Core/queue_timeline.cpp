@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "queue_timeline.h"
+
+void QueueTimeline::init(CreateInfo& info)
+{
+	APP_LOG_INFO("Initializing queue timeline ({})", info.name);
+
+	m_device = info.device;
+	m_queue  = info.queue;
+	m_name   = info.name;
+	m_value  = 0;
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue  = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_semaphore) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create timeline semaphore ({})", m_name);
+		throw std::exception();
+	}
+}
+
+uint64_t QueueTimeline::submit(const VkSubmitInfo& submitInfo, VkFence fence)
+{
+	// Values must be signaled in the order that they are handed out, so the lock is held across the submit
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint64_t value = m_value + 1;
+
+	// Binary semaphores ignore their value, but every semaphore needs one once the timeline info is chained. Values
+	// of other timeline semaphores are taken from the timeline info of the caller
+	std::vector<uint64_t> waitValues(submitInfo.waitSemaphoreCount, 0);
+	std::vector<uint64_t> signalValues(submitInfo.signalSemaphoreCount, 0);
+
+	const void* next = submitInfo.pNext;
+
+	const auto* callerInfo = static_cast<const VkTimelineSemaphoreSubmitInfo*>(submitInfo.pNext);
+	if (callerInfo && callerInfo->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO)
+	{
+		for (uint32_t i = 0; i < callerInfo->waitSemaphoreValueCount && i < waitValues.size(); i++)
+			waitValues[i] = callerInfo->pWaitSemaphoreValues[i];
+
+		for (uint32_t i = 0; i < callerInfo->signalSemaphoreValueCount && i < signalValues.size(); i++)
+			signalValues[i] = callerInfo->pSignalSemaphoreValues[i];
+
+		next = callerInfo->pNext;
+	}
+
+	std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+	signalSemaphores.push_back(m_semaphore);
+	signalValues.push_back(value);
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.pNext                     = next;
+	timelineInfo.waitSemaphoreValueCount   = static_cast<uint32_t>(waitValues.size());
+	timelineInfo.pWaitSemaphoreValues      = waitValues.data();
+	timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+	timelineInfo.pSignalSemaphoreValues    = signalValues.data();
+
+	VkSubmitInfo timelineSubmit         = submitInfo;
+	timelineSubmit.pNext                = &timelineInfo;
+	timelineSubmit.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+	timelineSubmit.pSignalSemaphores    = signalSemaphores.data();
+
+	if (vkQueueSubmit(m_queue, 1, &timelineSubmit, fence) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to submit to queue ({})", m_name);
+		throw std::exception();
+	}
+
+	m_value = value;
+	return value;
+}
+
+uint64_t QueueTimeline::getSubmittedValue() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_value;
+}
+
+uint64_t QueueTimeline::getCompletedValue() const
+{
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(m_device, m_semaphore, &completed);
+
+	return completed;
+}
+
+void QueueTimeline::wait(uint64_t value) const
+{
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores    = &m_semaphore;
+	waitInfo.pValues        = &value;
+
+	vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX);
+}
+
+void QueueTimeline::defer(std::function<void()> release)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_deferred.push_back({ m_value + 1, std::move(release) });
+}
+
+void QueueTimeline::collect()
+{
+	uint64_t completed = getCompletedValue();
+
+	// Releases run outside of the lock, so they are free to defer or submit again
+	std::vector<Deferred> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 0; i < m_deferred.size();)
+		{
+			if (m_deferred[i].value <= completed)
+			{
+				ready.push_back(std::move(m_deferred[i]));
+				m_deferred[i] = std::move(m_deferred.back());
+				m_deferred.pop_back();
+			}
+			else
+				i++;
+		}
+	}
+
+	for (auto& deferred : ready)
+		deferred.release();
+}
+
+void QueueTimeline::cleanup()
+{
+	if (m_semaphore == VK_NULL_HANDLE)
+		return;
+
+	APP_LOG_INFO("Destroying queue timeline ({})", m_name);
+
+	wait(getSubmittedValue());
+
+	// Releases that wait for a submission that never happened are run as well
+	std::vector<Deferred> remaining;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		remaining.swap(m_deferred);
+	}
+
+	for (auto& deferred : remaining)
+		deferred.release();
+
+	vkDestroySemaphore(m_device, m_semaphore, nullptr);
+	m_semaphore = VK_NULL_HANDLE;
+}
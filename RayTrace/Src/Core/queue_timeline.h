@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Application/logging.h"
+
+#include <functional>
+#include <mutex>
+
+/*****************************************************************************************************************
+ *
+ * @class QueueTimeline
+ *
+ * A timeline semaphore that counts the submissions of one queue. Every submit() signals the next value, so a
+ * value stands for that submission and everything submitted to the queue before it. The CPU can poll or wait for
+ * exactly the work that holds a resource instead of waiting for a fence per frame or for the whole queue to idle.
+ *
+ * Resources that the GPU may still use can be handed to defer(). They are released by collect() once the work
+ * that was submitted up to then is done.
+ *
+ * The timelines are owned by the Device, one per queue. Submissions and deferred releases are thread safe.
+ *
+ * Example Usage:
+ *     QueueTimeline& timeline = device.getGraphicsTimeline();
+ *
+ *     uint64_t value = timeline.submit(submitInfo);
+ *     timeline.defer([=]() { vkDestroyBuffer(device.getLogical(), buffer, nullptr); });
+ *
+ *     timeline.wait(value);
+ *     timeline.collect();
+ *
+ */
+class QueueTimeline
+{
+public:
+	struct CreateInfo
+	{
+		VkDevice    device = VK_NULL_HANDLE;
+		VkQueue     queue  = VK_NULL_HANDLE;
+		const char* name   = "Queue";
+	};
+
+	QueueTimeline() = default;
+
+	void init(CreateInfo& info);
+
+	/**
+	 * Submit one batch to the queue and signal the next value once it is done.
+	 *
+	 * @param submitInfo: The batch. Its semaphores are kept. Values of other timeline semaphores are read from a
+	 * VkTimelineSemaphoreSubmitInfo at the front of its pNext chain.
+	 * @param fence: Optional fence to signal as well.
+	 *
+	 * @return The value that signals once the batch is done.
+	 */
+	uint64_t submit(const VkSubmitInfo& submitInfo, VkFence fence = VK_NULL_HANDLE);
+
+	uint64_t getSubmittedValue() const;
+	uint64_t getCompletedValue() const;
+
+	bool isComplete(uint64_t value) const { return getCompletedValue() >= value; }
+	void wait(uint64_t value) const;
+
+	/**
+	 * Release a resource once the next submission and everything before it is done. Resources that are only used
+	 * by commands which were already submitted are released at the same point.
+	 *
+	 * @param release: Destroys or recycles the resource.
+	 */
+	void defer(std::function<void()> release);
+
+	// Run the releases whose work is done
+	void collect();
+
+	VkSemaphore getSemaphore() const { return m_semaphore; }
+	VkQueue getQueue() const { return m_queue; }
+
+	// Wait for everything that was submitted and run the remaining releases
+	void cleanup();
+
+private:
+	struct Deferred
+	{
+		uint64_t              value = 0;
+		std::function<void()> release;
+	};
+
+	VkDevice    m_device    = VK_NULL_HANDLE;
+	VkQueue     m_queue     = VK_NULL_HANDLE;
+	VkSemaphore m_semaphore = VK_NULL_HANDLE;
+	std::string m_name      = "";
+	uint64_t    m_value     = 0;
+
+	std::vector<Deferred> m_deferred;
+
+	mutable std::mutex m_mutex;
+};
@@ -2,6 +2,8 @@
 
 #include "renderer.h"
 
+#include "Application/cpu_profiler.h"
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -12,15 +14,21 @@ void Renderer::beginFrame()
 	// Acquire image from swapchain
 	m_imageIndex = m_swapchain->acquireImage(m_frameIndex);
 
+	// The GPU is done with the command buffers of this frame
+	m_commandSystem->resetFrame(m_frameIndex);
+
+	// The previous submission of this frame is done, so its feedback can be read and its set rewritten
+	if (m_textureStreamer)
+		m_textureStreamer->update(m_frameIndex, m_offscreenDescriptorSets[m_frameIndex]);
+
 	// Compute delta time
 	float currentFrameTime = static_cast<float>(glfwGetTime());
 	deltaTime       = currentFrameTime - m_lastFrameTime;
 	m_lastFrameTime = currentFrameTime;
 
 	m_camera->updatePosition(deltaTime);
-	// Reset and begin command buffer
+	// Begin command buffer
 	m_commandBuffer = m_commandSystem->getCommandBuffer(m_frameIndex);
-	vkResetCommandBuffer(m_commandBuffer, 0);
 
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -31,6 +39,11 @@ void Renderer::beginFrame()
 		throw;
 	}
 
+	// Timings of the last use of this frame are ready, so they are read before its queries are reset
+	if (m_gpuProfiler)
+		m_gpuProfiler->beginFrame(m_commandBuffer, m_frameIndex);
+	m_frameScope = beginScope("Frame");
+
 	// Get window size
 	VkExtent2D extent = m_swapchain->getExtent();
 	m_windowWidth     = extent.width;
@@ -48,9 +61,38 @@ void Renderer::beginFrame()
 	Buffer::Update(BufferType::UNIFORM, m_uniformBuffers[m_frameIndex], &ubo);
 }
 
+void Renderer::postProcess()
+{
+	if (!m_postProcessor)
+		return;
+
+	m_postSemaphore = m_postProcessor->submit(m_commandBuffer, m_offscreenTexture->getImage().image, m_frameIndex, postPushConstants);
+
+	// The rest of the frame is recorded into its second command buffer, which is submitted after the post work
+	m_commandBuffer = m_commandSystem->getCommandBuffer(m_frameIndex, 1);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+	if (vkBeginCommandBuffer(m_commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to begin recording command buffer");
+		throw;
+	}
+
+	m_postProcessor->acquire(m_commandBuffer, m_frameIndex);
+}
+
 void Renderer::submit()
 { 
-	m_swapchain->submitGraphics(m_commandBuffer, m_frameIndex);
+	endScope(m_frameScope);
+
+	if (m_textureStreamer)
+		m_textureStreamer->recordFeedbackBarrier(m_commandBuffer, m_frameIndex);
+
+	m_swapchain->submitGraphics(m_commandBuffer, m_frameIndex, m_postSemaphore, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	m_postSemaphore = VK_NULL_HANDLE;
 }
 
 void Renderer::endFrame()
@@ -61,7 +103,7 @@ void Renderer::endFrame()
 	m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
 }
 
-void Renderer::beginRenderPass(RenderPass::PassType pass)
+void Renderer::beginRenderPass(RenderPass::PassType pass, bool parallel)
 {
 	VkRenderPassBeginInfo beginInfo{};
 	beginInfo.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -79,14 +121,79 @@ void Renderer::beginRenderPass(RenderPass::PassType pass)
 		case RenderPass::POST: beginInfo.framebuffer = m_postFramebuffers[m_imageIndex].get(); break;
 	}
 
-	vkCmdBeginRenderPass(m_commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	// Timestamps are written outside of the pass, which may only execute secondary command buffers
+	m_passScope = beginScope(pass == RenderPass::MAIN ? "Raster" : "Post Pass");
 
-	m_passIndex = pass;
+	vkCmdBeginRenderPass(m_commandBuffer, &beginInfo, parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+	m_passIndex    = pass;
+	m_framebuffer  = beginInfo.framebuffer;
+	m_parallelPass = parallel;
 }
 
 void Renderer::endRenderPass()
 {
 	vkCmdEndRenderPass(m_commandBuffer);
+	endScope(m_passScope);
+
+	m_parallelPass = false;
+}
+
+void Renderer::recordParallel(uint32_t itemCount, const std::function<void(Renderer& renderer, uint32_t first, uint32_t count)>& record)
+{
+	if (!m_parallelPass)
+	{
+		APP_LOG_CRITICAL("Parallel recording outside of a parallel render pass");
+		throw std::exception();
+	}
+
+	if (itemCount == 0)
+		return;
+
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass  = m_renderPasses[m_passIndex].renderPass;
+	inheritance.subpass     = 0;
+	inheritance.framebuffer = m_framebuffer;
+
+	// A few ranges per thread balance uneven items without recording a secondary per item
+	uint32_t threadCount = m_jobSystem ? m_jobSystem->getThreadCount() : 1;
+	uint32_t rangeCount  = std::min(itemCount, threadCount * 2);
+	uint32_t rangeSize   = (itemCount + rangeCount - 1) / rangeCount;
+	rangeCount           = (itemCount + rangeSize - 1) / rangeSize;
+
+	std::vector<VkCommandBuffer> secondaries(rangeCount);
+
+	auto job = [&](uint32_t range, uint32_t thread) {
+		Renderer recorder        = *this;
+		recorder.m_commandBuffer = m_commandSystem->beginSecondary(m_frameIndex, thread, inheritance);
+		recorder.m_parallelPass  = false;
+		recorder.m_gpuProfiler   = nullptr; // The profiler is not thread safe
+
+		// Dynamic states are not inherited by secondary command buffers
+		recorder.setDynamicStates();
+
+		uint32_t first = range * rangeSize;
+		record(recorder, first, std::min(rangeSize, itemCount - first));
+
+		if (vkEndCommandBuffer(recorder.m_commandBuffer) != VK_SUCCESS)
+		{
+			APP_LOG_CRITICAL("Failed to record secondary command buffer");
+			throw std::exception();
+		}
+
+		secondaries[range] = recorder.m_commandBuffer;
+	};
+
+	if (m_jobSystem)
+		m_jobSystem->run(rangeCount, job);
+	else
+	{
+		for (uint32_t i = 0; i < rangeCount; i++)
+			job(i, 0);
+	}
+
+	vkCmdExecuteCommands(m_commandBuffer, rangeCount, secondaries.data());
 }
 
 void Renderer::bindPipeline(Pipeline::PipelineType pipeline)
@@ -227,9 +334,9 @@ void Renderer::drawVertex()
 		vkCmdDraw(m_commandBuffer, m_vertexBuffer.getCount(), 1, 0, 0);
 }
 
-void Renderer::drawIndexed()
+void Renderer::drawIndexed(uint32_t indexCount, uint32_t firstIndex)
 {
-	vkCmdDrawIndexed(m_commandBuffer, m_indexBuffer.getCount(), 1, 0, 0, 0);
+	vkCmdDrawIndexed(m_commandBuffer, indexCount, 1, firstIndex, 0, 0);
 }
 
 void Renderer::drawUI()
@@ -237,7 +344,9 @@ void Renderer::drawUI()
 	if (!m_showUI)
 		return;
 
+	uint32_t scope = beginScope("UI");
 	m_gui->renderUI(m_commandBuffer);
+	endScope(scope);
 }
 
 void Renderer::traceRays()
@@ -262,6 +371,7 @@ void Renderer::traceRays()
 	}
 	auto& regions = sbt->getRegions();
 
+	uint32_t scope = beginScope("Trace");
 	vkCmdTraceRaysKHR(
 		m_commandBuffer,
 		&regions[ShaderBindingTable::RGEN],
@@ -269,10 +379,15 @@ void Renderer::traceRays()
 		&regions[ShaderBindingTable::HIT],
 		&regions[ShaderBindingTable::CALL],
 		m_windowWidth, m_windowHeight, 1);
+	endScope(scope);
 }
 
 void Renderer::setDynamicStates()
 {
+	// Only secondary command buffers can record inside of a parallel pass, they set their own states
+	if (m_parallelPass)
+		return;
+
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
@@ -288,6 +403,47 @@ void Renderer::setDynamicStates()
 	vkCmdSetScissor(m_commandBuffer, 0, 1, &scissor);
 }
 
+bool Renderer::isBoxVisible(const glm::vec3& minBounds, const glm::vec3& maxBounds, const glm::mat4& transform) const
+{
+	// Transform the corners of the box into clip space and reject the box only if every corner is outside
+	// of the same frustum plane. This is conservative, so some boxes that are not visible will pass
+	glm::mat4 mvp = ubo.viewProjection * transform;
+
+	uint32_t outside[6] = { 0, 0, 0, 0, 0, 0 };
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		glm::vec3 corner = {
+			(i & 1) ? maxBounds.x : minBounds.x,
+			(i & 2) ? maxBounds.y : minBounds.y,
+			(i & 4) ? maxBounds.z : minBounds.z
+		};
+		glm::vec4 clip = mvp * glm::vec4(corner, 1.0f);
+
+		outside[0] += (clip.x < -clip.w);
+		outside[1] += (clip.x >  clip.w);
+		outside[2] += (clip.y < -clip.w);
+		outside[3] += (clip.y >  clip.w);
+		outside[4] += (clip.z <  0.0f);
+		outside[5] += (clip.z >  clip.w);
+	}
+
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		if (outside[i] == 8)
+			return false;
+	}
+
+	return true;
+}
+
+float Renderer::getProjectedScale(const glm::vec3& center, float radius) const
+{
+	float distance = std::max(glm::length(center - ubo.viewPosition) - radius, 0.001f);
+	float focal    = m_windowHeight / (2.0f * std::tan(glm::radians(m_camera->getFov()) * 0.5f));
+
+	return focal / distance;
+}
+
 void Renderer::onKeyPress(KeyPressEvent event)
 {
 	if (event.key == GLFW_KEY_U)
@@ -296,6 +452,8 @@ void Renderer::onKeyPress(KeyPressEvent event)
 
 void Renderer::updateUI()
 {
+	APP_PROFILE_FUNCTION();
+
 	if (!m_showUI)
 		return;
 
@@ -355,3 +513,19 @@ void Renderer::resetRtxFrame()
 {
 	rtxPushConstants.frame = -1;
 }
+
+uint32_t Renderer::beginScope(const char* name)
+{
+	if (!m_gpuProfiler)
+		return GpuProfiler::INVALID_SCOPE;
+
+	return m_gpuProfiler->beginScope(m_commandBuffer, name);
+}
+
+void Renderer::endScope(uint32_t& scope)
+{
+	if (m_gpuProfiler)
+		m_gpuProfiler->endScope(m_commandBuffer, scope);
+
+	scope = GpuProfiler::INVALID_SCOPE;
+}
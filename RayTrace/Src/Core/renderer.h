@@ -14,6 +14,13 @@
 #include "rendering_structures.h"
 #include "descriptor.h"
 #include "framebuffer.h"
+#include "texture_streamer.h"
+#include "post_processor.h"
+#include "job_system.h"
+#include "gpu_profiler.h"
+#include "texture.h"
+
+#include <functional>
 
 
 class Renderer
@@ -33,6 +40,14 @@ public:
 		Camera*        pCamera                  = nullptr;
 		Gui*           pGui                     = nullptr;
 
+		TextureStreamer* pTextureStreamer = nullptr; // Optional
+		JobSystem*       pJobSystem       = nullptr; // Optional, parallel recording runs on the calling thread without it
+		GpuProfiler*     pGpuProfiler     = nullptr; // Optional
+
+		// Post processing on the compute queue. The command system needs two buffers per frame in flight
+		PostProcessor* pPostProcessor    = nullptr;
+		Texture*       pOffscreenTexture = nullptr;
+
 		ShaderBindingTable* pRtSBT   = nullptr;
 		ShaderBindingTable* pPathSBT = nullptr;
 
@@ -69,16 +84,43 @@ public:
 		  m_offScreenFramebuffer   (info.pOffscreenFramebuffer),
 		  m_rtSBT                  (info.pRtSBT),
 		  m_pathSBT(info.pPathSBT),
+		  m_textureStreamer        (info.pTextureStreamer),
+		  m_jobSystem              (info.pJobSystem),
+		  m_gpuProfiler            (info.pGpuProfiler),
+		  m_postProcessor          (info.pPostProcessor),
+		  m_offscreenTexture       (info.pOffscreenTexture),
 		  m_useRtx                 (info.enableRtx)
 	{}
 
 	void beginFrame();
+
+	/**
+	 * Submit the scene and post process it on the compute queue. The post pass that follows draws the result.
+	 */
+	void postProcess();
+
 	void submit();
 	void endFrame();
 
-	void beginRenderPass(RenderPass::PassType pass);
+	/**
+	 * @param pass: The render pass.
+	 * @param parallel: True if the draws of the pass are recorded with recordParallel(). Nothing else can be
+	 * recorded inside of such a pass.
+	 */
+	void beginRenderPass(RenderPass::PassType pass, bool parallel = false);
 	void endRenderPass();
 
+	/**
+	 * Record draws of the current parallel render pass on the job system. The items are split into contiguous
+	 * ranges and every range is recorded into its own secondary command buffer through a copy of the renderer, so
+	 * the bound state and push constants of a range are not shared with the others. The dynamic states are
+	 * already set in every range, but pipelines and descriptor sets must be bound by the range itself.
+	 *
+	 * @param itemCount: Number of items to draw, like the objects of a scene.
+	 * @param record: Records the items first to first + count - 1. It must not draw the UI.
+	 */
+	void recordParallel(uint32_t itemCount, const std::function<void(Renderer& renderer, uint32_t first, uint32_t count)>& record);
+
 	void bindPipeline(Pipeline::PipelineType pipeline);
 	void bindVertexBuffer(Buffer& vertexBuffer);
 	void bindIndexBuffer(Buffer& indexBuffer);
@@ -90,7 +132,7 @@ public:
 	void bindRtxPushConstants();
 
 	void drawVertex();
-	void drawIndexed();
+	void drawIndexed(uint32_t indexCount, uint32_t firstIndex);
 	void drawUI();
 
 	void traceRays();
@@ -98,8 +140,14 @@ public:
 	void setDynamicStates();
 
 	bool isRtxEnabled() const { return m_useRtx; }
+	bool isBoxVisible(const glm::vec3& minBounds, const glm::vec3& maxBounds, const glm::mat4& transform) const;
+
+	// Number of pixels that one world unit covers at the closest point of a sphere
+	float getProjectedScale(const glm::vec3& center, float radius) const;
+	float getLodThreshold() const { return m_ui.lodThreshold; }
 
 	void onWindowResize(WindowResizeEvent event) { resetRtxFrame(); }
+	void onShadersReloaded() { resetRtxFrame(); }
 	void onKeyPress(KeyPressEvent event);
 
 private:
@@ -136,6 +184,21 @@ private:
 	ShaderBindingTable* m_rtSBT   = nullptr;
 	ShaderBindingTable* m_pathSBT = nullptr;
 
+	TextureStreamer* m_textureStreamer = nullptr;
+	JobSystem*       m_jobSystem       = nullptr;
+	GpuProfiler*     m_gpuProfiler     = nullptr;
+
+	// GPU scopes of the frame and of the current render pass
+	uint32_t m_frameScope = GpuProfiler::INVALID_SCOPE;
+	uint32_t m_passScope  = GpuProfiler::INVALID_SCOPE;
+
+	VkFramebuffer m_framebuffer  = VK_NULL_HANDLE; // Framebuffer of the current render pass
+	bool          m_parallelPass = false;
+
+	PostProcessor* m_postProcessor    = nullptr;
+	Texture*       m_offscreenTexture = nullptr;
+	VkSemaphore    m_postSemaphore    = VK_NULL_HANDLE; // Signaled once the post output of the frame is written
+
 	bool m_useRtx = false;
 
 	glm::mat4 m_currentCameraView = glm::mat4(1.0f);
@@ -147,4 +210,7 @@ private:
 
 	void updateRtxFrame();
 	void resetRtxFrame();
+
+	uint32_t beginScope(const char* name);
+	void endScope(uint32_t& scope);
 };
@@ -6,8 +6,10 @@ struct MeshPushConstants
 {
 	// Sorted by alignment
 	glm::mat4 model       = glm::mat4(1.0f);
-	glm::vec3 objectColor = { 0.5f, 0.5f, 0.5f };
-	int32_t   objectID    = 0;
+	glm::vec3 objectColor     = { 0.5f, 0.5f, 0.5f };
+	int32_t   objectID        = 0;
+	int32_t   primitiveOffset = 0;
+	int32_t   materialID      = -1; // Scene material of the whole draw, -1 to read the material index buffer
 };
 
 struct PostPushConstants
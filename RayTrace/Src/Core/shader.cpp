@@ -19,7 +19,16 @@ void ShaderSet::addShader(ShaderStage type, const char* filepath, uint32_t hitGr
 
 	std::vector<char> m_code = readFile(filepath);
 
-	VkShaderModule module = createShaderModule(m_code);
+	addStage(type, createShaderModule(reinterpret_cast<const uint32_t*>(m_code.data()), m_code.size()), hitGroup);
+}
+
+void ShaderSet::addShader(ShaderStage type, const std::vector<uint32_t>& code, uint32_t hitGroup)
+{
+	addStage(type, createShaderModule(code.data(), code.size() * sizeof(uint32_t)), hitGroup);
+}
+
+void ShaderSet::addStage(ShaderStage type, VkShaderModule module, uint32_t hitGroup)
+{
 	m_modules.emplace_back(module);
 
 	VkPipelineShaderStageCreateInfo stage{};
@@ -27,6 +36,9 @@ void ShaderSet::addShader(ShaderStage type, const char* filepath, uint32_t hitGr
 	stage.module = module;
 	stage.pName  = "main";
 
+	if (!m_constantEntries.empty())
+		stage.pSpecializationInfo = &m_specialization;
+
 	switch (type)
 	{
 		case ShaderStage::VERT: 
@@ -60,11 +72,59 @@ void ShaderSet::addShader(ShaderStage type, const char* filepath, uint32_t hitGr
 			m_stageCount[(size_t)ShaderStage::AHIT]++;
 			m_hitGroups[hitGroup].ahitIndex = static_cast<uint32_t>(m_shaderStages.size());
 			break;
+
+		case ShaderStage::COMP:
+			stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			m_stageCount[(size_t)ShaderStage::COMP]++;
+			break;
 	}
 
 	m_shaderStages.emplace_back(stage);
 }
 
+void ShaderSet::setConstant(SpecConstant id, int32_t value)
+{
+	uint32_t data = 0;
+	std::memcpy(&data, &value, sizeof(data));
+	addConstant(id, data);
+}
+
+void ShaderSet::setConstant(SpecConstant id, float value)
+{
+	uint32_t data = 0;
+	std::memcpy(&data, &value, sizeof(data));
+	addConstant(id, data);
+}
+
+void ShaderSet::addConstant(SpecConstant id, uint32_t data)
+{
+	// A constant that is set again keeps its entry
+	for (const auto& entry : m_constantEntries)
+	{
+		if (entry.constantID == static_cast<uint32_t>(id))
+		{
+			m_constantData[entry.offset / sizeof(uint32_t)] = data;
+			return;
+		}
+	}
+
+	VkSpecializationMapEntry entry{};
+	entry.constantID = static_cast<uint32_t>(id);
+	entry.offset     = static_cast<uint32_t>(m_constantData.size() * sizeof(uint32_t));
+	entry.size       = sizeof(uint32_t);
+
+	m_constantEntries.emplace_back(entry);
+	m_constantData.emplace_back(data);
+
+	m_specialization.mapEntryCount = static_cast<uint32_t>(m_constantEntries.size());
+	m_specialization.pMapEntries   = m_constantEntries.data();
+	m_specialization.dataSize      = m_constantData.size() * sizeof(uint32_t);
+	m_specialization.pData         = m_constantData.data();
+
+	for (auto& stage : m_shaderStages)
+		stage.pSpecializationInfo = &m_specialization;
+}
+
 void ShaderSet::setupRtxShaderGroup()
 {
 	// Ray gen and miss groups
@@ -108,13 +168,13 @@ void ShaderSet::cleanup()
 		vkDestroyShaderModule(m_device->getLogical(), module, nullptr);
 }
 
-VkShaderModule ShaderSet::createShaderModule(const std::vector<char>& code)
+VkShaderModule ShaderSet::createShaderModule(const uint32_t* code, size_t size)
 {
 	// Create shader module
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode    = reinterpret_cast<const uint32_t*>(code.data());
+	createInfo.codeSize = size;
+	createInfo.pCode    = code;
 
 	VkShaderModule shaderModule;
 	if (vkCreateShaderModule(m_device->getLogical(), &createInfo, nullptr, &shaderModule))
@@ -18,9 +18,23 @@ enum class ShaderStage
 	MISS,
 	CHIT,
 	AHIT,
+	COMP,
 	ENUM_MAX
 };
 
+/*****************************************************************************************************************
+ *
+ * Ids of the specialization constants that the shaders declare in structures.glsl.
+ *
+ */
+enum class SpecConstant
+{
+	DEBUG_MODE = 0,
+	SAMPLE_COUNT,
+	MAX_DEPTH,
+	REFLECTIONS
+};
+
 /*****************************************************************************************************************
  *
  * @class Shader Set
@@ -37,6 +51,25 @@ public:
 
 	void addShader(ShaderStage type, const char* filepath, uint32_t hitGroup = 0);
 
+	/**
+	 * Add a shader from SPIR-V that is already in memory, like the output of the ShaderCompiler.
+	 *
+	 * @param type: The stage of the shader.
+	 * @param code: The SPIR-V words.
+	 * @param hitGroup: Hit group of closest and any hit shaders.
+	 */
+	void addShader(ShaderStage type, const std::vector<uint32_t>& code, uint32_t hitGroup = 0);
+
+	/**
+	 * Specialize a constant in every stage of the set. Stages that do not declare the constant ignore it. The
+	 * stages point into the set, so it must not be copied once a constant was set.
+	 *
+	 * @param id: The constant.
+	 * @param value: The value, 0 or 1 for bool constants.
+	 */
+	void setConstant(SpecConstant id, int32_t value);
+	void setConstant(SpecConstant id, float value);
+
 	void setupRtxShaderGroup();
 
 	VkPipelineShaderStageCreateInfo* getStages() { return m_shaderStages.data(); }
@@ -64,7 +97,15 @@ private:
 
 	std::array<uint32_t, (size_t)ShaderStage::ENUM_MAX> m_stageCount{ 0 };
 
-	VkShaderModule createShaderModule(const std::vector<char>& code);
+	// Specialization constants of all stages. Every constant is one 32 bit word of the data
+	std::vector<VkSpecializationMapEntry> m_constantEntries;
+	std::vector<uint32_t>                 m_constantData;
+	VkSpecializationInfo                  m_specialization{};
+
+	void addStage(ShaderStage type, VkShaderModule module, uint32_t hitGroup);
+	void addConstant(SpecConstant id, uint32_t data);
+
+	VkShaderModule createShaderModule(const uint32_t* code, size_t size);
 	std::vector<char> readFile(const std::string& filename);
 };
 
@@ -0,0 +1,460 @@
+#include "pch.h"
+#include "shader_compiler.h"
+#include "utilities.h"
+
+#include "Application/cpu_profiler.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <set>
+#include <algorithm>
+
+namespace
+{
+	// Resolves includes from the source directory and keeps the content of every file that was included
+	class Includer : public shaderc::CompileOptions::IncluderInterface
+	{
+	public:
+		Includer(const std::filesystem::path& directory, std::vector<std::pair<std::string, std::string>>& files)
+			: m_directory(directory), m_files(files) {}
+
+		shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+		{
+			auto* include = new Include();
+
+			std::ifstream file(m_directory / requestedSource, std::ios::binary);
+			if (file.is_open())
+			{
+				include->name    = requestedSource;
+				include->content = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+				bool known = false;
+				for (const auto& [name, content] : m_files)
+					known |= (name == include->name);
+				if (!known)
+					m_files.emplace_back(include->name, include->content);
+			}
+			else
+			{
+				// An empty name tells shaderc that the include failed, and the content is the error
+				include->content = "Failed to open include " + std::string(requestedSource);
+			}
+
+			include->result.source_name        = include->name.c_str();
+			include->result.source_name_length = include->name.size();
+			include->result.content            = include->content.c_str();
+			include->result.content_length     = include->content.size();
+			include->result.user_data          = include;
+
+			return &include->result;
+		}
+
+		void ReleaseInclude(shaderc_include_result* data) override
+		{
+			delete static_cast<Include*>(data->user_data);
+		}
+
+	private:
+		struct Include
+		{
+			shaderc_include_result result{};
+			std::string            name;
+			std::string            content;
+		};
+
+		std::filesystem::path                             m_directory;
+		std::vector<std::pair<std::string, std::string>>& m_files;
+	};
+
+	bool getShaderKind(const std::string& name, shaderc_shader_kind& kind)
+	{
+		std::string extension = std::filesystem::path(name).extension().string();
+
+		if      (extension == ".vert")  kind = shaderc_vertex_shader;
+		else if (extension == ".frag")  kind = shaderc_fragment_shader;
+		else if (extension == ".comp")  kind = shaderc_compute_shader;
+		else if (extension == ".rgen")  kind = shaderc_raygen_shader;
+		else if (extension == ".rmiss") kind = shaderc_miss_shader;
+		else if (extension == ".rchit") kind = shaderc_closesthit_shader;
+		else if (extension == ".rahit") kind = shaderc_anyhit_shader;
+		else
+			return false;
+
+		return true;
+	}
+}
+
+void ShaderCompiler::init(CreateInfo& info)
+{
+	APP_LOG_INFO("Initializing shader compiler");
+
+	m_sourceDirectory = info.sourceDirectory;
+	m_binaryDirectory = info.binaryDirectory;
+	m_cacheDirectory  = info.cacheDirectory;
+	m_pollInterval    = info.pollInterval;
+	m_defines         = info.defines;
+
+	std::error_code error;
+	std::filesystem::create_directories(m_cacheDirectory, error);
+
+	if (info.watch && std::filesystem::is_directory(m_sourceDirectory, error))
+	{
+		m_running = true;
+		m_thread  = std::thread(&ShaderCompiler::watchThread, this);
+	}
+}
+
+std::vector<uint32_t> ShaderCompiler::load(const std::string& name)
+{
+	std::string source;
+	if (!readSource(name, source))
+	{
+		APP_LOG_WARN("Shader source {} not found, using the offline compiled shader", name);
+		return loadBinary(name);
+	}
+
+	uint64_t              sourceHash = hashSource(source);
+	std::vector<uint32_t> code;
+	std::vector<Include>  includes;
+
+	if (readCache(name, sourceHash, code, includes))
+	{
+		APP_LOG_INFO("Loaded shader {} from the cache", name);
+	}
+	else if (compile(name, source, code, includes))
+	{
+		APP_LOG_INFO("Compiled shader {}", name);
+		writeCache(name, sourceHash, code, includes);
+	}
+	else
+	{
+		// Still watch the shader, so fixing the source brings it back
+		track(name, includes);
+		return loadBinary(name);
+	}
+
+	track(name, includes);
+	return code;
+}
+
+std::vector<std::string> ShaderCompiler::takeChangedShaders()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<std::string> changed;
+	changed.swap(m_changed);
+	return changed;
+}
+
+void ShaderCompiler::cleanup()
+{
+	APP_LOG_INFO("Destroying shader compiler");
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_condition.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+bool ShaderCompiler::compile(const std::string& name, const std::string& source, std::vector<uint32_t>& code, std::vector<Include>& includes) const
+{
+	APP_PROFILE_FUNCTION();
+
+	shaderc_shader_kind kind;
+	if (!getShaderKind(name, kind))
+	{
+		APP_LOG_ERROR("Unknown shader stage of {}", name);
+		return false;
+	}
+
+	std::vector<std::pair<std::string, std::string>> files;
+
+	// Same target as Scripts/compile_shaders.py
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+	options.SetIncluder(std::make_unique<Includer>(m_sourceDirectory, files));
+	for (const auto& define : m_defines)
+		options.AddMacroDefinition(define);
+
+	// The compiler is cheap to create, and one per call keeps compiles on different threads apart
+	shaderc::Compiler             compiler;
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, kind, name.c_str(), options);
+
+	includes.clear();
+	for (const auto& [file, content] : files)
+		includes.push_back({ file, hashBytes(content.data(), content.size()) });
+
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		APP_LOG_ERROR("Failed to compile shader {}\n{}", name, result.GetErrorMessage());
+		return false;
+	}
+
+	if (result.GetNumWarnings() > 0)
+		APP_LOG_WARN("Shader {} compiled with warnings\n{}", name, result.GetErrorMessage());
+
+	code.assign(result.cbegin(), result.cend());
+	return true;
+}
+
+bool ShaderCompiler::readCache(const std::string& name, uint64_t sourceHash, std::vector<uint32_t>& code, std::vector<Include>& includes) const
+{
+	std::ifstream file(m_cacheDirectory / (name + ".cache"), std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	// Sizes in a damaged file must not be trusted beyond the size of the file
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	file.seekg(0);
+
+	auto read = [&](auto& value) {
+		file.read(reinterpret_cast<char*>(&value), sizeof(value));
+	};
+
+	uint32_t magic      = 0;
+	uint32_t version    = 0;
+	uint64_t cachedHash = 0;
+	read(magic);
+	read(version);
+	read(cachedHash);
+
+	if (!file.good() || magic != CACHE_MAGIC || version != CACHE_VERSION || cachedHash != sourceHash)
+		return false;
+
+	uint32_t includeCount = 0;
+	read(includeCount);
+
+	includes.clear();
+	for (uint32_t i = 0; i < includeCount && file.good(); i++)
+	{
+		uint32_t nameLength = 0;
+		read(nameLength);
+		if (nameLength > fileSize)
+			return false;
+
+		Include include;
+		include.name.resize(nameLength);
+		file.read(include.name.data(), nameLength);
+		read(include.hash);
+
+		includes.push_back(include);
+	}
+
+	uint32_t wordCount = 0;
+	read(wordCount);
+	if (!file.good() || wordCount > fileSize / sizeof(uint32_t))
+		return false;
+
+	code.resize(wordCount);
+	file.read(reinterpret_cast<char*>(code.data()), wordCount * sizeof(uint32_t));
+
+	if (!file.good() || code.empty())
+		return false;
+
+	// The cached code is stale if any include changed since
+	for (const auto& include : includes)
+	{
+		std::string content;
+		if (!readSource(include.name, content) || hashBytes(content.data(), content.size()) != include.hash)
+			return false;
+	}
+
+	return true;
+}
+
+void ShaderCompiler::writeCache(const std::string& name, uint64_t sourceHash, const std::vector<uint32_t>& code, const std::vector<Include>& includes) const
+{
+	// Replace the old entry only once the new one is complete. The temporary file is per thread, since a shader
+	// can be compiled on the watcher thread while the pipelines load it
+	std::filesystem::path path     = m_cacheDirectory / (name + ".cache");
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			APP_LOG_ERROR("Failed to open shader cache {}", tempPath.string());
+			return;
+		}
+
+		auto write = [&](const auto& value) {
+			file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		};
+
+		write(CACHE_MAGIC);
+		write(CACHE_VERSION);
+		write(sourceHash);
+
+		write(static_cast<uint32_t>(includes.size()));
+		for (const auto& include : includes)
+		{
+			write(static_cast<uint32_t>(include.name.size()));
+			file.write(include.name.data(), include.name.size());
+			write(include.hash);
+		}
+
+		write(static_cast<uint32_t>(code.size()));
+		file.write(reinterpret_cast<const char*>(code.data()), code.size() * sizeof(uint32_t));
+
+		if (!file.good())
+		{
+			APP_LOG_ERROR("Failed to write shader cache {}", tempPath.string());
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		APP_LOG_ERROR("Failed to replace shader cache {}: {}", path.string(), error.message());
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+std::vector<uint32_t> ShaderCompiler::loadBinary(const std::string& name) const
+{
+	// "rtx_path.rchit" was compiled offline to "rtx_path_rchit.spv", and with NO_FRAGMENT_STORES defined to
+	// "rtx_path_rchit_no_fragment_stores.spv". A shader that was compiled without the defines could be invalid
+	// on this device, so a missing variant is an error
+	std::filesystem::path source = name;
+	std::string           binary = source.stem().string() + "_" + source.extension().string().substr(1);
+
+	for (const auto& define : m_defines)
+	{
+		binary += "_";
+		for (char c : define)
+			binary += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	binary += ".spv";
+
+	std::ifstream file(m_binaryDirectory / binary, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+	{
+		APP_LOG_CRITICAL("Failed to open file {}", (m_binaryDirectory / binary).string());
+		throw std::exception();
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<uint32_t> code(fileSize / sizeof(uint32_t));
+
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(code.data()), code.size() * sizeof(uint32_t));
+
+	return code;
+}
+
+void ShaderCompiler::track(const std::string& name, const std::vector<Include>& includes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<std::string>& dependencies = m_dependencies[name];
+	dependencies.clear();
+
+	for (const auto& include : includes)
+		dependencies.push_back(include.name);
+
+	// Changes from here on are picked up by the watcher
+	std::error_code error;
+	m_writeTimes[name] = std::filesystem::last_write_time(m_sourceDirectory / name, error);
+	for (const auto& include : includes)
+		m_writeTimes[include.name] = std::filesystem::last_write_time(m_sourceDirectory / include.name, error);
+}
+
+void ShaderCompiler::watchThread()
+{
+	APP_PROFILE_THREAD("Shader Watcher");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_running)
+	{
+		m_condition.wait_for(lock, std::chrono::milliseconds(m_pollInterval), [this]() { return !m_running; });
+		if (!m_running)
+			break;
+
+		// Find the sources and includes that were written since they were last compiled
+		std::set<std::string> changedFiles;
+		for (auto& [file, writeTime] : m_writeTimes)
+		{
+			std::error_code error;
+			auto            current = std::filesystem::last_write_time(m_sourceDirectory / file, error);
+			if (!error && current != writeTime)
+			{
+				writeTime = current;
+				changedFiles.insert(file);
+			}
+		}
+
+		if (changedFiles.empty())
+			continue;
+
+		std::vector<std::string> shaders;
+		for (const auto& [shader, dependencies] : m_dependencies)
+		{
+			bool changed = changedFiles.count(shader) > 0;
+			for (const auto& dependency : dependencies)
+				changed |= changedFiles.count(dependency) > 0;
+
+			if (changed)
+				shaders.push_back(shader);
+		}
+
+		// Compile without the lock, so loads on other threads are not blocked
+		lock.unlock();
+
+		for (const auto& shader : shaders)
+		{
+			std::string           source;
+			std::vector<uint32_t> code;
+			std::vector<Include>  includes;
+
+			if (!readSource(shader, source))
+				continue;
+
+			// Shaders with errors keep their last pipeline until they compile again
+			bool compiled = compile(shader, source, code, includes);
+			if (compiled)
+			{
+				APP_LOG_INFO("Recompiled shader {}", shader);
+				writeCache(shader, hashSource(source), code, includes);
+			}
+
+			track(shader, includes);
+
+			if (compiled)
+			{
+				std::lock_guard<std::mutex> changedLock(m_mutex);
+				if (std::find(m_changed.begin(), m_changed.end(), shader) == m_changed.end())
+					m_changed.push_back(shader);
+			}
+		}
+
+		lock.lock();
+	}
+}
+
+bool ShaderCompiler::readSource(const std::string& name, std::string& source) const
+{
+	std::ifstream file(m_sourceDirectory / name, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+uint64_t ShaderCompiler::hashSource(const std::string& source) const
+{
+	// The same source compiles to different code under other defines
+	std::string key;
+	for (const auto& define : m_defines)
+		key += define + "\n";
+
+	key += source;
+	return hashBytes(key.data(), key.size());
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Application/logging.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <filesystem>
+
+/*****************************************************************************************************************
+ *
+ * @class ShaderCompiler
+ *
+ * Compiles GLSL shaders to SPIR-V at runtime with shaderc. The SPIR-V of every shader is cached on disk together
+ * with the hash of its source and of every file it includes, so a shader is only compiled again when one of them
+ * changed. Shaders whose source can not be found or compiled at startup fall back to the SPIR-V that was compiled
+ * offline by Scripts/compile_shaders.py. The defines of the create info are part of the cache key, and the
+ * fallback uses the offline variant that was compiled with the same defines. Loading fails if there is none.
+ *
+ * When watching is enabled, a background thread polls the source directory. Shaders whose source or includes
+ * changed are compiled again on that thread, and the ones that compiled without errors are reported by
+ * takeChangedShaders(), so the pipelines that use them can be rebuilt without restarting.
+ *
+ * load() and takeChangedShaders() are thread safe. The creator of the compiler is responsible for calling its
+ * cleanup().
+ *
+ * Example Usage:
+ *     ShaderCompiler::CreateInfo info{};
+ *     compiler.init(info);
+ *
+ *     ShaderSet shaders(device, 1);
+ *     shaders.addShader(ShaderStage::RGEN, compiler.load("rtx_path.rgen"));
+ *
+ *     for (const auto& name : compiler.takeChangedShaders())
+ *         ...
+ *
+ *     compiler.cleanup();
+ *
+ */
+class ShaderCompiler
+{
+public:
+	struct CreateInfo
+	{
+		std::string sourceDirectory = "../../../RayTrace/Src/Shaders";
+		std::string binaryDirectory = "../../Shaders";       // Shaders that were compiled offline
+		std::string cacheDirectory  = "../../Shaders/Cache";
+		bool        watch           = true;                  // Compile changed sources in the background
+		uint32_t    pollInterval    = 500;                   // Milliseconds between checks of the sources
+
+		std::vector<std::string> defines; // Macros that are defined in every shader
+	};
+
+	ShaderCompiler() = default;
+
+	void init(CreateInfo& info);
+
+	/**
+	 * Get the SPIR-V of a shader. It is taken from the cache when the source and its includes did not change,
+	 * and compiled otherwise.
+	 *
+	 * @param name: File name of the source in the source directory, like "rtx_path.rchit".
+	 *
+	 * @return The SPIR-V of the shader.
+	 */
+	std::vector<uint32_t> load(const std::string& name);
+
+	/**
+	 * @return The shaders that were compiled again since the last call, because their source or one of their
+	 * includes changed.
+	 */
+	std::vector<std::string> takeChangedShaders();
+
+	void cleanup();
+
+private:
+	struct Include
+	{
+		std::string name;
+		uint64_t    hash = 0;
+	};
+
+	static constexpr uint32_t CACHE_MAGIC   = 0x43535452; // "RTSC"
+	static constexpr uint32_t CACHE_VERSION = 1;
+
+	std::filesystem::path m_sourceDirectory;
+	std::filesystem::path m_binaryDirectory;
+	std::filesystem::path m_cacheDirectory;
+	uint32_t              m_pollInterval = 500;
+
+	std::vector<std::string> m_defines;
+
+	// Guards everything below
+	std::mutex m_mutex;
+
+	std::unordered_map<std::string, std::vector<std::string>>               m_dependencies; // Includes of every loaded shader
+	std::unordered_map<std::string, std::filesystem::file_time_type>        m_writeTimes;   // Of every source and include
+	std::vector<std::string>                                                m_changed;
+
+	std::thread             m_thread;
+	std::condition_variable m_condition;
+	bool                    m_running = false;
+
+	bool compile(const std::string& name, const std::string& source, std::vector<uint32_t>& code, std::vector<Include>& includes) const;
+
+	bool readCache(const std::string& name, uint64_t sourceHash, std::vector<uint32_t>& code, std::vector<Include>& includes) const;
+	void writeCache(const std::string& name, uint64_t sourceHash, const std::vector<uint32_t>& code, const std::vector<Include>& includes) const;
+
+	std::vector<uint32_t> loadBinary(const std::string& name) const;
+
+	void track(const std::string& name, const std::vector<Include>& includes);
+
+	void watchThread();
+
+	bool readSource(const std::string& name, std::string& source) const;
+	uint64_t hashSource(const std::string& source) const;
+};
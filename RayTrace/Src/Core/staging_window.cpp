@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "staging_window.h"
+
+#include "buffer.h"
+
+StagingWindow StagingWindow::Create(CreateInfo& info)
+{
+	APP_LOG_TRACE("Creating staging window ({}, {} bytes)", info.name, info.size);
+
+	StagingWindow window;
+	window.m_device        = info.device;
+	window.m_commandSystem = info.commandSystem;
+	window.m_name          = info.name;
+	window.m_halfSize      = std::max<VkDeviceSize>(info.size / 2, 1);
+
+	Buffer::CreateBuffer(
+		window.m_halfSize * 2,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		window.m_buffer, window.m_memory,
+		*info.device,
+		MemoryCategory::STAGING,
+		info.name);
+
+	window.m_map = static_cast<uint8_t*>(window.m_memory.map);
+
+	for (uint32_t i = 0; i < 2; i++)
+		window.m_halves[i].offset = i * window.m_halfSize;
+
+	return window;
+}
+
+void StagingWindow::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+
+	while (size > 0)
+	{
+		Half& half = m_halves[m_current];
+
+		// Hand the full half to the GPU and continue in the other one once its previous copies are done
+		if (half.used == m_halfSize)
+		{
+			submit(m_current);
+			m_current = 1 - m_current;
+			wait(m_current);
+			continue;
+		}
+
+		VkDeviceSize count = std::min(m_halfSize - half.used, size);
+		memcpy(m_map + half.offset + half.used, src, static_cast<size_t>(count));
+
+		VkBufferCopy region{};
+		region.srcOffset = half.offset + half.used;
+		region.dstOffset = dstOffset;
+		region.size      = count;
+		half.copies.emplace_back(dstBuffer, region);
+
+		half.used += count;
+		src       += count;
+		dstOffset += count;
+		size      -= count;
+	}
+}
+
+void StagingWindow::flush()
+{
+	submit(m_current);
+	wait(0);
+	wait(1);
+}
+
+void StagingWindow::cleanup()
+{
+	if (m_buffer == VK_NULL_HANDLE)
+		return;
+
+	flush();
+
+	Buffer::DestroyBuffer(m_buffer, m_memory, *m_device);
+
+	m_buffer = VK_NULL_HANDLE;
+}
+
+void StagingWindow::submit(uint32_t index)
+{
+	Half& half = m_halves[index];
+	if (half.pending || half.copies.empty())
+		return;
+
+	half.cmdBuf = m_commandSystem->beginSingleTimeCommands();
+
+	for (const auto& [dstBuffer, region] : half.copies)
+		vkCmdCopyBuffer(half.cmdBuf, m_buffer, dstBuffer, 1, &region);
+
+	half.value   = m_commandSystem->submitSingleTimeCommands(half.cmdBuf, m_device->getGraphicsQueue());
+	half.pending = true;
+}
+
+void StagingWindow::wait(uint32_t index)
+{
+	Half& half = m_halves[index];
+	if (half.pending)
+	{
+		m_device->getGraphicsTimeline().wait(half.value);
+
+		m_commandSystem->freeSingleTimeCommands(half.cmdBuf);
+		half.cmdBuf  = VK_NULL_HANDLE;
+		half.pending = false;
+	}
+
+	half.used = 0;
+	half.copies.clear();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Application/logging.h"
+#include "device.h"
+#include "command.h"
+
+/*****************************************************************************************************************
+ *
+ * @class StagingWindow
+ *
+ * A fixed size, persistently mapped staging buffer that is reused for any number of uploads. The window is split
+ * into two halves. While the copies of one half are running on the GPU the other half is being filled, so data
+ * can be produced and uploaded in chunks without ever holding a staging copy of the whole resource.
+ *
+ * Example Usage:
+ *     StagingWindow::CreateInfo info{};
+ *     info.device        = &device;
+ *     info.commandSystem = &commandSystem;
+ *     StagingWindow window = StagingWindow::Create(info);
+ *
+ *     window.upload(buffer.getBuffer(), 0, data, size);
+ *     window.flush();
+ *     window.cleanup();
+ *
+ */
+class StagingWindow
+{
+public:
+	struct CreateInfo
+	{
+		const Device*        device        = nullptr;
+		const CommandSystem* commandSystem = nullptr;
+		VkDeviceSize         size          = 64ull * 1024 * 1024;
+		const char*          name          = "Staging Window";
+	};
+
+	StagingWindow() = default;
+
+	static StagingWindow Create(CreateInfo& info);
+
+	/**
+	 * Copy data into a device buffer. The data is copied into the window right away, so it can be freed or
+	 * reused as soon as this returns. The copy itself is only guaranteed to be done after flush().
+	 *
+	 * @param dstBuffer: Buffer to copy into. Must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+	 * @param dstOffset: Byte offset into the destination buffer.
+	 * @param data: Data to upload.
+	 * @param size: Size of the data in bytes.
+	 */
+	void upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+	// Submit the pending copies and wait for every copy to finish
+	void flush();
+
+	void cleanup();
+
+private:
+	struct Half
+	{
+		VkDeviceSize    offset  = 0;
+		VkDeviceSize    used    = 0;
+		VkCommandBuffer cmdBuf  = VK_NULL_HANDLE;
+		uint64_t        value   = 0; // Graphics timeline value of the copies
+		bool            pending = false;
+
+		std::vector<std::pair<VkBuffer, VkBufferCopy>> copies;
+	};
+
+	const Device*        m_device        = nullptr;
+	const CommandSystem* m_commandSystem = nullptr;
+	std::string          m_name          = "";
+
+	VkBuffer   m_buffer = VK_NULL_HANDLE;
+	Allocation m_memory;
+	uint8_t*   m_map    = nullptr;
+
+	VkDeviceSize m_halfSize = 0;
+	Half         m_halves[2];
+	uint32_t     m_current  = 0;
+
+	void submit(uint32_t half);
+	void wait(uint32_t half);
+};
@@ -59,8 +59,13 @@ uint32_t Swapchain::acquireImage(uint32_t& frameIndex)
 	// Try to get an image. Return when an image is acquired
 	while (true)
 	{
-		// Wait for an available image
-		vkWaitForFences(m_device->getLogical(), 1, &m_inFlightFences[frameIndex], VK_TRUE, UINT64_MAX);
+		// Wait until the GPU is done with the last use of this frame in flight
+		m_device->getGraphicsTimeline().wait(m_frameValues[frameIndex]);
+
+		// Release the resources that were deferred until the GPU finished with them
+		m_device->getGraphicsTimeline().collect();
+		m_device->getComputeTimeline().collect();
+		m_device->getTransferTimeline().collect();
 
 		// Get an image
 		VkResult result;
@@ -77,15 +82,12 @@ uint32_t Swapchain::acquireImage(uint32_t& frameIndex)
 			APP_LOG_ERROR("Failed to acquire swap chain image");
 		}
 
-		// Un-signal fence
-		vkResetFences(m_device->getLogical(), 1, &m_inFlightFences[frameIndex]);
-
 		return imageIndex;
 	}
 
 }
 
-void Swapchain::submitGraphics(VkCommandBuffer commandBuffer, uint32_t& frameIndex)
+void Swapchain::submitGraphics(VkCommandBuffer commandBuffer, uint32_t& frameIndex, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage)
 {
 	// End command buffer
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
@@ -95,9 +97,9 @@ void Swapchain::submitGraphics(VkCommandBuffer commandBuffer, uint32_t& frameInd
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphores[]      = { m_imageAvailableSemaphores[frameIndex] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	VkSemaphore waitSemaphores[]      = { m_imageAvailableSemaphores[frameIndex], waitSemaphore };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, waitStage };
+	submitInfo.waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 2 : 1;
 	submitInfo.pWaitSemaphores    = waitSemaphores;
 	submitInfo.pWaitDstStageMask  = waitStages;
 
@@ -108,8 +110,7 @@ void Swapchain::submitGraphics(VkCommandBuffer commandBuffer, uint32_t& frameInd
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores    = signalSemaphores;
 
-	if (vkQueueSubmit(m_device->getGraphicsQueue(), 1, &submitInfo, m_inFlightFences[frameIndex]) != VK_SUCCESS)
-		APP_LOG_CRITICAL("Failed to submit to graphics queue");
+	m_frameValues[frameIndex] = m_device->getGraphicsTimeline().submit(submitInfo);
 }
 
 void Swapchain::present(uint32_t frameIndex, uint32_t& imageIndex)
@@ -186,7 +187,6 @@ void Swapchain::cleanup()
 	{
 		vkDestroySemaphore(m_device->getLogical(), m_imageAvailableSemaphores[i], nullptr);
 		vkDestroySemaphore(m_device->getLogical(), m_renderFinishedSemaphores[i], nullptr);
-		vkDestroyFence(m_device->getLogical(), m_inFlightFences[i], nullptr);
 	}
 }
 
@@ -275,21 +275,16 @@ void Swapchain::setupSyncObjects(uint32_t framesInFlight)
 {
 	m_imageAvailableSemaphores.resize(framesInFlight);
 	m_renderFinishedSemaphores.resize(framesInFlight);
-	m_inFlightFences.resize(framesInFlight);
+	m_frameValues.assign(framesInFlight, 0);
 
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	// For each frame in flight, create two semaphores and one fence
+	// For each frame in flight, create two semaphores. Frames are paced by the graphics timeline
 	for (size_t i = 0; i < framesInFlight; i++)
 	{
 		if (vkCreateSemaphore(m_device->getLogical(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(m_device->getLogical(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-			vkCreateFence(m_device->getLogical(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS)
+			vkCreateSemaphore(m_device->getLogical(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS)
 		{
 			APP_LOG_CRITICAL("Failed to create syncronization objects for frame {}", i);
 			throw;
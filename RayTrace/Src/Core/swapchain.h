@@ -30,7 +30,19 @@ public:
 	void onWindowResize(WindowResizeEvent event);
 
 	uint32_t acquireImage(uint32_t& frameIndex);
-	void submitGraphics(VkCommandBuffer commandBuffer, uint32_t& frameIndex);
+	/**
+	 * Submit the commands that draw to the acquired image.
+	 *
+	 * @param commandBuffer: The command buffer. It is ended here.
+	 * @param frameIndex: The frame in flight.
+	 * @param waitSemaphore: Optional semaphore of earlier work that the commands read from.
+	 * @param waitStage: The stage that waits on the semaphore.
+	 */
+	void submitGraphics(
+		VkCommandBuffer      commandBuffer,
+		uint32_t&            frameIndex,
+		VkSemaphore          waitSemaphore = VK_NULL_HANDLE,
+		VkPipelineStageFlags waitStage     = 0);
 	void present(uint32_t frameIndex, uint32_t& imageIndex);
 
 	// Getters
@@ -67,7 +79,7 @@ private:
 	// Syncronization
 	std::vector<VkSemaphore> m_imageAvailableSemaphores;
 	std::vector<VkSemaphore> m_renderFinishedSemaphores;
-	std::vector<VkFence>     m_inFlightFences;
+	std::vector<uint64_t>    m_frameValues; // Graphics timeline value of the last submission of each frame in flight
 
 	// Recreation
 	bool m_recreate = false;
@@ -1,18 +1,44 @@
 #include "pch.h"
 #include "texture.h"
 
+#include "texture_compression.h"
+#include "mip_generator.h"
+
+#include "Application/cpu_profiler.h"
+
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// Levels of a streamed texture up to this size are uploaded when it is created and are always resident
+static const uint32_t s_streamedResidentSize = 128;
+
+static uint32_t swizzleToChannel(VkComponentSwizzle swizzle)
+{
+	switch (swizzle)
+	{
+		case VK_COMPONENT_SWIZZLE_G: return 1;
+		case VK_COMPONENT_SWIZZLE_B: return 2;
+		case VK_COMPONENT_SWIZZLE_A: return 3;
+		default:                     return 0;
+	}
+}
+
 Texture Texture::Create(Texture::CreateInfo& info)
 {
 	return Texture(info);
 }
 
-std::vector<Texture> Texture::CreateBatch(std::vector<Texture::CreateInfo>& infos, uint32_t numTextures)
+std::vector<Texture> Texture::CreateBatch(std::vector<Texture::CreateInfo>& infos, uint32_t numTextures, MipGeneration mipGeneration)
 {
-	std::vector<Texture> textures;
-	textures.reserve(numTextures);
+	APP_PROFILE_FUNCTION();
 
-	std::vector<VkBuffer>       stagingBuffers(numTextures);
-	std::vector<VkDeviceMemory> stagingMemory(numTextures);
+	std::vector<Texture> textures(numTextures);
+	if (numTextures == 0)
+		return textures;
 
 	const Device*        device = infos[0].pDevice;
 	const CommandSystem* cmdSys = infos[0].pCommandSystem;
@@ -36,61 +62,358 @@ std::vector<Texture> Texture::CreateBatch(std::vector<Texture::CreateInfo>& info
 	samplerInfo.compareOp               = VK_COMPARE_OP_ALWAYS;
 	samplerInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.minLod                  = 0.0f;
-	samplerInfo.maxLod                  = 1.0f;
+	samplerInfo.maxLod                  = VK_LOD_CLAMP_NONE;
 	samplerInfo.mipLodBias              = 0.0f;
 
-	VkCommandBuffer cmdBuf = cmdSys->beginSingleTimeCommands();
+	// A pool of workers decodes the images while this thread records and submits the uploads. Decoded images
+	// are handed over in the order they finish, so one large file does not hold back the smaller ones. Textures
+	// that are compressed are read from their KTX2 cache, or encoded by the worker and written to the cache
+	struct Decoded
+	{
+		char* pixels   = nullptr;
+		int   width    = 0;
+		int   height   = 0;
+		int   channels = 0;
+
+		TextureCompressor::CompressedImage compressed;
+		std::string                        streamFile; // KTX2 file that holds every level of a streamed texture
+	};
+	std::vector<Decoded> decoded(numTextures);
+
+	std::mutex              readyMutex;
+	std::condition_variable readyCondition;
+	std::deque<uint32_t>    ready;
+	bool                    failed = false;
+
+	std::atomic<uint32_t> next = 0;
+	auto worker = [&]() {
+		APP_PROFILE_THREAD("Texture Loader");
+		APP_PROFILE_ZONE("Load Textures");
+
+		for (uint32_t i = next++; i < numTextures; i = next++)
+		{
+			// The whole batch is thrown away once a texture failed, so there is no point in decoding the rest
+			{
+				std::lock_guard<std::mutex> lock(readyMutex);
+				if (failed)
+					break;
+			}
+
+			bool success = true;
+			try
+			{
+				Decoded& d = decoded[i];
+
+				bool packed = infos[i].fileType == FileType::PACKED;
+
+				// Every file the texture is read from
+				std::vector<const char*> sources;
+				if (packed)
+				{
+					for (const auto& map : infos[i].maps)
+					{
+						if (map.type != FileType::NONE)
+							sources.push_back(map.filename);
+					}
+				}
+				else if (infos[i].filename)
+					sources.push_back(infos[i].filename);
+
+				std::string cacheFile;
+				VkFormat    compressedFormat = VK_FORMAT_UNDEFINED;
+				uint32_t    sourceChannel    = 0;
+				bool        cached           = false;
+				const char* cachePath        = infos[i].cachePath ? infos[i].cachePath : infos[i].filename;
+				if (infos[i].compress && cachePath && device->isTextureCompressionSupported())
+				{
+					const char* suffix = "";
+					Texture::GetCompressedFormat(infos[i], &compressedFormat, &sourceChannel, &suffix);
+
+					cacheFile = std::string(cachePath) + "." + suffix + ".ktx2";
+
+					// The cache is only used while it is at least as new as every source
+					std::error_code cacheError;
+					auto cacheTime = std::filesystem::last_write_time(cacheFile, cacheError);
+
+					bool valid = !cacheError;
+					for (const char* source : sources)
+					{
+						std::error_code sourceError;
+						auto sourceTime = std::filesystem::last_write_time(source, sourceError);
+						valid = valid && !sourceError && cacheTime >= sourceTime;
+					}
+
+					if (valid)
+						cached = TextureCompressor::ReadKtx2(cacheFile, d.compressed) && d.compressed.format == compressedFormat;
+
+					if (!cached)
+						d.compressed = {};
+				}
+
+				if (!cached && packed)
+					Texture::LoadPackedTexture(infos[i].maps, &d.width, &d.height, &d.channels, &d.pixels);
+				else if (!cached && infos[i].fileData)
+					Texture::LoadTextureFromMemory(infos[i].fileData, infos[i].fileSize, infos[i].fileType, &d.width, &d.height, &d.channels, &d.pixels);
+				else if (!cached)
+					Texture::LoadTexture(infos[i].filename, infos[i].fileType, &d.width, &d.height, &d.channels, &d.pixels);
+
+				if (!cached && compressedFormat != VK_FORMAT_UNDEFINED)
+				{
+					d.compressed = TextureCompressor::Compress(reinterpret_cast<uint8_t*>(d.pixels), d.width, d.height, compressedFormat, sourceChannel);
+					stbi_image_free(d.pixels);
+					d.pixels = nullptr;
+
+					cached = TextureCompressor::WriteKtx2(cacheFile, d.compressed);
+				}
+				else if (!cached && packed && sources.size() == 1)
+				{
+					// A packed texture with a single map is uploaded as one channel
+					uint32_t channel = 0;
+					while (infos[i].maps[channel].type == FileType::NONE)
+						channel++;
+
+					for (size_t texel = 0; texel < static_cast<size_t>(d.width) * d.height; texel++)
+						d.pixels[texel] = d.pixels[4 * texel + channel];
+					d.channels = 1;
+				}
+
+				if (cached && infos[i].stream)
+					d.streamFile = cacheFile;
+			}
+			catch (...)
+			{
+				success = false;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(readyMutex);
+				if (success)
+					ready.push_back(i);
+				else
+					failed = true;
+			}
+			readyCondition.notify_one();
+		}
+	};
+
+	// The recording thread keeps a core for itself
+	uint32_t threadCount = std::min(std::max(2u, std::thread::hardware_concurrency()) - 1, numTextures);
 
-	for (uint32_t i = 0; i < numTextures; i++)
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	// Uploads are recorded into batches. A batch is submitted once it holds enough data, and its staging buffers
+	// are freed when the graphics timeline reaches the value of the batch. Only a few batches are kept in flight so the staging
+	// memory stays bounded. Mip chains that are built with compute are recorded for the whole batch at once
+	struct UploadBatch
 	{
-		// Load texture
-		char* pixels;
-		int width, height, channels;
-		Texture::LoadTexture(infos[i].filename, infos[i].fileType, &width, &height, &channels, &pixels);
+		VkCommandBuffer cmdBuf = VK_NULL_HANDLE;
+		uint64_t        value  = 0;
+		VkDeviceSize    size   = 0;
+
+		std::vector<std::pair<VkBuffer, Allocation>> staging;
+
+		std::vector<MipGenerator::Target> mipTargets;
+		MipGenerator::Resources           mipResources;
+	};
+
+	MipGenerator mipGenerator;
+
+	const VkDeviceSize maxBatchSize       = 64ull * 1024 * 1024;
+	const size_t       maxBatchesInFlight = 2;
+
+	UploadBatch              current;
+	std::vector<UploadBatch> inFlight;
+
+	auto retire = [&](UploadBatch& batch) {
+		device->getGraphicsTimeline().wait(batch.value);
+		cmdSys->freeSingleTimeCommands(batch.cmdBuf);
+
+		for (auto& [buffer, memory] : batch.staging)
+			Buffer::DestroyBuffer(buffer, memory, *device);
+
+		mipGenerator.release(batch.mipResources);
+	};
+
+	auto submit = [&]() {
+		if (current.cmdBuf == VK_NULL_HANDLE)
+			return;
+
+		if (!current.mipTargets.empty())
+			current.mipResources = mipGenerator.record(current.cmdBuf, current.mipTargets);
+
+		current.value = cmdSys->submitSingleTimeCommands(current.cmdBuf, device->getGraphicsQueue());
+		inFlight.emplace_back(std::move(current));
+		current = UploadBatch{};
+
+		if (inFlight.size() > maxBatchesInFlight)
+		{
+			retire(inFlight.front());
+			inFlight.erase(inFlight.begin());
+		}
+	};
+
+	auto finish = [&]() {
+		for (auto& thread : threads)
+			thread.join();
+		threads.clear();
+
+		submit();
+		for (auto& batch : inFlight)
+			retire(batch);
+		inFlight.clear();
+
+		mipGenerator.cleanup();
+	};
+
+	for (uint32_t uploaded = 0; uploaded < numTextures; uploaded++)
+	{
+		// Wait for the next decoded image. Submit what has been recorded so far instead of letting the GPU idle
+		uint32_t i = 0;
+		{
+			std::unique_lock<std::mutex> lock(readyMutex);
+			if (ready.empty() && !failed && current.cmdBuf != VK_NULL_HANDLE)
+			{
+				lock.unlock();
+				submit();
+				lock.lock();
+			}
+
+			readyCondition.wait(lock, [&]() { return !ready.empty() || failed; });
+
+			if (failed)
+			{
+				lock.unlock();
+				finish();
+
+				for (auto& d : decoded)
+					stbi_image_free(d.pixels);
+				for (auto& texture : textures)
+				{
+					if (texture.m_device)
+						texture.cleanup();
+				}
+
+				APP_LOG_CRITICAL("Failed to load texture batch");
+				throw std::exception();
+			}
+
+			i = ready.front();
+			ready.pop_front();
+		}
+
+		char* pixels   = decoded[i].pixels;
+		int   width    = decoded[i].width;
+		int   height   = decoded[i].height;
+		int   channels = decoded[i].channels;
+
+		const TextureCompressor::CompressedImage& compressed = decoded[i].compressed;
+		bool isCompressed = !compressed.levels.empty();
+
+		// A streamed texture starts with only its small levels. The streamer loads the rest from the cache
+		uint32_t firstLevel = 0;
+		if (isCompressed && !decoded[i].streamFile.empty())
+		{
+			while (firstLevel + 1 < compressed.levels.size() &&
+				std::max(compressed.levels[firstLevel].width, compressed.levels[firstLevel].height) > s_streamedResidentSize)
+				firstLevel++;
+		}
 
 		// Setup type specific parameters
 		VkFormat      format      = VK_FORMAT_UNDEFINED;
 		size_t        channelSize = sizeof uint8_t;
 		VkImageTiling imageTiling = VK_IMAGE_TILING_OPTIMAL;
-		uint32_t      mipLevels   = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
-		switch (infos[i].fileType)
+		uint32_t      mipLevels   = 0;
+		VkDeviceSize  imageSize   = 0;
+		if (isCompressed)
+		{
+			format    = compressed.format;
+			width     = compressed.levels[firstLevel].width;
+			height    = compressed.levels[firstLevel].height;
+			mipLevels = static_cast<uint32_t>(compressed.levels.size()) - firstLevel;
+
+			for (uint32_t level = firstLevel; level < compressed.levels.size(); level++)
+				imageSize += compressed.levels[level].data.size();
+		}
+		else
 		{
-			case FileType::ALBEDO:
-				format    = VK_FORMAT_R8G8B8A8_SRGB;
-				break;
-
-			case FileType::NORMAL:
-			case FileType::ALPHA:
-			case FileType::METAL:
-			case FileType::ROUGH:
-				format = VK_FORMAT_R8G8B8A8_UNORM;
-				break;
-
-			case FileType::NONE:
-				APP_LOG_CRITICAL("Invalid file type: NONE");
-				break;
-
-			default:
-				APP_LOG_CRITICAL("No file type was specified");
+			switch (infos[i].fileType)
+			{
+				case FileType::ALBEDO:
+					format    = VK_FORMAT_R8G8B8A8_SRGB;
+					break;
+
+				case FileType::NORMAL:
+				case FileType::ALPHA:
+				case FileType::METAL:
+				case FileType::ROUGH:
+					format = VK_FORMAT_R8G8B8A8_UNORM;
+					break;
+
+				case FileType::PACKED:
+					format = (channels == 1) ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8G8B8A8_UNORM;
+					break;
+
+				case FileType::NONE:
+					APP_LOG_CRITICAL("Invalid file type: NONE");
+					break;
+
+				default:
+					APP_LOG_CRITICAL("No file type was specified");
+			}
+
+			mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+			imageSize = static_cast<uint64_t>(width) * height * channels * channelSize;
 		}
 
-		VkDeviceSize imageSize = static_cast<uint64_t>(width) * height * channels * channelSize;
+		// The mip chains of supported formats are built with compute when the upload batch is submitted
+		bool computeMips = !isCompressed && mipGeneration == MipGeneration::COMPUTE &&
+			MipGenerator::IsSupported(format, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+
+		if (computeMips && !mipGenerator.isInitialized())
+		{
+			MipGenerator::CreateInfo generatorInfo{};
+			generatorInfo.device = device;
+			mipGenerator.init(generatorInfo);
+		}
 
 		// Create staging buffer
+		VkBuffer   stagingBuffer;
+		Allocation stagingMemory;
 		Buffer::CreateBuffer(
 			imageSize,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffers[i], stagingMemory[i],
-			*device);
+			stagingBuffer, stagingMemory,
+			*device,
+			MemoryCategory::STAGING,
+			"Texture Staging Buffer");
+
+		// Transfer buffer data into staging buffer memory. Compressed levels are stored one after another
+		void* deviceData = stagingMemory.map;
+		if (isCompressed)
+		{
+			uint8_t* dst = static_cast<uint8_t*>(deviceData);
+			for (uint32_t level = firstLevel; level < compressed.levels.size(); level++)
+			{
+				memcpy(dst, compressed.levels[level].data.data(), compressed.levels[level].data.size());
+				dst += compressed.levels[level].data.size();
+			}
+		}
+		else
+			memcpy(deviceData, pixels, (size_t)imageSize);
+
+		stbi_image_free(pixels);
+		decoded[i].pixels = nullptr;
 
-		// Transfer buffer data into staging buffer memory
-		void* deviceData;
-		vkMapMemory(device->getLogical(), stagingMemory[i], 0, imageSize, 0, &deviceData);
-		memcpy(deviceData, pixels, (size_t)imageSize);
-		vkUnmapMemory(device->getLogical(), stagingMemory[i]);
+		if (current.cmdBuf == VK_NULL_HANDLE)
+			current.cmdBuf = cmdSys->beginSingleTimeCommands();
 
-		// Create image
+		current.staging.emplace_back(stagingBuffer, stagingMemory);
+		current.size += imageSize;
+
+		// Create image. Compressed images already have their mip chain, so they are never blitted
 		Image::CreateInfo imgCreateInfo{};
 		imgCreateInfo.width      = width;
 		imgCreateInfo.height     = height;
@@ -98,20 +421,40 @@ std::vector<Texture> Texture::CreateBatch(std::vector<Texture::CreateInfo>& info
 		imgCreateInfo.layerCount = 1;
 		imgCreateInfo.numSamples = VK_SAMPLE_COUNT_1_BIT;
 		imgCreateInfo.tiling     = VK_IMAGE_TILING_OPTIMAL;
-		imgCreateInfo.usage      = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imgCreateInfo.usage      = isCompressed
+			? VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+			: VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		imgCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		imgCreateInfo.format     = format;
 		imgCreateInfo.device     = device;
 		imgCreateInfo.name       = infos[i].name;
 
+		if (computeMips)
+		{
+			imgCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			imgCreateInfo.flags  = MipGenerator::GetImageFlags();
+		}
+
 		Image image = Image::CreateImage(imgCreateInfo);
 
-		// Setup image view
+		// Setup image view. The channel of a compressed single channel map was moved to red when it was encoded.
+		// A packed texture with one channel returns it in every channel, so the shaders find it in its slot
+		VkComponentMapping components = { isCompressed ? VK_COMPONENT_SWIZZLE_IDENTITY : infos[i].channel, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+		if (infos[i].fileType == FileType::PACKED)
+		{
+			bool singleChannel = (format == VK_FORMAT_R8_UNORM || format == VK_FORMAT_BC4_UNORM_BLOCK);
+			components = singleChannel
+				? VkComponentMapping{ VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE }
+				: VkComponentMapping{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+		}
+
 		Image::ImageViewSetupInfo viewSetupInfo{};
 		viewSetupInfo.format      = imgCreateInfo.format;
 		viewSetupInfo.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
 		viewSetupInfo.mipLevels   = mipLevels;
 		viewSetupInfo.layerCount  = 1;
+		viewSetupInfo.components  = components;
+		viewSetupInfo.usage       = computeMips ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
 		viewSetupInfo.device      = device;
 		Image::SetupImageView(image, viewSetupInfo);
 		
@@ -124,17 +467,53 @@ std::vector<Texture> Texture::CreateBatch(std::vector<Texture::CreateInfo>& info
 		transitionInfo.dstStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		transitionInfo.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		transitionInfo.levelCount    = mipLevels;
-		Image::TransitionImage(cmdBuf, image.image, transitionInfo);
-
-		// Copy data from staging buffer to image
-		Image::CopyFromBuffer(
-			cmdBuf,
-			image.image, stagingBuffers[i],
-			width, height,
-			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 });
+		Image::TransitionImage(current.cmdBuf, image.image, transitionInfo);
 
-		// Generate mip maps and transition layout to shader read only optimal
-		Texture::GenerateMipMaps(cmdBuf, image.image, width, height, mipLevels);
+		if (isCompressed)
+		{
+			// Copy every level from the staging buffer and transition the image to shader read only optimal
+			std::vector<VkBufferImageCopy> regions(mipLevels);
+			VkDeviceSize                   offset = 0;
+			for (uint32_t level = 0; level < mipLevels; level++)
+			{
+				regions[level].bufferOffset     = offset;
+				regions[level].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+				regions[level].imageExtent      = { compressed.levels[firstLevel + level].width, compressed.levels[firstLevel + level].height, 1 };
+
+				offset += compressed.levels[firstLevel + level].data.size();
+			}
+
+			vkCmdCopyBufferToImage(
+				current.cmdBuf,
+				stagingBuffer,
+				image.image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				mipLevels,
+				regions.data());
+
+			transitionInfo.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			transitionInfo.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			transitionInfo.srcStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			transitionInfo.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			transitionInfo.dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			transitionInfo.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			Image::TransitionImage(current.cmdBuf, image.image, transitionInfo);
+		}
+		else
+		{
+			// Copy data from staging buffer to image
+			Image::CopyFromBuffer(
+				current.cmdBuf,
+				image.image, stagingBuffer,
+				width, height,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 });
+
+			// Generate mip maps and transition layout to shader read only optimal
+			if (computeMips)
+				current.mipTargets.push_back({ image.image, format, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels });
+			else
+				Texture::GenerateMipMaps(current.cmdBuf, image.image, width, height, mipLevels);
+		}
 
 		// Setup descriptor information
 		VkDescriptorImageInfo descriptor{};
@@ -148,18 +527,28 @@ std::vector<Texture> Texture::CreateBatch(std::vector<Texture::CreateInfo>& info
 		}
 
 		// Store texture
-		textures.emplace_back(Texture(infos[i].pDevice, infos[i].name, image, descriptor));
-	}
+		textures[i] = Texture(infos[i].pDevice, infos[i].name, image, descriptor);
 
-	infos[0].pCommandSystem->endSingleTimeCommands(cmdBuf, infos[0].pDevice->getGraphicsQueue());
+		if (!decoded[i].streamFile.empty())
+		{
+			Texture::StreamInfo& stream = textures[i].m_streamInfo;
+			stream.file       = decoded[i].streamFile;
+			stream.format     = format;
+			stream.width      = compressed.levels[0].width;
+			stream.height     = compressed.levels[0].height;
+			stream.levelCount = static_cast<uint32_t>(compressed.levels.size());
+			stream.firstLevel = firstLevel;
+			stream.components = components;
+		}
 
-	// Cleanup staging resources
-	for (uint32_t i = 0; i < numTextures; i++)
-	{
-		vkDestroyBuffer(device->getLogical(), stagingBuffers[i], nullptr);
-		vkFreeMemory(device->getLogical(), stagingMemory[i], nullptr);
+		decoded[i].compressed = {};
+
+		if (current.size >= maxBatchSize)
+			submit();
 	}
 
+	finish();
+
 	return textures;
 }
 
@@ -245,7 +634,7 @@ Texture::Texture(Texture::CreateInfo& info)
 	samplerInfo.compareOp               = VK_COMPARE_OP_ALWAYS;
 	samplerInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.minLod                  = 0.0f;
-	samplerInfo.maxLod                  = 1.0f;
+	samplerInfo.maxLod                  = VK_LOD_CLAMP_NONE;
 	samplerInfo.mipLodBias              = 0.0f;
 
 	if (vkCreateSampler(info.pDevice->getLogical(), &samplerInfo, nullptr, &m_descriptor.sampler) != VK_SUCCESS)
@@ -279,7 +668,8 @@ void Texture::LoadTexture(const char* file, FileType type, int* width, int* heig
 			APP_LOG_CRITICAL("No file type was specified");
 	}
 
-	stbi_set_flip_vertically_on_load(true);
+	// Textures can be decoded from several threads at once, so the flip setting is set per thread
+	stbi_set_flip_vertically_on_load_thread(true);
 	*data = (char*)stbi_load(file, width, height, channels, loadFormat);
 	if (!*data)
 	{
@@ -291,6 +681,183 @@ void Texture::LoadTexture(const char* file, FileType type, int* width, int* heig
 	*channels = 4;
 }
 
+void Texture::LoadPackedTexture(const PackedMap* maps, int* width, int* height, int* channels, char** data)
+{
+	APP_LOG_TRACE("Loading packed texture");
+
+	struct Source
+	{
+		char* pixels = nullptr;
+		int   width  = 0;
+		int   height = 0;
+		bool  shared = false;
+	};
+	Source sources[3];
+
+	auto freeSources = [&]() {
+		for (auto& source : sources)
+		{
+			if (!source.shared)
+				stbi_image_free(source.pixels);
+		}
+	};
+
+	// Decode every map. Maps that read different channels of the same image (e.g. glTF metal roughness) only
+	// decode it once
+	int packedWidth  = 0;
+	int packedHeight = 0;
+	try
+	{
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			if (maps[i].type == FileType::NONE)
+				continue;
+
+			for (uint32_t j = 0; j < i && !sources[i].pixels; j++)
+			{
+				bool sameData = maps[i].fileData && maps[i].fileData == maps[j].fileData;
+				bool sameFile = !maps[i].fileData && !maps[j].fileData && maps[j].filename && strcmp(maps[i].filename, maps[j].filename) == 0;
+				if (maps[j].type != FileType::NONE && (sameData || sameFile))
+				{
+					sources[i]        = sources[j];
+					sources[i].shared = true;
+				}
+			}
+
+			int sourceChannels = 0;
+			if (!sources[i].pixels && maps[i].fileData)
+				Texture::LoadTextureFromMemory(maps[i].fileData, maps[i].fileSize, maps[i].type, &sources[i].width, &sources[i].height, &sourceChannels, &sources[i].pixels);
+			else if (!sources[i].pixels)
+				Texture::LoadTexture(maps[i].filename, maps[i].type, &sources[i].width, &sources[i].height, &sourceChannels, &sources[i].pixels);
+
+			packedWidth  = std::max(packedWidth, sources[i].width);
+			packedHeight = std::max(packedHeight, sources[i].height);
+		}
+	}
+	catch (...)
+	{
+		freeSources();
+		throw;
+	}
+
+	// Copy the requested channel of every map into its slot. Maps that are smaller than the largest one are
+	// scaled up with nearest filtering. The packed texture is freed with stbi_image_free like the others
+	uint8_t* packed = static_cast<uint8_t*>(malloc(static_cast<size_t>(packedWidth) * packedHeight * 4));
+	if (!packed)
+	{
+		freeSources();
+		APP_LOG_CRITICAL("Failed to allocate packed texture");
+		throw std::exception();
+	}
+
+	for (int y = 0; y < packedHeight; y++)
+	{
+		for (int x = 0; x < packedWidth; x++)
+		{
+			uint8_t* texel = packed + (static_cast<size_t>(y) * packedWidth + x) * 4;
+			texel[0] = 0;
+			texel[1] = 0;
+			texel[2] = 0;
+			texel[3] = 255;
+
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				if (!sources[i].pixels)
+					continue;
+
+				int sourceX = x * sources[i].width / packedWidth;
+				int sourceY = y * sources[i].height / packedHeight;
+
+				const uint8_t* sourceTexel = reinterpret_cast<const uint8_t*>(sources[i].pixels) + (static_cast<size_t>(sourceY) * sources[i].width + sourceX) * 4;
+				texel[i] = sourceTexel[swizzleToChannel(maps[i].channel)];
+			}
+		}
+	}
+
+	freeSources();
+
+	*width    = packedWidth;
+	*height   = packedHeight;
+	*channels = 4;
+	*data     = reinterpret_cast<char*>(packed);
+}
+
+void Texture::LoadTextureFromMemory(const uint8_t* fileData, size_t fileSize, FileType type, int* width, int* height, int* channels, char** data)
+{
+	APP_LOG_TRACE("Loading texture from memory ({} bytes)", fileSize);
+
+	if (type == FileType::NONE)
+	{
+		APP_LOG_CRITICAL("File type is NONE");
+		throw std::exception();
+	}
+
+	stbi_set_flip_vertically_on_load_thread(true);
+	*data = (char*)stbi_load_from_memory(fileData, static_cast<int>(fileSize), width, height, channels, STBI_rgb_alpha);
+	if (!*data)
+	{
+		APP_LOG_CRITICAL("Failed to load texture from memory");
+		throw std::exception();
+	}
+
+	// Force textures to be rgba
+	*channels = 4;
+}
+
+void Texture::GetCompressedFormat(const CreateInfo& info, VkFormat* format, uint32_t* sourceChannel, const char** suffix)
+{
+	static const char* singleChannelSuffixes[4] = { "bc4r", "bc4g", "bc4b", "bc4a" };
+
+	*format        = VK_FORMAT_UNDEFINED;
+	*sourceChannel = 0;
+	*suffix        = "";
+
+	// Color keeps all four channels and normals only need x and y. Single channel maps are stored on their
+	// own, and a packed texture is only stored as BC7 if it really holds more than one map
+	switch (info.fileType)
+	{
+		case FileType::ALBEDO:
+			*format = VK_FORMAT_BC7_SRGB_BLOCK;
+			*suffix = "bc7";
+			break;
+
+		case FileType::NORMAL:
+			*format = VK_FORMAT_BC5_UNORM_BLOCK;
+			*suffix = "bc5";
+			break;
+
+		case FileType::ALPHA:
+		case FileType::METAL:
+		case FileType::ROUGH:
+			*format        = VK_FORMAT_BC4_UNORM_BLOCK;
+			*sourceChannel = swizzleToChannel(info.channel);
+			*suffix        = singleChannelSuffixes[*sourceChannel];
+			break;
+
+		case FileType::PACKED:
+		{
+			uint32_t mapCount = 0;
+			for (uint32_t channel = 0; channel < 3; channel++)
+			{
+				if (info.maps[channel].type != FileType::NONE)
+				{
+					mapCount++;
+					*sourceChannel = channel;
+				}
+			}
+
+			*format = (mapCount == 1) ? VK_FORMAT_BC4_UNORM_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+			*suffix = (mapCount == 1) ? singleChannelSuffixes[*sourceChannel] : "bc7";
+			if (mapCount != 1)
+				*sourceChannel = 0;
+			break;
+		}
+
+		default:
+			APP_LOG_CRITICAL("No file type was specified");
+	}
+}
+
 void Texture::GenerateMipMaps(VkCommandBuffer cmdBuf, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
 {
 	// Inital barrier setup
@@ -19,7 +19,25 @@ public:
 		NORMAL,
 		ALPHA,
 		METAL,
-		ROUGH
+		ROUGH,
+		PACKED  // Alpha, roughness and metalness maps in the red, green and blue channels
+	};
+
+	// How CreateBatch builds the mip chain of textures that are not compressed
+	enum class MipGeneration
+	{
+		BLIT = 0, // One blit and two barriers per level of every texture
+		COMPUTE   // One dispatch per texture and shared barriers. Formats that it does not support are blitted
+	};
+
+	// One map of a packed texture
+	struct PackedMap
+	{
+		FileType           type     = FileType::NONE; // NONE if the channel is not used
+		const char*        filename = nullptr;
+		const uint8_t*     fileData = nullptr;
+		size_t             fileSize = 0;
+		VkComponentSwizzle channel  = VK_COMPONENT_SWIZZLE_IDENTITY; // Channel of the source image to read
 	};
 
 	struct CreateInfo 
@@ -30,18 +48,54 @@ public:
 		const char*          filename       = nullptr;
 		FileType             fileType       = FileType::NONE;
 		const char*          name           = "";
+
+		// Encoded image in memory (e.g. embedded in a glTF file). Used instead of the filename when set
+		const uint8_t*       fileData       = nullptr;
+		size_t               fileSize       = 0;
+
+		// Channel that the shaders read as red. Lets single channel maps be stored inside packed textures
+		VkComponentSwizzle   channel        = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+		// Store the texture block compressed if the device supports it. The compressed mip chain is cached in a
+		// KTX2 file next to the cache path (the filename by default) and is reused while it is newer than the
+		// filename. When fileData is set the filename should be the file that holds the data
+		bool                 compress       = true;
+		const char*          cachePath      = nullptr;
+
+		// FileType::PACKED: the maps of the red, green and blue channels. A cache path is required to compress
+		PackedMap            maps[3];
+
+		// Only upload the small levels of a compressed texture and leave the finer levels in its KTX2 cache, so a
+		// TextureStreamer can load them when they are needed
+		bool                 stream         = false;
+	};
+
+	// Describes the full mip chain of a streamed texture. The image of the texture only holds the small levels
+	struct StreamInfo
+	{
+		std::string        file       = "";  // KTX2 file with every level. Empty if the texture is not streamed
+		VkFormat           format     = VK_FORMAT_UNDEFINED;
+		uint32_t           width      = 0;   // Size of level 0
+		uint32_t           height     = 0;
+		uint32_t           levelCount = 0;
+		uint32_t           firstLevel = 0;   // First level of the full chain that the image holds
+		VkComponentMapping components = {};
 	};
 
 	Texture() = default;
 
 	static Texture Create(Texture::CreateInfo& info);
-	static std::vector<Texture> CreateBatch(std::vector<Texture::CreateInfo>& infos, uint32_t numTextures);
+	static std::vector<Texture> CreateBatch(std::vector<Texture::CreateInfo>& infos, uint32_t numTextures, MipGeneration mipGeneration = MipGeneration::COMPUTE);
 
 	static void LoadTexture(const char* file, FileType type, int* width, int* height, int* channels, char** data);
+	static void LoadPackedTexture(const PackedMap* maps, int* width, int* height, int* channels, char** data);
+	static void LoadTextureFromMemory(const uint8_t* fileData, size_t fileSize, FileType type, int* width, int* height, int* channels, char** data);
+	static void GetCompressedFormat(const CreateInfo& info, VkFormat* format, uint32_t* sourceChannel, const char** suffix);
 	static void GenerateMipMaps(VkCommandBuffer cmdBuf, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
 
 	const Image& getImage() const { return m_image; }
 	const VkDescriptorImageInfo& getDescriptor() const { return m_descriptor; }
+	const StreamInfo& getStreamInfo() const { return m_streamInfo; }
 
 	void cleanup();
 
@@ -51,6 +105,7 @@ private:
 
 	Image                 m_image;
 	VkDescriptorImageInfo m_descriptor{};
+	StreamInfo            m_streamInfo;
 
 	Texture(Texture::CreateInfo& info);
 
@@ -0,0 +1,630 @@
+#include "pch.h"
+#include "texture_compression.h"
+
+#include <filesystem>
+
+// --------------------------------------------------------------------------
+// Helpers
+//
+
+static float s_srgbToLinear[256];
+
+static void initSrgbTable()
+{
+	static bool initialized = []() {
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			s_srgbToLinear[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return true;
+	}();
+	(void)initialized;
+}
+
+static uint8_t linearToSrgb(float c)
+{
+	c = std::clamp(c, 0.0f, 1.0f);
+	c = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	return static_cast<uint8_t>(c * 255.0f + 0.5f);
+}
+
+// Box filter to the next mip level. Color channels of sRGB images are averaged in linear space
+static std::vector<uint8_t> downsample(const std::vector<uint8_t>& src, uint32_t width, uint32_t height, bool srgb)
+{
+	uint32_t dstWidth  = std::max(1u, width / 2);
+	uint32_t dstHeight = std::max(1u, height / 2);
+
+	std::vector<uint8_t> dst(static_cast<size_t>(dstWidth) * dstHeight * 4);
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		uint32_t y0 = std::min(2 * y, height - 1);
+		uint32_t y1 = std::min(2 * y + 1, height - 1);
+
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			uint32_t x0 = std::min(2 * x, width - 1);
+			uint32_t x1 = std::min(2 * x + 1, width - 1);
+
+			const uint8_t* p[4] = {
+				&src[(static_cast<size_t>(y0) * width + x0) * 4], &src[(static_cast<size_t>(y0) * width + x1) * 4],
+				&src[(static_cast<size_t>(y1) * width + x0) * 4], &src[(static_cast<size_t>(y1) * width + x1) * 4]
+			};
+
+			uint8_t* out = &dst[(static_cast<size_t>(y) * dstWidth + x) * 4];
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				if (srgb && c < 3)
+				{
+					float sum = s_srgbToLinear[p[0][c]] + s_srgbToLinear[p[1][c]] + s_srgbToLinear[p[2][c]] + s_srgbToLinear[p[3][c]];
+					out[c] = linearToSrgb(sum * 0.25f);
+				}
+				else
+					out[c] = static_cast<uint8_t>((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+			}
+		}
+	}
+
+	return dst;
+}
+
+// Writes values into a 128 bit block starting at the lowest bit
+class BlockWriter
+{
+public:
+	BlockWriter(uint8_t* out)
+		: m_out(out) { memset(out, 0, 16); }
+
+	void write(uint32_t value, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++, m_position++)
+		{
+			if (value & (1u << i))
+				m_out[m_position / 8] |= static_cast<uint8_t>(1u << (m_position % 8));
+		}
+	}
+
+private:
+	uint8_t* m_out;
+	uint32_t m_position = 0;
+};
+
+// --------------------------------------------------------------------------
+// Block Encoders
+//
+
+void TextureCompressor::EncodeBC4Block(const uint8_t* pixels, uint32_t channel, uint8_t* out)
+{
+	uint8_t minValue = 255, maxValue = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		minValue = std::min(minValue, pixels[4 * i + channel]);
+		maxValue = std::max(maxValue, pixels[4 * i + channel]);
+	}
+
+	// With the first endpoint larger than the second, the palette has 6 interpolated values
+	out[0] = maxValue;
+	out[1] = minValue;
+
+	uint64_t indices = 0;
+	if (maxValue != minValue)
+	{
+		int32_t palette[8] = { maxValue, minValue };
+		for (int32_t i = 2; i < 8; i++)
+			palette[i] = ((8 - i) * maxValue + (i - 1) * minValue + 3) / 7;
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			int32_t  value     = pixels[4 * i + channel];
+			uint64_t bestIndex = 0;
+			int32_t  bestError = INT32_MAX;
+			for (uint32_t p = 0; p < 8; p++)
+			{
+				int32_t error = std::abs(palette[p] - value);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = p;
+				}
+			}
+
+			indices |= bestIndex << (3 * i);
+		}
+	}
+
+	for (uint32_t i = 0; i < 6; i++)
+		out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+}
+
+void TextureCompressor::EncodeBC5Block(const uint8_t* pixels, uint32_t channel, uint8_t* out)
+{
+	EncodeBC4Block(pixels, channel, out);
+	EncodeBC4Block(pixels, std::min(channel + 1, 3u), out + 8);
+}
+
+void TextureCompressor::EncodeBC7Block(const uint8_t* pixels, uint8_t* out)
+{
+	// Mode 6. One pair of RGBA endpoints with 7 bits per channel and a shared low bit per endpoint, and a 4 bit
+	// index per pixel
+	static const int32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Fit a line through the colors of the block. The endpoints are the extremes of the colors along the line
+	float mean[4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+			mean[c] += pixels[4 * i + c] / 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float d[4];
+		for (uint32_t c = 0; c < 4; c++)
+			d[c] = pixels[4 * i + c] - mean[c];
+
+		for (uint32_t a = 0; a < 4; a++)
+		{
+			for (uint32_t b = 0; b < 4; b++)
+				covariance[a][b] += d[a] * d[b];
+		}
+	}
+
+	// Power iteration for the principal axis. It starts at the channel with the most variance, since a fixed
+	// start such as the gray axis is orthogonal to gradients like red to blue and never leaves the mean
+	uint32_t largest = 0;
+	for (uint32_t c = 1; c < 4; c++)
+	{
+		if (covariance[c][c] > covariance[largest][largest])
+			largest = c;
+	}
+
+	float axis[4] = {};
+	axis[largest] = 1.0f;
+	for (uint32_t iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		for (uint32_t a = 0; a < 4; a++)
+		{
+			for (uint32_t b = 0; b < 4; b++)
+				next[a] += covariance[a][b] * axis[b];
+		}
+
+		float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+		if (length < 1e-6f)
+			break;
+
+		for (uint32_t c = 0; c < 4; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (uint32_t c = 0; c < 4; c++)
+			t += (pixels[4 * i + c] - mean[c]) * axis[c];
+
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	float targets[2][4];
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		targets[0][c] = mean[c] + minT * axis[c];
+		targets[1][c] = mean[c] + maxT * axis[c];
+	}
+
+	int32_t  endpoints[2][4];
+	int32_t  pBits[2];
+	uint32_t indices[16];
+
+	// Quantizes the targets to 7 bits plus the shared bit that fits each endpoint best, then picks the closest
+	// palette entry for every pixel. Returns the squared error of the block
+	auto encode = [&](const float (&target)[2][4], int32_t (&outEndpoints)[2][4], int32_t (&outPBits)[2], uint32_t (&outIndices)[16]) {
+		for (uint32_t e = 0; e < 2; e++)
+		{
+			float bestError = FLT_MAX;
+			for (int32_t p = 0; p < 2; p++)
+			{
+				int32_t quantized[4];
+				float   error = 0.0f;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					float value  = std::clamp(target[e][c], 0.0f, 255.0f);
+					quantized[c] = std::clamp(static_cast<int32_t>(std::round((value - p) / 2.0f)), 0, 127);
+
+					float difference = static_cast<float>((quantized[c] << 1) | p) - value;
+					error += difference * difference;
+				}
+
+				if (error < bestError)
+				{
+					bestError   = error;
+					outPBits[e] = p;
+					memcpy(outEndpoints[e], quantized, sizeof(quantized));
+				}
+			}
+		}
+
+		int32_t palette[16][4];
+		for (uint32_t w = 0; w < 16; w++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				int32_t a = (outEndpoints[0][c] << 1) | outPBits[0];
+				int32_t b = (outEndpoints[1][c] << 1) | outPBits[1];
+				palette[w][c] = ((64 - weights[w]) * a + weights[w] * b + 32) >> 6;
+			}
+		}
+
+		int32_t totalError = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			int32_t bestError = INT32_MAX;
+			for (uint32_t w = 0; w < 16; w++)
+			{
+				int32_t error = 0;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					int32_t difference = palette[w][c] - pixels[4 * i + c];
+					error += difference * difference;
+				}
+
+				if (error < bestError)
+				{
+					bestError     = error;
+					outIndices[i] = w;
+				}
+			}
+
+			totalError += bestError;
+		}
+
+		return totalError;
+	};
+
+	int32_t error = encode(targets, endpoints, pBits, indices);
+
+	// Refine the endpoints with a least squares fit to the chosen weights and keep the result if it is better
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float w = weights[indices[i]] / 64.0f;
+		aa += (1.0f - w) * (1.0f - w);
+		ab += (1.0f - w) * w;
+		bb += w * w;
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			ax[c] += (1.0f - w) * pixels[4 * i + c];
+			bx[c] += w * pixels[4 * i + c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (std::abs(determinant) > 1e-6f)
+	{
+		float refined[2][4];
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			refined[0][c] = (bb * ax[c] - ab * bx[c]) / determinant;
+			refined[1][c] = (aa * bx[c] - ab * ax[c]) / determinant;
+		}
+
+		int32_t  refinedEndpoints[2][4];
+		int32_t  refinedPBits[2];
+		uint32_t refinedIndices[16];
+		if (encode(refined, refinedEndpoints, refinedPBits, refinedIndices) < error)
+		{
+			memcpy(endpoints, refinedEndpoints, sizeof(endpoints));
+			memcpy(pBits, refinedPBits, sizeof(pBits));
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	// The highest bit of the first index is not stored, so the endpoints are swapped if it would be set
+	if (indices[0] & 8)
+	{
+		std::swap(endpoints[0], endpoints[1]);
+		std::swap(pBits[0], pBits[1]);
+		for (auto& index : indices)
+			index = 15 - index;
+	}
+
+	BlockWriter writer(out);
+	writer.write(1u << 6, 7);
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		writer.write(endpoints[0][c], 7);
+		writer.write(endpoints[1][c], 7);
+	}
+	writer.write(pBits[0], 1);
+	writer.write(pBits[1], 1);
+
+	writer.write(indices[0], 3);
+	for (uint32_t i = 1; i < 16; i++)
+		writer.write(indices[i], 4);
+}
+
+// --------------------------------------------------------------------------
+// Texture Compressor
+//
+
+bool TextureCompressor::IsSupportedFormat(VkFormat format)
+{
+	return GetBlockSize(format) != 0;
+}
+
+uint32_t TextureCompressor::GetBlockSize(VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			return 8;
+
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return 16;
+
+		default:
+			return 0;
+	}
+}
+
+TextureCompressor::CompressedImage TextureCompressor::Compress(const uint8_t* rgba, uint32_t width, uint32_t height, VkFormat format, uint32_t channel)
+{
+	initSrgbTable();
+
+	CompressedImage image;
+	image.format = format;
+
+	uint32_t blockSize = GetBlockSize(format);
+	if (blockSize == 0)
+	{
+		APP_LOG_CRITICAL("Unsupported compression format ({})", static_cast<int>(format));
+		throw std::exception();
+	}
+
+	std::vector<uint8_t> level(rgba, rgba + static_cast<size_t>(width) * height * 4);
+
+	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	for (uint32_t mip = 0; mip < mipLevels; mip++)
+	{
+		uint32_t blocksX = (width + 3) / 4;
+		uint32_t blocksY = (height + 3) / 4;
+
+		Level& out = image.levels.emplace_back();
+		out.width  = width;
+		out.height = height;
+		out.data.resize(static_cast<size_t>(blocksX) * blocksY * blockSize);
+
+		// Blocks that reach past the edge repeat the last row and column
+		uint8_t block[64];
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				for (uint32_t y = 0; y < 4; y++)
+				{
+					for (uint32_t x = 0; x < 4; x++)
+					{
+						uint32_t sx = std::min(bx * 4 + x, width - 1);
+						uint32_t sy = std::min(by * 4 + y, height - 1);
+						memcpy(&block[(y * 4 + x) * 4], &level[(static_cast<size_t>(sy) * width + sx) * 4], 4);
+					}
+				}
+
+				uint8_t* dst = &out.data[(static_cast<size_t>(by) * blocksX + bx) * blockSize];
+				switch (format)
+				{
+					case VK_FORMAT_BC4_UNORM_BLOCK: EncodeBC4Block(block, channel, dst); break;
+					case VK_FORMAT_BC5_UNORM_BLOCK: EncodeBC5Block(block, channel, dst); break;
+					default:                        EncodeBC7Block(block, dst); break;
+				}
+			}
+		}
+
+		if (mip + 1 < mipLevels)
+		{
+			level  = downsample(level, width, height, format == VK_FORMAT_BC7_SRGB_BLOCK);
+			width  = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+		}
+	}
+
+	return image;
+}
+
+// --------------------------------------------------------------------------
+// KTX2
+//
+
+static const uint8_t s_ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+struct Ktx2Header
+{
+	uint8_t  identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2Level
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+bool TextureCompressor::ReadKtx2(const std::string& filename, CompressedImage& image, uint32_t firstLevel)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	Ktx2Header header{};
+	if (fileSize < sizeof(Ktx2Header) || !file.read(reinterpret_cast<char*>(&header), sizeof(Ktx2Header)))
+		return false;
+
+	VkFormat format = static_cast<VkFormat>(header.vkFormat);
+	if (memcmp(header.identifier, s_ktx2Identifier, sizeof(s_ktx2Identifier)) != 0 || !IsSupportedFormat(format) ||
+		header.supercompressionScheme != 0 || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1 ||
+		header.levelCount == 0 || sizeof(Ktx2Header) + sizeof(Ktx2Level) * header.levelCount > fileSize)
+	{
+		APP_LOG_WARN("Ignoring unsupported KTX2 file {}", filename);
+		return false;
+	}
+
+	if (firstLevel >= header.levelCount)
+		return false;
+
+	std::vector<Ktx2Level> levels(header.levelCount);
+	file.read(reinterpret_cast<char*>(levels.data()), sizeof(Ktx2Level) * header.levelCount);
+
+	uint32_t blockSize = GetBlockSize(format);
+
+	// Only the requested levels are read, so a streamed texture can load its finer levels on their own
+	CompressedImage result;
+	result.format = format;
+	for (uint32_t mip = firstLevel; mip < header.levelCount; mip++)
+	{
+		Level& level = result.levels.emplace_back();
+		level.width  = std::max(1u, header.pixelWidth >> mip);
+		level.height = std::max(1u, header.pixelHeight >> mip);
+
+		uint64_t expected = static_cast<uint64_t>((level.width + 3) / 4) * ((level.height + 3) / 4) * blockSize;
+		if (levels[mip].byteLength != expected || levels[mip].byteOffset + levels[mip].byteLength > fileSize)
+		{
+			APP_LOG_WARN("Ignoring corrupt KTX2 file {}", filename);
+			return false;
+		}
+
+		level.data.resize(static_cast<size_t>(levels[mip].byteLength));
+		file.seekg(static_cast<std::streamoff>(levels[mip].byteOffset));
+		file.read(reinterpret_cast<char*>(level.data.data()), level.data.size());
+	}
+
+	if (!file.good())
+	{
+		APP_LOG_WARN("Failed to read KTX2 file {}", filename);
+		return false;
+	}
+
+	image = std::move(result);
+	return true;
+}
+
+bool TextureCompressor::WriteKtx2(const std::string& filename, const CompressedImage& image)
+{
+	uint32_t blockSize = GetBlockSize(image.format);
+	if (blockSize == 0 || image.levels.empty())
+		return false;
+
+	// Data format descriptor for a single plane block compressed format
+	bool     isBC5       = (image.format == VK_FORMAT_BC5_UNORM_BLOCK);
+	uint32_t sampleCount = isBC5 ? 2 : 1;
+
+	uint8_t colorModel = 134; // KHR_DF_MODEL_BC7
+	if (image.format == VK_FORMAT_BC4_UNORM_BLOCK)
+		colorModel = 131;
+	else if (isBC5)
+		colorModel = 132;
+
+	std::vector<uint32_t> dfd;
+	dfd.push_back(0);                                    // Total size, filled in below
+	dfd.push_back(0);                                    // Khronos vendor, basic descriptor type
+	dfd.push_back(2 | ((24 + 16 * sampleCount) << 16)); // Version 2, block size
+	dfd.push_back(colorModel | (1u << 8) | ((image.format == VK_FORMAT_BC7_SRGB_BLOCK ? 2u : 1u) << 16));
+	dfd.push_back(3 | (3 << 8));                         // 4x4 texel blocks
+	dfd.push_back(blockSize);                            // Bytes in plane 0
+	dfd.push_back(0);
+	for (uint32_t s = 0; s < sampleCount; s++)
+	{
+		uint32_t bitLength = (isBC5 ? 64 : blockSize * 8) - 1;
+		dfd.push_back((s * 64) | (bitLength << 16) | (s << 24));
+		dfd.push_back(0);
+		dfd.push_back(0);
+		dfd.push_back(UINT32_MAX);
+	}
+	dfd[0] = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+	uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+
+	Ktx2Header header{};
+	memcpy(header.identifier, s_ktx2Identifier, sizeof(s_ktx2Identifier));
+	header.vkFormat      = image.format;
+	header.typeSize      = 1;
+	header.pixelWidth    = image.levels[0].width;
+	header.pixelHeight   = image.levels[0].height;
+	header.faceCount     = 1;
+	header.levelCount    = levelCount;
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + sizeof(Ktx2Level) * levelCount);
+	header.dfdByteLength = dfd[0];
+
+	// Levels are stored smallest first, each aligned to the block size
+	std::vector<Ktx2Level> levels(levelCount);
+	uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+	for (uint32_t mip = levelCount; mip-- > 0;)
+	{
+		offset = (offset + blockSize - 1) / blockSize * blockSize;
+
+		levels[mip].byteOffset             = offset;
+		levels[mip].byteLength             = image.levels[mip].data.size();
+		levels[mip].uncompressedByteLength = image.levels[mip].data.size();
+		offset += levels[mip].byteLength;
+	}
+
+	std::string temporary = filename + ".tmp";
+	bool        written   = false;
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (file.is_open())
+		{
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Ktx2Header));
+			file.write(reinterpret_cast<const char*>(levels.data()), sizeof(Ktx2Level) * levelCount);
+			file.write(reinterpret_cast<const char*>(dfd.data()), dfd[0]);
+
+			const char padding[16] = {};
+			for (uint32_t mip = levelCount; mip-- > 0;)
+			{
+				file.write(padding, static_cast<std::streamsize>(levels[mip].byteOffset - static_cast<uint64_t>(file.tellp())));
+				file.write(reinterpret_cast<const char*>(image.levels[mip].data.data()), image.levels[mip].data.size());
+			}
+
+			written = file.good();
+		}
+	}
+
+	std::error_code error;
+	if (written)
+		std::filesystem::rename(temporary, filename, error);
+
+	if (!written || error)
+	{
+		APP_LOG_WARN("Failed to write texture cache {}", filename);
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Application/logging.h"
+
+/*****************************************************************************************************************
+ *
+ * @class TextureCompressor
+ *
+ * CPU block compression for textures. Images are encoded with their full mip chain to BC7 (color), BC5 (two
+ * channels) or BC4 (one channel) and can be stored in a KTX2 file, so later runs upload the blocks directly
+ * without decoding or encoding anything.
+ *
+ * The encoders favor speed over quality. BC7 only uses mode 6, which is a single endpoint pair per block.
+ *
+ * Example Usage:
+ *     TextureCompressor::CompressedImage image;
+ *     if (!TextureCompressor::ReadKtx2("albedo.png.bc7.ktx2", image))
+ *     {
+ *         image = TextureCompressor::Compress(pixels, width, height, VK_FORMAT_BC7_SRGB_BLOCK, 0);
+ *         TextureCompressor::WriteKtx2("albedo.png.bc7.ktx2", image);
+ *     }
+ *
+ */
+class TextureCompressor
+{
+public:
+	struct Level
+	{
+		uint32_t             width  = 0;
+		uint32_t             height = 0;
+		std::vector<uint8_t> data;
+	};
+
+	struct CompressedImage
+	{
+		VkFormat           format = VK_FORMAT_UNDEFINED;
+		std::vector<Level> levels; // Largest level first
+	};
+
+	/**
+	 * Build the mip chain of an image and encode every level.
+	 *
+	 * @param rgba: Pixels with 4 bytes each.
+	 * @param width: Width of the image.
+	 * @param height: Height of the image.
+	 * @param format: VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK or VK_FORMAT_BC4_UNORM_BLOCK.
+	 * @param channel: First channel to encode for BC4 and BC5 (0 = red, 1 = green, 2 = blue, 3 = alpha).
+	 *
+	 * @return The encoded mip chain.
+	 */
+	static CompressedImage Compress(const uint8_t* rgba, uint32_t width, uint32_t height, VkFormat format, uint32_t channel);
+
+	static bool IsSupportedFormat(VkFormat format);
+	static uint32_t GetBlockSize(VkFormat format);
+
+	// Encode one 4x4 block of RGBA pixels. The block is read row by row
+	static void EncodeBC4Block(const uint8_t* pixels, uint32_t channel, uint8_t* out);
+	static void EncodeBC5Block(const uint8_t* pixels, uint32_t channel, uint8_t* out);
+	static void EncodeBC7Block(const uint8_t* pixels, uint8_t* out);
+
+	/**
+	 * Read a KTX2 file written by WriteKtx2.
+	 *
+	 * @param filename: Path to the file.
+	 * @param image: Receives the image.
+	 * @param firstLevel: First level to read. The levels before it are skipped and not stored in the image.
+	 *
+	 * @return False if the file does not exist or does not hold a supported format.
+	 */
+	static bool ReadKtx2(const std::string& filename, CompressedImage& image, uint32_t firstLevel = 0);
+
+	// Write the image to a temporary file first and rename it, so a partially written cache is never read.
+	// Failures are logged
+	static bool WriteKtx2(const std::string& filename, const CompressedImage& image);
+};
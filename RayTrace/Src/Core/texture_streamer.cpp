@@ -0,0 +1,499 @@
+#include "pch.h"
+#include "texture_streamer.h"
+
+#include "Application/cpu_profiler.h"
+
+void TextureStreamer::init(CreateInfo& info, const std::vector<VkDescriptorImageInfo>& descriptors, const std::vector<Texture::StreamInfo>& streams)
+{
+	m_device         = info.device;
+	m_commandSystem  = info.commandSystem;
+	m_framesInFlight = info.framesInFlight;
+	m_budget         = info.budget;
+	m_maxJobs        = std::max(info.maxJobs, 1u);
+	m_idleFrames     = info.idleFrames;
+
+	uint32_t streamedCount = 0;
+	m_entries.resize(descriptors.size());
+	for (size_t i = 0; i < descriptors.size(); i++)
+	{
+		Entry& entry = m_entries[i];
+		entry.tail = descriptors[i];
+		entry.boundLevel.resize(m_framesInFlight, 0);
+
+		if (i < streams.size() && !streams[i].file.empty() && streams[i].firstLevel > 0)
+		{
+			entry.stream      = streams[i];
+			entry.firstLevel  = entry.stream.firstLevel;
+			entry.wantedLevel = entry.stream.firstLevel;
+			std::fill(entry.boundLevel.begin(), entry.boundLevel.end(), entry.stream.firstLevel);
+
+			streamedCount++;
+		}
+	}
+
+	APP_LOG_INFO("Streaming {} of {} textures ({} MB budget)", streamedCount, descriptors.size(), m_budget / (1024 * 1024));
+
+	// One feedback slot per texture and frame in flight, every slot starts without a request
+	std::vector<uint32_t> noRequests(std::max<size_t>(descriptors.size(), 1), TEXTURE_LOD_NO_REQUEST);
+
+	Buffer::CreateInfo bufferInfo{};
+	bufferInfo.data      = noRequests.data();
+	bufferInfo.dataSize  = sizeof(uint32_t) * noRequests.size();
+	bufferInfo.dataCount = static_cast<uint32_t>(noRequests.size());
+	bufferInfo.device    = m_device;
+	bufferInfo.name      = "Texture Feedback Buffer";
+
+	for (uint32_t i = 0; i < m_framesInFlight; i++)
+		m_feedbackBuffers.push_back(Buffer::CreateReadbackBuffer(bufferInfo));
+
+	m_running = true;
+	m_thread  = std::thread(&TextureStreamer::loaderThread, this);
+}
+
+void TextureStreamer::update(uint32_t frameIndex, DescriptorSet& set)
+{
+	m_frame++;
+
+	// Every set has been rewritten since these images were replaced and the frames that used them are done
+	for (size_t i = 0; i < m_retired.size();)
+	{
+		if (m_retired[i].frame <= m_frame)
+		{
+			m_retired[i].image.cleanup(m_device->getLogical());
+			m_retired[i] = m_retired.back();
+			m_retired.pop_back();
+		}
+		else
+			i++;
+	}
+
+	readFeedback(frameIndex);
+	processUploads();
+	processResults();
+	scheduleLoads();
+	writeDescriptors(frameIndex, set);
+}
+
+void TextureStreamer::recordFeedbackBarrier(VkCommandBuffer cmdBuf, uint32_t frameIndex) const
+{
+	// The host reads the feedback after waiting for the frame, which alone does not make the shader writes visible
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask       = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer              = m_feedbackBuffers[frameIndex].getBuffer();
+	barrier.offset              = 0;
+	barrier.size                = VK_WHOLE_SIZE;
+
+	VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	if (m_device->isRtxSupported())
+		srcStages |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+
+	vkCmdPipelineBarrier(cmdBuf, srcStages, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void TextureStreamer::cleanup()
+{
+	if (!m_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_condition.notify_all();
+	m_thread.join();
+
+	for (auto& upload : m_uploads)
+	{
+		m_device->getGraphicsTimeline().wait(upload.value);
+		m_commandSystem->freeSingleTimeCommands(upload.cmdBuf);
+
+		Buffer::DestroyBuffer(upload.staging, upload.stagingMemory, *m_device);
+		upload.image.cleanup(m_device->getLogical());
+	}
+
+	for (auto& retired : m_retired)
+		retired.image.cleanup(m_device->getLogical());
+
+	for (auto& entry : m_entries)
+	{
+		if (entry.image.image != VK_NULL_HANDLE)
+			entry.image.cleanup(m_device->getLogical());
+	}
+
+	for (auto& buffer : m_feedbackBuffers)
+		buffer.cleanup();
+
+	m_uploads.clear();
+	m_retired.clear();
+	m_entries.clear();
+	m_feedbackBuffers.clear();
+	m_requests.clear();
+	m_results.clear();
+}
+
+void TextureStreamer::loaderThread()
+{
+	APP_PROFILE_THREAD("Texture Streamer");
+
+	while (true)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return !m_running || !m_requests.empty(); });
+
+			if (!m_running)
+				return;
+
+			request = std::move(m_requests.front());
+			m_requests.pop_front();
+		}
+
+		request.loaded = TextureCompressor::ReadKtx2(request.file, request.image, request.firstLevel);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_results.push_back(std::move(request));
+	}
+}
+
+void TextureStreamer::readFeedback(uint32_t frameIndex)
+{
+	applyFeedback(static_cast<uint32_t*>(m_feedbackBuffers[frameIndex].getMap()), frameIndex);
+}
+
+void TextureStreamer::applyFeedback(uint32_t* feedback, uint32_t frameIndex)
+{
+	for (uint32_t i = 0; i < m_entries.size(); i++)
+	{
+		Entry& entry = m_entries[i];
+
+		uint32_t value = feedback[i];
+		feedback[i]    = TEXTURE_LOD_NO_REQUEST;
+
+		if (entry.stream.file.empty())
+			continue;
+
+		// Textures that were sampled in that frame want the level that they asked for
+		if (value != TEXTURE_LOD_NO_REQUEST)
+		{
+			entry.wantedLevel = GetWantedLevel(value, entry.boundLevel[frameIndex], entry.stream.firstLevel);
+			entry.lastUsed    = m_frame;
+		}
+		else if (m_frame - entry.lastUsed > m_idleFrames)
+			entry.wantedLevel = entry.stream.firstLevel;
+	}
+}
+
+void TextureStreamer::processUploads()
+{
+	for (size_t i = 0; i < m_uploads.size();)
+	{
+		Upload& upload = m_uploads[i];
+		if (!m_device->getGraphicsTimeline().isComplete(upload.value))
+		{
+			i++;
+			continue;
+		}
+
+		m_commandSystem->freeSingleTimeCommands(upload.cmdBuf);
+		Buffer::DestroyBuffer(upload.staging, upload.stagingMemory, *m_device);
+
+		// The size was reserved when the load was scheduled
+		Entry& entry = m_entries[upload.index];
+		VkDeviceSize size = GetLevelsSize(entry.stream, upload.firstLevel);
+		m_residentSize -= size;
+
+		setImage(upload.index, upload.image, upload.firstLevel, size);
+		entry.busy = false;
+		m_jobCount--;
+
+		m_uploads[i] = m_uploads.back();
+		m_uploads.pop_back();
+	}
+}
+
+void TextureStreamer::processResults()
+{
+	std::vector<Request> results;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::swap(results, m_results);
+	}
+
+	for (auto& result : results)
+	{
+		Entry& entry = m_entries[result.index];
+		uint32_t expectedLevels = entry.stream.levelCount - result.firstLevel;
+
+		if (!result.loaded || result.image.format != entry.stream.format || result.image.levels.size() != expectedLevels)
+		{
+			// Keep the tail for good instead of retrying a file that cannot be read
+			APP_LOG_WARN("Failed to stream texture levels from {}", result.file);
+
+			m_residentSize -= GetLevelsSize(entry.stream, result.firstLevel);
+			entry.stream.file.clear();
+			entry.busy = false;
+			m_jobCount--;
+			continue;
+		}
+
+		startUpload(result);
+	}
+}
+
+void TextureStreamer::scheduleLoads()
+{
+	// Textures that have not been used for a while fall back to their tail
+	for (uint32_t i = 0; i < m_entries.size(); i++)
+	{
+		Entry& entry = m_entries[i];
+		if (!entry.busy && entry.image.image != VK_NULL_HANDLE && entry.wantedLevel >= entry.stream.firstLevel)
+			setImage(i, Image(), entry.stream.firstLevel, 0);
+	}
+
+	if (m_jobCount >= m_maxJobs)
+		return;
+
+	// Textures that want finer levels than they have, the most recently used and the most detailed first
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0; i < m_entries.size(); i++)
+	{
+		const Entry& entry = m_entries[i];
+		if (!entry.stream.file.empty() && !entry.busy && entry.wantedLevel < entry.firstLevel)
+			candidates.push_back(i);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+		if (m_entries[a].lastUsed != m_entries[b].lastUsed)
+			return m_entries[a].lastUsed > m_entries[b].lastUsed;
+		return m_entries[a].wantedLevel < m_entries[b].wantedLevel;
+	});
+
+	for (uint32_t index : candidates)
+	{
+		if (m_jobCount >= m_maxJobs)
+			break;
+
+		Entry& entry = m_entries[index];
+		VkDeviceSize size = GetLevelsSize(entry.stream, entry.wantedLevel);
+
+		// Evict the least recently used textures until the levels fit. The image that they replace is released
+		// when they arrive, so it does not count
+		while (m_residentSize - entry.size + size > m_budget)
+		{
+			int32_t victim = -1;
+			for (uint32_t i = 0; i < m_entries.size(); i++)
+			{
+				const Entry& other = m_entries[i];
+				if (i == index || other.busy || other.image.image == VK_NULL_HANDLE || other.lastUsed >= entry.lastUsed)
+					continue;
+
+				if (victim < 0 || other.lastUsed < m_entries[victim].lastUsed)
+					victim = static_cast<int32_t>(i);
+			}
+
+			if (victim < 0)
+				break;
+
+			setImage(static_cast<uint32_t>(victim), Image(), m_entries[victim].stream.firstLevel, 0);
+		}
+
+		if (m_residentSize - entry.size + size > m_budget)
+			continue;
+
+		m_residentSize += size;
+		entry.busy      = true;
+		m_jobCount++;
+
+		Request request;
+		request.index      = index;
+		request.firstLevel = entry.wantedLevel;
+		request.file       = entry.stream.file;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(std::move(request));
+		m_condition.notify_one();
+	}
+}
+
+void TextureStreamer::writeDescriptors(uint32_t frameIndex, DescriptorSet& set)
+{
+	uint32_t frameBit = 1u << frameIndex;
+
+	// Reserved up front, the writes point into the image infos
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	std::vector<VkWriteDescriptorSet>  writes;
+	imageInfos.reserve(m_entries.size());
+	writes.reserve(m_entries.size());
+
+	for (uint32_t i = 0; i < m_entries.size(); i++)
+	{
+		Entry& entry = m_entries[i];
+		if (!(entry.dirtyFrames & frameBit))
+			continue;
+
+		VkDescriptorImageInfo imageInfo = entry.tail;
+		if (entry.image.view != VK_NULL_HANDLE)
+			imageInfo.imageView = entry.image.view;
+		imageInfos.push_back(imageInfo);
+
+		VkWriteDescriptorSet write{};
+		write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet          = set.getSet();
+		write.dstBinding      = (uint32_t)SceneBinding::TEXTURE;
+		write.dstArrayElement = i;
+		write.descriptorCount = 1;
+		write.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo      = &imageInfos.back();
+		writes.push_back(write);
+
+		entry.boundLevel[frameIndex] = entry.firstLevel;
+		entry.dirtyFrames           &= ~frameBit;
+	}
+
+	if (!writes.empty())
+		vkUpdateDescriptorSets(m_device->getLogical(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void TextureStreamer::startUpload(Request& request)
+{
+	Entry& entry = m_entries[request.index];
+	const std::vector<TextureCompressor::Level>& levels = request.image.levels;
+	uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+
+	Upload upload;
+	upload.index      = request.index;
+	upload.firstLevel = request.firstLevel;
+
+	// Copy every level into a staging buffer
+	VkDeviceSize size = 0;
+	for (const auto& level : levels)
+		size += level.data.size();
+
+	Buffer::CreateBuffer(
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		upload.staging, upload.stagingMemory,
+		*m_device,
+		MemoryCategory::STAGING,
+		"Texture Streaming Staging Buffer");
+
+	uint8_t* dst = static_cast<uint8_t*>(upload.stagingMemory.map);
+	for (const auto& level : levels)
+	{
+		memcpy(dst, level.data.data(), level.data.size());
+		dst += level.data.size();
+	}
+
+	// Create the image with the same format and swizzle as the tail
+	Image::CreateInfo imgCreateInfo{};
+	imgCreateInfo.width      = levels[0].width;
+	imgCreateInfo.height     = levels[0].height;
+	imgCreateInfo.mipLevels  = mipLevels;
+	imgCreateInfo.layerCount = 1;
+	imgCreateInfo.numSamples = VK_SAMPLE_COUNT_1_BIT;
+	imgCreateInfo.tiling     = VK_IMAGE_TILING_OPTIMAL;
+	imgCreateInfo.usage      = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imgCreateInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	imgCreateInfo.format     = entry.stream.format;
+	imgCreateInfo.device     = m_device;
+	imgCreateInfo.name       = "Streamed Texture";
+
+	upload.image = Image::CreateImage(imgCreateInfo);
+
+	Image::ImageViewSetupInfo viewSetupInfo{};
+	viewSetupInfo.format      = entry.stream.format;
+	viewSetupInfo.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewSetupInfo.mipLevels   = mipLevels;
+	viewSetupInfo.layerCount  = 1;
+	viewSetupInfo.components  = entry.stream.components;
+	viewSetupInfo.device      = m_device;
+	Image::SetupImageView(upload.image, viewSetupInfo);
+
+	// Record the copy and hand it to the GPU without waiting. Its timeline value is polled every frame
+	upload.cmdBuf = m_commandSystem->beginSingleTimeCommands();
+
+	Image::TransitionInfo transitionInfo{};
+	transitionInfo.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+	transitionInfo.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	transitionInfo.srcStageMask  = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	transitionInfo.srcAccessMask = 0;
+	transitionInfo.dstStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	transitionInfo.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	transitionInfo.levelCount    = mipLevels;
+	Image::TransitionImage(upload.cmdBuf, upload.image.image, transitionInfo);
+
+	std::vector<VkBufferImageCopy> regions(mipLevels);
+	VkDeviceSize                   offset = 0;
+	for (uint32_t level = 0; level < mipLevels; level++)
+	{
+		regions[level].bufferOffset     = offset;
+		regions[level].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+		regions[level].imageExtent      = { levels[level].width, levels[level].height, 1 };
+
+		offset += levels[level].data.size();
+	}
+
+	vkCmdCopyBufferToImage(
+		upload.cmdBuf,
+		upload.staging,
+		upload.image.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		mipLevels,
+		regions.data());
+
+	transitionInfo.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	transitionInfo.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	transitionInfo.srcStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	transitionInfo.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	transitionInfo.dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+	transitionInfo.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	Image::TransitionImage(upload.cmdBuf, upload.image.image, transitionInfo);
+
+	upload.value = m_commandSystem->submitSingleTimeCommands(upload.cmdBuf, m_device->getGraphicsQueue());
+	m_uploads.push_back(upload);
+}
+
+void TextureStreamer::setImage(uint32_t index, Image image, uint32_t firstLevel, VkDeviceSize size)
+{
+	Entry& entry = m_entries[index];
+
+	if (entry.image.image != VK_NULL_HANDLE)
+		m_retired.push_back({ entry.image, m_frame + m_framesInFlight });
+
+	m_residentSize -= entry.size;
+	m_residentSize += size;
+
+	entry.image       = image;
+	entry.firstLevel  = firstLevel;
+	entry.size        = size;
+	entry.dirtyFrames = (1u << m_framesInFlight) - 1;
+}
+
+VkDeviceSize TextureStreamer::GetLevelsSize(const Texture::StreamInfo& stream, uint32_t firstLevel)
+{
+	VkDeviceSize size      = 0;
+	uint32_t     blockSize = TextureCompressor::GetBlockSize(stream.format);
+
+	for (uint32_t level = firstLevel; level < stream.levelCount; level++)
+	{
+		uint32_t width  = std::max(stream.width >> level, 1u);
+		uint32_t height = std::max(stream.height >> level, 1u);
+		size += static_cast<VkDeviceSize>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+	}
+
+	return size;
+}
+
+uint32_t TextureStreamer::GetWantedLevel(uint32_t feedback, uint32_t boundLevel, uint32_t firstLevel)
+{
+	// The shaders measure the level against the image that was bound, and never ask for less than the tail
+	int32_t level = static_cast<int32_t>(feedback) - static_cast<int32_t>(TEXTURE_LOD_BIAS) + static_cast<int32_t>(boundLevel);
+
+	return static_cast<uint32_t>(std::clamp(level, 0, static_cast<int32_t>(firstLevel)));
+}
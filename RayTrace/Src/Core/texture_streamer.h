@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Application/logging.h"
+
+#include "device.h"
+#include "command.h"
+#include "buffer.h"
+#include "image.h"
+#include "texture.h"
+#include "texture_compression.h"
+#include "descriptor.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// Matches TEXTURE_LOD_BIAS in structures.glsl. The feedback buffer stores floor(lod) + bias so negative levels fit
+// in an unsigned value
+static const uint32_t TEXTURE_LOD_BIAS       = 16;
+static const uint32_t TEXTURE_LOD_NO_REQUEST = 0xFFFFFFFF;
+
+/*****************************************************************************************************************
+ *
+ * @class TextureStreamer
+ *
+ * Keeps the finer mip levels of streamed textures resident only while they are needed and only within a VRAM
+ * budget. A streamed texture always keeps its small tail levels (the image of the Texture). The finer levels are
+ * read from its KTX2 cache on a background thread and uploaded into a separate image that replaces the tail in the
+ * scene descriptor set.
+ *
+ * The shaders write the finest level that they want of every texture into a feedback buffer (one per frame in
+ * flight). Each frame the streamer reads the feedback of the frame that the swapchain just waited for, loads the
+ * wanted levels that fit in the budget and evicts the least recently used textures back to their tail when it does
+ * not.
+ *
+ * Descriptors are only written into the set of the current frame, which is not in use by the GPU after the
+ * swapchain image was acquired. Replaced images are destroyed once every frame in flight has rebound its set.
+ *
+ * Example Usage:
+ *     TextureStreamer::CreateInfo info{};
+ *     info.device        = &device;
+ *     info.commandSystem = &commandSystem;
+ *     streamer.init(info, sceneBuilder.getTextureInfo(), sceneBuilder.getTextureStreamInfo());
+ *
+ *     // Every frame, after the swapchain image was acquired
+ *     streamer.update(frameIndex, descriptorSets[frameIndex]);
+ *
+ *     streamer.cleanup();
+ *
+ */
+class TextureStreamer
+{
+public:
+	struct CreateInfo
+	{
+		const Device*        device         = nullptr;
+		const CommandSystem* commandSystem  = nullptr;
+		uint32_t             framesInFlight = 2;
+		VkDeviceSize         budget         = 512ull * 1024 * 1024; // Bytes of streamed levels, the tails are not counted
+		uint32_t             maxJobs        = 4;                    // Loads in flight at once
+		uint32_t             idleFrames     = 120;                  // Frames without a request before a texture falls back to its tail
+	};
+
+	TextureStreamer() = default;
+
+	/**
+	 * Start streaming the textures of a scene.
+	 *
+	 * @param info: The create info.
+	 * @param descriptors: Descriptors of the scene textures, in the order of the scene texture array.
+	 * @param streams: Stream info of every texture in the same order. Textures without a stream file are skipped.
+	 */
+	void init(CreateInfo& info, const std::vector<VkDescriptorImageInfo>& descriptors, const std::vector<Texture::StreamInfo>& streams);
+
+	/**
+	 * Read the feedback of a frame, move finished loads into the descriptor set and start new loads.
+	 *
+	 * @param frameIndex: The frame in flight that is about to be recorded. Its previous submission must be done.
+	 * @param set: The scene descriptor set of that frame.
+	 */
+	void update(uint32_t frameIndex, DescriptorSet& set);
+
+	/**
+	 * Make the feedback that the shaders wrote visible to the host. Record it at the end of every frame.
+	 *
+	 * @param cmdBuf: The last command buffer of the frame.
+	 * @param frameIndex: The frame in flight that is recorded.
+	 */
+	void recordFeedbackBarrier(VkCommandBuffer cmdBuf, uint32_t frameIndex) const;
+
+	Buffer& getFeedbackBuffer(uint32_t frameIndex) { return m_feedbackBuffers[frameIndex]; }
+	VkDeviceSize getResidentSize() const { return m_residentSize; }
+	VkDeviceSize getBudget() const { return m_budget; }
+
+	void cleanup();
+
+private:
+	struct Entry
+	{
+		Texture::StreamInfo   stream;
+		VkDescriptorImageInfo tail{};               // Descriptor of the texture's own image
+
+		Image        image;                         // Streamed levels, no image while only the tail is resident
+		uint32_t     firstLevel   = 0;              // First level of the full chain that is resident
+		VkDeviceSize size         = 0;              // Bytes of the streamed image
+		uint32_t     wantedLevel  = 0;
+		uint64_t     lastUsed     = 0;
+		bool         busy         = false;          // A load is in flight
+		uint32_t     dirtyFrames  = 0;              // Frames in flight whose set does not hold the current image yet
+
+		std::vector<uint32_t> boundLevel;           // First level bound in the set of each frame in flight
+	};
+
+	struct Request
+	{
+		uint32_t    index      = 0;
+		uint32_t    firstLevel = 0;
+		std::string file       = "";
+
+		TextureCompressor::CompressedImage image;
+		bool                               loaded = false;
+	};
+
+	struct Upload
+	{
+		uint32_t        index         = 0;
+		uint32_t        firstLevel    = 0;
+		Image           image;
+		VkBuffer        staging       = VK_NULL_HANDLE;
+		Allocation      stagingMemory;
+		VkCommandBuffer cmdBuf        = VK_NULL_HANDLE;
+		uint64_t        value         = 0; // Graphics timeline value of the copy
+	};
+
+	struct Retired
+	{
+		Image    image;
+		uint64_t frame = 0; // Frame after which the image is no longer bound anywhere
+	};
+
+	const Device*        m_device         = nullptr;
+	const CommandSystem* m_commandSystem  = nullptr;
+	uint32_t             m_framesInFlight = 2;
+	VkDeviceSize         m_budget         = 0;
+	uint32_t             m_maxJobs        = 4;
+	uint32_t             m_idleFrames     = 120;
+
+	std::vector<Entry>   m_entries;
+	std::vector<Buffer>  m_feedbackBuffers;
+	std::vector<Upload>  m_uploads;
+	std::vector<Retired> m_retired;
+
+	uint64_t     m_frame        = 0;
+	VkDeviceSize m_residentSize = 0;
+	uint32_t     m_jobCount     = 0;
+
+	// Loader thread
+	std::thread             m_thread;
+	std::mutex              m_mutex;
+	std::condition_variable m_condition;
+	std::deque<Request>     m_requests;
+	std::vector<Request>    m_results;
+	bool                    m_running = false;
+
+	void loaderThread();
+
+	void readFeedback(uint32_t frameIndex);
+	void applyFeedback(uint32_t* feedback, uint32_t frameIndex);
+	void processResults();
+	void processUploads();
+	void scheduleLoads();
+	void writeDescriptors(uint32_t frameIndex, DescriptorSet& set);
+
+	void startUpload(Request& request);
+	void setImage(uint32_t index, Image image, uint32_t firstLevel, VkDeviceSize size);
+
+	static VkDeviceSize GetLevelsSize(const Texture::StreamInfo& stream, uint32_t firstLevel);
+	static uint32_t GetWantedLevel(uint32_t feedback, uint32_t boundLevel, uint32_t firstLevel);
+};
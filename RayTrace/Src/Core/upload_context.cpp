@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "upload_context.h"
+
+#include "buffer.h"
+
+void UploadContext::init(CreateInfo& info)
+{
+	APP_LOG_INFO("Initializing upload context ({}, {} bytes)", info.name, info.size);
+
+	m_device = info.device;
+	m_name   = info.name;
+	m_size   = info.size;
+
+	Buffer::CreateBuffer(
+		m_size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_buffer, m_memory,
+		*m_device,
+		MemoryCategory::STAGING,
+		m_name);
+
+	m_map = static_cast<uint8_t*>(m_memory.map);
+
+	// Command buffers are reused once their copies are done
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = m_device->getTransferFamily();
+
+	if (vkCreateCommandPool(m_device->getLogical(), &poolInfo, nullptr, &m_pool) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create upload command pool ({})", m_name);
+		throw std::exception();
+	}
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue  = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(m_device->getLogical(), &semaphoreInfo, nullptr, &m_semaphore) != VK_SUCCESS)
+	{
+		APP_LOG_CRITICAL("Failed to create upload timeline semaphore ({})", m_name);
+		throw std::exception();
+	}
+}
+
+void UploadContext::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+
+	// Large uploads are split so that a chunk never needs more than the oldest part of the ring
+	VkDeviceSize maxChunk = std::max<VkDeviceSize>(m_size / 4, 1);
+
+	while (size > 0)
+	{
+		VkDeviceSize count  = std::min(size, maxChunk);
+		VkDeviceSize offset = reserve(count);
+
+		memcpy(m_map + offset, src, static_cast<size_t>(count));
+
+		VkBufferCopy region{};
+		region.srcOffset = offset;
+		region.dstOffset = dstOffset;
+		region.size      = count;
+		vkCmdCopyBuffer(getCommandBuffer(), m_buffer, dstBuffer, 1, &region);
+
+		src       += count;
+		dstOffset += count;
+		size      -= count;
+	}
+}
+
+uint64_t UploadContext::submit()
+{
+	if (m_cmdBuf == VK_NULL_HANDLE)
+		return m_value;
+
+	vkEndCommandBuffer(m_cmdBuf);
+	m_value++;
+
+	VkTimelineSemaphoreSubmitInfo signalInfo{};
+	signalInfo.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	signalInfo.signalSemaphoreValueCount = 1;
+	signalInfo.pSignalSemaphoreValues    = &m_value;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext                = &signalInfo;
+	submitInfo.commandBufferCount   = 1;
+	submitInfo.pCommandBuffers      = &m_cmdBuf;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores    = &m_semaphore;
+
+	m_device->getTransferTimeline().submit(submitInfo);
+
+	// Everything that is submitted to the graphics queue from now on waits for the copies
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	VkTimelineSemaphoreSubmitInfo waitInfo{};
+	waitInfo.sType                   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	waitInfo.waitSemaphoreValueCount = 1;
+	waitInfo.pWaitSemaphoreValues    = &m_value;
+
+	VkSubmitInfo waitSubmit{};
+	waitSubmit.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	waitSubmit.pNext              = &waitInfo;
+	waitSubmit.waitSemaphoreCount = 1;
+	waitSubmit.pWaitSemaphores    = &m_semaphore;
+	waitSubmit.pWaitDstStageMask  = &waitStage;
+
+	m_device->getGraphicsTimeline().submit(waitSubmit);
+
+	Submission submission;
+	submission.cmdBuf  = m_cmdBuf;
+	submission.value   = m_value;
+	submission.ringEnd = m_head;
+	m_inFlight.push_back(submission);
+
+	m_cmdBuf = VK_NULL_HANDLE;
+
+	return m_value;
+}
+
+bool UploadContext::isComplete(uint64_t value) const
+{
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(m_device->getLogical(), m_semaphore, &completed);
+
+	return completed >= value;
+}
+
+void UploadContext::wait(uint64_t value) const
+{
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores    = &m_semaphore;
+	waitInfo.pValues        = &value;
+
+	vkWaitSemaphores(m_device->getLogical(), &waitInfo, UINT64_MAX);
+}
+
+void UploadContext::cleanup()
+{
+	if (m_buffer == VK_NULL_HANDLE)
+		return;
+
+	APP_LOG_INFO("Destroying upload context ({})", m_name);
+
+	wait(submit());
+
+	vkDestroySemaphore(m_device->getLogical(), m_semaphore, nullptr);
+	vkDestroyCommandPool(m_device->getLogical(), m_pool, nullptr);
+	Buffer::DestroyBuffer(m_buffer, m_memory, *m_device);
+
+	m_inFlight.clear();
+	m_freeCmdBufs.clear();
+	m_buffer = VK_NULL_HANDLE;
+}
+
+VkDeviceSize UploadContext::reserve(VkDeviceSize size)
+{
+	for (;;)
+	{
+		retire();
+
+		// Nothing is in use, so the next copy can start at the beginning of the ring
+		if (m_inFlight.empty() && m_cmdBuf == VK_NULL_HANDLE)
+			m_head = m_tail = 0;
+
+		// A copy never wraps around the end of the ring
+		uint64_t start = m_head;
+		if (start % m_size + size > m_size)
+			start += m_size - start % m_size;
+
+		if (start + size - m_tail <= m_size)
+		{
+			m_head = start + size;
+			return static_cast<VkDeviceSize>(start % m_size);
+		}
+
+		// The space is held by copies that are still running or were not submitted yet
+		if (m_inFlight.empty())
+			submit();
+
+		APP_LOG_TRACE("Upload ring is full, waiting for copies ({})", m_name);
+		wait(m_inFlight.front().value);
+	}
+}
+
+void UploadContext::retire()
+{
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(m_device->getLogical(), m_semaphore, &completed);
+
+	while (!m_inFlight.empty() && m_inFlight.front().value <= completed)
+	{
+		m_tail = m_inFlight.front().ringEnd;
+		m_freeCmdBufs.push_back(m_inFlight.front().cmdBuf);
+		m_inFlight.pop_front();
+	}
+}
+
+VkCommandBuffer UploadContext::getCommandBuffer()
+{
+	if (m_cmdBuf != VK_NULL_HANDLE)
+		return m_cmdBuf;
+
+	if (!m_freeCmdBufs.empty())
+	{
+		m_cmdBuf = m_freeCmdBufs.back();
+		m_freeCmdBufs.pop_back();
+	}
+	else
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool        = m_pool;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(m_device->getLogical(), &allocInfo, &m_cmdBuf) != VK_SUCCESS)
+		{
+			APP_LOG_CRITICAL("Failed to allocate upload command buffer ({})", m_name);
+			throw std::exception();
+		}
+	}
+
+	// Beginning a command buffer from a pool with the reset flag also resets it
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(m_cmdBuf, &beginInfo);
+
+	return m_cmdBuf;
+}
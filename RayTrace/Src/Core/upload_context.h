@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Application/logging.h"
+#include "device.h"
+
+#include <deque>
+
+/*****************************************************************************************************************
+ *
+ * @class UploadContext
+ *
+ * Uploads buffer data through one persistently mapped staging ring. Copies are recorded into a command buffer
+ * until submit(), so the buffers of a whole model go to the GPU in a single submission. The copies run on the
+ * transfer queue when the device has one and signal a timeline semaphore.
+ *
+ * Every submission is followed by a wait on the graphics queue, so graphics work that is submitted afterwards
+ * sees the copied data without the CPU waiting for it. The CPU only waits when the ring is full and the oldest
+ * copies are still running.
+ *
+ * Destination buffers must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT, which makes Buffer share
+ * them with the transfer queue. The context is not thread safe.
+ *
+ * Example Usage:
+ *     UploadContext::CreateInfo info{};
+ *     info.device = &device;
+ *     context.init(info);
+ *
+ *     context.upload(vertexBuffer.getBuffer(), 0, vertices.data(), vertexSize);
+ *     context.upload(indexBuffer.getBuffer(), 0, indices.data(), indexSize);
+ *     uint64_t value = context.submit();
+ *
+ *     context.cleanup();
+ *
+ */
+class UploadContext
+{
+public:
+	struct CreateInfo
+	{
+		const Device* device = nullptr;
+		VkDeviceSize  size   = 64ull * 1024 * 1024;
+		const char*   name   = "Upload Context";
+	};
+
+	UploadContext() = default;
+
+	void init(CreateInfo& info);
+
+	/**
+	 * Record a copy into a device buffer. The data is copied into the ring right away, so it can be freed or
+	 * reused as soon as this returns.
+	 *
+	 * @param dstBuffer: Buffer to copy into. Must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+	 * @param dstOffset: Byte offset into the destination buffer.
+	 * @param data: Data to upload.
+	 * @param size: Size of the data in bytes.
+	 */
+	void upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+	/**
+	 * Submit the recorded copies.
+	 *
+	 * @return The value of the timeline semaphore that signals once the copies are done.
+	 */
+	uint64_t submit();
+
+	bool isComplete(uint64_t value) const;
+	void wait(uint64_t value) const;
+
+	VkSemaphore getSemaphore() const { return m_semaphore; }
+	uint64_t getSubmittedValue() const { return m_value; }
+
+	void cleanup();
+
+private:
+	struct Submission
+	{
+		VkCommandBuffer cmdBuf  = VK_NULL_HANDLE;
+		uint64_t        value   = 0;
+		uint64_t        ringEnd = 0; // Ring position after the last copy of the submission
+	};
+
+	const Device* m_device = nullptr;
+	std::string   m_name   = "";
+
+	VkCommandPool m_pool      = VK_NULL_HANDLE;
+	VkSemaphore   m_semaphore = VK_NULL_HANDLE;
+	uint64_t      m_value     = 0;
+
+	VkBuffer     m_buffer = VK_NULL_HANDLE;
+	Allocation   m_memory;
+	uint8_t*     m_map    = nullptr;
+	VkDeviceSize m_size   = 0;
+
+	// Ring positions count every byte that was ever reserved, so head - tail is the space in use
+	uint64_t m_head = 0;
+	uint64_t m_tail = 0;
+
+	VkCommandBuffer              m_cmdBuf = VK_NULL_HANDLE; // Copies recorded since the last submit
+	std::deque<Submission>       m_inFlight;
+	std::vector<VkCommandBuffer> m_freeCmdBufs;
+
+	VkDeviceSize reserve(VkDeviceSize size);
+	void retire();
+	VkCommandBuffer getCommandBuffer();
+};
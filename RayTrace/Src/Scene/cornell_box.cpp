@@ -63,46 +63,19 @@ void CornellBoxScene::onUpdate(Renderer& renderer)
 		// Cornell box
 		{
 			renderer.bindPipeline(Pipeline::LIGHTING);
-			renderer.bindVertexBuffer(m_cornellBoxModel.getVertexBuffer());
-			renderer.bindIndexBuffer(m_cornellBoxModel.getIndexBuffer());
 			renderer.bindDescriptorSets(Pipeline::LIGHTING);
 
-			renderer.pushConstants.model    = m_cornellBox.transform;
-			renderer.pushConstants.objectID = m_cornellBox.objectID;
-			renderer.bindPushConstants(Pipeline::LIGHTING);
-			renderer.drawIndexed();
+			drawModel(renderer, m_cornellBoxModel, m_cornellBox);
 		}
 
 		// Plane
-		{
-			renderer.bindPipeline(Pipeline::LIGHTING);
-			renderer.bindVertexBuffer(m_planeModel.getVertexBuffer());
-			renderer.bindIndexBuffer(m_planeModel.getIndexBuffer());
-			renderer.bindDescriptorSets(Pipeline::LIGHTING);
-
-			renderer.pushConstants.model    = m_plane.transform;
-			renderer.pushConstants.objectID = m_plane.objectID;
-			renderer.bindPushConstants(Pipeline::LIGHTING);
-			renderer.drawVertex();
-		}
+		drawModel(renderer, m_planeModel, m_plane);
 
 		// Mirrors
 		if (m_renderMirrors)
 		{
-			renderer.bindVertexBuffer(m_mirrorModel.getVertexBuffer());
-			renderer.bindIndexBuffer(m_mirrorModel.getIndexBuffer());
-
-			// Left mirror
-			renderer.pushConstants.model    = m_leftMirror.transform;
-			renderer.pushConstants.objectID = m_leftMirror.objectID;
-			renderer.bindPushConstants(Pipeline::LIGHTING);
-			renderer.drawIndexed();
-
-			// Right mirror
-			renderer.pushConstants.model    = m_rightMirror.transform;
-			renderer.pushConstants.objectID = m_rightMirror.objectID;
-			renderer.bindPushConstants(Pipeline::LIGHTING);
-			renderer.drawIndexed();
+			drawModel(renderer, m_mirrorModel, m_leftMirror);
+			drawModel(renderer, m_mirrorModel, m_rightMirror);
 		}
 
 		// Light cube
@@ -117,12 +90,15 @@ void CornellBoxScene::onUpdate(Renderer& renderer)
 			renderer.pushConstants.objectColor = renderer.ubo.lightColor;
 			renderer.bindPushConstants(Pipeline::FLAT);
 
-			renderer.drawIndexed();
+			drawBaseLevel(renderer, m_mirrorModel);
 		}
 
 		renderer.endRenderPass();
 	}
 
+	// Tone mapping on the compute queue
+	renderer.postProcess();
+
 	// Post pass
 	{
 		renderer.beginRenderPass(RenderPass::POST);
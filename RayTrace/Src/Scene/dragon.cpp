@@ -47,40 +47,64 @@ void DragonScene::onUpdate(Renderer& renderer)
 	}
 	else // Render rasterized scene
 	{
-		renderer.beginRenderPass(RenderPass::MAIN);
+		// Every object is recorded on its own job
+		renderer.beginRenderPass(RenderPass::MAIN, true);
+
+		uint32_t objectCount = m_visualizeLight ? 4 : 3;
+		renderer.recordParallel(objectCount, [&](Renderer& recorder, uint32_t first, uint32_t count) {
+			for (uint32_t i = first; i < first + count; i++)
+				drawObject(recorder, i);
+		});
+
+		renderer.endRenderPass();
+	}
+
+	// Tone mapping on the compute queue
+	renderer.postProcess();
+
+	// Post pass
+	{
+		renderer.beginRenderPass(RenderPass::POST);
 
 		renderer.setDynamicStates();
 
+		renderer.bindPipeline(Pipeline::POST);
+		renderer.bindDescriptorSets(Pipeline::POST);
+		renderer.bindPushConstants(Pipeline::POST);
+		renderer.drawVertex();
+		renderer.drawUI();
+
+		renderer.endRenderPass();
+	}
+
+	renderer.submit();
+	renderer.endFrame();
+}
+
+void DragonScene::drawObject(Renderer& renderer, uint32_t object)
+{
+	switch (object)
+	{
 		// Dragon
-		{
+		case 0:
 			renderer.bindPipeline(Pipeline::LIGHTING);
-			renderer.bindVertexBuffer(m_dragonModel.getVertexBuffer());
-			renderer.bindIndexBuffer(m_dragonModel.getIndexBuffer());
 			renderer.bindDescriptorSets(Pipeline::LIGHTING);
 
-			renderer.pushConstants.model    = m_dragon.transform;
-			renderer.pushConstants.objectID = m_dragon.objectID;
-			renderer.bindPushConstants(Pipeline::LIGHTING);
-			renderer.drawIndexed();
-		}
+			drawModel(renderer, m_dragonModel, m_dragon);
+			break;
 
 		// Plane
-		{
+		case 1:
 			renderer.bindPipeline(Pipeline::LIGHTING);
-			renderer.bindVertexBuffer(m_planeModel.getVertexBuffer());
-			renderer.bindIndexBuffer(m_planeModel.getIndexBuffer());
 			renderer.bindDescriptorSets(Pipeline::LIGHTING);
 
-			renderer.pushConstants.model    = m_plane.transform;
-			renderer.pushConstants.objectID = m_plane.objectID;
-			renderer.bindPushConstants(Pipeline::LIGHTING);
-			renderer.drawIndexed();
-		}
+			drawModel(renderer, m_planeModel, m_plane);
+			break;
 
 		// Light
-		{
+		case 2:
 			renderer.bindPipeline(Pipeline::FLAT);
-			renderer.bindVertexBuffer(m_lightModel .getVertexBuffer());
+			renderer.bindVertexBuffer(m_lightModel.getVertexBuffer());
 			renderer.bindIndexBuffer(m_lightModel.getIndexBuffer());
 			renderer.bindDescriptorSets(Pipeline::FLAT);
 
@@ -88,43 +112,26 @@ void DragonScene::onUpdate(Renderer& renderer)
 			renderer.pushConstants.objectColor = renderer.ubo.lightColor;
 			renderer.pushConstants.objectID    = m_light.objectID;
 			renderer.bindPushConstants(Pipeline::FLAT);
-			renderer.drawIndexed();
-		}
+			drawBaseLevel(renderer, m_lightModel);
+			break;
 
-		if (m_visualizeLight)
+		// Light position
+		case 3:
 		{
 			renderer.bindPipeline(Pipeline::FLAT);
 			renderer.bindVertexBuffer(m_lightModel.getVertexBuffer());
 			renderer.bindIndexBuffer(m_lightModel.getIndexBuffer());
+			renderer.bindDescriptorSets(Pipeline::FLAT);
 
 			glm::mat4 lightTransform           = glm::translate(glm::mat4(1.0f), renderer.ubo.lightPosition);
 			renderer.pushConstants.model       = glm::scale(lightTransform, glm::vec3(0.01f, 0.01f, 0.01f));
 			renderer.pushConstants.objectColor = renderer.ubo.lightColor;
 			renderer.bindPushConstants(Pipeline::FLAT);
 
-			renderer.drawIndexed();
+			drawBaseLevel(renderer, m_lightModel);
+			break;
 		}
-
-		renderer.endRenderPass();
-	}
-
-	// Post pass
-	{
-		renderer.beginRenderPass(RenderPass::POST);
-
-		renderer.setDynamicStates();
-
-		renderer.bindPipeline(Pipeline::POST);
-		renderer.bindDescriptorSets(Pipeline::POST);
-		renderer.bindPushConstants(Pipeline::POST);
-		renderer.drawVertex();
-		renderer.drawUI();
-
-		renderer.endRenderPass();
 	}
-
-	renderer.submit();
-	renderer.endFrame();
 }
 
 void DragonScene::onUnload()
@@ -33,4 +33,7 @@ private:
 
 	bool m_renderMirrors  = true;
 	bool m_visualizeLight = true;
+
+	// Records one object of the raster pass. Objects are the dragon, the plane, the light and its position
+	void drawObject(Renderer& renderer, uint32_t object);
 };
\ No newline at end of file
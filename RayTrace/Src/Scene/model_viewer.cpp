@@ -39,38 +39,35 @@ void ModelViewerScene::onUpdate(Renderer& renderer)
 	}
 	else // Render rasterized scene
 	{
-		renderer.beginRenderPass(RenderPass::MAIN);
-
-		renderer.setDynamicStates();
+		// The parts of the model are recorded in parallel
+		renderer.beginRenderPass(RenderPass::MAIN, true);
 
 		// Model
-		{
-			renderer.bindPipeline(Pipeline::LIGHTING);
-			renderer.bindVertexBuffer(m_mainModel.getVertexBuffer());
-			renderer.bindIndexBuffer(m_mainModel.getIndexBuffer());
-			renderer.bindDescriptorSets(Pipeline::LIGHTING);
-
-			renderer.pushConstants.model    = m_model.transform;
-			renderer.pushConstants.objectID = m_model.objectID;
-			renderer.bindPushConstants(Pipeline::LIGHTING);
-			renderer.drawIndexed();
-		}
+		drawModelParallel(renderer, m_mainModel, m_model);
 
 		if (m_visualizeLight)
 		{
-			renderer.bindPipeline(Pipeline::FLAT);
-
-			glm::mat4 lightTransform           = glm::translate(glm::mat4(1.0f), renderer.ubo.lightPosition);
-			renderer.pushConstants.model       = glm::scale(lightTransform, glm::vec3(0.1f, 0.1f, 0.1f));
-			renderer.pushConstants.objectColor = renderer.ubo.lightColor;
-			renderer.bindPushConstants(Pipeline::FLAT);
-
-			renderer.drawIndexed();
+			renderer.recordParallel(1, [&](Renderer& recorder, uint32_t first, uint32_t count) {
+				recorder.bindPipeline(Pipeline::FLAT);
+				recorder.bindVertexBuffer(m_mainModel.getVertexBuffer());
+				recorder.bindIndexBuffer(m_mainModel.getIndexBuffer());
+				recorder.bindDescriptorSets(Pipeline::FLAT);
+
+				glm::mat4 lightTransform           = glm::translate(glm::mat4(1.0f), recorder.ubo.lightPosition);
+				recorder.pushConstants.model       = glm::scale(lightTransform, glm::vec3(0.1f, 0.1f, 0.1f));
+				recorder.pushConstants.objectColor = recorder.ubo.lightColor;
+				recorder.bindPushConstants(Pipeline::FLAT);
+
+				drawBaseLevel(recorder, m_mainModel);
+			});
 		}
 
 		renderer.endRenderPass();
 	}
 
+	// Tone mapping on the compute queue
+	renderer.postProcess();
+
 	// Post pass
 	{
 		renderer.beginRenderPass(RenderPass::POST);
@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "scene.h"
+
+void Scene::drawModel(Renderer& renderer, Model& model, const Model::Instance& instance, Pipeline::PipelineType pipeline)
+{
+	drawGeometries(renderer, model, instance.transform, pipeline);
+
+	for (const auto& local : model.getLocalInstances())
+		drawGeometries(renderer, model.getPart(local.objectID), instance.transform * local.transform, pipeline);
+}
+
+void Scene::drawModelParallel(Renderer& renderer, Model& model, const Model::Instance& instance, Pipeline::PipelineType pipeline)
+{
+	const auto& locals = model.getLocalInstances();
+
+	// Item 0 is the model itself and the others are its parts
+	renderer.recordParallel(static_cast<uint32_t>(locals.size()) + 1, [&](Renderer& recorder, uint32_t first, uint32_t count) {
+		recorder.bindPipeline(pipeline);
+		recorder.bindDescriptorSets(pipeline);
+
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			if (i == 0)
+				drawGeometries(recorder, model, instance.transform, pipeline);
+			else
+				drawGeometries(recorder, model.getPart(locals[i - 1].objectID), instance.transform * locals[i - 1].transform, pipeline);
+		}
+	});
+}
+
+void Scene::drawGeometries(Renderer& renderer, Model& model, const glm::mat4& transform, Pipeline::PipelineType pipeline)
+{
+	renderer.bindVertexBuffer(model.getVertexBuffer());
+	renderer.bindIndexBuffer(model.getIndexBuffer());
+
+	renderer.pushConstants.model    = transform;
+	renderer.pushConstants.objectID = model.getIndex();
+
+	// Object space errors are scaled by the largest axis of the transform
+	float maxScale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+	float threshold = renderer.getLodThreshold();
+
+	// Draw each geometry separately so that the ones outside of the view can be skipped
+	for (const auto& geometry : model.getGeometries())
+	{
+		if (!renderer.isBoxVisible(geometry.minBounds, geometry.maxBounds, transform))
+			continue;
+
+		uint32_t firstIndex = geometry.firstIndex;
+		uint32_t indexCount = geometry.indexCount;
+
+		// Use the coarsest level whose error stays below the threshold on screen
+		if (!geometry.lods.empty() && threshold > 0.0f)
+		{
+			glm::vec3 center = transform * glm::vec4((geometry.minBounds + geometry.maxBounds) * 0.5f, 1.0f);
+			float     radius = glm::length(geometry.maxBounds - geometry.minBounds) * 0.5f * maxScale;
+			float     scale  = renderer.getProjectedScale(center, radius) * maxScale;
+
+			for (const auto& lod : geometry.lods)
+			{
+				if (lod.error * scale > threshold)
+					break;
+
+				firstIndex = lod.firstIndex;
+				indexCount = lod.indexCount;
+			}
+		}
+
+		renderer.pushConstants.primitiveOffset = firstIndex / 3;
+		renderer.pushConstants.materialID      = geometry.material;
+		renderer.bindPushConstants(pipeline);
+		renderer.drawIndexed(indexCount, firstIndex);
+	}
+
+	renderer.pushConstants.primitiveOffset = 0;
+	renderer.pushConstants.materialID      = -1;
+}
+
+void Scene::drawBaseLevel(Renderer& renderer, Model& model)
+{
+	for (const auto& geometry : model.getGeometries())
+		renderer.drawIndexed(geometry.indexCount, geometry.firstIndex);
+}
@@ -14,4 +14,21 @@ public:
 	virtual void onUpdate(Renderer& renderer) = 0;
 
 	virtual void onUnload() = 0;
-};
\ No newline at end of file
+
+protected:
+	// Rasterizes an instance of a model along with the repeated shapes that were split into parts. Geometries
+	// outside of the view frustum are skipped. The pipeline and descriptor sets must already be bound
+	void drawModel(Renderer& renderer, Model& model, const Model::Instance& instance, Pipeline::PipelineType pipeline = Pipeline::LIGHTING);
+
+	// Same as drawModel, but the model and its parts are recorded in parallel. Must be called inside of a parallel
+	// render pass. The pipeline and descriptor sets are bound by every range
+	void drawModelParallel(Renderer& renderer, Model& model, const Model::Instance& instance, Pipeline::PipelineType pipeline = Pipeline::LIGHTING);
+
+	// Draws every geometry of a model at full detail and without culling, for helpers like the light gizmo. The
+	// buffers and push constants must already be bound. The index buffer also holds the LODs, so it is never drawn
+	// as a whole
+	void drawBaseLevel(Renderer& renderer, Model& model);
+
+private:
+	void drawGeometries(Renderer& renderer, Model& model, const glm::mat4& transform, Pipeline::PipelineType pipeline);
+};
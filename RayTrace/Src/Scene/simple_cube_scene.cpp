@@ -37,30 +37,26 @@ void SimpleCubeScene::onUpdate(Renderer& renderer)
 
 		renderer.setDynamicStates();
 
-		// Bind buffers
-		renderer.bindVertexBuffer(m_cubeModel.getVertexBuffer());
-		renderer.bindIndexBuffer(m_cubeModel.getIndexBuffer());
-
 		// Draw main cube
 		renderer.bindPipeline(Pipeline::LIGHTING);
 		renderer.bindDescriptorSets(Pipeline::LIGHTING);
 
-		renderer.pushConstants.model = m_mainCube.transform;
-		renderer.pushConstants.objectID = m_mainCube.objectID;
-		renderer.bindPushConstants(Pipeline::LIGHTING);
-		renderer.drawIndexed();
+		drawModel(renderer, m_cubeModel, m_mainCube);
 
 
 		// Draw light cube
 		renderer.bindPipeline(Pipeline::FLAT);
 		updateLightCube(renderer);
 		renderer.bindPushConstants(Pipeline::FLAT);
-		renderer.drawIndexed();
+		drawBaseLevel(renderer, m_cubeModel);
 
 		renderer.endRenderPass();
 	}
 
 
+	// Tone mapping on the compute queue
+	renderer.postProcess();
+
 	// Post pass
 	{
 		renderer.beginRenderPass(RenderPass::POST);
@@ -21,9 +21,8 @@ layout (location = 0) out vec4 outColor;
 // Global uniform buffer
 layout (binding = 0) uniform _GlobalUniform { GlobalUniform uni; };
 
-// Material storage buffers
-layout (buffer_reference, scalar) buffer MaterialBuffer { Material m[]; };
-layout (buffer_reference, scalar) buffer MatIndexBuffer { int i[]; };
+// Material index buffer
+layout (buffer_reference, scalar) buffer MatIndexBuffer { uint i[]; };
 
 // Addresses to the storage buffers
 layout (binding = 1) buffer ObjectDescription_ { ObjectDescription i[]; } objDesc;
@@ -31,12 +30,25 @@ layout (binding = 1) buffer ObjectDescription_ { ObjectDescription i[]; } objDes
 // Texture samplers
 layout (binding = 2) uniform sampler2D[] textureSamplers;
 
+// Scene material table
+layout (binding = 3, scalar) buffer _MaterialTable { Material m[]; } materialTable;
+
+// Finest mip level that each texture needs, read by the texture streamer. Devices without stores in fragment
+// shaders get no feedback from the raster pass
+#ifdef NO_FRAGMENT_STORES
+#define TEXTURE_FEEDBACK_READONLY 1
+layout (binding = 4) readonly buffer _TextureFeedback { uint lod[]; } textureFeedback;
+#else
+layout (binding = 4) buffer _TextureFeedback { uint lod[]; } textureFeedback;
+#endif
+
 // Push constant
 layout (push_constant) uniform Constants { PushConstant pc; };
 
 #include "pbr.glsl"
 #include "random.glsl"
 #include "shade_state.glsl"
+#include "texture_feedback.glsl"
 
 vec3 computeLighting(Material mat, vec3 normal, vec3 viewDirection, vec3 lightDirection)
 {
@@ -65,28 +77,34 @@ vec3 computeLighting(Material mat, vec3 normal, vec3 viewDirection, vec3 lightDi
 
 void main()
 {
-	// Get material buffers
-	ObjectDescription objAddresses   = objDesc.i[pc.objectID];
-	MatIndexBuffer    matIndexBuffer = MatIndexBuffer(objAddresses.materialIndexAddress);
-	MaterialBuffer    materialBuffer = MaterialBuffer(objAddresses.materialAddress);
+	// Size of the pixel in uv space. Derivatives are only defined before any divergent branch
+	float uvFootprint = max(length(dFdx(texCoords)), length(dFdy(texCoords)));
+
+	// Get the material. Geometries with a single material pass it in the push constant
+	int matIndex = pc.materialID;
+	if (matIndex < 0)
+	{
+		MatIndexBuffer matIndexBuffer = MatIndexBuffer(objDesc.i[pc.objectID].materialIndexAddress);
+
+		int primitiveID = gl_PrimitiveID + pc.primitiveOffset;
+		matIndex = unpackMaterialIndex(matIndexBuffer.i[primitiveID >> 1], primitiveID);
+	}
 
-	// Get the material
-	int      matIndex = matIndexBuffer.i[gl_PrimitiveID];
-	Material material = materialBuffer.m[matIndex];
+	Material material = materialTable.m[matIndex];
 
 	vec4  albedo    = vec4(material.diffuse, 1.0);
 	vec3  normal    = fragNormal;
 	float metallic  = material.metallic;
 	float roughness = material.roughness;
 
-	if (material.textureID >= 0)
+	if (material.textureMask != 0)
 	{
-		int txtOffset = objDesc.i[pc.objectID].txtOffset;
-		sampleTextures(material, txtOffset, texCoords, albedo, normal, TBN, metallic, roughness);
+		requestTextureLods(material, uvFootprint);
+		sampleTextures(material, texCoords, albedo, normal, TBN, metallic, roughness);
 	}
 
 	// Throw out transparent pixels
-	if (albedo.a < 0.1)
+	if (albedo.a < material.alphaCutoff)
 		discard;
 
 	// Lighting
@@ -107,7 +125,8 @@ void main()
 	vec3 color   = Lo + ambient;
 
 	// Set final color
-	switch (uni.debugMode)
+	int debugMode = (SPEC_DEBUG_MODE >= 0) ? SPEC_DEBUG_MODE : uni.debugMode;
+	switch (debugMode)
 	{
 		case DEBUG_NONE:
 			outColor = vec4(color, 1.0);
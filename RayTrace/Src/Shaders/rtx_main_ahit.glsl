@@ -23,8 +23,8 @@ layout (set = 1, binding = 0) uniform _GlobalUniform { GlobalUniform uni; };
 // Object buffers
 layout (buffer_reference, scalar) buffer VertexBuffer { Vertex v[]; };
 layout (buffer_reference, scalar) buffer IndexBuffer { ivec3 i[]; };
-layout (buffer_reference, scalar) buffer MaterialBuffer { Material m[]; };
-layout (buffer_reference, scalar) buffer MatIndexBuffer { int i[]; };
+layout (buffer_reference, scalar) buffer MatIndexBuffer { uint i[]; };
+layout (buffer_reference, scalar) buffer GeometryBuffer { GeometryDescription g[]; };
 
 // Addresses to the object buffers
 layout (set = 1, binding = 1) buffer _ObjectDescription { ObjectDescription i[]; } objDesc;
@@ -32,6 +32,9 @@ layout (set = 1, binding = 1) buffer _ObjectDescription { ObjectDescription i[];
 // Texture samplers
 layout (set = 1, binding = 2) uniform sampler2D[] textureSamplers;
 
+// Scene material table
+layout (set = 1, binding = 3, scalar) buffer _MaterialTable { Material m[]; } materialTable;
+
 // Push constant
 layout (push_constant) uniform _RtxPushConstant { RtxPushConstant pc; };
 
@@ -42,21 +45,28 @@ void main()
 	// Get object buffers
 	ObjectDescription objAddresses   = objDesc.i[gl_InstanceCustomIndexEXT];
 	MatIndexBuffer    matIndexBuffer = MatIndexBuffer(objAddresses.materialIndexAddress);
-	MaterialBuffer    materialBuffer = MaterialBuffer(objAddresses.materialAddress);
 	VertexBuffer      vertexBuffer   = VertexBuffer(objAddresses.vertexAddress);
 	IndexBuffer       indexBuffer    = IndexBuffer(objAddresses.indexAddress);
+	GeometryBuffer    geometryBuffer = GeometryBuffer(objAddresses.geometryAddress);
+
+	// gl_PrimitiveID is relative to the geometry (shape) that was hit
+	GeometryDescription geometry = geometryBuffer.g[gl_GeometryIndexEXT];
+	int primitiveID = gl_PrimitiveID + int(geometry.primitiveOffset);
 
 	// Indices of the triangle
-	ivec3 indices = indexBuffer.i[gl_PrimitiveID];
+	ivec3 indices = indexBuffer.i[primitiveID];
 
 	// Vertices of the triangle
 	Vertex v0 = vertexBuffer.v[indices.x];
 	Vertex v1 = vertexBuffer.v[indices.y];
 	Vertex v2 = vertexBuffer.v[indices.z];
 
-	// Material
-	int      matIndex = matIndexBuffer.i[gl_PrimitiveID];
-	Material material = materialBuffer.m[matIndex];
+	// Material. Only geometries with more than one material need to read the material index
+	int matIndex = geometry.material;
+	if (matIndex < 0)
+		matIndex = unpackMaterialIndex(matIndexBuffer.i[primitiveID >> 1], primitiveID);
+
+	Material material = materialTable.m[matIndex];
 
 	const vec3 barycentrics = vec3(1.0 - attribs.x - attribs.y, attribs.x, attribs.y);
 
@@ -64,17 +74,15 @@ void main()
 	vec2 texCoords = v0.texCoord * barycentrics.x + v1.texCoord * barycentrics.y + v2.texCoord * barycentrics.z;
 
 	vec4 albedo = vec4(material.diffuse, 1.0);
-	if (material.textureID >= 0)
+	if (material.textureMask != 0)
 	{
-		int txtOffset = objDesc.i[gl_InstanceCustomIndexEXT].txtOffset;
-
 		vec3  dummyNormal;
 		float dummyMetal, dummyRough;
 		mat3  dummyTBN;
-		sampleTextures(material, txtOffset, texCoords, albedo, dummyNormal, dummyTBN, dummyMetal, dummyRough);
+		sampleTextures(material, texCoords, albedo, dummyNormal, dummyTBN, dummyMetal, dummyRough);
 	}
 
-	if (albedo.a < 0.1)
+	if (albedo.a < material.alphaCutoff)
 		ignoreIntersectionEXT;
 
 	if (material.illum != 7)
@@ -3,47 +3,36 @@
 
 #include "structures.glsl"
 
-void sampleTextures(Material mat, int txtOffset, vec2 txtCoord, inout vec4 albedo, inout vec3 normal, mat3 TBN, inout float metallic, inout float roughness)
+void sampleTextures(Material mat, vec2 txtCoord, inout vec4 albedo, inout vec3 normal, mat3 TBN, inout float metallic, inout float roughness)
 {
-	// Note: Textures must be sourced in the same order they were added during loading
-
-	int txtID = txtOffset + mat.textureID;
-
 	// Albedo
 	if ((mat.textureMask & ALBEDO_BIT) == ALBEDO_BIT)
 	{
-		vec4 albedoTxt = texture(textureSamplers[nonuniformEXT(txtID)], txtCoord);
+		vec4 albedoTxt = texture(textureSamplers[nonuniformEXT(mat.albedoTexture)], txtCoord);
 		albedo = albedoTxt;
 	}
 
 	// Normal
 	if ((mat.textureMask & NORMAL_BIT) == NORMAL_BIT)
 	{
-		txtID++;
-		normal = texture(textureSamplers[nonuniformEXT(txtID)], txtCoord).xyz;
-		normal = normal * 2.0 - 1.0;
-		normal = normalize(TBN * normal);
+		// Only x and y are stored when the map is BC5 compressed, so z is rebuilt from them
+		vec2 xy = texture(textureSamplers[nonuniformEXT(mat.normalTexture)], txtCoord).xy * 2.0 - 1.0;
+		normal  = normalize(TBN * vec3(xy, sqrt(max(0.0, 1.0 - dot(xy, xy)))));
 	}
 
-	// Alpha
-	if ((mat.textureMask & ALPHA_BIT) == ALPHA_BIT)
+	// Alpha, roughness and metalness share one texture
+	if ((mat.textureMask & (ALPHA_BIT | METAL_BIT | ROUGH_BIT)) != 0)
 	{
-		txtID++;
-		albedo.a = texture(textureSamplers[nonuniformEXT(txtID)], txtCoord).x;
-	}
+		vec3 maps = texture(textureSamplers[nonuniformEXT(mat.packedTexture)], txtCoord).rgb;
 
-	// Metal
-	if ((mat.textureMask & METAL_BIT) == METAL_BIT)
-	{
-		txtID++;
-		metallic = texture(textureSamplers[nonuniformEXT(txtID)], txtCoord).x;
-	}
+		if ((mat.textureMask & ALPHA_BIT) == ALPHA_BIT)
+			albedo.a = maps.r;
 
-	// Roughness
-	if ((mat.textureMask & ROUGH_BIT) == ROUGH_BIT)
-	{
-		txtID++;
-		roughness = texture(textureSamplers[nonuniformEXT(txtID)], txtCoord).x;
+		if ((mat.textureMask & ROUGH_BIT) == ROUGH_BIT)
+			roughness = maps.g;
+
+		if ((mat.textureMask & METAL_BIT) == METAL_BIT)
+			metallic = maps.b;
 	}
 }
 
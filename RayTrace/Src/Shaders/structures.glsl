@@ -16,6 +16,16 @@
 #define DEBUG_ROUGH  4
 #define DEBUG_EXTRA  5
 
+// Specialization constants of the pipeline variants. The default values leave the setting to the uniforms and
+// push constants. Matches SpecConstant in shader.h
+layout (constant_id = 0) const int  SPEC_DEBUG_MODE   = -1;
+layout (constant_id = 1) const int  SPEC_SAMPLE_COUNT = 0;
+layout (constant_id = 2) const int  SPEC_MAX_DEPTH    = 0;
+layout (constant_id = 3) const bool SPEC_REFLECTIONS  = true; // False if no material of the scene reflects
+
+// Added to the mip levels in the texture feedback buffer so they stay positive. Matches the TextureStreamer
+#define TEXTURE_LOD_BIAS 16
+
 struct GlobalUniform
 {
 	mat4 viewProjection;
@@ -35,9 +45,14 @@ struct ObjectDescription
 {
 	uint64_t vertexAddress;
 	uint64_t indexAddress;
-	uint64_t materialAddress;
 	uint64_t materialIndexAddress;
-	int txtOffset;
+	uint64_t geometryAddress;
+};
+
+struct GeometryDescription
+{
+	uint primitiveOffset;
+	int  material; // -1 if the material index buffer has to be read
 };
 
 struct Vertex
@@ -64,12 +79,17 @@ struct Material
 	int   illum;
 
 	vec3  emission;
-	int   textureID;
+	int   albedoTexture;
 
 	float roughness;
 	float metallic;
 
 	uint  textureMask;
+
+	int   normalTexture;
+	int   packedTexture; // Alpha in red, roughness in green, metalness in blue
+
+	float alphaCutoff;
 };
 
 struct PushConstant
@@ -77,8 +97,16 @@ struct PushConstant
 	mat4 model;
 	vec3 objectColor;
 	int  objectID;
+	int  primitiveOffset;
+	int  materialID;
 };
 
+// Material indices are stored as 16 bit values, two per uint
+int unpackMaterialIndex(uint packed, int primitiveID)
+{
+	return int((packed >> ((primitiveID & 1) * 16)) & 0xFFFFu);
+}
+
 struct PostPushConstant
 {
 	float exposure;
@@ -0,0 +1,42 @@
+#ifndef TEXTURE_FEEDBACK_GLSL
+#define TEXTURE_FEEDBACK_GLSL 1
+
+#include "structures.glsl"
+
+// Record the finest mip level that a texture needs for a footprint in uv space. The level is relative to the image
+// that is bound, the streamer adds the level that the image starts at
+void requestTextureLod(int index, float uvFootprint)
+{
+#ifndef TEXTURE_FEEDBACK_READONLY
+	ivec2 size  = textureSize(textureSamplers[nonuniformEXT(index)], 0);
+	float lod   = log2(max(uvFootprint * float(max(size.x, size.y)), 1e-6));
+	uint  value = uint(clamp(floor(lod) + float(TEXTURE_LOD_BIAS), 0.0, float(2 * TEXTURE_LOD_BIAS)));
+
+	// Most invocations ask for a level that is already recorded, so only the first ones pay for the atomic
+	if (value < textureFeedback.lod[index])
+		atomicMin(textureFeedback.lod[index], value);
+#endif
+}
+
+void requestTextureLods(Material mat, float uvFootprint)
+{
+	if ((mat.textureMask & ALBEDO_BIT) == ALBEDO_BIT)
+		requestTextureLod(mat.albedoTexture, uvFootprint);
+
+	if ((mat.textureMask & NORMAL_BIT) == NORMAL_BIT)
+		requestTextureLod(mat.normalTexture, uvFootprint);
+
+	if ((mat.textureMask & (ALPHA_BIT | METAL_BIT | ROUGH_BIT)) != 0)
+		requestTextureLod(mat.packedTexture, uvFootprint);
+}
+
+// Footprint of a ray cone on a triangle in uv space. The cone width is the width of the ray at the hit point
+float rayConeFootprint(vec3 p0, vec3 p1, vec3 p2, vec2 t0, vec2 t1, vec2 t2, float coneWidth)
+{
+	float worldArea = length(cross(p1 - p0, p2 - p0));
+	float uvArea    = abs((t1.x - t0.x) * (t2.y - t0.y) - (t2.x - t0.x) * (t1.y - t0.y));
+
+	return coneWidth * sqrt(uvArea / max(worldArea, 1e-12));
+}
+
+#endif
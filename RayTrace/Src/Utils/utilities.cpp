@@ -0,0 +1,49 @@
+#include "pch.h"
+#include "utilities.h"
+
+uint64_t hashBytes(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+std::string quoteJson(const std::string& text)
+{
+	static const char hexDigits[] = "0123456789abcdef";
+
+	std::string result = "\"";
+	for (char c : text)
+	{
+		switch (c)
+		{
+			case '"':  result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\b': result += "\\b";  break;
+			case '\f': result += "\\f";  break;
+			case '\n': result += "\\n";  break;
+			case '\r': result += "\\r";  break;
+			case '\t': result += "\\t";  break;
+
+			default:
+				// The remaining control characters have no short escape
+				if (static_cast<uint8_t>(c) < 0x20)
+				{
+					result += "\\u00";
+					result += hexDigits[c >> 4];
+					result += hexDigits[c & 0xF];
+				}
+				else
+					result += c;
+		}
+	}
+
+	return result + "\"";
+}
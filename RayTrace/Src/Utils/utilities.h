@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// 64 bit FNV-1a hash of a block of bytes. Caches store it on disk, so the result must never change
+uint64_t hashBytes(const void* data, size_t size);
+
+// The text as a JSON string, including the quotes. Quotes, backslashes and control characters are escaped
+std::string quoteJson(const std::string& text);
@@ -14,7 +14,12 @@ class ShaderCompiler:
         executable = f"../Vendor/VulkanSDK/{vulkan_version}/Bin/glslc.exe"
         source_dir = "../RayTrace/Src/Shaders"
         bin_dir    = "../Bin/Shaders"
-        extensions = ["*.vert", "*.frag", "*.rgen", "*.rchit", "*.rmiss", "*.rahit"]
+        extensions = ["*.vert", "*.frag", "*.rgen", "*.rchit", "*.rmiss", "*.rahit", "*.comp"]
+
+        # Every shader is also compiled with each of these defines, for devices that lack a feature. The variant
+        # of lighting.frag with NO_FRAGMENT_STORES is written to lighting_frag_no_fragment_stores.spv. The runtime
+        # shader compiler falls back to these variants, and refuses to load a shader that has none
+        variants = ["NO_FRAGMENT_STORES"]
 
         # Find all shader sources to compile
         source_paths = []
@@ -30,6 +35,12 @@ class ShaderCompiler:
             print(f"Compiling [{source_path}] ---> [{bin_path}]")
             subprocess.run([executable, source_path, "-o", bin_path, "--target-env=vulkan1.3"])
 
+            for define in variants:
+                variant_path = f"{bin_dir}/{name}_{ext[1:]}_{define.lower()}.spv"
+
+                print(f"Compiling [{source_path}] ({define}) ---> [{variant_path}]")
+                subprocess.run([executable, source_path, "-o", variant_path, "--target-env=vulkan1.3", f"-D{define}"])
+
         print("Compilation finished")
 
     def _find_vulkan_version(self) -> str:
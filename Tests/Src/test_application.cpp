@@ -369,5 +369,509 @@ namespace ApplicationTest
 			Assert::IsTrue(test.objectID == 0);
 		}
 
+		// Appends a shape with one vertex per index, the way the OBJ loader stores it
+		static void AddShape(SceneBuilder::ObjLoader& loader, const std::vector<Vertex>& shape)
+		{
+			SceneBuilder::ObjLoader::ShapeRange range{};
+			range.firstIndex    = static_cast<uint32_t>(loader.indices.size());
+			range.indexCount    = static_cast<uint32_t>(shape.size());
+			range.firstVertex   = static_cast<uint32_t>(loader.vertices.size());
+			range.vertexCount   = static_cast<uint32_t>(shape.size());
+			range.firstGeometry = static_cast<uint32_t>(loader.geometries.size());
+			range.geometryCount = 1;
+
+			for (const Vertex& vertex : shape)
+			{
+				loader.indices.push_back(static_cast<uint32_t>(loader.vertices.size()));
+				loader.vertices.push_back(vertex);
+			}
+			loader.matIndex.insert(loader.matIndex.end(), shape.size() / 3, 0);
+
+			loader.shapeRanges.push_back(range);
+			loader.addGeometry(range.firstIndex, range.indexCount, true);
+		}
+
+		// A tetrahedron with a different extent along every axis, so its principal axes are well defined
+		static std::vector<Vertex> MakeTetrahedron(const glm::mat4& transform)
+		{
+			const glm::vec3 corners[4] = { { 0.0f, 0.0f, 0.0f }, { 2.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.5f } };
+			const uint32_t  faces[12]  = { 0, 2, 1, 0, 1, 3, 0, 3, 2, 1, 2, 3 };
+
+			std::vector<Vertex> shape;
+			for (uint32_t f = 0; f < 12; f += 3)
+			{
+				glm::vec3 p0 = glm::vec3(transform * glm::vec4(corners[faces[f]], 1.0f));
+				glm::vec3 p1 = glm::vec3(transform * glm::vec4(corners[faces[f + 1]], 1.0f));
+				glm::vec3 p2 = glm::vec3(transform * glm::vec4(corners[faces[f + 2]], 1.0f));
+
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					Vertex vertex{};
+					vertex.pos      = (i == 0) ? p0 : (i == 1) ? p1 : p2;
+					vertex.normal   = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+					vertex.texCoord = glm::vec2(0.1f * float(f + i), 0.5f);
+					shape.push_back(vertex);
+				}
+			}
+
+			return shape;
+		}
+
+		TEST_METHOD(RepeatedShapes)
+		{
+			glm::mat4 moved = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f)) * glm::rotate(glm::mat4(1.0f), 1.0f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+
+			SceneBuilder::ObjLoader loader;
+			AddShape(loader, MakeTetrahedron(glm::mat4(1.0f)));
+			AddShape(loader, MakeTetrahedron(moved));
+
+			// Two copies that only differ by less than the old matching tolerance, one in a position and one in
+			// a texture coordinate. They land in the same hash bucket but are different shapes
+			std::vector<Vertex> nearPosition = MakeTetrahedron(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 3.0f, 0.0f)));
+			nearPosition[4].pos.x += 3e-5f;
+			AddShape(loader, nearPosition);
+
+			std::vector<Vertex> nearTexCoord = MakeTetrahedron(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 4.0f)));
+			nearTexCoord[7].texCoord.x += 1e-6f;
+			AddShape(loader, nearTexCoord);
+
+			std::vector<SceneBuilder::ObjLoader::InstanceGroup> groups = loader.findInstances();
+			Assert::IsTrue(groups.size() == 1);
+			Assert::IsTrue(groups[0].shapes == std::vector<uint32_t>({ 0, 1 }));
+
+			// The transform places the prototype onto the copy
+			for (uint32_t i = 0; i < 12; i++)
+			{
+				glm::vec3 placed = glm::vec3(groups[0].transforms[1] * glm::vec4(loader.vertices[i].pos, 1.0f));
+				Assert::IsTrue(glm::length(placed - loader.vertices[12 + i].pos) < 1e-5f);
+			}
+
+			// The extracted shapes are rebased onto their own buffers
+			SceneBuilder::ObjLoader part = loader.extractShapes({ 1, 3 });
+			Assert::IsTrue(part.shapeRanges.size() == 2 && part.geometries.size() == 2);
+			Assert::IsTrue(part.vertices.size() == 24 && part.indices.size() == 24 && part.matIndex.size() == 8);
+
+			const auto& second = part.shapeRanges[1];
+			Assert::IsTrue(second.firstIndex == 12 && second.firstVertex == 12 && second.firstGeometry == 1);
+			Assert::IsTrue(part.geometries[1].firstIndex == 12 && part.geometries[1].indexCount == 12);
+
+			for (uint32_t i = 0; i < 12; i++)
+			{
+				Assert::IsTrue(part.indices[i] == i && part.indices[12 + i] == 12 + i);
+				Assert::IsTrue(part.vertices[i].pos == loader.vertices[12 + i].pos);
+				Assert::IsTrue(part.vertices[12 + i].texCoord == loader.vertices[36 + i].texCoord);
+			}
+		}
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Mesh Simplifier
+	//
+	TEST_CLASS(MeshSimplifierTest)
+	{
+	public:
+		TEST_METHOD(GridLodChain)
+		{
+			// A flat grid of 32 by 32 quads, its outline is a boundary so the corners must survive
+			const uint32_t size = 32;
+
+			std::vector<Vertex> vertices;
+			for (uint32_t y = 0; y <= size; y++)
+			{
+				for (uint32_t x = 0; x <= size; x++)
+				{
+					Vertex vertex{};
+					vertex.pos = glm::vec3(float(x) / size, 0.0f, float(y) / size);
+					vertices.push_back(vertex);
+				}
+			}
+
+			std::vector<uint32_t> indices;
+			for (uint32_t y = 0; y < size; y++)
+			{
+				for (uint32_t x = 0; x < size; x++)
+				{
+					uint32_t i = y * (size + 1) + x;
+					indices.insert(indices.end(), { i, i + size + 1, i + 1 });
+					indices.insert(indices.end(), { i + 1, i + size + 1, i + size + 2 });
+				}
+			}
+
+			std::vector<MeshSimplifier::Lod> lods = MeshSimplifier::BuildLodChain(vertices, indices.data(), (uint32_t)indices.size(), 4);
+			Assert::IsFalse(lods.empty());
+
+			size_t previousTriangles = indices.size() / 3;
+			for (const MeshSimplifier::Lod& lod : lods)
+			{
+				Assert::IsTrue(lod.indices.size() % 3 == 0);
+				Assert::IsTrue(lod.indices.size() / 3 < previousTriangles);
+				Assert::IsTrue(lod.sourceTriangles.size() == lod.indices.size() / 3);
+				previousTriangles = lod.indices.size() / 3;
+
+				glm::vec3 minBounds(FLT_MAX);
+				glm::vec3 maxBounds(-FLT_MAX);
+				for (uint32_t index : lod.indices)
+				{
+					Assert::IsTrue(index < vertices.size());
+					minBounds = glm::min(minBounds, vertices[index].pos);
+					maxBounds = glm::max(maxBounds, vertices[index].pos);
+				}
+
+				Assert::IsTrue(minBounds == glm::vec3(0.0f));
+				Assert::IsTrue(maxBounds == glm::vec3(1.0f, 0.0f, 1.0f));
+			}
+		}
+
+		TEST_METHOD(TextureSeam)
+		{
+			// A grid of 32 by 32 quads with a texture seam down the middle. Both halves have their own vertices
+			// on the seam, with texture coordinates from different parts of the texture
+			const uint32_t size = 32;
+			const uint32_t half = size / 2;
+
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> left((size + 1) * (size + 1)), right((size + 1) * (size + 1));
+			for (uint32_t y = 0; y <= size; y++)
+			{
+				for (uint32_t x = 0; x <= size; x++)
+				{
+					Vertex vertex{};
+					vertex.pos = glm::vec3(float(x) / size, 0.0f, float(y) / size);
+
+					if (x <= half)
+					{
+						vertex.texCoord = glm::vec2(float(x) / size, float(y) / size);
+						left[y * (size + 1) + x] = static_cast<uint32_t>(vertices.size());
+						vertices.push_back(vertex);
+					}
+					if (x >= half)
+					{
+						vertex.texCoord = glm::vec2(float(x) / size + 1.0f, float(y) / size);
+						right[y * (size + 1) + x] = static_cast<uint32_t>(vertices.size());
+						vertices.push_back(vertex);
+					}
+				}
+			}
+
+			std::vector<uint32_t> indices;
+			for (uint32_t y = 0; y < size; y++)
+			{
+				for (uint32_t x = 0; x < size; x++)
+				{
+					const std::vector<uint32_t>& side = (x < half) ? left : right;
+
+					uint32_t i = y * (size + 1) + x;
+					indices.insert(indices.end(), { side[i], side[i + size + 1], side[i + 1] });
+					indices.insert(indices.end(), { side[i + 1], side[i + size + 1], side[i + size + 2] });
+				}
+			}
+
+			std::vector<MeshSimplifier::Lod> lods = MeshSimplifier::BuildLodChain(vertices, indices.data(), (uint32_t)indices.size(), 4);
+			Assert::IsFalse(lods.empty());
+			Assert::IsTrue(lods.back().indices.size() < indices.size() / 2);
+
+			for (const MeshSimplifier::Lod& lod : lods)
+			{
+				// Every vertex of the seam is still used
+				for (uint32_t y = 0; y <= size; y++)
+				{
+					glm::vec3 seam(0.5f, 0.0f, float(y) / size);
+					Assert::IsTrue(std::any_of(lod.indices.begin(), lod.indices.end(), [&](uint32_t index) { return vertices[index].pos == seam; }));
+				}
+
+				// No triangle mixes the texture coordinates of the two halves
+				for (size_t i = 0; i < lod.indices.size(); i += 3)
+				{
+					bool leftSide = vertices[lod.indices[i]].texCoord.x <= 0.5f;
+					Assert::IsTrue((vertices[lod.indices[i + 1]].texCoord.x <= 0.5f) == leftSide);
+					Assert::IsTrue((vertices[lod.indices[i + 2]].texCoord.x <= 0.5f) == leftSide);
+				}
+			}
+		}
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Gltf
+	//
+	TEST_CLASS(GltfTest)
+	{
+	public:
+		// Builds a GLB container with the JSON chunk padded by spaces and the binary chunk padded by zeros
+		static std::vector<uint8_t> MakeGlb(std::string json, std::vector<uint8_t> bin)
+		{
+			json.resize((json.size() + 3) & ~size_t(3), ' ');
+			bin.resize((bin.size() + 3) & ~size_t(3), 0);
+
+			std::vector<uint8_t> glb;
+			auto writeU32 = [&](uint32_t value) {
+				glb.insert(glb.end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + 4);
+			};
+
+			writeU32(0x46546C67); // "glTF"
+			writeU32(2);
+			writeU32(static_cast<uint32_t>(12 + 8 + json.size() + (bin.empty() ? 0 : 8 + bin.size())));
+
+			writeU32(static_cast<uint32_t>(json.size()));
+			writeU32(0x4E4F534A); // "JSON"
+			glb.insert(glb.end(), json.begin(), json.end());
+
+			if (!bin.empty())
+			{
+				writeU32(static_cast<uint32_t>(bin.size()));
+				writeU32(0x004E4942); // "BIN"
+				glb.insert(glb.end(), bin.begin(), bin.end());
+			}
+
+			return glb;
+		}
+
+		template<typename T>
+		static void Append(std::vector<uint8_t>& bytes, std::initializer_list<T> values)
+		{
+			for (T value : values)
+				bytes.insert(bytes.end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + sizeof(T));
+		}
+
+		static bool Near(glm::vec3 a, glm::vec3 b)
+		{
+			return glm::length(a - b) < 1e-5f;
+		}
+
+		TEST_METHOD(GlbChunks)
+		{
+			std::vector<uint8_t> glb = MakeGlb(
+				R"({ "buffers": [ { "byteLength": 8 } ], "bufferViews": [ { "buffer": 0, "byteOffset": 4, "byteLength": 4 } ] })",
+				{ 1, 2, 3, 4, 5, 6, 7, 8 });
+
+			GltfFile gltf;
+			Assert::IsTrue(gltf.loadFromMemory(glb.data(), glb.size()));
+			Assert::IsTrue(gltf.getJson()["buffers"].size() == 1);
+
+			size_t size = 0;
+			const uint8_t* view = gltf.getBufferView(0, &size);
+			Assert::IsTrue(view != nullptr && size == 4);
+			Assert::IsTrue(view[0] == 5 && view[3] == 8);
+
+			// Views outside of their buffer are rejected
+			Assert::IsTrue(gltf.getBufferView(1, &size) == nullptr);
+		}
+
+		TEST_METHOD(TruncatedGlb)
+		{
+			std::vector<uint8_t> glb = MakeGlb(R"({ "asset": { "version": "2.0" } })", { 1, 2, 3, 4 });
+
+			// Missing the end of the file
+			{
+				GltfFile gltf;
+				Assert::IsFalse(gltf.loadFromMemory(glb.data(), glb.size() - 4));
+			}
+
+			// A chunk that runs past the declared length
+			{
+				std::vector<uint8_t> bad = glb;
+				uint32_t length = static_cast<uint32_t>(bad.size()) - 4;
+				memcpy(bad.data() + 8, &length, sizeof(uint32_t));
+
+				GltfFile gltf;
+				Assert::IsFalse(gltf.loadFromMemory(bad.data(), bad.size()));
+			}
+
+			// Only part of a chunk header
+			{
+				std::vector<uint8_t> bad = glb;
+				bad.insert(bad.end(), { 4, 0, 0, 0 });
+				uint32_t length = static_cast<uint32_t>(bad.size());
+				memcpy(bad.data() + 8, &length, sizeof(uint32_t));
+
+				GltfFile gltf;
+				Assert::IsFalse(gltf.loadFromMemory(bad.data(), bad.size()));
+			}
+		}
+
+		TEST_METHOD(MisalignedChunk)
+		{
+			// A JSON chunk of 5 bytes without padding
+			std::vector<uint8_t> glb;
+			Append<uint32_t>(glb, { 0x46546C67, 2, 12 + 8 + 5, 5, 0x4E4F534A });
+			glb.insert(glb.end(), { '{', ' ', ' ', ' ', '}' });
+
+			GltfFile gltf;
+			Assert::IsFalse(gltf.loadFromMemory(glb.data(), glb.size()));
+		}
+
+		TEST_METHOD(AccessorStrideAndOffset)
+		{
+			// Four bytes of padding, then three interleaved vertices with a position and a 16 bit texture
+			// coordinate, followed by three 16 bit indices
+			std::vector<uint8_t> bin(4, 0xFF);
+			for (uint16_t i = 0; i < 3; i++)
+			{
+				Append<float>(bin, { float(i), float(i) * 2.0f, float(i) * 3.0f });
+				Append<uint16_t>(bin, { uint16_t(i * 100), 65535 });
+			}
+			Append<uint16_t>(bin, { 2, 0, 1 });
+
+			std::vector<uint8_t> glb = MakeGlb(R"({
+				"buffers": [ { "byteLength": 58 } ],
+				"bufferViews": [
+					{ "buffer": 0, "byteOffset": 4, "byteLength": 48, "byteStride": 16 },
+					{ "buffer": 0, "byteOffset": 52, "byteLength": 6 },
+					{ "buffer": 0, "byteOffset": 4, "byteLength": 48, "byteStride": 8 }
+				],
+				"accessors": [
+					{ "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3" },
+					{ "bufferView": 0, "byteOffset": 12, "componentType": 5123, "normalized": true, "count": 3, "type": "VEC2" },
+					{ "bufferView": 1, "componentType": 5123, "count": 3, "type": "SCALAR" },
+					{ "bufferView": 0, "byteOffset": 12, "componentType": 5126, "count": 3, "type": "VEC3" },
+					{ "bufferView": 2, "componentType": 5126, "count": 3, "type": "VEC3" }
+				]
+			})", bin);
+
+			GltfFile gltf;
+			Assert::IsTrue(gltf.loadFromMemory(glb.data(), glb.size()));
+
+			GltfFile::Accessor positions = gltf.getAccessor(0);
+			Assert::IsTrue(positions.count == 3 && positions.stride == 16 && positions.components == 3);
+			Assert::IsTrue(positions.readFloat(2, 0) == 2.0f);
+			Assert::IsTrue(positions.readFloat(2, 1) == 4.0f);
+			Assert::IsTrue(positions.readFloat(2, 2) == 6.0f);
+
+			GltfFile::Accessor texCoords = gltf.getAccessor(1);
+			Assert::IsTrue(texCoords.count == 3 && texCoords.stride == 16);
+			Assert::IsTrue(texCoords.readFloat(1, 0) == 100.0f / 65535.0f);
+			Assert::IsTrue(texCoords.readFloat(1, 1) == 1.0f);
+
+			GltfFile::Accessor indices = gltf.getAccessor(2);
+			Assert::IsTrue(indices.count == 3);
+			Assert::IsTrue(indices.readIndex(0) == 2 && indices.readIndex(1) == 0 && indices.readIndex(2) == 1);
+
+			// The last element would end past the view, and a stride smaller than an element is invalid
+			Assert::IsTrue(gltf.getAccessor(3).count == 0);
+			Assert::IsTrue(gltf.getAccessor(4).count == 0);
+
+			// Missing accessors are empty
+			Assert::IsTrue(gltf.getAccessor(5).count == 0);
+			Assert::IsTrue(gltf.getAccessor(-1).count == 0);
+		}
+
+		TEST_METHOD(NodeHierarchy)
+		{
+			// One triangle placed twice: by a child node under a translated parent and by a second root node
+			std::vector<uint8_t> bin;
+			Append<float>(bin, { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f });
+
+			std::vector<uint8_t> glb = MakeGlb(R"({
+				"buffers": [ { "byteLength": 36 } ],
+				"bufferViews": [ { "buffer": 0, "byteLength": 36 } ],
+				"accessors": [ { "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3" } ],
+				"meshes": [ { "primitives": [ { "attributes": { "POSITION": 0 } } ] } ],
+				"nodes": [
+					{ "translation": [ 1, 0, 0 ], "children": [ 1 ] },
+					{ "scale": [ 2, 2, 2 ], "mesh": 0 },
+					{ "matrix": [ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 5, 1 ], "mesh": 0 }
+				],
+				"scenes": [ { "nodes": [ 0, 2 ] } ]
+			})", bin);
+
+			SceneBuilder::ObjLoader loader;
+			loader.gltf = std::make_shared<GltfFile>();
+			Assert::IsTrue(loader.gltf->loadFromMemory(glb.data(), glb.size()));
+			loader.readGltf();
+
+			// The mesh is stored once in the space of one of its nodes and the other node becomes an instance
+			Assert::IsTrue(loader.shapeRanges.size() == 1);
+			Assert::IsTrue(loader.vertices.size() == 3 && loader.indices.size() == 3);
+			Assert::IsTrue(loader.nodeInstances.size() == 1);
+
+			const auto& group = loader.nodeInstances[0];
+			Assert::IsTrue(group.shapes.size() == 2 && group.transforms.size() == 2);
+			Assert::IsTrue(group.transforms[0] == glm::mat4(1.0f));
+
+			// Placing the first vertex with each instance transform gives its position under both nodes
+			glm::vec3 first  = glm::vec3(group.transforms[0] * glm::vec4(loader.vertices[0].pos, 1.0f));
+			glm::vec3 second = glm::vec3(group.transforms[1] * glm::vec4(loader.vertices[0].pos, 1.0f));
+
+			glm::vec3 underParent(3.0f, 0.0f, 0.0f);
+			glm::vec3 underRoot(1.0f, 0.0f, 5.0f);
+			Assert::IsTrue((Near(first, underParent) && Near(second, underRoot)) || (Near(first, underRoot) && Near(second, underParent)));
+		}
+
+		TEST_METHOD(MalformedJson)
+		{
+			// Every document is rejected with a logged error instead of an exception
+			const std::vector<std::string> documents = {
+				"",
+				"{ \"asset\": ",
+				"{ \"asset\" 1 }",
+				"{ \"a\": [ 1, 2 }",
+				"{ \"a\": tru }",
+				"{ \"a\": \"unterminated }",
+				"{ \"a\": \"\\x\" }",
+				"{ \"a\": \"\\ud83d\" }",
+				"{ \"a\": \"\\ud83d\\u0041\" }",
+				"{ \"a\": \"\\ud83d\\ud83d\" }",
+				"{ \"a\": \"\\ude00\" }",
+				"{ \"a\": 1 } trailing",
+				"[ 1, 2, 3 ]",
+				std::string(10000, '['),
+			};
+
+			for (const std::string& document : documents)
+			{
+				GltfFile gltf;
+				Assert::IsFalse(gltf.loadFromMemory(reinterpret_cast<const uint8_t*>(document.data()), document.size()));
+				Assert::IsTrue(gltf.getJson().isNull());
+			}
+
+			// The same for the JSON chunk of a GLB
+			std::vector<uint8_t> glb = MakeGlb("{ \"buffers\": [ ", {});
+
+			GltfFile gltf;
+			Assert::IsFalse(gltf.loadFromMemory(glb.data(), glb.size()));
+		}
+
+		TEST_METHOD(UnicodeEscapes)
+		{
+			std::string document = "{ \"a\": \"\\u00e9\\ud83d\\ude00\" }";
+
+			GltfFile gltf;
+			Assert::IsTrue(gltf.loadFromMemory(reinterpret_cast<const uint8_t*>(document.data()), document.size()));
+			Assert::AreEqual(std::string("\xC3\xA9\xF0\x9F\x98\x80"), gltf.getJson()["a"].getString());
+		}
+
+		TEST_METHOD(MissingFiles)
+		{
+			// Files and buffers that can not be read are reported through the return value
+			GltfFile missing;
+			Assert::IsFalse(missing.load("missing.gltf"));
+
+			std::string document = R"({ "buffers": [ { "uri": "missing.bin", "byteLength": 4 } ] })";
+
+			GltfFile gltf;
+			Assert::IsFalse(gltf.loadFromMemory(reinterpret_cast<const uint8_t*>(document.data()), document.size()));
+		}
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Utilities
+	//
+	TEST_CLASS(UtilitiesTest)
+	{
+	public:
+		TEST_METHOD(HashBytes)
+		{
+			// Reference values of 64 bit FNV-1a
+			Assert::IsTrue(hashBytes("", 0) == 14695981039346656037ull);
+			Assert::IsTrue(hashBytes("a", 1) == 0xaf63dc4c8601ec8cull);
+			Assert::IsTrue(hashBytes("foobar", 6) == 0x85944171f73967e8ull);
+		}
+
+		TEST_METHOD(QuoteJson)
+		{
+			Assert::AreEqual(std::string("\"Vertex Buffer\""), quoteJson("Vertex Buffer"));
+			Assert::AreEqual(std::string("\"a \\\"b\\\" c:\\\\d\""), quoteJson("a \"b\" c:\\d"));
+			Assert::AreEqual(std::string("\"\\n\\t\\r\\b\\f\""), quoteJson("\n\t\r\b\f"));
+			Assert::AreEqual(std::string("\"\\u0001\\u001f\""), quoteJson(std::string("\x01\x1f")));
+		}
 	};
 }
\ No newline at end of file
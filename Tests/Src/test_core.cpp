@@ -161,6 +161,63 @@ namespace CoreTest
 		}
 	};
 
+	// ---------------------------------------------------------------------------------------------------------
+	// Pipeline Cache
+	//
+	TEST_CLASS(PipelineCacheTest)
+	{
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			m_window.init(100, 100);
+			m_context.init(m_window);
+		}
+
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			m_context.cleanup();
+			m_window.cleanup();
+		}
+
+		TEST_METHOD(RejectsDamagedFile)
+		{
+			const Device& device = m_context.getDevice();
+
+			PipelineCache::CreateInfo info{};
+			info.physical = device.getPhysical();
+			info.logical  = device.getLogical();
+			info.filename = "pipeline_cache_test.bin";
+
+			PipelineCache cache;
+			cache.init(info);
+			Assert::IsTrue(cache.save());
+			cache.cleanup();
+
+			// A file that this device wrote is loaded
+			PipelineCache reloaded;
+			reloaded.init(info);
+			Assert::IsFalse(reloaded.loadFile().empty());
+
+			// Flip a byte of the driver data
+			std::vector<char> bytes;
+			{
+				std::ifstream file(info.filename, std::ios::binary);
+				bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+			bytes.back() ^= 0x5a;
+			{
+				std::ofstream file(info.filename, std::ios::binary | std::ios::trunc);
+				file.write(bytes.data(), bytes.size());
+			}
+
+			Assert::IsTrue(reloaded.loadFile().empty());
+			reloaded.cleanup();
+		}
+
+	private:
+		Window        m_window;
+		SystemContext m_context;
+	};
+
 	// ---------------------------------------------------------------------------------------------------------
 	// Buffer
 	//
@@ -200,12 +257,318 @@ namespace CoreTest
 			buffer.cleanup();
 		}
 
+		TEST_METHOD(SubAllocation)
+		{
+			MemoryAllocator&       allocator = m_context.getDevice().getAllocator();
+			MemoryAllocator::Stats before    = allocator.getStats();
+
+			Buffer::CreateInfo info;
+			info.device = &m_context.getDevice();
+			info.dataSize = 1000;
+
+			Buffer a = Buffer::CreateScratchBuffer(info);
+			Buffer b = Buffer::CreateScratchBuffer(info);
+
+			// Small buffers share one block without overlapping
+			const Allocation& allocA = a.getAllocation();
+			const Allocation& allocB = b.getAllocation();
+			Assert::IsTrue(allocA.memory == allocB.memory);
+			Assert::IsTrue(allocA.offset + allocA.size <= allocB.offset || allocB.offset + allocB.size <= allocA.offset);
+			Assert::IsTrue(allocator.getStats().allocationCount == before.allocationCount + 2);
+
+			a.cleanup();
+			b.cleanup();
+
+			Assert::IsTrue(allocator.getStats().allocationCount == before.allocationCount);
+			Assert::IsTrue(allocator.getStats().usedBytes == before.usedBytes);
+		}
+
+		TEST_METHOD(CategoryTracking)
+		{
+			MemoryAllocator&       allocator = m_context.getDevice().getAllocator();
+			MemoryAllocator::Stats before    = allocator.getStats();
+			size_t                 geometry  = static_cast<size_t>(MemoryCategory::GEOMETRY);
+
+			std::vector<uint32_t> data = { 0, 1, 2 };
+
+			Buffer::CreateInfo info;
+			info.device        = &m_context.getDevice();
+			info.commandSystem = &m_commandSystem;
+			info.data          = data.data();
+			info.dataSize      = sizeof(uint32_t) * data.size();
+			info.dataCount     = static_cast<uint32_t>(data.size());
+			info.name          = "Category Test Index Buffer";
+
+			Buffer buffer = Buffer::CreateIndexBuffer(info);
+
+			// The index buffer counts as geometry, its staging memory is freed again
+			Assert::IsTrue(allocator.getStats().categoryBytes[geometry] > before.categoryBytes[geometry]);
+
+			buffer.cleanup();
+
+			Assert::IsTrue(allocator.getStats().categoryBytes[geometry] == before.categoryBytes[geometry]);
+		}
+
+		TEST_METHOD(UploadContextWrap)
+		{
+			std::vector<uint32_t> data(1000);
+			for (uint32_t i = 0; i < data.size(); i++)
+				data[i] = i;
+
+			// A ring much smaller than the data has to wrap and wait for its own copies
+			UploadContext::CreateInfo contextInfo{};
+			contextInfo.device = &m_context.getDevice();
+			contextInfo.size   = 1024;
+
+			UploadContext context;
+			context.init(contextInfo);
+
+			Buffer::CreateInfo info;
+			info.device   = &m_context.getDevice();
+			info.dataSize = sizeof(uint32_t) * data.size();
+			info.flags    = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+			Buffer buffer = Buffer::CreateReadbackBuffer(info);
+
+			context.upload(buffer.getBuffer(), 0, data.data(), info.dataSize);
+			context.wait(context.submit());
+
+			Assert::IsTrue(memcmp(buffer.getMap(), data.data(), static_cast<size_t>(info.dataSize)) == 0);
+
+			buffer.cleanup();
+			context.cleanup();
+		}
+
+	private:
+		Window        m_window;
+		SystemContext m_context;
+		CommandSystem m_commandSystem;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Queue Timeline
+	//
+	TEST_CLASS(QueueTimelineTest)
+	{
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			m_window.init(100, 100);
+			m_context.init(m_window);
+			m_commandSystem.init(m_context.getDevice(), 2);
+		}
+
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			m_commandSystem.cleanup();
+			m_context.cleanup();
+			m_window.cleanup();
+		}
+
+		TEST_METHOD(DeferredRelease)
+		{
+			const Device&  device   = m_context.getDevice();
+			QueueTimeline& timeline = device.getGraphicsTimeline();
+
+			bool released = false;
+			timeline.defer([&]() { released = true; });
+
+			// Nothing was submitted after the release was deferred, so it has to wait
+			timeline.collect();
+			Assert::IsFalse(released);
+
+			VkCommandBuffer cmdBuf = m_commandSystem.beginSingleTimeCommands();
+			uint64_t        value  = m_commandSystem.submitSingleTimeCommands(cmdBuf, device.getGraphicsQueue());
+
+			Assert::IsTrue(value == timeline.getSubmittedValue());
+
+			timeline.wait(value);
+			timeline.collect();
+
+			Assert::IsTrue(timeline.isComplete(value));
+			Assert::IsTrue(released);
+
+			m_commandSystem.freeSingleTimeCommands(cmdBuf);
+		}
+
 	private:
 		Window        m_window;
 		SystemContext m_context;
 		CommandSystem m_commandSystem;
 	};
 
+	// ---------------------------------------------------------------------------------------------------------
+	// GPU Profiler
+	//
+	TEST_CLASS(GpuProfilerTest)
+	{
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			m_window.init(100, 100);
+			m_context.init(m_window);
+			m_commandSystem.init(m_context.getDevice(), 2);
+		}
+
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			m_commandSystem.cleanup();
+			m_context.cleanup();
+			m_window.cleanup();
+		}
+
+		TEST_METHOD(ScopesAreReadNextFrame)
+		{
+			const Device& device = m_context.getDevice();
+
+			GpuProfiler::CreateInfo info{};
+			info.device         = &device;
+			info.framesInFlight = 1;
+			info.historySize    = 4;
+
+			GpuProfiler profiler;
+			profiler.init(info);
+
+			// Scopes of the same name share one timing
+			VkCommandBuffer cmdBuf = m_commandSystem.beginSingleTimeCommands();
+			profiler.beginFrame(cmdBuf, 0);
+			profiler.endScope(cmdBuf, profiler.beginScope(cmdBuf, "Test"));
+			profiler.endScope(cmdBuf, profiler.beginScope(cmdBuf, "Test"));
+			m_commandSystem.endSingleTimeCommands(cmdBuf, device.getGraphicsQueue());
+
+			Assert::IsTrue(profiler.getTimings().size() == 1);
+			Assert::IsTrue(profiler.m_sampleCount == 0);
+
+			cmdBuf = m_commandSystem.beginSingleTimeCommands();
+			profiler.beginFrame(cmdBuf, 0);
+			m_commandSystem.endSingleTimeCommands(cmdBuf, device.getGraphicsQueue());
+
+			Assert::IsTrue(profiler.m_sampleCount == 1);
+			Assert::IsTrue(profiler.getTimings()[0].latest >= 0.0f);
+
+			profiler.cleanup();
+		}
+
+	private:
+		Window        m_window;
+		SystemContext m_context;
+		CommandSystem m_commandSystem;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Job System
+	//
+	TEST_CLASS(JobSystemTest)
+	{
+		TEST_METHOD(RunsEveryJobOnce)
+		{
+			JobSystem::CreateInfo info{};
+			info.threadCount = 4;
+
+			JobSystem jobSystem;
+			jobSystem.init(info);
+
+			// Runs back to back reuse the same workers
+			for (uint32_t run = 0; run < 10; run++)
+			{
+				std::vector<uint32_t> counts(100, 0);
+				bool                  validThreads = true;
+
+				jobSystem.run(static_cast<uint32_t>(counts.size()), [&](uint32_t job, uint32_t thread) {
+					counts[job]++;
+					if (thread >= jobSystem.getThreadCount())
+						validThreads = false;
+				});
+
+				for (uint32_t count : counts)
+					Assert::IsTrue(count == 1);
+				Assert::IsTrue(validThreads);
+			}
+
+			jobSystem.cleanup();
+		}
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// CPU Profiler
+	//
+	TEST_CLASS(CpuProfilerTest)
+	{
+		TEST_METHOD(TraceHasEveryThread)
+		{
+			std::thread worker([]() {
+				CpuProfiler::SetThreadName("Test Worker");
+				CpuProfiler::Zone zone("Worker Zone");
+			});
+			worker.join();
+
+			{
+				CpuProfiler::Zone zone("Main Zone");
+			}
+
+			Assert::IsTrue(CpuProfiler::WriteTrace("cpu_trace_test.json"));
+
+			std::ifstream file("cpu_trace_test.json");
+			std::stringstream trace;
+			trace << file.rdbuf();
+
+			// Zones of threads that already exited are kept
+			Assert::IsTrue(trace.str().find("\"Test Worker\"") != std::string::npos);
+			Assert::IsTrue(trace.str().find("\"Worker Zone\"") != std::string::npos);
+			Assert::IsTrue(trace.str().find("\"Main Zone\"") != std::string::npos);
+		}
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Shader Compiler
+	//
+	TEST_CLASS(ShaderCompilerTest)
+	{
+		TEST_METHOD(CompilesAndCaches)
+		{
+			std::filesystem::create_directories("shader_compiler_test");
+			{
+				std::ofstream include("shader_compiler_test/common.glsl");
+				include << "const uint groupSize = 8;\n";
+
+				std::ofstream source("shader_compiler_test/test.comp");
+				source << "#version 460\n#extension GL_GOOGLE_include_directive : enable\n#include \"common.glsl\"\n";
+				source << "layout(local_size_x = groupSize) in;\nvoid main() {}\n";
+			}
+
+			ShaderCompiler::CreateInfo info{};
+			info.sourceDirectory = "shader_compiler_test";
+			info.cacheDirectory  = "shader_compiler_test/Cache";
+			info.watch           = false;
+
+			ShaderCompiler compiler;
+			compiler.init(info);
+			std::vector<uint32_t> compiled = compiler.load("test.comp");
+			compiler.cleanup();
+
+			// SPIR-V magic number
+			Assert::IsFalse(compiled.empty());
+			Assert::IsTrue(compiled[0] == 0x07230203);
+
+			// A different source misses the cache
+			std::vector<uint32_t>                code;
+			std::vector<ShaderCompiler::Include> includes;
+			Assert::IsFalse(compiler.readCache("test.comp", compiler.hashSource(std::string()), code, includes));
+
+			// The include is recorded with the cached code
+			std::string source;
+			Assert::IsTrue(compiler.readSource("test.comp", source));
+			Assert::IsTrue(compiler.readCache("test.comp", compiler.hashSource(source), code, includes));
+			Assert::IsTrue(code == compiled);
+			Assert::IsTrue(includes.size() == 1 && includes[0].name == "common.glsl");
+
+			// Changing the include makes the cached code stale
+			{
+				std::ofstream include("shader_compiler_test/common.glsl");
+				include << "const uint groupSize = 16;\n";
+			}
+			Assert::IsFalse(compiler.readCache("test.comp", compiler.hashSource(source), code, includes));
+		}
+	};
+
 	// ---------------------------------------------------------------------------------------------------------
 	// Descriptor Set
 	//
@@ -264,4 +627,496 @@ namespace CoreTest
 		SystemContext m_context;
 		CommandSystem m_commandSystem;
 	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Texture Compressor
+	//
+	TEST_CLASS(TextureCompressorTest)
+	{
+	public:
+		TEST_METHOD(MipChainSizes)
+		{
+			std::vector<uint8_t> pixels(37 * 23 * 4, 128);
+
+			auto image = TextureCompressor::Compress(pixels.data(), 37, 23, VK_FORMAT_BC7_SRGB_BLOCK, 0);
+			Assert::IsTrue(image.levels.size() == 6);
+			Assert::IsTrue(image.levels[0].data.size() == 10 * 6 * 16);
+			Assert::IsTrue(image.levels[5].width == 1 && image.levels[5].height == 1);
+
+			image = TextureCompressor::Compress(pixels.data(), 37, 23, VK_FORMAT_BC4_UNORM_BLOCK, 1);
+			Assert::IsTrue(image.levels[0].data.size() == 10 * 6 * 8);
+		}
+
+		TEST_METHOD(BC7RoundTrip)
+		{
+			// A solid color keeps every channel within the precision of the endpoints
+			uint8_t pixels[16 * 4];
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				pixels[4 * i + 0] = 200;
+				pixels[4 * i + 1] = 100;
+				pixels[4 * i + 2] = 50;
+				pixels[4 * i + 3] = 255;
+			}
+
+			uint8_t block[16];
+			uint8_t decoded[16 * 4];
+			TextureCompressor::EncodeBC7Block(pixels, block);
+			DecodeBC7Mode6(block, decoded);
+			Assert::IsTrue(MaxError(pixels, decoded, 4) <= 1);
+
+			// A gradient between two colors lies on one line, so only the index precision is lost
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = i % 4;
+				pixels[4 * i + 0] = static_cast<uint8_t>(255 - 85 * x);
+				pixels[4 * i + 1] = 32;
+				pixels[4 * i + 2] = static_cast<uint8_t>(85 * x);
+				pixels[4 * i + 3] = 255;
+			}
+
+			TextureCompressor::EncodeBC7Block(pixels, block);
+			DecodeBC7Mode6(block, decoded);
+			Assert::IsTrue(MaxError(pixels, decoded, 4) <= 4);
+		}
+
+		TEST_METHOD(BC4RoundTrip)
+		{
+			// Only the green channel is encoded, the others hold values that must be ignored
+			uint8_t pixels[16 * 4];
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				pixels[4 * i + 0] = 255;
+				pixels[4 * i + 1] = 77;
+				pixels[4 * i + 2] = 0;
+				pixels[4 * i + 3] = 255;
+			}
+
+			uint8_t block[8];
+			uint8_t decoded[16];
+			TextureCompressor::EncodeBC4Block(pixels, 1, block);
+			DecodeBC4(block, decoded);
+			Assert::IsTrue(MaxError(pixels + 1, decoded, 1) == 0);
+
+			// A gradient from black to white is limited by the spacing of the 8 palette entries
+			for (uint32_t i = 0; i < 16; i++)
+				pixels[4 * i + 1] = static_cast<uint8_t>(17 * i);
+
+			TextureCompressor::EncodeBC4Block(pixels, 1, block);
+			DecodeBC4(block, decoded);
+			Assert::IsTrue(MaxError(pixels + 1, decoded, 1) <= 19);
+		}
+
+	private:
+		// Largest difference between the source channels, read with a stride of 4, and the tightly packed
+		// decoded channels
+		static int32_t MaxError(const uint8_t* source, const uint8_t* decoded, uint32_t channels)
+		{
+			int32_t error = 0;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				for (uint32_t c = 0; c < channels; c++)
+					error = std::max(error, std::abs(source[4 * i + c] - decoded[channels * i + c]));
+			}
+			return error;
+		}
+
+		static uint32_t ReadBits(const uint8_t* block, uint32_t& position, uint32_t count)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; i++, position++)
+				value |= ((block[position / 8] >> (position % 8)) & 1u) << i;
+			return value;
+		}
+
+		// Reference decoder for BC7 mode 6 written from the format specification
+		static void DecodeBC7Mode6(const uint8_t* block, uint8_t* rgba)
+		{
+			static const uint32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+			uint32_t position = 0;
+			Assert::IsTrue(ReadBits(block, position, 7) == (1u << 6));
+
+			uint32_t endpoints[2][4];
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				endpoints[0][c] = ReadBits(block, position, 7) << 1;
+				endpoints[1][c] = ReadBits(block, position, 7) << 1;
+			}
+
+			uint32_t p0 = ReadBits(block, position, 1);
+			uint32_t p1 = ReadBits(block, position, 1);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				endpoints[0][c] |= p0;
+				endpoints[1][c] |= p1;
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t index = ReadBits(block, position, i == 0 ? 3 : 4);
+				for (uint32_t c = 0; c < 4; c++)
+					rgba[4 * i + c] = static_cast<uint8_t>(((64 - weights[index]) * endpoints[0][c] + weights[index] * endpoints[1][c] + 32) >> 6);
+			}
+		}
+
+		// Reference decoder for BC4 with both the 8 and the 6 value palette
+		static void DecodeBC4(const uint8_t* block, uint8_t* values)
+		{
+			int32_t r0 = block[0];
+			int32_t r1 = block[1];
+
+			int32_t palette[8] = { r0, r1 };
+			if (r0 > r1)
+			{
+				for (int32_t i = 2; i < 8; i++)
+					palette[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+			}
+			else
+			{
+				for (int32_t i = 2; i < 6; i++)
+					palette[i] = ((6 - i) * r0 + (i - 1) * r1) / 5;
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+
+			uint32_t position = 16;
+			for (uint32_t i = 0; i < 16; i++)
+				values[i] = static_cast<uint8_t>(palette[ReadBits(block, position, 3)]);
+		}
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Mip Generator
+	//
+	TEST_CLASS(MipGeneratorTest)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			m_window.init(100, 100);
+			m_context.init(m_window);
+			m_commandSystem.init(m_context.getDevice(), 2);
+		}
+
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			m_commandSystem.cleanup();
+			m_context.cleanup();
+			m_window.cleanup();
+		}
+
+		TEST_METHOD(SupportedTargets)
+		{
+			Assert::IsTrue(MipGenerator::IsSupported(VK_FORMAT_R8G8B8A8_SRGB, 4096, 1024));
+			Assert::IsTrue(MipGenerator::IsSupported(VK_FORMAT_R8G8B8A8_UNORM, 2, 1));
+
+			Assert::IsFalse(MipGenerator::IsSupported(VK_FORMAT_R8_UNORM, 512, 512));
+			Assert::IsFalse(MipGenerator::IsSupported(VK_FORMAT_R8G8B8A8_UNORM, 8192, 512));
+			Assert::IsFalse(MipGenerator::IsSupported(VK_FORMAT_R8G8B8A8_UNORM, 1, 1));
+		}
+
+		TEST_METHOD(MatchesBoxFilter)
+		{
+			const Device& device = m_context.getDevice();
+
+			// Odd sizes below level 0 and more than one workgroup in each direction
+			const uint32_t width     = 130;
+			const uint32_t height    = 70;
+			const uint32_t mipLevels = 8;
+
+			MipGenerator::CreateInfo generatorInfo{};
+			generatorInfo.device = &device;
+
+			MipGenerator generator;
+			generator.init(generatorInfo);
+
+			Image::CreateInfo imageInfo{};
+			imageInfo.width      = width;
+			imageInfo.height     = height;
+			imageInfo.mipLevels  = mipLevels;
+			imageInfo.layerCount = 1;
+			imageInfo.format     = VK_FORMAT_R8G8B8A8_UNORM;
+			imageInfo.usage      = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+			imageInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			imageInfo.flags      = MipGenerator::GetImageFlags();
+			imageInfo.device     = &device;
+			imageInfo.name       = "Mip Generator Test Image";
+			Image image = Image::CreateImage(imageInfo);
+
+			// Level 0 goes in at the start of the buffer and every level comes back after it
+			std::vector<VkDeviceSize> offsets;
+			VkDeviceSize              bufferSize = 0;
+			for (uint32_t level = 0; level < mipLevels; level++)
+			{
+				offsets.push_back(bufferSize);
+				bufferSize += 4ull * std::max(width >> level, 1u) * std::max(height >> level, 1u);
+			}
+
+			VkBuffer   buffer;
+			Allocation memory;
+			Buffer::CreateBuffer(
+				bufferSize,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				buffer, memory,
+				device,
+				MemoryCategory::OTHER,
+				"Mip Generator Test Buffer");
+
+			uint8_t* data = static_cast<uint8_t*>(memory.map);
+			for (uint32_t y = 0; y < height; y++)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					uint8_t* texel = data + 4 * (y * width + x);
+					texel[0] = static_cast<uint8_t>(x * 255 / (width - 1));
+					texel[1] = static_cast<uint8_t>(y * 255 / (height - 1));
+					texel[2] = static_cast<uint8_t>((x * 7 + y * 13) & 0xFF);
+					texel[3] = ((x / 3 + y / 5) & 1) ? 255 : 0;
+				}
+			}
+
+			VkCommandBuffer cmdBuf = m_commandSystem.beginSingleTimeCommands();
+
+			Image::TransitionInfo transitionInfo{};
+			transitionInfo.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+			transitionInfo.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			transitionInfo.srcStageMask  = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			transitionInfo.dstStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			transitionInfo.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			Image::TransitionImage(cmdBuf, image.image, transitionInfo);
+
+			Image::CopyFromBuffer(cmdBuf, image.image, buffer, width, height, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 });
+
+			MipGenerator::Target target{};
+			target.image     = image.image;
+			target.format    = VK_FORMAT_R8G8B8A8_UNORM;
+			target.width     = width;
+			target.height    = height;
+			target.mipLevels = mipLevels;
+			MipGenerator::Resources resources = generator.record(cmdBuf, { target });
+
+			// Read back every level that was built
+			transitionInfo.baseMipLevel  = 1;
+			transitionInfo.levelCount    = mipLevels - 1;
+			transitionInfo.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			transitionInfo.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			transitionInfo.srcStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			transitionInfo.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			transitionInfo.dstStageMask  = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			transitionInfo.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			Image::TransitionImage(cmdBuf, image.image, transitionInfo);
+
+			std::vector<VkBufferImageCopy> regions;
+			for (uint32_t level = 1; level < mipLevels; level++)
+			{
+				VkBufferImageCopy region{};
+				region.bufferOffset     = offsets[level];
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+				region.imageExtent      = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+				regions.push_back(region);
+			}
+			vkCmdCopyImageToBuffer(cmdBuf, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, static_cast<uint32_t>(regions.size()), regions.data());
+
+			m_commandSystem.endSingleTimeCommands(cmdBuf, device.getGraphicsQueue());
+
+			// Every level is the 2x2 box filter of the level below it. An odd last row or column is dropped and
+			// levels of width or height 1 repeat their edge
+			std::vector<float> reference(data, data + 4ull * width * height);
+			uint32_t           levelWidth  = width;
+			uint32_t           levelHeight = height;
+			for (uint32_t level = 1; level < mipLevels; level++)
+			{
+				uint32_t nextWidth  = std::max(levelWidth / 2, 1u);
+				uint32_t nextHeight = std::max(levelHeight / 2, 1u);
+
+				std::vector<float> next(4ull * nextWidth * nextHeight);
+				for (uint32_t y = 0; y < nextHeight; y++)
+				{
+					for (uint32_t x = 0; x < nextWidth; x++)
+					{
+						uint32_t x0 = std::min(2 * x, levelWidth - 1), x1 = std::min(2 * x + 1, levelWidth - 1);
+						uint32_t y0 = std::min(2 * y, levelHeight - 1), y1 = std::min(2 * y + 1, levelHeight - 1);
+
+						for (uint32_t c = 0; c < 4; c++)
+						{
+							next[4 * (y * nextWidth + x) + c] = 0.25f * (
+								reference[4 * (y0 * levelWidth + x0) + c] + reference[4 * (y0 * levelWidth + x1) + c] +
+								reference[4 * (y1 * levelWidth + x0) + c] + reference[4 * (y1 * levelWidth + x1) + c]);
+						}
+					}
+				}
+
+				reference   = std::move(next);
+				levelWidth  = nextWidth;
+				levelHeight = nextHeight;
+
+				// The levels are rounded to 8 bits, so the error grows by at most half a step per level
+				const uint8_t* result = data + offsets[level];
+				for (size_t i = 0; i < reference.size(); i++)
+					Assert::IsTrue(std::abs(reference[i] - result[i]) <= 0.5f * level + 1.0f);
+			}
+
+			generator.release(resources);
+			Buffer::DestroyBuffer(buffer, memory, device);
+			image.cleanup(device.getLogical());
+			generator.cleanup();
+		}
+
+	private:
+		Window        m_window;
+		SystemContext m_context;
+		CommandSystem m_commandSystem;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------
+	// Texture Streamer
+	//
+	TEST_CLASS(TextureStreamerTest)
+	{
+	public:
+		TEST_METHOD(FeedbackToWantedLevel)
+		{
+			// The bias is removed and the first level of the bound image is added
+			Assert::IsTrue(TextureStreamer::GetWantedLevel(TEXTURE_LOD_BIAS, 0, 5) == 0);
+			Assert::IsTrue(TextureStreamer::GetWantedLevel(TEXTURE_LOD_BIAS + 1, 2, 5) == 3);
+
+			// Levels finer than the full image or coarser than the tail are clamped
+			Assert::IsTrue(TextureStreamer::GetWantedLevel(TEXTURE_LOD_BIAS - 3, 1, 5) == 0);
+			Assert::IsTrue(TextureStreamer::GetWantedLevel(2 * TEXTURE_LOD_BIAS, 3, 5) == 5);
+		}
+
+		TEST_METHOD(IdleTexturesFallBack)
+		{
+			TextureStreamer streamer;
+			streamer.m_framesInFlight = 1;
+			streamer.m_idleFrames     = 10;
+
+			// A streamed texture with the levels from 1 on resident, and a texture that is not streamed
+			TextureStreamer::Entry streamed;
+			streamed.stream.file       = "streamed.ktx2";
+			streamed.stream.firstLevel = 4;
+			streamed.firstLevel        = 1;
+			streamed.wantedLevel       = 1;
+			streamed.image.image       = reinterpret_cast<VkImage>(static_cast<uintptr_t>(1));
+			streamed.size              = 1000;
+			streamed.boundLevel        = { 1 };
+			streamer.m_entries.push_back(streamed);
+			streamer.m_residentSize = 1000;
+
+			TextureStreamer::Entry plain;
+			plain.boundLevel = { 0 };
+			streamer.m_entries.push_back(plain);
+
+			// Requests are relative to the bound image and every slot is reset after it was read
+			std::vector<uint32_t> feedback = { TEXTURE_LOD_BIAS, TEXTURE_LOD_BIAS };
+			streamer.m_frame = 1;
+			streamer.applyFeedback(feedback.data(), 0);
+
+			Assert::IsTrue(streamer.m_entries[0].wantedLevel == 1);
+			Assert::IsTrue(streamer.m_entries[0].lastUsed == 1);
+			Assert::IsTrue(streamer.m_entries[1].lastUsed == 0);
+			Assert::IsTrue(feedback[0] == TEXTURE_LOD_NO_REQUEST && feedback[1] == TEXTURE_LOD_NO_REQUEST);
+
+			// Without requests the levels are kept until the texture was idle for longer than the idle frames
+			streamer.m_frame = 11;
+			streamer.applyFeedback(feedback.data(), 0);
+			Assert::IsTrue(streamer.m_entries[0].wantedLevel == 1);
+
+			streamer.m_frame = 12;
+			streamer.applyFeedback(feedback.data(), 0);
+			Assert::IsTrue(streamer.m_entries[0].wantedLevel == 4);
+
+			// Then the texture falls back to its tail and its image is retired
+			streamer.scheduleLoads();
+			Assert::IsTrue(streamer.m_entries[0].image.image == VK_NULL_HANDLE);
+			Assert::IsTrue(streamer.m_entries[0].firstLevel == 4);
+			Assert::IsTrue(streamer.m_residentSize == 0);
+			Assert::IsTrue(streamer.m_retired.size() == 1);
+			Assert::IsTrue(streamer.m_requests.empty());
+		}
+
+		// A 64x64 BC7 texture whose tail starts at level 4. Its levels from 1 on take 1392 bytes, all of them 5488
+		static TextureStreamer::Entry MakeEntry(uint32_t firstLevel, uint32_t wantedLevel, uint64_t lastUsed)
+		{
+			TextureStreamer::Entry entry;
+			entry.stream.file       = "streamed.ktx2";
+			entry.stream.format     = VK_FORMAT_BC7_UNORM_BLOCK;
+			entry.stream.width      = 64;
+			entry.stream.height     = 64;
+			entry.stream.levelCount = 7;
+			entry.stream.firstLevel = 4;
+			entry.firstLevel        = firstLevel;
+			entry.wantedLevel       = wantedLevel;
+			entry.lastUsed          = lastUsed;
+			entry.boundLevel        = { firstLevel, firstLevel };
+
+			if (firstLevel < entry.stream.firstLevel)
+			{
+				entry.image.image = reinterpret_cast<VkImage>(static_cast<uintptr_t>(lastUsed));
+				entry.size        = TextureStreamer::GetLevelsSize(entry.stream, firstLevel);
+			}
+
+			return entry;
+		}
+
+		TEST_METHOD(BudgetEvictsLeastRecentlyUsed)
+		{
+			Assert::IsTrue(TextureStreamer::GetLevelsSize(MakeEntry(4, 4, 0).stream, 1) == 1392);
+			Assert::IsTrue(TextureStreamer::GetLevelsSize(MakeEntry(4, 4, 0).stream, 0) == 5488);
+
+			// Two resident textures and a more recently used one that wants its full chain. Only one of the
+			// resident textures has to go to make room
+			TextureStreamer streamer;
+			streamer.m_budget = 2 * 1392 + 5488 - 1;
+			streamer.m_entries.push_back(MakeEntry(1, 1, 5));
+			streamer.m_entries.push_back(MakeEntry(1, 1, 8));
+			streamer.m_entries.push_back(MakeEntry(4, 0, 10));
+			streamer.m_residentSize = 2 * 1392;
+
+			streamer.scheduleLoads();
+
+			// The least recently used texture falls back to its tail
+			Assert::IsTrue(streamer.m_entries[0].image.image == VK_NULL_HANDLE);
+			Assert::IsTrue(streamer.m_entries[0].firstLevel == 4);
+			Assert::IsTrue(streamer.m_entries[1].image.image != VK_NULL_HANDLE);
+			Assert::IsTrue(streamer.m_retired.size() == 1);
+
+			// The load is requested and its levels already count against the budget
+			Assert::IsTrue(streamer.m_entries[2].busy);
+			Assert::IsTrue(streamer.m_requests.size() == 1);
+			Assert::IsTrue(streamer.m_requests[0].index == 2 && streamer.m_requests[0].firstLevel == 0);
+			Assert::IsTrue(streamer.m_residentSize == 1392 + 5488);
+			Assert::IsTrue(streamer.m_residentSize <= streamer.m_budget);
+		}
+
+		TEST_METHOD(BudgetKeepsMoreRecentlyUsed)
+		{
+			// The texture that wants its full chain was used before the resident ones, so it does not evict them
+			TextureStreamer streamer;
+			streamer.m_budget = 2 * 1392 + 5488 - 1;
+			streamer.m_entries.push_back(MakeEntry(1, 1, 5));
+			streamer.m_entries.push_back(MakeEntry(1, 1, 8));
+			streamer.m_entries.push_back(MakeEntry(4, 0, 3));
+			streamer.m_residentSize = 2 * 1392;
+
+			streamer.scheduleLoads();
+
+			Assert::IsTrue(streamer.m_entries[0].image.image != VK_NULL_HANDLE);
+			Assert::IsTrue(streamer.m_entries[1].image.image != VK_NULL_HANDLE);
+			Assert::IsFalse(streamer.m_entries[2].busy);
+			Assert::IsTrue(streamer.m_requests.empty());
+			Assert::IsTrue(streamer.m_retired.empty());
+			Assert::IsTrue(streamer.m_residentSize == 2 * 1392);
+
+			// A smaller request fits next to them without evicting anything
+			streamer.m_entries[2].wantedLevel = 1;
+			streamer.scheduleLoads();
+
+			Assert::IsTrue(streamer.m_entries[2].busy);
+			Assert::IsTrue(streamer.m_retired.empty());
+			Assert::IsTrue(streamer.m_residentSize == 3 * 1392);
+		}
+	};
 }
@@ -14,6 +14,8 @@
 #include "Application/event.h"
 #include "Application/Gui.h"
 #include "Application/model.h"
+#include "Application/cpu_profiler.h"
+#include "Application/mesh_simplifier.h"
 
 #include "Core/system_context.h"
 #include "Core/swapchain.h"
@@ -29,5 +31,15 @@
 #include "Core/rendering_structures.h"
 #include "Core/framebuffer.h"
 #include "Core/texture.h"
+#include "Core/texture_compression.h"
+#include "Core/texture_streamer.h"
+#include "Core/mip_generator.h"
+#include "Core/upload_context.h"
+#include "Core/job_system.h"
+#include "Core/gpu_profiler.h"
+#include "Core/pipeline_cache.h"
+#include "Core/shader_compiler.h"
+
+#include "Utils/utilities.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
\ No newline at end of file
@@ -71,6 +71,7 @@ project "RayTrace"
 	{
 		"glfw3",
 		"vulkan-1",
+		"shaderc_shared",
 		"ImGui"
 	}
 
@@ -152,6 +153,7 @@ project "Tests"
 	{
 		"glfw3",
 		"vulkan-1",
+		"shaderc_shared",
 		"ImGui",
 
 		-- It's unfortunate, but it has to be done
@@ -160,28 +162,45 @@ project "Tests"
 		"camera.obj",
 		"command.obj",
 		"cornell_box.obj",
+		"cpu_profiler.obj",
 		"cpu_raytracer.obj",
 		"depth_buffer.obj",
 		"descriptor.obj",
 		"device.obj",
 		"event.obj",
 		"framebuffer.obj",
+		"gpu_profiler.obj",
+		"gltf.obj",
 		"Gui.obj",
 		"image.obj",
+		"job_system.obj",
 		"logging.obj",
+		"memory_allocator.obj",
+		"mesh_simplifier.obj",
+		"mip_generator.obj",
 		"model.obj",
 		"pch.obj",
 		"pipeline.obj",
+		"pipeline_cache.obj",
+		"post_processor.obj",
+		"queue_timeline.obj",
 		"renderer.obj",
 		"render_pass.obj",
 		"rendering_structures.obj",
+		"scene.obj",
 		"shader.obj",
+		"shader_compiler.obj",
 		"simple_cube_scene.obj",
 		"simpleDenoise.obj",
+		"staging_window.obj",
 		"stb_image_usage.obj",
 		"swapchain.obj",
 		"system_context.obj",
 		"texture.obj",
+		"texture_compression.obj",
+		"texture_streamer.obj",
+		"upload_context.obj",
+		"utilities.obj",
 		"window.obj"
 	}
 